@@ -0,0 +1,307 @@
+#include "assetLoader.h"
+#include <fstream>
+#include <mutex>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+AssetLoader::AssetLoader() {
+	graphics = NULL;
+	pack = NULL;
+	QueryPerformanceFrequency(&timerFreq);
+	loadStart.QuadPart = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+AssetLoader::~AssetLoader() {
+	clear();
+}
+
+//=============================================================================
+// Remove all steps
+//=============================================================================
+void AssetLoader::clear() {
+	for (size_t i = 0; i < textures.size(); i++)
+		SAFE_DELETE(textures[i]);
+	textures.clear();
+	nodes.clear();
+}
+
+//=============================================================================
+// Add a step
+//=============================================================================
+int AssetLoader::addTask(const char *name, const Task &task, bool worker, int dep0, int dep1) {
+	Node node;
+	node.name = name;
+	node.task = task;
+	node.worker = worker;
+	node.waiting = 0;
+	node.done = false;
+	node.failed = false;
+	node.start = node.end = 0;
+	node.thread = 0;
+	nodes.push_back(node);
+	int n = (int)nodes.size() - 1;
+	addDependency(n, dep0);
+	addDependency(n, dep1);
+	return n;
+}
+
+//=============================================================================
+// Make step n wait for step dep
+//=============================================================================
+void AssetLoader::addDependency(int n, int dep) {
+	if (n < 0 || n >= (int)nodes.size() || dep < 0 || dep >= (int)nodes.size() || dep == n)
+		return;
+	nodes[n].deps.push_back(dep);
+}
+
+//=============================================================================
+// Add a texture: read on a worker, create on the loading thread
+//=============================================================================
+int AssetLoader::addTexture(TextureManager *texture, const char *file) {
+	TextureFile *t = new TextureFile();
+	t->texture = texture;
+	t->file = file;
+	t->inPack = false;
+	ZeroMemory(&t->view, sizeof(t->view));
+	textures.push_back(t);
+
+	int read = addTask(file, [this, t]() -> bool {
+		if (pack && pack->find(t->file, t->view)) {
+			t->inPack = true;
+			if (t->view.compressed && !pack->read(t->file, t->data))
+				return false;
+		}
+		else {
+			std::ifstream in(t->file, std::ios::binary);
+			if (!in)
+				return false;
+			t->data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			if (t->data.empty())
+				return false;
+		}
+		const void *data = t->data.empty() ? t->view.data : &t->data[0];
+		UINT size = t->data.empty() ? t->view.size : (UINT)t->data.size();
+		if (SUCCEEDED(Graphics::decodeImage(data, size, TRANSCOLOR, t->image)))
+			std::vector<BYTE>().swap(t->data);	// the pixels are all that is needed
+		return true;
+	}, true);
+
+	t->node = addTask(file, [this, t]() -> bool {
+		bool ok;
+		if (!t->image.pixels.empty())
+			ok = t->texture->initialize(graphics, t->inPack ? pack : NULL, t->file, t->image);
+		else {									// not decoded by WIC, D3DX decodes it here
+			const void *data = t->data.empty() ? t->view.data : &t->data[0];
+			UINT size = t->data.empty() ? t->view.size : (UINT)t->data.size();
+			ok = t->texture->initialize(graphics, t->inPack ? pack : NULL, t->file, data, size);
+		}
+		std::vector<BYTE>().swap(t->data);		// free the file contents
+		std::vector<DWORD>().swap(t->image.pixels);
+		return ok;
+	}, false, read);
+	return t->node;
+}
+
+//=============================================================================
+// Return the step that creates texture t
+//=============================================================================
+int AssetLoader::findTexture(const TextureManager *t) const {
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (textures[i]->texture == t)
+			return textures[i]->node;
+	}
+	return assetLoaderNS::NONE;
+}
+
+//=============================================================================
+// Add an Image that depends on its texture
+//=============================================================================
+int AssetLoader::addImage(Image *image, int width, int height, int ncols, TextureManager *texture) {
+	int t = findTexture(texture);
+	std::string name = "Image " + ((t == assetLoaderNS::NONE) ? std::string() : nodes[t].name);
+	return addTask(name.c_str(), [this, image, width, height, ncols, texture]() -> bool {
+		return image->initialize(graphics, width, height, ncols, texture);
+	}, false, t);
+}
+
+//=============================================================================
+// Return milli-seconds since load() started
+//=============================================================================
+float AssetLoader::now() const {
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return (float)(t.QuadPart - loadStart.QuadPart) * 1000.0f / (float)timerFreq.QuadPart;
+}
+
+//=============================================================================
+// Run one step
+//=============================================================================
+void AssetLoader::runNode(int n, int thread) {
+	Node &node = nodes[n];
+	node.thread = thread;
+	node.start = now();
+	try {
+		node.failed = !node.task();
+	}
+	catch (...) { node.failed = true; }
+	node.end = now();
+}
+
+//=============================================================================
+// Finish a step and release or skip its dependents
+//=============================================================================
+void AssetLoader::finishNode(int n, int &doneCount, const Progress &progress) {
+	Node &node = nodes[n];
+	node.done = true;
+	doneCount++;
+	if (progress)
+		progress(doneCount, (int)nodes.size(), node.name.c_str());
+	for (size_t i = 0; i < node.dependents.size(); i++) {
+		int d = node.dependents[i];
+		if (nodes[d].done)
+			continue;
+		if (node.failed) {
+			nodes[d].failed = true;				// skipped, never runs
+			finishNode(d, doneCount, progress);
+		}
+		else
+			nodes[d].waiting--;
+	}
+}
+
+//=============================================================================
+// Run every step in dependency order
+// Each round runs all ready worker steps in parallel, then all ready
+// loading thread steps, until nothing is left. Worker steps are queued as
+// they finish, and the loading thread finishes the queued steps between its
+// own, so progress is reported per step rather than once per round.
+//=============================================================================
+bool AssetLoader::load(Graphics *g, const AssetPack *p, JobSystem *jobs, const Progress &progress) {
+	graphics = g;
+	pack = p;
+	QueryPerformanceCounter(&loadStart);
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		nodes[i].dependents.clear();
+		nodes[i].waiting = (int)nodes[i].deps.size();
+		nodes[i].done = false;
+		nodes[i].failed = false;
+		nodes[i].start = nodes[i].end = 0;
+		nodes[i].thread = -1;
+	}
+	for (size_t i = 0; i < nodes.size(); i++) {
+		for (size_t d = 0; d < nodes[i].deps.size(); d++)
+			nodes[nodes[i].deps[d]].dependents.push_back((int)i);
+	}
+
+	int doneCount = 0;
+	std::vector<int> workerReady, mainReady;
+	while (doneCount < (int)nodes.size()) {
+		workerReady.clear();
+		mainReady.clear();
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (nodes[i].done || nodes[i].waiting > 0)
+				continue;
+			if (nodes[i].worker)
+				workerReady.push_back((int)i);
+			else
+				mainReady.push_back((int)i);
+		}
+		if (workerReady.empty() && mainReady.empty())
+			break;								// a dependency cycle
+
+		if (jobs) {
+			std::mutex lock;
+			std::vector<int> finished;			// worker steps run, in the order they finished
+			size_t reported = 0;				// of finished, those finishNode() has seen
+			auto report = [&]() {				// on the loading thread, outside the lock
+				for (;;) {
+					int n;
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						if (reported == finished.size())
+							return;
+						n = finished[reported++];
+					}
+					finishNode(n, doneCount, progress);
+				}
+			};
+			jobs->parallelFor((int)workerReady.size(), 1, [&](int begin, int end, int worker) {
+				for (int i = begin; i < end; i++) {
+					runNode(workerReady[i], worker);
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						finished.push_back(workerReady[i]);
+					}
+					if (worker == 0)
+						report();
+				}
+			});
+			report();
+		}
+		else {
+			for (size_t i = 0; i < workerReady.size(); i++) {
+				runNode(workerReady[i], 0);
+				finishNode(workerReady[i], doneCount, progress);
+			}
+		}
+
+		for (size_t i = 0; i < mainReady.size(); i++) {
+			if (nodes[mainReady[i]].done)
+				continue;						// skipped by a failure this round
+			runNode(mainReady[i], 0);
+			finishNode(mainReady[i], doneCount, progress);
+		}
+	}
+
+	if (doneCount < (int)nodes.size())
+		return false;
+	return getFailed() == NULL;
+}
+
+//=============================================================================
+// Return the name of the first failed step
+//=============================================================================
+const char* AssetLoader::getFailed() const {
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].failed || !nodes[i].done)
+			return nodes[i].name.c_str();
+	}
+	return NULL;
+}
+
+//=============================================================================
+// Write the step timings as a Chrome trace
+//=============================================================================
+bool AssetLoader::writeTimeline(const char *file) const {
+	std::ofstream out(file);
+	if (!out)
+		return false;
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		const Node &node = nodes[i];
+		if (node.thread < 0)
+			continue;							// skipped steps did not run
+		std::string name;
+		for (size_t c = 0; c < node.name.length(); c++) {
+			if (node.name[c] == '\\' || node.name[c] == '"')
+				name.push_back('\\');
+			name.push_back(node.name[c]);
+		}
+		if (!first)
+			out << ",\n";
+		first = false;
+		out << "{\"name\":\"" << name << "\",\"cat\":\"" << (node.worker ? "read" : "create")
+			<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << node.thread
+			<< ",\"ts\":" << (long long)(node.start * 1000.0f)
+			<< ",\"dur\":" << (long long)((node.end - node.start) * 1000.0f)
+			<< ",\"args\":{\"failed\":" << (node.failed ? "true" : "false") << "}}";
+	}
+	out << "\n]}\n";
+	return out.good();
+}
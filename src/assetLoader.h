@@ -0,0 +1,133 @@
+#ifndef _ASSETLOADER_H
+#define _ASSETLOADER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include <string>
+#include <functional>
+#include "image.h"
+#include "assetPack.h"
+#include "jobSystem.h"
+
+namespace assetLoaderNS {
+	const int   NONE = -1;				// no dependency
+}
+
+// Manifest of assets resolved as a dependency graph. A game registers its
+// textures, images and any other loading steps, then calls load().
+// Steps that only read and decode files run in parallel on JobSystem
+// threads; steps that use the graphics device run on the calling thread,
+// because the device is not created for multithreaded use. Each step runs
+// once all the steps it depends on have finished.
+class AssetLoader {
+public:
+	// Loading step. Returns false on error.
+	typedef std::function<bool()> Task;
+
+	// Called on the loading thread after each step with the number of steps
+	// done, the total and the name of the finished step. Steps on worker
+	// threads are reported while the others still run.
+	typedef std::function<void(int done, int total, const char *name)> Progress;
+
+private:
+	// One step of the graph
+	struct Node {
+		std::string name;
+		Task        task;
+		bool        worker;				// true to run on a worker thread
+		std::vector<int> deps;			// steps this one waits for
+		std::vector<int> dependents;	// steps waiting for this one, set by load()
+		int         waiting;			// unfinished steps this one depends on
+		bool        done;
+		bool        failed;				// failed, or skipped because a dependency failed
+		float       start, end;			// milli-seconds since load() started
+		int         thread;				// worker number that ran it, 0 for the loading thread, -1 if skipped
+	};
+
+	// A texture file read and decoded by a worker, then created on the
+	// loading thread
+	struct TextureFile {
+		TextureManager *texture;
+		const char  *file;
+		std::vector<BYTE> data;			// file contents if not used in place
+		AssetView   view;				// in place pack data
+		bool        inPack;				// file was found in the pack
+		DecodedImage image;				// pixels, empty if WIC could not decode the file
+		int         node;				// node that creates the texture
+	};
+
+	std::vector<Node> nodes;
+	std::vector<TextureFile*> textures;
+	Graphics    *graphics;
+	const AssetPack *pack;
+	LARGE_INTEGER timerFreq;			// Performance Counter frequency
+	LARGE_INTEGER loadStart;			// Performance Counter when load() started
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return milli-seconds since load() started.
+	float now() const;
+
+	// Run node n on thread and record its timing.
+	void runNode(int n, int thread);
+
+	// Mark node n finished, release its dependents and report progress.
+	// Dependents of a failed node are skipped.
+	void finishNode(int n, int &doneCount, const Progress &progress);
+
+	// Return the node that creates texture t, NONE if it is not registered.
+	int findTexture(const TextureManager *t) const;
+
+	// Loader holds pointers into itself, so it is not copied
+	AssetLoader(const AssetLoader&);
+	AssetLoader& operator=(const AssetLoader&);
+
+public:
+	// Constructor
+	AssetLoader();
+
+	// Destructor
+	virtual ~AssetLoader();
+
+	// Add a step. It runs after every step in deps (NONE entries are ignored).
+	// worker = true if the step may run on a worker thread.
+	// Returns the step number.
+	int addTask(const char *name, const Task &task, bool worker,
+		int dep0 = assetLoaderNS::NONE, int dep1 = assetLoaderNS::NONE);
+
+	// Make step n wait for step dep as well.
+	void addDependency(int n, int dep);
+
+	// Add a texture. The file is read and decoded on a worker thread, from the
+	// asset pack when there is one, and the texture is created from the
+	// pixels on the loading thread. Files WIC cannot decode are decoded by
+	// D3DX on the loading thread.
+	// Returns the step that finishes the texture.
+	int addTexture(TextureManager *texture, const char *file);
+
+	// Add an Image. It is initialized once its texture is loaded, if the
+	// texture was added with addTexture().
+	// Returns the step number.
+	int addImage(Image *image, int width, int height, int ncols, TextureManager *texture);
+
+	// Run every step.
+	// Pre: *g points to Graphics object
+	//      *p is the asset pack, or NULL for loose files
+	//      *jobs runs worker steps, or NULL to run them on this thread
+	// Post: returns false if a step failed; its dependents are skipped
+	bool load(Graphics *g, const AssetPack *p, JobSystem *jobs, const Progress &progress = Progress());
+
+	// Return the name of the first step that failed, NULL if none.
+	const char* getFailed() const;
+
+	// Write the timing of every step from the last load() as a Chrome
+	// trace (chrome://tracing or Perfetto). Returns false on error.
+	bool writeTimeline(const char *file) const;
+
+	// Remove all steps.
+	void clear();
+
+	// Return number of steps.
+	int getCount() const { return (int)nodes.size(); }
+};
+
+#endif
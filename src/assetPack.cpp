@@ -0,0 +1,442 @@
+#include "assetPack.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+
+namespace assetPackNS {
+	// A file being packed
+	struct PackFile {
+		std::string name;			// normalized name
+		UINT64      hash;
+		std::vector<BYTE> data;		// bytes to store
+		UINT        size;			// original size
+		UINT        flags;
+	};
+
+	//=========================================================================
+	// Add every file under dir to files
+	//=========================================================================
+	static bool listFiles(const std::string &dir, std::vector<std::string> &files) {
+		WIN32_FIND_DATA found;
+		HANDLE find = FindFirstFile((dir + "/*").c_str(), &found);
+		if (find == INVALID_HANDLE_VALUE)
+			return false;
+		do {
+			std::string name = found.cFileName;
+			if (name == "." || name == "..")
+				continue;
+			if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				listFiles(dir + "/" + name, files);
+			else
+				files.push_back(dir + "/" + name);
+		} while (FindNextFile(find, &found));
+		FindClose(find);
+		return true;
+	}
+
+	inline UINT read32(const BYTE *p) {
+		return (UINT)p[0] | (UINT)p[1] << 8 | (UINT)p[2] << 16 | (UINT)p[3] << 24;
+	}
+
+	//=========================================================================
+	// Write an LZ4 length continuation: 255 until less than 255 remains
+	//=========================================================================
+	static bool writeLength(BYTE *dst, int &op, int dstCapacity, int length) {
+		while (length >= 255) {
+			if (op >= dstCapacity)
+				return false;
+			dst[op++] = 255;
+			length -= 255;
+		}
+		if (op >= dstCapacity)
+			return false;
+		dst[op++] = (BYTE)length;
+		return true;
+	}
+
+	//=========================================================================
+	// Write one LZ4 sequence: literals, then a match unless matchLength is 0
+	//=========================================================================
+	static bool writeSequence(const BYTE *literals, int literalLength, int offset, int matchLength,
+		BYTE *dst, int &op, int dstCapacity) {
+		if (op >= dstCapacity)
+			return false;
+		int token = op++;
+		int ml = matchLength ? matchLength - 4 : 0;
+		dst[token] = (BYTE)(((literalLength < 15) ? literalLength : 15) << 4 | ((ml < 15) ? ml : 15));
+		if (literalLength >= 15 && !writeLength(dst, op, dstCapacity, literalLength - 15))
+			return false;
+		if (op + literalLength > dstCapacity)
+			return false;
+		memcpy(dst + op, literals, literalLength);
+		op += literalLength;
+		if (matchLength == 0)
+			return true;
+		if (op + 2 > dstCapacity)
+			return false;
+		dst[op++] = (BYTE)offset;
+		dst[op++] = (BYTE)(offset >> 8);
+		if (ml >= 15 && !writeLength(dst, op, dstCapacity, ml - 15))
+			return false;
+		return true;
+	}
+}
+
+//=============================================================================
+// Normalize a path for lookup
+//=============================================================================
+bool assetPackNS::normalizePath(const char *path, char *out, size_t outSize) {
+	while (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+		path += 2;
+	size_t n = 0;
+	for (; *path; path++) {
+		if (n + 1 >= outSize)
+			return false;
+		char c = *path;
+		if (c == '\\')
+			c = '/';
+		else if (c >= 'A' && c <= 'Z')
+			c = c - 'A' + 'a';
+		out[n++] = c;
+	}
+	out[n] = 0;
+	return true;
+}
+
+//=============================================================================
+// FNV-1a hash of a normalized path
+//=============================================================================
+UINT64 assetPackNS::hashPath(const char *normalized) {
+	UINT64 hash = 14695981039346656037ULL;
+	for (; *normalized; normalized++) {
+		hash ^= (UCHAR)*normalized;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//=============================================================================
+// LZ4 block compression
+// Greedy matching with a 4096 entry hash table of 4 byte sequences. The
+// last 5 bytes are always literals and no match starts in the last 12, as
+// the block format requires.
+//=============================================================================
+int assetPackNS::lz4Compress(const BYTE *src, int srcSize, BYTE *dst, int dstCapacity) {
+	const int HASH_BITS = 12;
+	int table[1 << HASH_BITS];
+	for (int i = 0; i < (1 << HASH_BITS); i++)
+		table[i] = -1;
+
+	int op = 0;
+	int anchor = 0;
+	int ip = 0;
+	const int matchStartLimit = srcSize - 12;
+	const int matchEndLimit = srcSize - 5;
+	while (ip < matchStartLimit) {
+		UINT sequence = read32(src + ip);
+		UINT h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		int ref = table[h];
+		table[h] = ip;
+		if (ref < 0 || ip - ref > 0xffff || read32(src + ref) != sequence) {
+			ip++;
+			continue;
+		}
+		int length = 4;
+		while (ip + length < matchEndLimit && src[ref + length] == src[ip + length])
+			length++;
+		if (!writeSequence(src + anchor, ip - anchor, ip - ref, length, dst, op, dstCapacity))
+			return 0;
+		ip += length;
+		anchor = ip;
+	}
+	if (!writeSequence(src + anchor, srcSize - anchor, 0, 0, dst, op, dstCapacity))
+		return 0;
+	return op;
+}
+
+//=============================================================================
+// LZ4 block decompression, checking every length against both buffers
+//=============================================================================
+bool assetPackNS::lz4Decompress(const BYTE *src, int srcSize, BYTE *dst, int dstSize) {
+	int ip = 0;
+	int op = 0;
+	while (ip < srcSize) {
+		int token = src[ip++];
+		int length = token >> 4;
+		if (length == 15) {
+			int b;
+			do {
+				if (ip >= srcSize)
+					return false;
+				b = src[ip++];
+				length += b;
+			} while (b == 255);
+		}
+		if (length > srcSize - ip || length > dstSize - op)
+			return false;
+		memcpy(dst + op, src + ip, length);
+		ip += length;
+		op += length;
+		if (ip >= srcSize)
+			break;							// the last sequence has no match
+
+		if (ip + 2 > srcSize)
+			return false;
+		int offset = src[ip] | src[ip + 1] << 8;
+		ip += 2;
+		if (offset == 0 || offset > op)
+			return false;
+		length = token & 15;
+		if (length == 15) {
+			int b;
+			do {
+				if (ip >= srcSize)
+					return false;
+				b = src[ip++];
+				length += b;
+			} while (b == 255);
+		}
+		length += 4;
+		if (length > dstSize - op)
+			return false;
+		const BYTE *match = dst + op - offset;
+		for (int i = 0; i < length; i++)	// matches may overlap the output
+			dst[op + i] = match[i];
+		op += length;
+	}
+	return op == dstSize;
+}
+
+//=============================================================================
+// Build a pack from a directory
+//=============================================================================
+bool assetPackNS::build(const char *dir, const char *file, bool compress) {
+	try {
+		std::string root = dir;
+		while (!root.empty() && (root[root.length() - 1] == '/' || root[root.length() - 1] == '\\'))
+			root.erase(root.length() - 1);
+		std::vector<std::string> paths;
+		if (!listFiles(root, paths))
+			return false;
+
+		std::vector<PackFile> files(paths.size());
+		for (size_t i = 0; i < paths.size(); i++) {
+			PackFile &f = files[i];
+			char name[MAX_PATH_LENGTH];
+			if (!normalizePath(paths[i].c_str(), name, sizeof(name)))
+				return false;
+			f.name = name;
+			f.hash = hashPath(name);
+
+			std::ifstream in(paths[i].c_str(), std::ios::binary);
+			if (!in)
+				return false;
+			f.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			f.size = (UINT)f.data.size();
+			f.flags = 0;
+			if (compress && f.size > 0) {
+				std::vector<BYTE> packed(lz4Bound(f.size));
+				int n = lz4Compress(&f.data[0], f.size, &packed[0], (int)packed.size());
+				if (n > 0 && n < f.size * (1.0f - MIN_SAVING)) {
+					packed.resize(n);
+					f.data.swap(packed);
+					f.flags = COMPRESSED;
+				}
+			}
+		}
+		std::sort(files.begin(), files.end(), [](const PackFile &a, const PackFile &b) {
+			return a.hash < b.hash || (a.hash == b.hash && a.name < b.name);
+		});
+
+		// layout: header, index, names, aligned data
+		std::string nameTable;
+		std::vector<PackEntry> entries(files.size());
+		for (size_t i = 0; i < files.size(); i++) {
+			ZeroMemory(&entries[i], sizeof(PackEntry));
+			entries[i].name = (UINT32)nameTable.size();
+			nameTable += files[i].name;
+			nameTable.push_back('\0');
+		}
+		PackHeader header;
+		ZeroMemory(&header, sizeof(header));
+		header.magic = FILE_MAGIC;
+		header.version = FILE_VERSION;
+		header.count = (UINT32)files.size();
+		header.namesOffset = (UINT32)(sizeof(PackHeader) + entries.size() * sizeof(PackEntry));
+		header.namesSize = (UINT32)nameTable.size();
+		UINT64 offset = header.namesOffset + header.namesSize;
+		for (size_t i = 0; i < files.size(); i++) {
+			offset = (offset + DATA_ALIGN - 1) & ~(UINT64)(DATA_ALIGN - 1);
+			if (offset + files[i].data.size() > 0xffffffff)
+				return false;						// packs are limited to 4 GB
+			entries[i].hash = files[i].hash;
+			entries[i].offset = (UINT32)offset;
+			entries[i].size = files[i].size;
+			entries[i].storedSize = (UINT32)files[i].data.size();
+			entries[i].flags = files[i].flags;
+			offset += files[i].data.size();
+		}
+
+		std::ofstream out(file, std::ios::binary);
+		if (!out)
+			return false;
+		out.write((const char*)&header, sizeof(header));
+		if (!entries.empty())
+			out.write((const char*)&entries[0], entries.size() * sizeof(PackEntry));
+		out.write(nameTable.data(), nameTable.size());
+		UINT64 written = header.namesOffset + header.namesSize;
+		const char zeros[DATA_ALIGN] = { 0 };
+		for (size_t i = 0; i < files.size(); i++) {
+			out.write(zeros, (std::streamsize)(entries[i].offset - written));
+			if (!files[i].data.empty())
+				out.write((const char*)&files[i].data[0], files[i].data.size());
+			written = entries[i].offset + files[i].data.size();
+		}
+		return out.good();
+	}
+	catch (...) { return false; }
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+AssetPack::AssetPack() {
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+	base = NULL;
+	size = 0;
+	header = NULL;
+	entries = NULL;
+	names = NULL;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+AssetPack::~AssetPack() {
+	release();
+}
+
+//=============================================================================
+// Open and map a pack, checking the header and index fit the file
+// Uncompressed entries are read in place, so their size must be the stored
+// size. Compressed entries must be smaller than their contents, whose size
+// must fit lz4Decompress() and what LZ4 can expand the stored bytes to.
+//=============================================================================
+bool AssetPack::initialize(const char *f) {
+	release();
+	file = CreateFile(f, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(PackHeader)) {
+		release();
+		return false;
+	}
+	size = (UINT64)fileSize.QuadPart;
+	mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		release();
+		return false;
+	}
+	base = (const BYTE*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (base == NULL) {
+		release();
+		return false;
+	}
+
+	header = (const PackHeader*)base;
+	UINT64 indexEnd = sizeof(PackHeader) + (UINT64)header->count * sizeof(PackEntry);
+	if (header->magic != assetPackNS::FILE_MAGIC || header->version != assetPackNS::FILE_VERSION ||
+		indexEnd > header->namesOffset || (UINT64)header->namesOffset + header->namesSize > size ||
+		(header->namesSize > 0 && base[header->namesOffset + header->namesSize - 1] != 0)) {
+		release();
+		return false;
+	}
+	entries = (const PackEntry*)(base + sizeof(PackHeader));
+	names = (const char*)(base + header->namesOffset);
+	for (UINT i = 0; i < header->count; i++) {
+		const PackEntry &e = entries[i];
+		bool sizeValid = (e.flags & assetPackNS::COMPRESSED) ?
+			e.storedSize < e.size && e.size <= (UINT32)INT_MAX &&
+			(UINT64)e.size <= (UINT64)e.storedSize * assetPackNS::MAX_RATIO :
+			e.size == e.storedSize;
+		if (e.name >= header->namesSize || !sizeValid ||
+			(UINT64)e.offset + e.storedSize > size) {
+			release();
+			return false;
+		}
+	}
+	return true;
+}
+
+//=============================================================================
+// Unmap and close the pack
+//=============================================================================
+void AssetPack::release() {
+	if (base)
+		UnmapViewOfFile(base);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+	base = NULL;
+	size = 0;
+	header = NULL;
+	entries = NULL;
+	names = NULL;
+}
+
+//=============================================================================
+// Find a packed file
+//=============================================================================
+bool AssetPack::find(const char *path, AssetView &view) const {
+	if (base == NULL)
+		return false;
+	char name[assetPackNS::MAX_PATH_LENGTH];
+	if (!assetPackNS::normalizePath(path, name, sizeof(name)))
+		return false;
+	UINT64 hash = assetPackNS::hashPath(name);
+
+	// first entry with this hash, then compare names in case of collisions
+	UINT lo = 0, hi = header->count;
+	while (lo < hi) {
+		UINT mid = (lo + hi) / 2;
+		if (entries[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (UINT i = lo; i < header->count && entries[i].hash == hash; i++) {
+		if (strcmp(names + entries[i].name, name) != 0)
+			continue;
+		view.data = base + entries[i].offset;
+		view.size = entries[i].size;
+		view.storedSize = entries[i].storedSize;
+		view.compressed = (entries[i].flags & assetPackNS::COMPRESSED) != 0;
+		return true;
+	}
+	return false;
+}
+
+//=============================================================================
+// Copy a packed file, decompressing it if needed
+//=============================================================================
+bool AssetPack::read(const char *path, std::vector<BYTE> &out) const {
+	AssetView view;
+	if (!find(path, view))
+		return false;
+	try {
+		out.resize(view.size);
+	}
+	catch (...) { return false; }
+	if (view.size == 0)
+		return true;
+	if (!view.compressed) {
+		memcpy(&out[0], view.data, view.size);
+		return true;
+	}
+	return assetPackNS::lz4Decompress(view.data, view.storedSize, &out[0], view.size);
+}
@@ -0,0 +1,123 @@
+#ifndef _ASSETPACK_H
+#define _ASSETPACK_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+#include <string>
+
+namespace assetPackNS {
+	const UINT  FILE_MAGIC = 0x4b505844;	// "DXPK"
+	const UINT  FILE_VERSION = 1;
+	const UINT  DATA_ALIGN = 64;			// alignment of entry data in the pack
+	const UINT  COMPRESSED = 1;				// entry flag, data is an LZ4 block
+	const float MIN_SAVING = 0.1f;			// store compressed only if it saves this fraction
+	const UINT  MAX_RATIO = 255;			// most an LZ4 block can expand, per stored byte
+	const int   MAX_PATH_LENGTH = 260;
+
+	// Build a pack from every file under dir. Entries are named by their
+	// path including dir, e.g. "sprites/ship.png".
+	// compress = true to LZ4 compress entries that shrink enough
+	// Returns false on error
+	bool build(const char *dir, const char *file, bool compress);
+
+	// Write the normalized form of path to out: lower case, '/' separators,
+	// no leading "./". Returns false if it does not fit.
+	bool normalizePath(const char *path, char *out, size_t outSize);
+
+	// Return the 64 bit FNV-1a hash of a normalized path.
+	UINT64 hashPath(const char *normalized);
+
+	// LZ4 block format compression.
+	// Returns compressed size, or 0 if dst is too small.
+	int lz4Compress(const BYTE *src, int srcSize, BYTE *dst, int dstCapacity);
+
+	// Return the largest compressed size of srcSize bytes.
+	inline int lz4Bound(int srcSize) { return srcSize + srcSize / 255 + 16; }
+
+	// LZ4 block format decompression. dstSize is the exact original size.
+	// Returns false if src is corrupt.
+	bool lz4Decompress(const BYTE *src, int srcSize, BYTE *dst, int dstSize);
+}
+
+// Pack file header, followed by count PackEntry sorted by hash, the name
+// table and the entry data.
+struct PackHeader {
+	UINT32      magic;				// FILE_MAGIC
+	UINT32      version;			// FILE_VERSION
+	UINT32      count;				// number of entries
+	UINT32      namesOffset;		// file offset of the name table
+	UINT32      namesSize;			// bytes in the name table
+	UINT32      reserved[3];
+};
+
+// Index entry of one packed file
+struct PackEntry {
+	UINT64      hash;				// hashPath() of the name
+	UINT32      name;				// offset of the 0 terminated name in the name table
+	UINT32      offset;				// file offset of the data, DATA_ALIGN aligned
+	UINT32      size;				// original size in bytes
+	UINT32      storedSize;			// bytes stored in the pack
+	UINT32      flags;				// COMPRESSED
+	UINT32      reserved;
+};
+
+// Location of a packed file inside the mapped pack. Valid while the pack is open.
+struct AssetView {
+	const BYTE  *data;				// stored bytes
+	UINT        size;				// original size
+	UINT        storedSize;			// bytes at data
+	bool        compressed;			// data is an LZ4 block of size bytes
+};
+
+// Read only archive of asset files. The pack is memory mapped, so opening
+// it costs one file open however many assets it holds, and uncompressed
+// assets are used in place without copying. Lookups hash the normalized
+// path and binary search the sorted index.
+class AssetPack {
+private:
+	HANDLE      file;				// pack file
+	HANDLE      mapping;			// file mapping object
+	const BYTE  *base;				// mapped view of the whole pack
+	UINT64      size;				// bytes in the pack
+	const PackHeader *header;
+	const PackEntry *entries;
+	const char  *names;				// name table
+
+	// Packs own a mapping, so they are not copied
+	AssetPack(const AssetPack&);
+	AssetPack& operator=(const AssetPack&);
+
+public:
+	// Constructor
+	AssetPack();
+
+	// Destructor
+	virtual ~AssetPack();
+
+	// Open and map a pack.
+	// Post: returns false on error
+	bool initialize(const char *file);
+
+	// Unmap and close the pack.
+	void release();
+
+	// Return true if a pack is open.
+	bool isOpen() const { return base != NULL; }
+
+	// Find path in the pack. path may use either slash and any case.
+	// Returns false if it is not in the pack.
+	bool find(const char *path, AssetView &view) const;
+
+	// Copy path into out, decompressing it if needed.
+	// Returns false if it is not in the pack or is corrupt.
+	bool read(const char *path, std::vector<BYTE> &out) const;
+
+	// Return number of files in the pack.
+	UINT getCount() const { return header ? header->count : 0; }
+
+	// Return the name of entry i.
+	const char* getName(UINT i) const { return names + entries[i].name; }
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "behavior.h"
+#include <malloc.h>
+#include <xmmintrin.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+BehaviorScheduler::BehaviorScheduler() {
+	frames = NULL;
+	frame = 0;
+	count = 0;
+	running = behaviorNS::NONE;
+	runningStopped = false;
+	resumed = 0;
+	cursor = behaviorNS::NONE;
+	for (int i = 0; i < behaviorNS::FRAME_SLOTS; i++)
+		heads[i] = behaviorNS::NONE;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+BehaviorScheduler::~BehaviorScheduler() {
+	release();
+}
+
+//=============================================================================
+// Make room for maxBehaviors behaviors
+// The wheel has one timer more than behaviors, so a behavior resumed by a
+// timer can wait for seconds again before that timer's slot is freed.
+//=============================================================================
+bool BehaviorScheduler::initialize(UINT maxBehaviors) {
+	release();
+	frames = (BYTE*)_aligned_malloc(maxBehaviors * behaviorNS::FRAME_BYTES, objectPoolNS::CACHE_LINE);
+	if (frames == NULL || !timers.initialize(maxBehaviors + 1))
+		return false;
+	try {
+		slots.resize(maxBehaviors);
+		freeList.resize(maxBehaviors);
+		waiting.reserve(maxBehaviors);
+	}
+	catch (...) {
+		release();
+		return false;
+	}
+	for (UINT i = 0; i < maxBehaviors; i++) {
+		slots[i].generation = 0;
+		slots[i].list = behaviorNS::NONE;
+		freeList[i] = maxBehaviors - 1 - i;		// frame 0 is used first
+	}
+	frame = 0;
+	resumed = 0;
+	return true;
+}
+
+//=============================================================================
+// Stop all behaviors and free storage
+//=============================================================================
+void BehaviorScheduler::release() {
+	clear();
+	if (frames)
+		_aligned_free(frames);
+	frames = NULL;
+	slots.clear();
+	freeList.clear();
+	waiting.clear();
+}
+
+//=============================================================================
+// Take a free frame
+//=============================================================================
+UINT BehaviorScheduler::allocate() {
+	if (freeList.empty())
+		return behaviorNS::NONE;
+	UINT i = freeList.back();
+	freeList.pop_back();
+	slots[i].generation++;					// odd while running
+	slots[i].list = behaviorNS::NONE;
+	slots[i].timer = PoolHandle();
+	count++;
+	return i;
+}
+
+//=============================================================================
+// Run a new behavior to its first wait
+//=============================================================================
+PoolHandle BehaviorScheduler::begin(UINT i) {
+	PoolHandle h;
+	h.index = i;
+	h.generation = slots[i].generation;
+	resume(i);
+	return isRunning(h) ? h : PoolHandle();
+}
+
+//=============================================================================
+// Link behavior i at the head of a list, or at the end of waiting
+//=============================================================================
+void BehaviorScheduler::link(UINT i, UINT list) {
+	Slot &s = slots[i];
+	s.list = list;
+	if (list == behaviorNS::WAITING) {
+		s.position = (UINT)waiting.size();
+		waiting.push_back(i);
+		return;
+	}
+	s.prev = behaviorNS::NONE;
+	s.next = heads[list];
+	if (s.next != behaviorNS::NONE)
+		slots[s.next].prev = i;
+	heads[list] = i;
+}
+
+//=============================================================================
+// Take behavior i out of its list
+// Its place in waiting is left empty until resumeWaiting() packs it.
+//=============================================================================
+void BehaviorScheduler::unlink(UINT i) {
+	Slot &s = slots[i];
+	if (s.list == behaviorNS::NONE)
+		return;
+	if (s.list == behaviorNS::WAITING) {
+		waiting[s.position] = behaviorNS::NONE;
+		s.list = behaviorNS::NONE;
+		return;
+	}
+	if (i == cursor)						// update() goes on to the next
+		cursor = s.next;
+	if (s.prev != behaviorNS::NONE)
+		slots[s.prev].next = s.next;
+	else
+		heads[s.list] = s.next;
+	if (s.next != behaviorNS::NONE)
+		slots[s.next].prev = s.prev;
+	s.list = behaviorNS::NONE;
+}
+
+//=============================================================================
+// Run behavior i from its last wait and queue it for its next
+// run() may start and stop behaviors, including itself, so the running
+// behavior is saved around it and one stopped while running is destroyed
+// once run() returns.
+//=============================================================================
+void BehaviorScheduler::resume(UINT i) {
+	using namespace behaviorNS;
+	UINT outer = running;
+	bool outerStopped = runningStopped;
+	running = i;
+	runningStopped = false;
+	resumed++;
+	Wait next = at(i)->resume();
+	bool stopped = runningStopped;
+	running = outer;
+	runningStopped = outerStopped;
+	if (stopped) {
+		destroy(i);
+		return;
+	}
+	if (next == WAIT_UNTIL && slots[i].list == WAITING)
+		return;								// still waiting on a condition
+	unlink(i);
+
+	switch (next) {
+	case WAIT_SECONDS:
+		slots[i].timer = timers.schedule(at(i)->getWaitSeconds(), [this, i](PoolHandle) {
+			slots[i].timer = PoolHandle();
+			resume(i);
+		});
+		break;
+	case WAIT_FRAMES: {
+		UINT n = at(i)->getWaitFrames();
+		slots[i].dueFrame = frame + ((n < 1) ? 1 : n);
+		link(i, slots[i].dueFrame % FRAME_SLOTS);
+		break;
+	}
+	case WAIT_UNTIL:
+		link(i, WAITING);
+		break;
+	default:								// reached BEHAVIOR_END
+		destroy(i);
+	}
+}
+
+//=============================================================================
+// Destroy behavior i and free its frame
+//=============================================================================
+void BehaviorScheduler::destroy(UINT i) {
+	unlink(i);
+	timers.cancel(slots[i].timer);
+	slots[i].timer = PoolHandle();
+	at(i)->~Behavior();
+	slots[i].generation++;					// stale handles no longer match
+	freeList.push_back(i);
+	count--;
+}
+
+//=============================================================================
+// End a behavior
+//=============================================================================
+bool BehaviorScheduler::stop(PoolHandle h) {
+	if (!isRunning(h))
+		return false;
+	if (h.index == running) {
+		runningStopped = true;				// destroyed when run() returns
+		return true;
+	}
+	destroy(h.index);
+	return true;
+}
+
+//=============================================================================
+// End all behaviors
+//=============================================================================
+void BehaviorScheduler::clear() {
+	for (UINT i = 0; i < slots.size(); i++) {
+		PoolHandle h;
+		h.index = i;
+		h.generation = slots[i].generation;
+		stop(h);
+	}
+}
+
+//=============================================================================
+// Resume the behaviors in a ring slot that are due
+// The list is walked in place. The cursor moves on if run() stops or moves
+// the next behavior, and behaviors linked during the walk go to the head,
+// so none is visited twice. Frame waits longer than FRAME_SLOTS stay in
+// the ring until the turn they are due.
+//=============================================================================
+void BehaviorScheduler::resumeFrames(UINT slot) {
+	cursor = heads[slot];
+	while (cursor != behaviorNS::NONE) {
+		UINT i = cursor;
+		cursor = slots[i].next;
+		if (slots[i].dueFrame == frame)
+			resume(i);
+	}
+}
+
+//=============================================================================
+// Resume the behaviors waiting on a condition
+// Those still waiting are packed to the front as the array is walked, then
+// those that began waiting during the walk, which are tested next update.
+// Frames are fetched PREFETCH behaviors ahead, since run() is too short to
+// hide a cache miss.
+//=============================================================================
+void BehaviorScheduler::resumeWaiting() {
+	using namespace behaviorNS;
+	size_t end = waiting.size();
+	size_t kept = 0;
+	for (size_t j = 0; j < end; j++) {
+		if (j + PREFETCH < end && waiting[j + PREFETCH] != NONE) {
+			_mm_prefetch((const char*)at(waiting[j + PREFETCH]), _MM_HINT_T0);
+			_mm_prefetch((const char*)&slots[waiting[j + PREFETCH]], _MM_HINT_T0);
+		}
+		UINT i = waiting[j];
+		if (i == NONE)
+			continue;
+		resume(i);
+		if (waiting[j] != i)				// no longer waiting
+			continue;
+		waiting[kept] = i;
+		slots[i].position = (UINT)kept++;
+	}
+	for (size_t j = end; j < waiting.size(); j++) {
+		UINT i = waiting[j];
+		if (i == NONE)
+			continue;
+		waiting[kept] = i;
+		slots[i].position = (UINT)kept++;
+	}
+	waiting.resize(kept);
+}
+
+//=============================================================================
+// Resume the behaviors that are due
+//=============================================================================
+void BehaviorScheduler::update(float frameTime) {
+	frame++;
+	timers.advance(frameTime);
+	resumeFrames(frame % behaviorNS::FRAME_SLOTS);
+	resumeWaiting();
+}
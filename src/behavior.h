@@ -0,0 +1,199 @@
+#ifndef _BEHAVIOR_H
+#define _BEHAVIOR_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+#include <new>
+#include "objectPool.h"
+#include "timerWheel.h"
+
+namespace behaviorNS {
+	const size_t FRAME_BYTES = 128;			// largest Behavior, in bytes
+	const int    FRAME_SLOTS = 256;			// frames ahead a frame wait is queued for directly
+	const UINT   WAITING = FRAME_SLOTS;		// list of behaviors waiting on a condition
+	const size_t PREFETCH = 8;				// condition waits ahead whose frames are fetched
+	const UINT   NONE = 0xffffffff;			// no behavior, or a behavior in no list
+
+	// What a behavior waits for when run() returns
+	enum Wait { WAIT_NONE, WAIT_SECONDS, WAIT_FRAMES, WAIT_UNTIL };
+}
+
+// Resumable behavior code. run() starts with BEHAVIOR_BEGIN, ends with
+// BEHAVIOR_END and suspends at the waits in between; the next run() jumps
+// back to the line after the wait, so a behavior reads as straight-line
+// code instead of a hand-written state machine. Local variables do not
+// survive a wait, so keep state in members. Each wait must be on a line of
+// its own, and waits may not be used inside a switch of the behavior's own.
+#define BEHAVIOR_BEGIN switch (resumePoint) { case 0:
+#define BEHAVIOR_END }
+#define BEHAVIOR_WAIT_SECONDS(sec) do { resumePoint = __LINE__; waitSeconds(sec); return; case __LINE__:; } while (0)
+#define BEHAVIOR_WAIT_FRAMES(n) do { resumePoint = __LINE__; waitFrames(n); return; case __LINE__:; } while (0)
+#define BEHAVIOR_WAIT_UNTIL(cond) do { resumePoint = __LINE__; case __LINE__: if (!(cond)) { waitUntil(); return; } } while (0)
+
+// A per-entity behavior run by a BehaviorScheduler. Derive from it, keep
+// the entity and any state that lives across waits in members, and write
+// run() with the BEHAVIOR_ macros. A behavior ends when run() reaches
+// BEHAVIOR_END.
+class Behavior {
+protected:
+	int     resumePoint;            // line of the wait to resume after, 0 to start
+	behaviorNS::Wait wait;          // set by the last wait
+	float   seconds;                // for WAIT_SECONDS
+	UINT    frames;                 // for WAIT_FRAMES
+
+	// Used by the BEHAVIOR_WAIT_ macros.
+	void waitSeconds(float sec) { wait = behaviorNS::WAIT_SECONDS; seconds = sec; }
+	void waitFrames(UINT n) { wait = behaviorNS::WAIT_FRAMES; frames = n; }
+	void waitUntil() { wait = behaviorNS::WAIT_UNTIL; }
+
+public:
+	// Constructor
+	Behavior() : resumePoint(0), wait(behaviorNS::WAIT_NONE), seconds(0), frames(0) {}
+
+	// Destructor
+	virtual ~Behavior() {}
+
+	// Run until the next wait or the end.
+	virtual void run() = 0;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Run from the last wait and return what the behavior waits for next.
+	behaviorNS::Wait resume() {
+		wait = behaviorNS::WAIT_NONE;
+		run();
+		return wait;
+	}
+
+	// Return seconds of the last BEHAVIOR_WAIT_SECONDS.
+	float getWaitSeconds() const { return seconds; }
+
+	// Return frames of the last BEHAVIOR_WAIT_FRAMES.
+	UINT getWaitFrames() const { return frames; }
+};
+
+// Runs behaviors, resuming each only when what it waits for is due.
+// Behaviors live in fixed size frames from one cache line aligned block, so
+// starting and ending them makes no heap calls after initialize(). Waits
+// for seconds are timers on a TimerWheel, and waits for frames are queued
+// in a ring of FRAME_SLOTS frames, so neither is visited until due. Only
+// behaviors waiting on a condition are run every frame, to test it; they
+// are kept in an array so their frames can be fetched ahead.
+class BehaviorScheduler {
+private:
+	struct Slot {
+		UINT        generation;         // odd while the behavior runs
+		UINT        next, prev;         // neighbours in its list
+		UINT        list;               // list the behavior is in, NONE for none
+		UINT        position;           // index in waiting, for a condition wait
+		UINT        dueFrame;           // frame a frame wait ends on
+		PoolHandle  timer;              // timer a seconds wait ends with
+	};
+
+	BYTE        *frames;                // capacity frames of FRAME_BYTES
+	std::vector<Slot> slots;
+	std::vector<UINT> freeList;         // stack of free frames
+	UINT        heads[behaviorNS::FRAME_SLOTS];	// first behavior waiting for each frame of the ring
+	UINT        cursor;                 // next behavior update() visits in the ring
+	std::vector<UINT> waiting;          // behaviors waiting on a condition, NONE for ones that left
+	TimerWheel  timers;                 // seconds waits
+	UINT        frame;                  // updates since initialize()
+	UINT        count;                  // behaviors running
+	UINT        running;                // behavior whose run() is in progress, NONE if none
+	bool        runningStopped;         // it was stopped while running
+	UINT64      resumed;                // run() calls since initialize()
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return frame i.
+	Behavior* at(UINT i) const { return (Behavior*)(frames + i * behaviorNS::FRAME_BYTES); }
+
+	// Take a free frame, NONE if there is none.
+	UINT allocate();
+
+	// Run a behavior just constructed in frame i and return its handle.
+	PoolHandle begin(UINT i);
+
+	// Run behavior i from its last wait and queue it for its next. A
+	// behavior still waiting on a condition stays where it is in the list.
+	void resume(UINT i);
+
+	// Resume the behaviors in ring slot that are due.
+	void resumeFrames(UINT slot);
+
+	// Resume the behaviors waiting on a condition.
+	void resumeWaiting();
+
+	// Link behavior i at the head of list, or at the end of waiting.
+	void link(UINT i, UINT list);
+
+	// Take behavior i out of its list.
+	void unlink(UINT i);
+
+	// Destroy behavior i and free its frame.
+	void destroy(UINT i);
+
+	// Schedulers own behaviors that run code, so they are not copied
+	BehaviorScheduler(const BehaviorScheduler&);
+	BehaviorScheduler& operator=(const BehaviorScheduler&);
+
+public:
+	// Constructor
+	BehaviorScheduler();
+
+	// Destructor
+	virtual ~BehaviorScheduler();
+
+	// Make room for maxBehaviors behaviors running at once.
+	// Post: returns false if out of memory
+	bool initialize(UINT maxBehaviors);
+
+	// Stop all behaviors and free storage.
+	void release();
+
+	// Start a copy of behavior, running it to its first wait.
+	// Returns its handle, or an invalid handle if the scheduler is full or
+	// the behavior ended without waiting.
+	template <class T>
+	PoolHandle start(const T &behavior) {
+		static_assert(sizeof(T) <= behaviorNS::FRAME_BYTES, "Behavior is larger than behaviorNS::FRAME_BYTES");
+		static_assert(__alignof(T) <= objectPoolNS::CACHE_LINE, "Behavior alignment is too large");
+		UINT i = allocate();
+		if (i == behaviorNS::NONE)
+			return PoolHandle();
+		new(at(i)) T(behavior);
+		return begin(i);
+	}
+
+	// End a behavior, which may be the one running.
+	// Returns false if h is stale or invalid.
+	bool stop(PoolHandle h);
+
+	// End all behaviors.
+	void clear();
+
+	// Advance by frameTime, resuming the behaviors that are due: seconds
+	// waits in order of due time, then frame waits, then condition waits.
+	void update(float frameTime);
+
+	// Return true if h refers to a behavior that has not ended.
+	bool isRunning(PoolHandle h) const {
+		return h.index < slots.size() && slots[h.index].generation == h.generation && (h.generation & 1);
+	}
+
+	// Return the behavior h refers to, NULL if it has ended.
+	Behavior* get(PoolHandle h) const { return isRunning(h) ? at(h.index) : NULL; }
+
+	// Return number of behaviors running.
+	UINT getCount() const { return count; }
+
+	// Return most behaviors running at once.
+	UINT getCapacity() const { return (UINT)slots.size(); }
+
+	// Return updates since initialize().
+	UINT getFrame() const { return frame; }
+
+	// Return run() calls since initialize().
+	UINT64 getResumed() const { return resumed; }
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <fstream>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+Benchmark::Benchmark() {
+	QueryPerformanceFrequency(&timerFreq);
+	frameStart.QuadPart = 0;
+	frameAllocs.allocations = 0;
+	frameAllocs.bytes = 0;
+	failureCount = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+Benchmark::~Benchmark() {}
+
+//=============================================================================
+// Start a new run
+//=============================================================================
+void Benchmark::initialize(const char *n) {
+	name = n;
+	samples.clear();
+	samples.reserve(benchmarkNS::RESERVE_FRAMES);
+	allocs.clear();
+	allocs.reserve(benchmarkNS::RESERVE_FRAMES);
+	failureCount = 0;
+	failures.clear();
+}
+
+//=============================================================================
+// Mark the start of a timed frame
+//=============================================================================
+void Benchmark::beginFrame() {
+	frameAllocs = memoryNS::getAllocCounts();
+	QueryPerformanceCounter(&frameStart);
+}
+
+//=============================================================================
+// Mark the end of a timed frame
+//=============================================================================
+void Benchmark::endFrame() {
+	LARGE_INTEGER frameEnd;
+	QueryPerformanceCounter(&frameEnd);
+	memoryNS::AllocCounts now = memoryNS::getAllocCounts();
+	memoryNS::AllocCounts frame;
+	frame.allocations = now.allocations - frameAllocs.allocations;
+	frame.bytes = now.bytes - frameAllocs.bytes;
+	samples.push_back((float)(frameEnd.QuadPart - frameStart.QuadPart) * 1000.0f / (float)timerFreq.QuadPart);
+	allocs.push_back(frame);
+}
+
+//=============================================================================
+// Record a failed check
+// Only the first MAX_FAILURES are kept, so a check failing in a loop does
+// not fill memory.
+//=============================================================================
+void Benchmark::fail(const char *what) {
+	failureCount++;
+	if (failures.size() < benchmarkNS::MAX_FAILURES)
+		failures.push_back(what);
+}
+
+//=============================================================================
+// Save a frame time measured elsewhere
+//=============================================================================
+void Benchmark::addSample(float ms) {
+	memoryNS::AllocCounts none = { 0, 0 };
+	samples.push_back(ms);
+	allocs.push_back(none);
+}
+
+//=============================================================================
+// Return average frame time in milli-seconds
+//=============================================================================
+float Benchmark::getAverage() const {
+	if (samples.empty())
+		return 0;
+	double total = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+		total += samples[i];
+	return (float)(total / samples.size());
+}
+
+//=============================================================================
+// Return average heap allocations per frame
+//=============================================================================
+float Benchmark::getAverageAllocations() const {
+	if (allocs.empty())
+		return 0;
+	double total = 0;
+	for (size_t i = 0; i < allocs.size(); i++)
+		total += (double)allocs[i].allocations;
+	return (float)(total / allocs.size());
+}
+
+//=============================================================================
+// Return average heap bytes per frame
+//=============================================================================
+float Benchmark::getAverageAllocBytes() const {
+	if (allocs.empty())
+		return 0;
+	double total = 0;
+	for (size_t i = 0; i < allocs.size(); i++)
+		total += (double)allocs[i].bytes;
+	return (float)(total / allocs.size());
+}
+
+//=============================================================================
+// Return the frame time below which p percent of frames fall
+//=============================================================================
+float Benchmark::getPercentile(float p) const {
+	if (samples.empty())
+		return 0;
+	std::vector<float> sorted(samples);
+	size_t n = (size_t)(p / 100.0f * (sorted.size() - 1) + 0.5f);
+	if (n >= sorted.size())
+		n = sorted.size() - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+	return sorted[n];
+}
+
+//=============================================================================
+// Write the report
+// Returns false on error
+//=============================================================================
+bool Benchmark::writeReport(const char *file) const {
+	std::ofstream out(file);
+	if (!out)
+		return false;
+
+	out << "# benchmark " << name << "\n";
+	out << "# frames " << samples.size() << "\n";
+	out << "# avg_ms " << getAverage() << "\n";
+	out << "# min_ms " << getPercentile(0) << "\n";
+	out << "# p50_ms " << getPercentile(50) << "\n";
+	out << "# p95_ms " << getPercentile(95) << "\n";
+	out << "# p99_ms " << getPercentile(99) << "\n";
+	out << "# max_ms " << getPercentile(100) << "\n";
+	out << "# allocs_per_frame " << getAverageAllocations() << "\n";
+	out << "# alloc_bytes_per_frame " << getAverageAllocBytes() << "\n";
+	out << "# failures " << failureCount << "\n";
+	for (size_t i = 0; i < failures.size(); i++)
+		out << "# failed " << failures[i] << "\n";
+	out << "frame,ms,allocs,bytes\n";
+	for (size_t i = 0; i < samples.size(); i++)
+		out << i << "," << samples[i] << "," << allocs[i].allocations << "," << allocs[i].bytes << "\n";
+	return out.good();
+}
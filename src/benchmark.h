@@ -0,0 +1,81 @@
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+#include <string>
+#include "memoryStats.h"
+
+namespace benchmarkNS {
+	const size_t RESERVE_FRAMES = 60 * 60 * 10;		// ten minutes at 60 FPS
+	const size_t MAX_FAILURES = 20;					// failed checks listed in the report
+}
+
+// Collects per-frame timings and heap allocation counts and writes a
+// report that can be compared across builds.
+class Benchmark {
+private:
+	std::vector<float> samples;		// frame timings in milli-seconds
+	std::vector<memoryNS::AllocCounts> allocs;	// heap allocations of each frame
+	memoryNS::AllocCounts frameAllocs;	// heap totals at beginFrame()
+	LARGE_INTEGER timerFreq;		// Performance Counter frequency
+	LARGE_INTEGER frameStart;		// Performance Counter at beginFrame()
+	std::string name;				// name written in the report
+	UINT        failureCount;		// checks failed since initialize()
+	std::vector<std::string> failures;	// the first MAX_FAILURES failed checks
+
+public:
+	// Constructor
+	Benchmark();
+
+	// Destructor
+	virtual ~Benchmark();
+
+	// Start a new run named n. Previous samples are discarded.
+	void initialize(const char *n);
+
+	// Mark the start of a timed frame.
+	void beginFrame();
+
+	// Mark the end of a timed frame and save its time and heap allocations.
+	void endFrame();
+
+	// Save a frame time measured elsewhere, with no heap allocations.
+	void addSample(float ms);
+
+	// Record a failed check named what unless ok. Unlike assert, checks
+	// run in release builds, where benchmarks are timed. Returns ok.
+	bool check(bool ok, const char *what) {
+		if (!ok)
+			fail(what);
+		return ok;
+	}
+
+	// Record a failed check named what.
+	void fail(const char *what);
+
+	// Return number of checks failed since initialize().
+	UINT getFailureCount() const { return failureCount; }
+
+	// Return number of timed frames.
+	size_t getFrameCount() const { return samples.size(); }
+
+	// Return average frame time in milli-seconds.
+	float getAverage() const;
+
+	// Return average heap allocations per frame.
+	float getAverageAllocations() const;
+
+	// Return average bytes allocated from the heap per frame.
+	float getAverageAllocBytes() const;
+
+	// Return the frame time below which p percent (0 to 100) of frames fall.
+	float getPercentile(float p) const;
+
+	// Write a summary, with any failed checks, followed by one line per frame.
+	// Returns false if the file could not be written.
+	bool writeReport(const char *file) const;
+};
+
+#endif
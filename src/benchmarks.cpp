@@ -0,0 +1,2385 @@
+#include "benchmarks.h"
+#include "bitmapFont.h"
+#include "particleSystem.h"
+#include "tilemap.h"
+#include "objectPool.h"
+#include "image.h"
+#include "assetPack.h"
+#include "transformHierarchy.h"
+#include "camera.h"
+#include "drawList.h"
+#include "radixSort.h"
+#include "spriteBatcher.h"
+#include "textureResidency.h"
+#include "logger.h"
+#include "resolutionScaler.h"
+#include "framePacer.h"
+#include "opacityMap.h"
+#include "softwareRasterizer.h"
+#include "spriteMesh.h"
+#include "overdrawHeatmap.h"
+#include "timerWheel.h"
+#include "controllerManager.h"
+#include "behavior.h"
+#include "flowField.h"
+#include "flock.h"
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <queue>
+#include <math.h>
+#include <assert.h>
+#include <mmsystem.h>
+
+namespace benchmarkNS {
+	// A named benchmark
+	struct Entry {
+		const char *name;
+		void(*run)(Benchmark &bench);
+	};
+
+	const Entry ENTRIES[] = {
+		{ "font", fontLabels },
+		{ "particles", particles },
+		{ "particles-mt", particlesThreaded },
+		{ "tilemap", tilemapScroll },
+		{ "pool", poolSpawn },
+		{ "pool-heap", heapSpawn },
+		{ "assets-loose", assetsLoose },
+		{ "assets-pack", assetsPack },
+		{ "assets-lz4", assetsPackLz4 },
+		{ "transforms", transformsDirty },
+		{ "transforms-full", transformsFull },
+		{ "camera", cameraCulled },
+		{ "camera-nocull", cameraUnculled },
+		{ "sort-radix", sortRadix },
+		{ "sort-std", sortStd },
+		{ "batch-1", batchThreads1 },
+		{ "batch-2", batchThreads2 },
+		{ "batch-4", batchThreads4 },
+		{ "batch-8", batchThreads8 },
+		{ "batch-16", batchThreads16 },
+		{ "residency", textureResidency },
+		{ "log", logHotPath },
+		{ "log-limited", logRateLimited },
+		{ "resolution", resolutionTraces },
+		{ "idle", idleThrottled },
+		{ "idle-off", idleAlwaysOn },
+		{ "overdraw", overdrawSplit },
+		{ "overdraw-single", overdrawSingle },
+		{ "meshes", meshesTrimmed },
+		{ "meshes-quads", meshesQuads },
+		{ "heatmap", overdrawHeatmap },
+		{ "timers", timersWheel },
+		{ "timers-poll", timersPolled },
+		{ "controllers", controllersPolled },
+		{ "behaviors", behaviorsScheduled },
+		{ "behaviors-poll", behaviorsPolled },
+		{ "flowfield", flowFieldBuild },
+		{ "flowfield-1", flowFieldBuildSerial },
+		{ "flowfield-update", flowFieldUpdate },
+		{ "flowfield-query", flowFieldQuery },
+		{ "flock", flockThreaded },
+		{ "flock-1", flockSerial },
+	};
+}
+
+//=============================================================================
+// Run the named benchmark and write its report
+//=============================================================================
+bool benchmarkNS::runBenchmark(const char *name, const char *report) {
+	for (size_t i = 0; i < sizeof(ENTRIES) / sizeof(ENTRIES[0]); i++) {
+		if (strcmp(ENTRIES[i].name, name) == 0) {
+			Benchmark bench;
+			bench.initialize(name);
+			ENTRIES[i].run(bench);
+			return bench.writeReport(report) && bench.getFailureCount() == 0;
+		}
+	}
+	return false;
+}
+
+//=============================================================================
+// Bitmap font labels
+// 5000 labels per frame, 5% of which change every frame.
+//=============================================================================
+void benchmarkNS::fontLabels(Benchmark &bench) {
+	const int LABELS = 5000;
+	const int CHANGING = LABELS / 20;
+
+	// synthetic 16x16 pixel font with two atlas pages
+	std::ostringstream fnt;
+	fnt << "common lineHeight=16 base=13 scaleW=256 scaleH=256 pages=2\n";
+	fnt << "page id=0 file=\"bench_0.png\"\npage id=1 file=\"bench_1.png\"\n";
+	for (int c = 32; c < 127; c++) {
+		int n = c - 32;
+		fnt << "char id=" << c << " x=" << (n % 16) * 16 << " y=" << (n / 16) * 16
+			<< " width=" << (c == ' ' ? 0 : 12) << " height=14 xoffset=1 yoffset=1 xadvance=13 page="
+			<< (c >= 'a' && c <= 'z' ? 1 : 0) << "\n";
+	}
+	BitmapFont font;
+	font.parse(fnt.str(), "");
+
+	std::vector<std::string> labels(LABELS);
+	for (int i = 0; i < LABELS; i++) {
+		std::ostringstream label;
+		label << "Label " << i << " hp=" << (i * 7) % 100;
+		labels[i] = label.str();
+	}
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		for (int i = 0; i < CHANGING; i++) {		// these labels change every frame
+			std::ostringstream label;
+			label << "Score " << frame * CHANGING + i;
+			labels[i] = label.str();
+		}
+
+		bench.beginFrame();
+		for (int i = 0; i < LABELS; i++)
+			font.print(labels[i], (float)(i % 40) * 24, (float)(i / 40) * 16);
+		font.flush();
+		bench.endFrame();
+	}
+}
+
+//=============================================================================
+// 200k live particles from 8 emitters, updated with jobs or on this thread
+//=============================================================================
+static void particleRun(Benchmark &bench, JobSystem *jobs) {
+	const int PARTICLES = 200000;
+	const float FRAME_TIME = 1.0f / 200.0f;
+
+	ParticleSystem system;
+	system.initialize(NULL, NULL, 8, 8, PARTICLES);
+	system.setGravity(0, 50.0f);
+	for (int i = 0; i < 8; i++) {
+		ParticleEmitter e;
+		e.x = (float)(GAME_WIDTH * (i + 1) / 9);
+		e.y = (float)GAME_HEIGHT / 2;
+		e.lifeMin = 1.0f;
+		e.lifeMax = 2.0f;
+		e.rate = PARTICLES / 8 / 1.5f;			// about PARTICLES alive once warmed up
+		system.addEmitter(e);
+	}
+	for (int frame = 0; frame < 400; frame++)	// warm up to a steady state
+		system.update(FRAME_TIME, jobs);
+
+	for (int frame = 0; frame < benchmarkNS::FRAMES; frame++) {
+		bench.beginFrame();
+		system.update(FRAME_TIME, jobs);
+		bench.endFrame();
+	}
+}
+
+//=============================================================================
+// Particles on one thread
+//=============================================================================
+void benchmarkNS::particles(Benchmark &bench) {
+	particleRun(bench, NULL);
+}
+
+//=============================================================================
+// Particles on all CPU cores
+//=============================================================================
+void benchmarkNS::particlesThreaded(Benchmark &bench) {
+	JobSystem jobs;
+	jobs.initialize();
+	particleRun(bench, &jobs);
+}
+
+//=============================================================================
+// Tilemap scrolling
+// The view moves diagonally fast enough to enter new chunks often, and 16
+// tiles inside the view change every frame.
+//=============================================================================
+void benchmarkNS::tilemapScroll(Benchmark &bench) {
+	const int SIZE = 4096;
+	const int TILE = 32;
+	const float SPEED = 400.0f;				// pixels per frame
+
+	Tilemap map;
+	map.initialize(NULL, NULL, SIZE, SIZE, 2, TILE, TILE);
+	UINT seed = 1;
+	for (int y = 0; y < SIZE; y++) {
+		for (int x = 0; x < SIZE; x++) {
+			seed = seed * 1664525 + 1013904223;
+			map.setTile(0, x, y, (WORD)(1 + (seed >> 24) % 64));		// ground everywhere
+			if ((seed >> 8 & 7) == 0)
+				map.setTile(1, x, y, (WORD)(65 + (seed >> 16) % 32));	// scattered decoration
+		}
+	}
+
+	const float mapPixels = (float)(SIZE * TILE);
+	float viewX = 0, viewY = 0;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < 16; i++) {
+			seed = seed * 1664525 + 1013904223;
+			int x = (int)(viewX / TILE) + (int)((seed >> 8) % (GAME_WIDTH / TILE));
+			int y = (int)(viewY / TILE) + (int)((seed >> 20) % (GAME_HEIGHT / TILE));
+			map.setTile(1, x, y, (WORD)(65 + frame % 32));
+		}
+		map.draw(viewX, viewY, (float)GAME_WIDTH, (float)GAME_HEIGHT);
+		bench.endFrame();
+
+		viewX = fmodf(viewX + SPEED, mapPixels - GAME_WIDTH);
+		viewY = fmodf(viewY + SPEED * 0.6f, mapPixels - GAME_HEIGHT);
+	}
+}
+
+//=============================================================================
+// 50k node transform hierarchy with some nodes moving each frame
+// 1000 roots with random descendants. After the run every world transform
+// is checked against one computed from scratch.
+//=============================================================================
+static void transformRun(Benchmark &bench, int moving) {
+	const int NODES = 50000;
+	const int ROOTS = 1000;
+
+	TransformHierarchy transforms;
+	transforms.initialize(NODES);
+	UINT seed = 1;
+	for (int i = 0; i < NODES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		int parent = (i < ROOTS) ? transformNS::NONE : (int)((seed >> 8) % i);
+		int n = transforms.add(parent);
+		transforms.setLocal(n, (float)((seed >> 4) % 64), (float)((seed >> 12) % 64),
+			(float)((seed >> 20) % 628) / 100.0f, 1.0f);
+	}
+	transforms.update();
+
+	for (int frame = 0; frame < benchmarkNS::FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < moving; i++) {
+			seed = seed * 1664525 + 1013904223;
+			int n = (moving == NODES) ? i : (int)((seed >> 8) % NODES);
+			const LocalTransform &l = transforms.getLocal(n);
+			transforms.setLocal(n, l.x, l.y, l.angle + 0.01f, l.scale);
+		}
+		transforms.update();
+		bench.endFrame();
+	}
+
+	// world transforms match a walk up the hierarchy
+	for (int n = 0; n < NODES; n++) {
+		float x = 0, y = 0;
+		for (int p = n; p != transformNS::NONE; p = transforms.getParent(p)) {
+			const LocalTransform &l = transforms.getLocal(p);
+			float c = cosf(l.angle), s = sinf(l.angle);
+			float rx = x * c - y * s, ry = x * s + y * c;		// rotate by local angle
+			x = rx + l.x;
+			y = ry + l.y;
+		}
+		bench.check(fabsf(transforms.getWorldX(n) - x) < 0.05f && fabsf(transforms.getWorldY(n) - y) < 0.05f,
+			"world transform matches its ancestors");
+	}
+}
+
+//=============================================================================
+// Transform hierarchy with 5% of nodes moving each frame
+//=============================================================================
+void benchmarkNS::transformsDirty(Benchmark &bench) {
+	transformRun(bench, 50000 / 20);
+}
+
+//=============================================================================
+// Transform hierarchy with every node moving each frame, for comparison
+//=============================================================================
+void benchmarkNS::transformsFull(Benchmark &bench) {
+	transformRun(bench, 50000);
+}
+
+//=============================================================================
+// Scrolling camera over a 32768x32768 world of 100k sprites, with a
+// parallax layer of 20k more. Each submitted sprite has its corners
+// transformed to the screen, as a sprite batch would.
+//=============================================================================
+static void cameraRun(Benchmark &bench, bool cull) {
+	const int WORLD_SPRITES = 100000;
+	const int PARALLAX_SPRITES = 20000;
+	const float WORLD_SIZE = 32768.0f;
+	const float SPEED = 60.0f;				// world units per frame
+
+	Camera2D camera;
+	camera.initialize((float)GAME_WIDTH, (float)GAME_HEIGHT);
+	int parallax = camera.addLayer(0.5f, 0.5f);
+	int counts[2] = { WORLD_SPRITES, PARALLAX_SPRITES };
+	std::vector<SpriteData> sprites[2];
+	UINT seed = 1;
+	for (int layer = 0; layer < 2; layer++) {
+		sprites[layer].resize(counts[layer]);
+		for (int i = 0; i < counts[layer]; i++) {
+			SpriteData &sd = sprites[layer][i];
+			memset(&sd, 0, sizeof(sd));
+			seed = seed * 1664525 + 1013904223;
+			sd.width = sd.height = 64;
+			sd.scale = 1.0f;
+			sd.x = (float)(seed >> 8 & 0x7fff);
+			seed = seed * 1664525 + 1013904223;
+			sd.y = (float)(seed >> 8 & 0x7fff);
+			sd.angle = (i % 4 == 0) ? (float)(seed >> 24) / 40.0f : 0.0f;
+		}
+	}
+
+	std::vector<QuadVertex> vertices;
+	vertices.reserve((WORLD_SPRITES + PARALLAX_SPRITES) * 4);
+	float x = GAME_WIDTH / 2.0f, y = GAME_HEIGHT / 2.0f;
+	for (int frame = 0; frame < benchmarkNS::FRAMES; frame++) {
+		x = fmodf(x + SPEED, WORLD_SIZE);
+		y = fmodf(y + SPEED * 0.6f, WORLD_SIZE);
+		bench.beginFrame();
+		camera.setPosition(x, y);
+		camera.setZoom(1.0f + 0.5f * sinf(frame * 0.02f));
+		vertices.clear();
+		for (int layer = parallax; layer >= cameraNS::WORLD_LAYER; layer--) {	// back to front
+			const D3DXMATRIX &m = camera.getViewMatrix(layer);
+			const std::vector<SpriteData> &list = sprites[layer];
+			for (size_t i = 0; i < list.size(); i++) {
+				const SpriteData &sd = list[i];
+				if (cull && !camera.isVisible(sd, layer))
+					continue;
+				float w = sd.width * sd.scale, h = sd.height * sd.scale;
+				float corners[4][2] = { { sd.x, sd.y }, { sd.x + w, sd.y }, { sd.x + w, sd.y + h }, { sd.x, sd.y + h } };
+				for (int c = 0; c < 4; c++) {
+					QuadVertex v;
+					v.x = corners[c][0] * m._11 + corners[c][1] * m._21 + m._41;
+					v.y = corners[c][0] * m._12 + corners[c][1] * m._22 + m._42;
+					v.z = 0.0f;
+					v.u = (c == 1 || c == 2) ? 1.0f : 0.0f;
+					v.v = (c >= 2) ? 1.0f : 0.0f;
+					vertices.push_back(v);
+				}
+			}
+		}
+		bench.endFrame();
+	}
+}
+
+//=============================================================================
+// Camera with sprites culled to the view
+//=============================================================================
+void benchmarkNS::cameraCulled(Benchmark &bench) {
+	cameraRun(bench, true);
+}
+
+//=============================================================================
+// Camera submitting every sprite, for comparison
+//=============================================================================
+void benchmarkNS::cameraUnculled(Benchmark &bench) {
+	cameraRun(bench, false);
+}
+
+namespace benchmarkNS {
+	const int SORT_KEYS = 100000;			// sprites submitted per frame
+}
+
+//=============================================================================
+// Make a frame's worth of sprite sort keys
+// 16 layers, y-sorted depth over a 4096 pixel world, mostly alpha blended,
+// from 64 textures.
+//=============================================================================
+static void makeSortKeys(std::vector<UINT64> &keys) {
+	keys.resize(benchmarkNS::SORT_KEYS);
+	UINT seed = 1;
+	for (size_t i = 0; i < keys.size(); i++) {
+		seed = seed * 1664525 + 1013904223;
+		UINT layer = seed >> 28;
+		float y = (float)(seed >> 8 & 0xfff) + (float)(seed & 0xff) / 256.0f;
+		graphicsNS::BLEND_MODE blend = (seed % 10 == 0) ? graphicsNS::BLEND_ADDITIVE : graphicsNS::BLEND_ALPHA;
+		LP_TEXTURE texture = (LP_TEXTURE)(UINT_PTR)(0x10000 + (seed >> 12 & 63) * 0x1000);
+		keys[i] = drawListNS::makeKey(layer, y, blend, texture);
+	}
+}
+
+//=============================================================================
+// Radix sort of 100k sprite sort keys
+// The result is checked against std::sort.
+//=============================================================================
+void benchmarkNS::sortRadix(Benchmark &bench) {
+	std::vector<UINT64> source, keys(SORT_KEYS), tempKeys(SORT_KEYS);
+	std::vector<UINT> order(SORT_KEYS), tempOrder(SORT_KEYS);
+	makeSortKeys(source);
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < SORT_KEYS; i++) {
+			keys[i] = source[i];
+			order[i] = i;
+		}
+		radixSortNS::sort(&keys[0], &order[0], SORT_KEYS, &tempKeys[0], &tempOrder[0]);
+		bench.endFrame();
+	}
+
+	std::vector<UINT64> expected(source);
+	std::sort(expected.begin(), expected.end());
+	for (int i = 0; i < SORT_KEYS; i++) {
+		bench.check(keys[i] == expected[i], "keys in std::sort order");
+		bench.check(source[order[i]] == keys[i], "values move with their keys");
+		bench.check(i == 0 || keys[i] != keys[i - 1] || order[i] > order[i - 1], "equal keys keep their order");
+	}
+}
+
+//=============================================================================
+// std::sort of the same keys with their sprite numbers, for comparison
+//=============================================================================
+void benchmarkNS::sortStd(Benchmark &bench) {
+	std::vector<UINT64> source;
+	std::vector<std::pair<UINT64, UINT> > items(SORT_KEYS);
+	makeSortKeys(source);
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < SORT_KEYS; i++)
+			items[i] = std::make_pair(source[i], (UINT)i);
+		std::sort(items.begin(), items.end());
+		bench.endFrame();
+	}
+}
+
+//=============================================================================
+// Build the vertices of 100k sprites on threads threads
+// Sprites come from 16 textures in runs, a quarter rotated, some flipped.
+// Every build's vertex stream must hash the same as a build on this thread
+// alone.
+//=============================================================================
+static void batchRun(Benchmark &bench, int threads) {
+	const int SPRITES = 100000;
+	const UINT TEXTURE_SIZE = 256;
+
+	std::vector<SpriteData> sprites(SPRITES);
+	UINT seed = 1;
+	for (int i = 0; i < SPRITES; i++) {
+		SpriteData &sd = sprites[i];
+		seed = seed * 1664525 + 1013904223;
+		sd.width = sd.height = 32;
+		sd.x = (float)(seed >> 8 & 1023);
+		sd.y = (float)(seed >> 18 & 1023) * 0.6f;
+		sd.scale = 1.0f + (float)(seed & 3) * 0.25f;
+		sd.angle = (i % 4 == 0) ? (float)(seed >> 24) / 40.0f : 0.0f;
+		sd.rect.left = (i % 8) * 32;
+		sd.rect.top = (i / 8 % 8) * 32;
+		sd.rect.right = sd.rect.left + 32;
+		sd.rect.bottom = sd.rect.top + 32;
+		sd.texture = (LP_TEXTURE)(UINT_PTR)(0x10000 + (i / 300 % 16) * 0x1000);
+		sd.flipHorizontal = (seed >> 4 & 7) == 0;
+		sd.flipVertical = false;
+	}
+	SpriteBatcher::Submit submit = [&sprites, TEXTURE_SIZE](int begin, int end, SpriteBucket &bucket) {
+		for (int i = begin; i < end; i++)
+			bucket.add(sprites[i], TEXTURE_SIZE, TEXTURE_SIZE, graphicsNS::WHITE);
+	};
+
+	SpriteBatcher batcher;
+	batcher.initialize(NULL, SPRITES);
+	batcher.build(NULL, SPRITES, submit);
+	UINT64 expected = batcher.hash();
+
+	JobSystem jobs;
+	jobs.initialize(threads);
+	for (int frame = 0; frame < benchmarkNS::FRAMES; frame++) {
+		bench.beginFrame();
+		batcher.build(&jobs, SPRITES, submit);
+		bench.endFrame();
+		bench.check(batcher.hash() == expected && batcher.getQuadCount() == SPRITES,
+			"vertices match a build on one thread");
+	}
+}
+
+//=============================================================================
+// Sprite vertices on 1 to 16 threads
+//=============================================================================
+void benchmarkNS::batchThreads1(Benchmark &bench) { batchRun(bench, 1); }
+void benchmarkNS::batchThreads2(Benchmark &bench) { batchRun(bench, 2); }
+void benchmarkNS::batchThreads4(Benchmark &bench) { batchRun(bench, 4); }
+void benchmarkNS::batchThreads8(Benchmark &bench) { batchRun(bench, 8); }
+void benchmarkNS::batchThreads16(Benchmark &bench) { batchRun(bench, 16); }
+
+namespace benchmarkNS {
+	const int   RESIDENT_TEXTURES = 1000;
+	const UINT64 RESIDENT_BUDGET = 32 * 1024 * 1024;
+
+	// Video memory of a simulated device
+	struct SimulatedDevice {
+		UINT64      capacity;			// bytes
+		UINT64      used;
+		UINT        loads;
+	};
+
+	// Texture that loads into a SimulatedDevice instead of Direct3D
+	class SimulatedTexture : public TextureManager {
+	private:
+		SimulatedDevice *device;
+
+	public:
+		// Create a width x height texture for d, loaded when first used.
+		void initialize(SimulatedDevice *d, UINT w, UINT h) {
+			device = d;
+			width = w;
+			height = h;
+			bytes = width * height * 4;
+			evicted = true;
+			initialized = true;
+		}
+
+		// Free the texture's device memory.
+		virtual void evict() {
+			if (evicted)
+				return;
+			device->used -= bytes;
+			evicted = true;
+		}
+
+		// Load the texture back. Fails if the device is full.
+		virtual bool restore() {
+			if (!evicted)
+				return true;
+			if (device->used + bytes > device->capacity)
+				return false;
+			device->used += bytes;
+			device->loads++;
+			evicted = false;
+			return true;
+		}
+	};
+}
+
+//=============================================================================
+// Texture residency on a simulated device
+// Textures lie along a strip of world regions, one per region. The camera
+// drifts along the strip while swinging back and forth, so it keeps
+// revisiting textures it has just left. Each frame draws 256 sprites from
+// each of the 24 textures in view and 8 HUD textures that are always used.
+// The device only has room for the budget, so any reload that went over it
+// would fail. Textures start evicted and load at the end of the frame they
+// are first used in. The sprites are split between JobSystem threads, as a
+// SpriteBatcher build would be.
+//=============================================================================
+void benchmarkNS::textureResidency(Benchmark &bench) {
+	const int   HUD_TEXTURES = 8;
+	const int   VIEW_TEXTURES = 24;
+	const int   SPRITES_PER_TEXTURE = 256;
+
+	SimulatedDevice device = { RESIDENT_BUDGET, 0, 0 };
+	JobSystem jobs;
+	jobs.initialize();
+	std::vector<SimulatedTexture> textures(RESIDENT_TEXTURES);
+	TextureResidency residency;
+	residency.initialize(RESIDENT_BUDGET);
+	UINT seed = 1;
+	UINT64 total = 0;
+	for (int i = 0; i < RESIDENT_TEXTURES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		UINT size = (i < HUD_TEXTURES) ? 128 : 64u << (seed >> 30);
+		textures[i].initialize(&device, size, size);
+		residency.add(&textures[i]);
+		total += textures[i].getBytes();
+	}
+	bench.check(total > 4 * RESIDENT_BUDGET, "textures are larger than the budget");
+
+	UINT uses = 0;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		int first = HUD_TEXTURES + 40 + (int)(frame * 0.5f + 40.0f * sinf(frame * 0.05f));
+		UINT loads = device.loads;
+		bench.beginFrame();
+		jobs.parallelFor(SPRITES_PER_TEXTURE, 16, [&](int begin, int end, int) {
+			for (int s = begin; s < end; s++) {
+				for (int t = 0; t < HUD_TEXTURES; t++)
+					textures[t].getTexture();
+				for (int t = first; t < first + VIEW_TEXTURES; t++)
+					textures[t].getTexture();
+			}
+		});
+		residency.endFrame();
+		bench.endFrame();
+		uses += HUD_TEXTURES + VIEW_TEXTURES;
+
+		for (int t = 0; t < HUD_TEXTURES; t++)
+			bench.check(textures[t].isResident(), "HUD texture stays resident");
+		for (int t = first; t < first + VIEW_TEXTURES; t++)
+			bench.check(textures[t].isResident(), "texture used this frame is resident");
+		bench.check(residency.getResidentBytes() <= RESIDENT_BUDGET, "resident bytes within budget");
+		bench.check(device.used == residency.getResidentBytes(), "resident bytes match the device");
+		bench.check(device.loads - loads <= (UINT)(frame == 0 ? HUD_TEXTURES + VIEW_TEXTURES : VIEW_TEXTURES),
+			"only textures used this frame are loaded");
+	}
+	bench.check(residency.getFailures() == 0, "no reload failures");
+	bench.check(residency.getHits() + residency.getMisses() == uses, "every use is a hit or a miss");
+	bench.check(residency.getMisses() == device.loads, "every miss is one load");
+	bench.check(residency.getHits() > residency.getMisses() * 4,	// swinging back finds textures still loaded
+		"least recently used textures are evicted first");
+	bench.check(residency.getEvictions() > 0, "textures are evicted");
+}
+
+namespace benchmarkNS {
+	const int   LOG_CALLS = 1000;		// records logged per frame
+	const char  LOG_BENCH_FILE[] = "bench_log.txt";
+}
+
+//=============================================================================
+// Log LOG_CALLS records per frame on this thread
+// Only the log calls are timed; the flush thread writes between frames, so
+// no records are dropped for lack of buffer space. Every record must reach
+// the file, or be rate limited when limited is true.
+//=============================================================================
+static void logRun(Benchmark &bench, bool limited) {
+	using namespace benchmarkNS;
+	Logger logger;
+	bool opened = logger.initialize(LOG_BENCH_FILE, logNS::LEVEL_DEBUG);
+	if (!bench.check(opened, "log file opened"))
+		return;
+	logger.setRateLimit(limited ? logNS::RATE_LIMIT : 0);
+	logger.setDebugOutput(false);
+	logger.info("benchmark {}", limited ? "log-limited" : "log");	// creates this thread's buffer
+	logger.flush();
+
+	UINT seed = 1;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < LOG_CALLS; i++) {
+			seed = seed * 1664525 + 1013904223;
+			logger.debug("sprite {} moved to {},{} on layer {}", i, (float)(seed >> 16), (float)(seed & 0xffff), "ground");
+		}
+		bench.endFrame();
+		logger.flush();
+	}
+
+	UINT64 calls = (UINT64)FRAMES * LOG_CALLS + 1;
+	UINT64 written = logger.getWritten();
+	bench.check(logger.getDropped() == 0, "no records dropped");
+	if (limited)
+		bench.check(written < calls / 100, "repeated records are rate limited");
+	else
+		bench.check(written == calls, "every record is written");
+	logger.shutdown();
+
+	std::ifstream in(LOG_BENCH_FILE);
+	std::string line;
+	UINT64 lines = 0;
+	while (std::getline(in, line)) {
+		bench.check(!line.empty() && line[0] == '{' && line[line.size() - 1] == '}',
+			"each record is one JSON object per line");
+		lines++;
+	}
+	in.close();
+	bench.check(lines == written, "file holds every written record");
+	DeleteFile(LOG_BENCH_FILE);
+}
+
+//=============================================================================
+// Log hot path, every record written
+//=============================================================================
+void benchmarkNS::logHotPath(Benchmark &bench) {
+	logRun(bench, false);
+}
+
+//=============================================================================
+// Log hot path with the rate limit dropping most records
+//=============================================================================
+void benchmarkNS::logRateLimited(Benchmark &bench) {
+	logRun(bench, true);
+}
+
+//=============================================================================
+// Feed frames of a fill rate bound scene to the resolution controller
+// Each frame takes base + fill * scale^2 seconds, times 1 +- noise.
+// Returns the number of scale changes.
+//=============================================================================
+static UINT resolutionTrace(ResolutionScaler &scaler, int frames, float base, float fill,
+	float noise, UINT &seed) {
+	UINT changes = scaler.getChanges();
+	for (int i = 0; i < frames; i++) {
+		seed = seed * 1664525 + 1013904223;
+		float jitter = 1.0f + noise * ((float)(seed >> 8) / (float)(1 << 24) * 2.0f - 1.0f);
+		float scale = scaler.getScale();
+		scaler.update((base + fill * scale * scale) * jitter);
+	}
+	return scaler.getChanges() - changes;
+}
+
+//=============================================================================
+// Dynamic resolution controller on synthetic traces, 60 Hz target
+// Steady: a scene too slow at full resolution settles on the largest step
+//   that fits, 0.75, and stays there.
+// Noisy: the same scene with +-15% frame to frame noise changes scale only
+//   a few times.
+// Burst: a light scene runs at full resolution, drops during a heavy burst
+//   and returns to full resolution afterwards.
+//=============================================================================
+void benchmarkNS::resolutionTraces(Benchmark &bench) {
+	const float TARGET = 1.0f / 60.0f;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		UINT seed = 1;
+		bench.beginFrame();
+
+		ResolutionScaler steady;
+		steady.initialize(TARGET);
+		resolutionTrace(steady, 500, 0.004f, 0.020f, 0.0f, seed);
+		UINT steadyChanges = resolutionTrace(steady, 1500, 0.004f, 0.020f, 0.0f, seed);
+
+		ResolutionScaler noisy;
+		noisy.initialize(TARGET);
+		UINT noisyChanges = resolutionTrace(noisy, 2000, 0.004f, 0.020f, 0.15f, seed);
+
+		ResolutionScaler burst;
+		burst.initialize(TARGET);
+		UINT lightChanges = resolutionTrace(burst, 500, 0.004f, 0.006f, 0.05f, seed);
+		resolutionTrace(burst, 500, 0.004f, 0.030f, 0.05f, seed);
+		float burstScale = burst.getScale();
+		float burstAverage = burst.getAverage();
+		resolutionTrace(burst, 1000, 0.004f, 0.006f, 0.05f, seed);
+
+		bench.endFrame();
+
+		bench.check(steady.getScale() == 0.75f && steadyChanges == 0, "steady scene settles on 0.75");
+		bench.check(steady.getAverage() <= TARGET, "steady scene meets the target");
+		bench.check(noisyChanges <= 6 && noisy.getScale() >= 0.6875f && noisy.getScale() <= 0.75f,
+			"noisy scene changes scale a few times");
+		bench.check(lightChanges == 0, "light scene stays at full resolution");
+		bench.check(burstScale <= 0.6875f && burstAverage <= TARGET, "burst drops resolution");
+		bench.check(burst.getScale() == 1.0f, "burst returns to full resolution");
+	}
+}
+
+namespace benchmarkNS {
+	const double IDLE_WINDOW = 0.1;			// seconds of game loop in each sample
+	const int   IDLE_PLAY_END = 60;			// timeline in samples: playing until here,
+	const int   IDLE_MENU_END = 180;		// then in a menu with occasional input,
+	const int   IDLE_BACKGROUND_END = 240;	// then without focus, then minimized
+	const double IDLE_INPUT_PERIOD = 1.0;	// seconds between inputs in the menu
+	const double IDLE_ANIMATION = 0.1;		// seconds the menu animates after input
+	const int   IDLE_PARTICLES = 20000;		// updated every frame run
+	const int   IDLE_SPRITES = 20000;		// built into vertices every frame drawn
+
+	// Return CPU milli-seconds used by this process on all threads.
+	double processCpuMs() {
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+			return 0;
+		ULARGE_INTEGER k, u;
+		k.LowPart = kernel.dwLowDateTime;
+		k.HighPart = kernel.dwHighDateTime;
+		u.LowPart = user.dwLowDateTime;
+		u.HighPart = user.dwHighDateTime;
+		return (double)(k.QuadPart + u.QuadPart) / 10000.0;	// 100 ns units
+	}
+
+	// Return seconds on the performance counter.
+	double clockSeconds() {
+		LARGE_INTEGER freq, now;
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&now);
+		return (double)now.QuadPart / (double)freq.QuadPart;
+	}
+}
+
+//=============================================================================
+// Run the game loop of Game::run() and WinMain in real time
+// Each benchmark frame is IDLE_WINDOW seconds of the loop, sampled as the
+// process CPU milli-seconds used in it. A frame run updates particles, and
+// a frame drawn also builds sprite vertices. Waits are real sleeps of the
+// length FramePacer gives, cut short by input as MsgWaitForMultipleObjects()
+// would be.
+// throttle = false runs the loop as it was before FramePacer: every frame
+// drawn at FRAME_RATE, with or without focus, even minimized.
+//=============================================================================
+static void idleRun(Benchmark &bench, bool throttle) {
+	using namespace benchmarkNS;
+	ParticleSystem particles;
+	particles.initialize(NULL, NULL, 1, 1, IDLE_PARTICLES);
+	ParticleEmitter emitter;
+	emitter.x = GAME_WIDTH / 2;
+	emitter.y = GAME_HEIGHT / 2;
+	emitter.lifeMin = 1.0f;
+	emitter.lifeMax = 2.0f;
+	emitter.rate = IDLE_PARTICLES / 1.5f;		// about IDLE_PARTICLES alive
+	particles.addEmitter(emitter);
+	std::vector<SpriteData> sprites(IDLE_SPRITES);
+	UINT seed = 1;
+	for (int i = 0; i < IDLE_SPRITES; i++) {
+		SpriteData &sd = sprites[i];
+		seed = seed * 1664525 + 1013904223;
+		sd.width = sd.height = 32;
+		sd.x = (float)(seed >> 8 & 1023);
+		sd.y = (float)(seed >> 18 & 1023) * 0.6f;
+		sd.scale = 1.0f;
+		sd.angle = (float)(seed >> 24) / 40.0f;
+		sd.rect.left = sd.rect.top = 0;
+		sd.rect.right = sd.rect.bottom = 32;
+		sd.texture = (LP_TEXTURE)(UINT_PTR)(0x10000 + (i / 500 % 8) * 0x1000);
+		sd.flipHorizontal = sd.flipVertical = false;
+	}
+	SpriteBatcher::Submit submit = [&sprites](int begin, int end, SpriteBucket &bucket) {
+		for (int i = begin; i < end; i++)
+			bucket.add(sprites[i], 256, 256, graphicsNS::WHITE);
+	};
+	SpriteBatcher batcher;
+	batcher.initialize(NULL, IDLE_SPRITES);
+
+	FramePacer pacer;
+	pacer.initialize(FRAME_RATE, IDLE_FRAME_RATE, BACKGROUND_FRAME_RATE);
+	pacer.setOnDemand(throttle);
+	timeBeginPeriod(1);							// 1 ms sleeps, as run() requests
+	double start = clockSeconds();
+	double frameStart = start - 1;
+	double animateUntil = start + IDLE_PLAY_END * IDLE_WINDOW;	// the game moves while playing
+	double nextInput = start + IDLE_PLAY_END * IDLE_WINDOW + IDLE_INPUT_PERIOD;
+	double menuEnd = start + IDLE_MENU_END * IDLE_WINDOW;
+	double inputTime = -1;						// input not drawn yet
+	double worstLatency = 0;					// milli-seconds from input to drawn
+	double phaseCpu[4] = { 0, 0, 0, 0 };		// play, menu, background, minimized
+
+	for (int sample = 0; sample < FRAMES; sample++) {
+		if (throttle && sample == IDLE_MENU_END)
+			pacer.setActive(false);
+		if (throttle && sample == IDLE_BACKGROUND_END)
+			pacer.setMinimized(true);
+		double end = start + (sample + 1) * IDLE_WINDOW;
+		double cpuStart = processCpuMs();
+		double now;
+		while ((now = clockSeconds()) < end) {
+			if (now >= nextInput) {				// key press message
+				pacer.requestRedraw();
+				inputTime = nextInput;
+				animateUntil = nextInput + IDLE_ANIMATION;
+				nextInput += IDLE_INPUT_PERIOD;
+				if (nextInput >= menuEnd)
+					nextInput = end + FRAMES;	// no more input
+			}
+
+			// wait the way run() and WinMain do
+			float elapsed = (float)(now - frameStart);
+			double wake = now;
+			if (pacer.isThrottled()) {
+				DWORD wait = pacer.getWait(elapsed);
+				wake = (wait == pacerNS::BLOCK) ? end : now + wait / 1000.0;
+			}
+			else if (elapsed < MIN_FRAME_TIME)
+				wake = frameStart + MIN_FRAME_TIME;
+			wake = (std::min)(wake, (std::min)(end, nextInput));
+			if (wake > now) {
+				Sleep((DWORD)((wake - now) * 1000.0));
+				continue;
+			}
+
+			// run a frame, drawing it if the pacer says so
+			frameStart = now;
+			particles.update(elapsed < MAX_FRAME_TIME ? elapsed : MAX_FRAME_TIME);
+			if (pacer.shouldDraw(now < animateUntil)) {
+				batcher.build(NULL, IDLE_SPRITES, submit);
+				if (inputTime >= 0) {
+					worstLatency = (std::max)(worstLatency, (clockSeconds() - inputTime) * 1000.0);
+					inputTime = -1;
+				}
+			}
+		}
+		double cpu = processCpuMs() - cpuStart;
+		bench.addSample((float)cpu);
+		int phase = (sample < IDLE_PLAY_END) ? 0 : (sample < IDLE_MENU_END) ? 1 :
+			(sample < IDLE_BACKGROUND_END) ? 2 : 3;
+		phaseCpu[phase] += cpu;
+	}
+	timeEndPeriod(1);
+
+	// CPU milli-seconds per sample in each phase
+	double play = phaseCpu[0] / IDLE_PLAY_END;
+	double menu = phaseCpu[1] / (IDLE_MENU_END - IDLE_PLAY_END);
+	double background = phaseCpu[2] / (IDLE_BACKGROUND_END - IDLE_MENU_END);
+	double minimized = phaseCpu[3] / (FRAMES - IDLE_BACKGROUND_END);
+	bench.check(play > 0, "playing uses CPU");
+	if (throttle) {
+		// the menu is drawn at full rate only while it animates after
+		// input, and run at the idle rate without drawing otherwise;
+		// without focus frames run at the background rate, and minimized
+		// none run at all
+		bench.check(menu < play * 0.5, "idle menu uses under half the CPU of play");
+		bench.check(background < play * 0.25, "background uses under a quarter of the CPU of play");
+		bench.check(minimized < play * 0.05, "minimized uses almost no CPU");
+		bench.check(worstLatency < 1000.0 / IDLE_FRAME_RATE, "input answered within an idle frame");
+	}
+	else
+		bench.check(menu > play * 0.5 && background > play * 0.5 && minimized > play * 0.5,
+			"unthrottled loop uses the CPU of play throughout");
+}
+
+//=============================================================================
+// Game loop CPU use while playing, idle in a menu, in the background and
+// minimized, drawn on demand and throttled
+//=============================================================================
+void benchmarkNS::idleThrottled(Benchmark &bench) {
+	idleRun(bench, true);
+}
+
+//=============================================================================
+// The same timeline with every frame drawn at the full frame rate
+//=============================================================================
+void benchmarkNS::idleAlwaysOn(Benchmark &bench) {
+	idleRun(bench, false);
+}
+
+namespace benchmarkNS {
+	const int OVERDRAW_SHIPS = 300;			// cutout sprites over the background
+	const int OVERDRAW_SMOKE = 150;			// blended sprites over the ships
+	const int OVERDRAW_PANELS = 8;			// opaque HUD panels on top
+}
+
+// Synthetic textures of the overdraw scene
+struct OverdrawTextures {
+	OpacityMap  background;				// opaque, screen sized
+	OpacityMap  ship;					// cutout circle
+	OpacityMap  smoke;					// blended radial falloff
+	OpacityMap  panel;					// opaque
+};
+
+//=============================================================================
+// Make a w x h opacity map, alpha from the distance to the center
+// radius = 0 for opaque, > 0 for a cutout circle, < 0 for a blended falloff
+//=============================================================================
+static void makeOpacity(OpacityMap &map, int w, int h, float radius) {
+	std::vector<BYTE> alpha(w * h);
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++) {
+			float dx = x + 0.5f - w / 2.0f, dy = y + 0.5f - h / 2.0f;
+			float d = sqrtf(dx * dx + dy * dy);
+			BYTE a = 255;
+			if (radius > 0)
+				a = (d < radius) ? 255 : 0;
+			else if (radius < 0)
+				a = (d < -radius) ? (BYTE)(255 * (1.0f + d / radius)) : 0;
+			alpha[y * w + x] = a;
+		}
+	map.initialize(&alpha[0], w, h, w, 1);
+}
+
+//=============================================================================
+// Submit the overdraw scene
+// A screen sized background, ships y-sorted over it, smoke over the ships
+// and HUD panels over everything.
+//=============================================================================
+static void submitOverdraw(DrawList &list, const OverdrawTextures &t) {
+	using namespace benchmarkNS;
+	SpriteData sd;
+	memset(&sd, 0, sizeof(sd));
+	sd.scale = 1.0f;
+	sd.width = GAME_WIDTH;
+	sd.height = GAME_HEIGHT;
+	sd.rect.right = GAME_WIDTH;
+	sd.rect.bottom = GAME_HEIGHT;
+	sd.texture = (LP_TEXTURE)(UINT_PTR)0x10000;
+	list.add(0, 0.0f, sd, graphicsNS::WHITE, graphicsNS::BLEND_ALPHA, &t.background);
+
+	UINT seed = 1;
+	sd.width = sd.height = 64;
+	sd.rect.right = sd.rect.bottom = 64;
+	sd.texture = (LP_TEXTURE)(UINT_PTR)0x11000;
+	for (int i = 0; i < OVERDRAW_SHIPS; i++) {
+		seed = seed * 1664525 + 1013904223;
+		sd.x = (float)(seed >> 8 & 1023) - 64.0f;
+		sd.y = (float)(seed >> 18 & 511) + 16.0f;
+		sd.scale = 1.0f + (seed & 3) * 0.25f;
+		sd.angle = (float)(seed >> 4 & 63) * 0.1f;
+		list.add(1, sd.y, sd, graphicsNS::WHITE, graphicsNS::BLEND_ALPHA, &t.ship);
+	}
+
+	sd.width = sd.height = 32;
+	sd.rect.right = sd.rect.bottom = 32;
+	sd.angle = 0.0f;
+	sd.texture = (LP_TEXTURE)(UINT_PTR)0x12000;
+	for (int i = 0; i < OVERDRAW_SMOKE; i++) {
+		seed = seed * 1664525 + 1013904223;
+		sd.x = (float)(seed >> 8 & 1023) - 32.0f;
+		sd.y = (float)(seed >> 18 & 511) + 32.0f;
+		sd.scale = 1.0f + (seed & 7) * 0.25f;
+		list.add(2, sd.y, sd, graphicsNS::WHITE, graphicsNS::BLEND_ALPHA, &t.smoke);
+	}
+
+	sd.width = 128;
+	sd.height = 64;
+	sd.rect.right = 128;
+	sd.rect.bottom = 64;
+	sd.scale = 1.0f;
+	sd.texture = (LP_TEXTURE)(UINT_PTR)0x13000;
+	for (int i = 0; i < OVERDRAW_PANELS; i++) {
+		sd.x = (float)(i * (GAME_WIDTH / OVERDRAW_PANELS));
+		sd.y = (float)(GAME_HEIGHT - 64);
+		list.add(3, 0.0f, sd, graphicsNS::WHITE, graphicsNS::BLEND_ALPHA, &t.panel);
+	}
+}
+
+//=============================================================================
+// Draw the overdraw scene with a software rasterizer
+// Before timing, the scene is drawn in one pass and in split passes, and
+// every pixel must end up showing the same sprite.
+//=============================================================================
+static void overdrawRun(Benchmark &bench, bool split) {
+	using namespace benchmarkNS;
+	OverdrawTextures textures;
+	makeOpacity(textures.background, GAME_WIDTH, GAME_HEIGHT, 0.0f);
+	makeOpacity(textures.ship, 64, 64, 28.0f);
+	makeOpacity(textures.smoke, 32, 32, -16.0f);
+	makeOpacity(textures.panel, 128, 64, 0.0f);
+	int sprites = 1 + OVERDRAW_SHIPS + OVERDRAW_SMOKE + OVERDRAW_PANELS;
+	DrawList list;
+	list.initialize(NULL, sprites);
+	SoftwareRasterizer single, passes;
+	single.initialize(GAME_WIDTH, GAME_HEIGHT);
+	passes.initialize(GAME_WIDTH, GAME_HEIGHT);
+
+	list.setSplitPasses(false);
+	list.setRasterizer(&single);
+	submitOverdraw(list, textures);
+	list.flush();
+	list.setSplitPasses(true);
+	list.setRasterizer(&passes);
+	submitOverdraw(list, textures);
+	list.flush();
+	int mismatched = 0;
+	for (int y = 0; y < GAME_HEIGHT; y++)
+		for (int x = 0; x < GAME_WIDTH; x++)
+			if (single.getTop(x, y) != passes.getTop(x, y))
+				mismatched++;
+	bench.check(mismatched == 0, "split passes show the same top sprite in every pixel");
+	bench.check(list.getStats().opaqueSprites == 1 + OVERDRAW_SHIPS + OVERDRAW_PANELS, "opaque pass sprites");
+	bench.check(list.getStats().blendedSprites == OVERDRAW_SMOKE, "blended pass sprites");
+	// the opaque background is no longer shaded under everything else
+	bench.check(passes.getShaded() < single.getShaded() * 0.6, "split passes shade fewer pixels");
+
+	SoftwareRasterizer &rasterizer = split ? passes : single;
+	list.setSplitPasses(split);
+	list.setRasterizer(&rasterizer);
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		rasterizer.clear();
+		submitOverdraw(list, textures);
+		list.flush();
+		bench.endFrame();
+	}
+}
+
+//=============================================================================
+// Overdraw scene drawn in split opaque and blended passes
+//=============================================================================
+void benchmarkNS::overdrawSplit(Benchmark &bench) {
+	overdrawRun(bench, true);
+}
+
+//=============================================================================
+// Overdraw scene drawn in one pass in key order
+//=============================================================================
+void benchmarkNS::overdrawSingle(Benchmark &bench) {
+	overdrawRun(bench, false);
+}
+
+namespace benchmarkNS {
+	const char  HEATMAP_FILE[] = "bench_heatmap.bmp";
+}
+
+//=============================================================================
+// Heatmap and fill totals of the overdraw scene
+// Before timing, the totals are checked against the rasterizer's own
+// counts and the top sprites against a full sort of every sprite.
+//=============================================================================
+void benchmarkNS::overdrawHeatmap(Benchmark &bench) {
+	using namespace heatmapNS;
+	OverdrawTextures textures;
+	makeOpacity(textures.background, GAME_WIDTH, GAME_HEIGHT, 0.0f);
+	makeOpacity(textures.ship, 64, 64, 28.0f);
+	makeOpacity(textures.smoke, 32, 32, -16.0f);
+	makeOpacity(textures.panel, 128, 64, 0.0f);
+	DrawList list;
+	list.initialize(NULL, 1 + OVERDRAW_SHIPS + OVERDRAW_SMOKE + OVERDRAW_PANELS);
+	SoftwareRasterizer rasterizer;
+	rasterizer.initialize(GAME_WIDTH, GAME_HEIGHT);
+	list.setRasterizer(&rasterizer);
+	OverdrawHeatmap heatmap;
+
+	submitOverdraw(list, textures);
+	list.flush();
+	heatmap.analyze(rasterizer);
+	const HeatmapStats &stats = heatmap.getStats();
+	UINT64 pixels = 0, atLeast = 0;
+	for (int level = 0; level <= LEVELS; level++) {
+		pixels += stats.pixels[level];
+		atLeast += (UINT64)level * stats.pixels[level];
+	}
+	bench.check(pixels == (UINT64)GAME_WIDTH * GAME_HEIGHT, "every pixel is in a level");
+	bench.check(stats.shaded == rasterizer.getShaded() && stats.shaded >= atLeast, "fill total");
+	bench.check(stats.maxCount >= (UINT)(stats.pixels[LEVELS] ? LEVELS : 0), "largest count");
+	const UINT *counts = rasterizer.getShadedCounts();
+	size_t miscolored = 0;
+	for (size_t i = 0; i < pixels; i++)
+		if (heatmap.getPixels()[i] != color(counts[i]))
+			miscolored++;
+	bench.check(miscolored == 0, "heatmap colors match the pixel counts");
+
+	std::vector<UINT64> byId;
+	UINT64 sum = 0;
+	for (UINT id = 0; id < rasterizer.getIdCount(); id++) {
+		byId.push_back(rasterizer.getShadedById(id));
+		sum += byId.back();
+	}
+	bench.check(sum == stats.shaded, "sprite fills add up to the fill total");
+	std::sort(byId.begin(), byId.end(), [](UINT64 a, UINT64 b) { return a > b; });
+	bench.check(stats.topCount == TOP_SPRITES, "top sprite count");
+	for (int i = 0; i < stats.topCount; i++)
+		bench.check(stats.top[i].shaded == byId[i] && rasterizer.getShadedById(stats.top[i].id) == byId[i],
+			"top sprites are the largest fills");
+	bool saved = heatmap.saveBitmap(HEATMAP_FILE);
+	bench.check(saved, "heatmap bitmap saved");
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		rasterizer.clear();
+		submitOverdraw(list, textures);
+		list.flush();
+		heatmap.analyze(rasterizer);
+		bench.endFrame();
+	}
+}
+
+namespace benchmarkNS {
+	const int MESH_SPRITES = 2000;			// sprites drawn per frame
+	const int MESH_FRAME = 64;				// frame size in pixels
+	const int MESH_COLS = 4;				// frames per row of the sheet
+	const int MESH_FRAMES = 8;				// frames of the sheet
+}
+
+//=============================================================================
+// Return the alpha of pixel x, y of a synthetic frame
+// Shapes a sprite sheet might hold, from a small blob in a corner to a
+// frame with every pixel visible.
+//=============================================================================
+static BYTE meshShape(int frame, int x, int y) {
+	using namespace benchmarkNS;
+	float cx = x + 0.5f - MESH_FRAME / 2.0f, cy = y + 0.5f - MESH_FRAME / 2.0f;
+	bool visible = false;
+	switch (frame) {
+	case 0: visible = cx * cx + cy * cy < 28.0f * 28.0f; break;				// ball
+	case 1: visible = fabsf(cy) < 4.0f + (cx + 30.0f) * 0.4f && cx > -30.0f	// arrow
+		&& cx < 30.0f - fabsf(cy) * 0.5f; break;
+	case 2: visible = fabsf(cx) + fabsf(cy) < 30.0f; break;					// diamond
+	case 3: visible = (x >= 8 && x < 20 && y >= 4 && y < 60) ||				// L
+		(x >= 8 && x < 56 && y >= 48 && y < 60); break;
+	case 4: visible = (x - 12) * (x - 12) + (y - 12) * (y - 12) < 100; break;	// corner blob
+	case 5: break;																// empty
+	case 6: visible = true; break;												// full
+	case 7: visible = cx * cx * 4.0f + cy * cy < 24.0f * 24.0f &&				// ring
+		cx * cx * 4.0f + cy * cy > 12.0f * 12.0f; break;
+	}
+	return visible ? 255 : 0;
+}
+
+//=============================================================================
+// Make the opacity map of the synthetic sheet
+//=============================================================================
+static void makeMeshSheet(OpacityMap &map) {
+	using namespace benchmarkNS;
+	int w = MESH_FRAME * MESH_COLS;
+	int h = MESH_FRAME * ((MESH_FRAMES + MESH_COLS - 1) / MESH_COLS);
+	std::vector<BYTE> alpha(w * h);
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++) {
+			int frame = y / MESH_FRAME * MESH_COLS + x / MESH_FRAME;
+			alpha[y * w + x] = meshShape(frame, x % MESH_FRAME, y % MESH_FRAME);
+		}
+	map.initialize(&alpha[0], w, h, w, 1);
+}
+
+//=============================================================================
+// Make the sprites of the mesh scene, each with the frame it shows
+//=============================================================================
+static void makeMeshSprites(std::vector<SpriteData> &sprites, std::vector<int> &frames) {
+	using namespace benchmarkNS;
+	sprites.resize(MESH_SPRITES);
+	frames.resize(MESH_SPRITES);
+	UINT seed = 1;
+	for (int i = 0; i < MESH_SPRITES; i++) {
+		SpriteData &sd = sprites[i];
+		memset(&sd, 0, sizeof(sd));
+		seed = seed * 1664525 + 1013904223;
+		int frame = i % MESH_FRAMES;
+		frames[i] = frame;
+		sd.width = sd.height = MESH_FRAME;
+		sd.rect.left = (frame % MESH_COLS) * MESH_FRAME;
+		sd.rect.top = (frame / MESH_COLS) * MESH_FRAME;
+		sd.rect.right = sd.rect.left + MESH_FRAME;
+		sd.rect.bottom = sd.rect.top + MESH_FRAME;
+		sd.x = (float)(seed >> 8 & 1023) - 32.0f;
+		sd.y = (float)(seed >> 18 & 511) + 16.0f;
+		sd.scale = 0.5f + (seed & 3) * 0.5f;
+		sd.angle = (i % 3 == 0) ? 0.0f : (float)(seed >> 4 & 63) * 0.1f;
+		sd.flipHorizontal = (seed >> 27 & 1) != 0;
+		sd.flipVertical = (seed >> 28 & 3) == 0;
+		sd.texture = (LP_TEXTURE)(UINT_PTR)0x10000;
+	}
+}
+
+//=============================================================================
+// Draw the mesh scene with a software rasterizer
+//=============================================================================
+static void drawMeshScene(SoftwareRasterizer &rasterizer, const std::vector<SpriteData> &sprites,
+	const std::vector<int> &frames, const SpriteMeshSheet *meshes) {
+	rasterizer.clear();
+	for (size_t i = 0; i < sprites.size(); i++) {
+		rasterizer.setId((UINT)i);
+		rasterizer.drawSprite(sprites[i], 0.0f, meshes ? meshes->getMesh(frames[i]) : NULL);
+	}
+}
+
+//=============================================================================
+// Draw the mesh scene with quads or trimmed meshes
+// Before timing, both are drawn and must write the same pixels, give or
+// take pixel centers on the edge of a texel, and the batcher must
+// emit each mesh's fan as (count - 1) / 2 quads.
+//=============================================================================
+static void meshesRun(Benchmark &bench, bool trimmed) {
+	using namespace benchmarkNS;
+	OpacityMap map;
+	makeMeshSheet(map);
+	SpriteMeshSheet meshes;
+	meshes.initialize(map, MESH_FRAME, MESH_FRAME, MESH_COLS, MESH_FRAMES);
+	bench.check(meshes.getMesh(5)->count == 0, "empty frame is skipped");
+	bench.check(meshes.getMesh(6)->count == 4, "full frame keeps its quad");
+	bench.check(meshes.getFillRatio() < 0.6f, "meshes trim the frames");
+	std::vector<SpriteData> sprites;
+	std::vector<int> frames;
+	makeMeshSprites(sprites, frames);
+
+	SoftwareRasterizer quads, fans;
+	quads.initialize(GAME_WIDTH, GAME_HEIGHT);
+	fans.initialize(GAME_WIDTH, GAME_HEIGHT);
+	quads.setCoverage(&map);
+	fans.setCoverage(&map);
+	drawMeshScene(quads, sprites, frames, NULL);
+	drawMeshScene(fans, sprites, frames, &meshes);
+	int mismatched = 0;
+	for (int y = 0; y < GAME_HEIGHT; y++)
+		for (int x = 0; x < GAME_WIDTH; x++)
+			if (quads.getTop(x, y) != fans.getTop(x, y))
+				mismatched++;
+	// texels found by interpolating across different triangles may round
+	// differently where a pixel center is within float error of a texel edge
+	bench.check((UINT64)mismatched * 10000 <= quads.getWritten(), "meshes write the pixels of their quads");
+	bench.check(fans.getShaded() < quads.getShaded() * 0.6, "meshes shade fewer pixels");
+
+	UINT expected = 0;
+	for (int i = 0; i < MESH_SPRITES; i++) {
+		int count = meshes.getMesh(frames[i])->count;
+		expected += (count < 3) ? 0 : (count - 1) / 2;
+	}
+	SpriteBatcher batcher;
+	batcher.initialize(NULL, MESH_SPRITES * meshNS::MAX_VERTICES / 2);
+	batcher.build(NULL, MESH_SPRITES, [&](int begin, int end, SpriteBucket &bucket) {
+		for (int i = begin; i < end; i++)
+			bucket.add(sprites[i], map.getWidth(), map.getHeight(), graphicsNS::WHITE,
+				meshes.getMesh(frames[i]));
+	});
+	bench.check(batcher.getQuadCount() == expected, "batcher emits each fan as quads");
+
+	// a DrawList carries each sprite's mesh through to the pixels it draws
+	SoftwareRasterizer listed;
+	listed.initialize(GAME_WIDTH, GAME_HEIGHT);
+	DrawList list;
+	list.initialize(NULL, MESH_SPRITES);
+	list.setSplitPasses(false);
+	list.setRasterizer(&listed);
+	for (int i = 0; i < MESH_SPRITES; i++)
+		list.add(0, 0.0f, sprites[i], graphicsNS::WHITE, graphicsNS::BLEND_ALPHA, &map,
+			meshes.getMesh(frames[i]));
+	list.flush();
+	bench.check(listed.getShaded() == fans.getShaded(), "DrawList draws the meshes");
+
+	SoftwareRasterizer &rasterizer = trimmed ? fans : quads;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		drawMeshScene(rasterizer, sprites, frames, trimmed ? &meshes : NULL);
+		bench.endFrame();
+	}
+}
+
+//=============================================================================
+// Sprites drawn as meshes trimmed to their visible pixels
+//=============================================================================
+void benchmarkNS::meshesTrimmed(Benchmark &bench) {
+	meshesRun(bench, true);
+}
+
+//=============================================================================
+// The same sprites drawn as quads
+//=============================================================================
+void benchmarkNS::meshesQuads(Benchmark &bench) {
+	meshesRun(bench, false);
+}
+
+namespace benchmarkNS {
+	const int   TIMER_COUNT = 1000000;		// timers pending at once
+	const int   TIMER_CHURN = 2000;			// timers cancelled and scheduled again each frame
+	const int   TIMER_REPEAT_ONE_IN = 8;	// one timer in this many repeats
+	const UINT  TIMER_MIN_DELAY = 16;		// milli-seconds
+	const UINT  TIMER_MAX_DELAY = 60000;
+	const UINT  TIMER_MIN_PERIOD = 250;
+	const UINT  TIMER_MAX_PERIOD = 10000;
+	const float TIMER_STEP = 1.0f / 60.0f;	// seconds advanced each frame
+	const int   TIMER_LONG_COUNT = 4000;	// timers of up to TIMER_LONG_DELAY checked through every level
+	const UINT  TIMER_LONG_DELAY = 20000000;	// milli-seconds, about 5.5 hours
+
+	// Expected calls of a timer on the wheel
+	struct TimerCheck {
+		UINT64      next;				// tick of the next call
+		UINT        period;				// ticks, 0 for one-shot
+		PoolHandle  handle;
+	};
+
+	// Timers on a wheel and what is expected of them
+	struct TimerBench {
+		TimerWheel  wheel;
+		std::vector<TimerCheck> checks;
+		Benchmark   *bench;				// records failed checks
+		UINT        seed;
+		UINT64      fired;
+	};
+
+	// A timer counted down each frame
+	struct PolledTimer {
+		float       remaining;			// seconds
+		float       period;				// seconds, 0 for one-shot
+	};
+}
+
+//=============================================================================
+// Pick a random delay and period in milli-seconds
+//=============================================================================
+static void randomTimer(UINT &seed, UINT &delay, UINT &period) {
+	using namespace benchmarkNS;
+	seed = seed * 1664525 + 1013904223;
+	delay = TIMER_MIN_DELAY + (seed >> 8) % (TIMER_MAX_DELAY - TIMER_MIN_DELAY);
+	seed = seed * 1664525 + 1013904223;
+	period = ((seed >> 8) % TIMER_REPEAT_ONE_IN == 0) ?
+		TIMER_MIN_PERIOD + (seed >> 12) % (TIMER_MAX_PERIOD - TIMER_MIN_PERIOD) : 0;
+}
+
+//=============================================================================
+// Schedule timer i of a TimerBench
+// Each call checks it is on the tick expected. A one-shot timer schedules
+// a new timer in its place, so the number pending stays the same.
+//=============================================================================
+static void scheduleChecked(benchmarkNS::TimerBench &b, UINT i) {
+	using namespace benchmarkNS;
+	UINT delay, period;
+	randomTimer(b.seed, delay, period);
+	TimerCheck &c = b.checks[i];
+	c.next = b.wheel.getTicks() + delay;
+	c.period = period;
+	TimerBench *bp = &b;
+	c.handle = b.wheel.schedule(delay / 1000.0f, [bp, i](PoolHandle h) {
+		TimerCheck &c = bp->checks[i];
+		bp->bench->check(h == c.handle && bp->wheel.getTicks() == c.next, "timer called on its due tick");
+		bp->fired++;
+		if (c.period > 0)
+			c.next += c.period;
+		else
+			scheduleChecked(*bp, i);
+	}, period / 1000.0f);
+	b.bench->check(b.wheel.isPending(c.handle), "scheduled timer is pending");
+}
+
+//=============================================================================
+// Check cancelling, stale handles and a full wheel on a small wheel
+//=============================================================================
+static void checkTimerWheel(Benchmark &bench) {
+	TimerWheel wheel;
+	wheel.initialize(3);
+	int calls = 0;
+	PoolHandle self, other;
+	self = wheel.schedule(0.010f, [&](PoolHandle h) {
+		calls++;
+		bool cancelled = wheel.cancel(h);			// cancels itself while running
+		bench.check(cancelled && !wheel.isPending(h), "running timer cancels itself");
+		wheel.cancel(other);						// due on the same tick
+	}, 0.010f);
+	other = wheel.schedule(0.010f, [&](PoolHandle) { calls++; });
+	PoolHandle later = wheel.schedule(100.0f, [&](PoolHandle) { calls += 100; });
+	PoolHandle full = wheel.schedule(1.0f, [](PoolHandle) {});
+	bench.check(!wheel.isPending(full), "full wheel refuses a timer");
+	bench.check(wheel.getRemaining(later) > 99.9f, "remaining time");
+	wheel.advance(0.5f);
+	bench.check(calls == 1 || calls == 2, "timer cancelled on its due tick");	// other runs first or is cancelled
+	bench.check(!wheel.isPending(self) && !wheel.isPending(other) && wheel.getCount() == 1,
+		"cancelled timers are no longer pending");
+	PoolHandle reused = wheel.schedule(0.001f, [&](PoolHandle) { calls += 10; });
+	bench.check(reused.index == self.index || reused.index == other.index, "freed slot is reused");
+	bool cancelledSelf = wheel.cancel(self);
+	bool cancelledOther = wheel.cancel(other);
+	bench.check(!cancelledSelf && !cancelledOther, "handles are stale after their slot is reused");
+	wheel.clear();
+	bench.check(!wheel.isPending(later) && !wheel.isPending(reused) && wheel.getCount() == 0,
+		"clear() removes every timer");
+	wheel.advance(200.0f);
+	bench.check(calls <= 2, "cleared timers are not called");
+
+	// long delays move down through every level, in steps of up to 100 s
+	using namespace benchmarkNS;
+	TimerWheel longWheel;
+	longWheel.initialize(TIMER_LONG_COUNT);
+	std::vector<UINT64> due(TIMER_LONG_COUNT);
+	UINT seed = 7;
+	for (int i = 0; i < TIMER_LONG_COUNT; i++) {
+		seed = seed * 1664525 + 1013904223;
+		float delay = (1 + (seed >> 4) % TIMER_LONG_DELAY) / 1000.0f;
+		due[i] = (UINT64)(delay * 1000.0 + 0.5);		// float seconds are not whole ticks this long
+		longWheel.schedule(delay, [&, i](PoolHandle) {
+			bench.check(longWheel.getTicks() == due[i], "long timer called on its due tick");
+		});
+	}
+	while (longWheel.getCount() > 0) {
+		seed = seed * 1664525 + 1013904223;
+		longWheel.advance((seed >> 8) % 100000 / 1000.0f);
+	}
+	bench.check(longWheel.getFired() == (UINT64)TIMER_LONG_COUNT && longWheel.getMoved() > 0,
+		"long timers cascade down every level");
+}
+
+//=============================================================================
+// Timers on a wheel
+//=============================================================================
+void benchmarkNS::timersWheel(Benchmark &bench) {
+	checkTimerWheel(bench);
+	TimerBench b;
+	b.bench = &bench;
+	b.wheel.initialize(TIMER_COUNT + 1);		// room for a one-shot timer to replace itself
+	b.checks.resize(TIMER_COUNT);
+	b.seed = 1;
+	b.fired = 0;
+	for (int i = 0; i < TIMER_COUNT; i++)
+		scheduleChecked(b, i);
+	std::vector<PoolHandle> stale;
+	stale.reserve(TIMER_CHURN);
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		stale.clear();
+		for (int i = 0; i < TIMER_CHURN; i++) {
+			b.seed = b.seed * 1664525 + 1013904223;
+			UINT n = (b.seed >> 8) % TIMER_COUNT;
+			stale.push_back(b.checks[n].handle);
+			b.wheel.cancel(b.checks[n].handle);
+			scheduleChecked(b, n);
+		}
+		b.wheel.advance(TIMER_STEP);
+		bench.endFrame();
+
+		for (size_t i = 0; i < stale.size(); i++)
+			bench.check(!b.wheel.isPending(stale[i]), "cancelled handle is stale");
+		bench.check(b.wheel.getCount() == (UINT)TIMER_COUNT, "pending timer count");
+	}
+	for (int i = 0; i < TIMER_COUNT; i++)
+		bench.check(b.checks[i].next > b.wheel.getTicks(), "no timer missed");
+	bench.check(b.fired == b.wheel.getFired() && b.fired > 0, "fired count");
+}
+
+//=============================================================================
+// The same timers counted down each frame
+//=============================================================================
+void benchmarkNS::timersPolled(Benchmark &bench) {
+	std::vector<PolledTimer> timers(TIMER_COUNT);
+	UINT seed = 1;
+	UINT delay, period;
+	for (int i = 0; i < TIMER_COUNT; i++) {
+		randomTimer(seed, delay, period);
+		timers[i].remaining = delay / 1000.0f;
+		timers[i].period = period / 1000.0f;
+	}
+	UINT64 fired = 0;
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < TIMER_CHURN; i++) {
+			seed = seed * 1664525 + 1013904223;
+			UINT n = (seed >> 8) % TIMER_COUNT;
+			randomTimer(seed, delay, period);
+			timers[n].remaining = delay / 1000.0f;
+			timers[n].period = period / 1000.0f;
+		}
+		for (int i = 0; i < TIMER_COUNT; i++) {
+			PolledTimer &t = timers[i];
+			t.remaining -= TIMER_STEP;
+			if (t.remaining > 0)
+				continue;
+			fired++;
+			if (t.period > 0)
+				t.remaining += t.period;
+			else {
+				randomTimer(seed, delay, period);
+				t.remaining = delay / 1000.0f;
+				t.period = period / 1000.0f;
+			}
+		}
+		bench.endFrame();
+	}
+	bench.check(fired > 0, "timers fired");
+}
+
+namespace benchmarkNS {
+	const float PAD_STEP = 1.0f / 60.0f;	// seconds per frame
+	const float PAD_PROBE = 0.5f;			// seconds between probes of an empty slot
+	const int   PAD_PLUG_FRAME = 150;		// pad 1 is plugged in on this frame
+	const int   PAD_RUMBLE_FRAMES = 60;		// pad 0 vibrates for 0.25 seconds this often
+
+	// ControllerBackend that counts calls to each slot
+	class CountingBackend : public ControllerBackend {
+	public:
+		bool    connected[MAX_CONTROLLERS];
+		UINT    getCalls[MAX_CONTROLLERS];
+		UINT    setCalls[MAX_CONTROLLERS];
+		DWORD   packet;						// packet number of every connected pad
+
+		CountingBackend() : packet(0) {
+			ZeroMemory(connected, sizeof(connected));
+			ZeroMemory(getCalls, sizeof(getCalls));
+			ZeroMemory(setCalls, sizeof(setCalls));
+		}
+
+		DWORD getState(DWORD n, XINPUT_STATE *state) {
+			getCalls[n]++;
+			if (!connected[n])
+				return ERROR_DEVICE_NOT_CONNECTED;
+			ZeroMemory(state, sizeof(XINPUT_STATE));
+			state->dwPacketNumber = packet;
+			return ERROR_SUCCESS;
+		}
+
+		DWORD setState(DWORD n, XINPUT_VIBRATION *) {
+			setCalls[n]++;
+			return connected[n] ? ERROR_SUCCESS : ERROR_DEVICE_NOT_CONNECTED;
+		}
+	};
+}
+
+//=============================================================================
+// Poll two connected pads and two empty slots at 60 Hz
+// Each frame must read every connected pad once and no empty slot, except
+// on the frames a probe is due, which read one. Pad 1 is plugged in with a
+// hot-plug probe, which reads each empty slot once. Vibration is only sent
+// to connected pads when their motor speeds change.
+//=============================================================================
+void benchmarkNS::controllersPolled(Benchmark &bench) {
+	CountingBackend backend;
+	backend.connected[0] = backend.connected[2] = true;
+	ControllerManager manager;
+	manager.setBackend(&backend);
+	manager.setProbeInterval(PAD_PROBE);
+	manager.probeAll();
+	bench.check(manager[0].connected && manager[2].connected && !manager[1].connected,
+		"probeAll() finds the connected pads");
+
+	UINT before[MAX_CONTROLLERS];
+	UINT probeFrames = 0, rumbles = 0;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		memcpy(before, backend.getCalls, sizeof(before));
+		bool plugged = (frame == PAD_PLUG_FRAME);
+		if (plugged) {
+			backend.connected[1] = true;
+			manager.requestProbe();
+		}
+		if (frame % PAD_RUMBLE_FRAMES == 0) {
+			manager.vibrateLeft(0, 30000, 0.25f);
+			rumbles++;
+		}
+		backend.packet++;
+
+		bench.beginFrame();
+		manager.poll(PAD_STEP);
+		manager.updateVibration(PAD_STEP, true);
+		bench.endFrame();
+
+		UINT emptyReads = 0;
+		for (DWORD n = 0; n < MAX_CONTROLLERS; n++) {
+			UINT reads = backend.getCalls[n] - before[n];
+			if (manager[n].connected && !(plugged && n == 1))
+				bench.check(reads == 1, "connected pad read once per frame");
+			else
+				emptyReads += reads;
+		}
+		if (plugged)
+			bench.check(emptyReads == 2 && manager[1].connected, "hot-plug probe reads each empty slot once");
+		else if (emptyReads > 0) {
+			bench.check(emptyReads == 1, "background probe reads one empty slot");
+			probeFrames++;
+		}
+	}
+
+	UINT dueProbes = (UINT)(FRAMES * PAD_STEP / PAD_PROBE);
+	bench.check(probeFrames + 1 >= dueProbes && probeFrames <= dueProbes + 1,
+		"empty slots are only read when a probe is due");
+	bench.check(backend.setCalls[1] == 1 && backend.setCalls[2] == 1,
+		"pads that never vibrate are sent it once, when they connect");
+	// the first rumble starts with the first send, and each one is sent
+	// once when it starts and once when it stops
+	bench.check(backend.setCalls[0] == 2 * rumbles, "vibration sent only when motor speeds change");
+	bench.check(backend.setCalls[3] == 0, "no vibration sent to an empty slot");
+}
+
+namespace benchmarkNS {
+	const int   PATROL_AGENTS = 100000;
+	const UINT  PATROL_MIN_IDLE = 500;		// milli-seconds
+	const UINT  PATROL_MAX_IDLE = 3000;
+	const UINT  PATROL_MAX_STEP = 20;		// frames
+	const UINT  PATROL_GATE = 30;			// frames between openings of the gate
+	const float PATROL_STEP = 1.0f / 60.0f;	// seconds each frame
+	const int   PATROL_ACTIONS = 3;			// actions in each patrol
+
+	// State shared by the patrols
+	struct PatrolWorld {
+		UINT        frame;
+		double      time;				// seconds
+		std::vector<float> x;			// position of each agent
+		UINT64      actions;
+		Benchmark   *bench;				// records failed checks
+	};
+
+	// Return a patrol's next idle time in seconds.
+	inline float patrolIdle(UINT &seed) {
+		seed = seed * 1664525 + 1013904223;
+		return (PATROL_MIN_IDLE + (seed >> 8) % (PATROL_MAX_IDLE - PATROL_MIN_IDLE)) / 1000.0f;
+	}
+
+	// Return a patrol's next step length in frames.
+	inline UINT patrolStep(UINT &seed) {
+		seed = seed * 1664525 + 1013904223;
+		return 1 + (seed >> 8) % PATROL_MAX_STEP;
+	}
+
+	// A patrol written as a behavior
+	class PatrolBehavior : public Behavior {
+	private:
+		PatrolWorld *world;
+		UINT        agent;
+		UINT        seed;
+		float       idle;
+		UINT        step;
+		double      suspendedTime;
+		UINT        suspendedFrame;
+
+	public:
+		PatrolBehavior(PatrolWorld *w, UINT a) : world(w), agent(a), seed(a * 7919 + 1) {}
+
+		// Idle, step out, step back, wait for the gate, repeat.
+		void run() {
+			BEHAVIOR_BEGIN
+			for (;;) {
+				idle = patrolIdle(seed);
+				suspendedTime = world->time;
+				BEHAVIOR_WAIT_SECONDS(idle);
+				world->bench->check(world->time - suspendedTime >= idle - 0.002 &&	// 1 ms ticks
+					world->time - suspendedTime <= idle + PATROL_STEP + 0.002, "idle wait resumes on time");
+				world->x[agent] += 1.0f;
+				world->actions++;
+				step = patrolStep(seed);
+				suspendedFrame = world->frame;
+				BEHAVIOR_WAIT_FRAMES(step);
+				world->bench->check(world->frame - suspendedFrame == step, "frame wait resumes on time");
+				world->x[agent] -= 1.0f;
+				world->actions++;
+				BEHAVIOR_WAIT_UNTIL(world->frame % PATROL_GATE == 0);
+				world->actions++;
+			}
+			BEHAVIOR_END
+		}
+	};
+
+	// A patrol written as a state machine
+	struct PatrolAgent {
+		enum State { IDLE, STEPPING, GATE } state;
+		float       timer;				// seconds left idle
+		UINT        frames;				// frames left stepping
+		UINT        seed;
+	};
+}
+
+//=============================================================================
+// Patrols as behaviors
+// Only patrols waiting for the gate are run each frame.
+//=============================================================================
+void benchmarkNS::behaviorsScheduled(Benchmark &bench) {
+	PatrolWorld world;
+	world.frame = 0;
+	world.time = 0;
+	world.x.assign(PATROL_AGENTS, 0.0f);
+	world.actions = 0;
+	world.bench = &bench;
+	BehaviorScheduler scheduler;
+	scheduler.initialize(PATROL_AGENTS);
+	for (int i = 0; i < PATROL_AGENTS; i++) {
+		PoolHandle h = scheduler.start(PatrolBehavior(&world, i));
+		bench.check(scheduler.isRunning(h), "started behavior is running");
+		if (i == 0) {							// handles go stale when stopped
+			bool stopped = scheduler.stop(h);
+			bool running = scheduler.isRunning(h);
+			bool stoppedAgain = scheduler.stop(h);
+			bench.check(stopped && !running && !stoppedAgain, "stopped behavior's handle is stale");
+			h = scheduler.start(PatrolBehavior(&world, i));
+			bench.check(scheduler.get(h) != NULL, "behavior restarts in the freed slot");
+		}
+	}
+	PoolHandle extra = scheduler.start(PatrolBehavior(&world, 0));
+	bench.check(scheduler.getCount() == (UINT)PATROL_AGENTS && extra == PoolHandle(), "full scheduler refuses a behavior");
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		world.frame++;
+		world.time += PATROL_STEP;
+		scheduler.update(PATROL_STEP);
+		bench.endFrame();
+		bench.check(scheduler.getFrame() == world.frame && scheduler.getCount() == (UINT)PATROL_AGENTS,
+			"every patrol keeps running");
+	}
+	bench.check(world.actions > (UINT64)PATROL_AGENTS * PATROL_ACTIONS, "patrols act");
+}
+
+//=============================================================================
+// Patrols as state machines polled every frame
+//=============================================================================
+void benchmarkNS::behaviorsPolled(Benchmark &bench) {
+	PatrolWorld world;
+	world.frame = 0;
+	world.time = 0;
+	world.x.assign(PATROL_AGENTS, 0.0f);
+	world.actions = 0;
+	world.bench = &bench;
+	std::vector<PatrolAgent> agents(PATROL_AGENTS);
+	for (int i = 0; i < PATROL_AGENTS; i++) {
+		agents[i].seed = i * 7919 + 1;
+		agents[i].state = PatrolAgent::IDLE;
+		agents[i].timer = patrolIdle(agents[i].seed);
+	}
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		world.frame++;
+		world.time += PATROL_STEP;
+		bool open = (world.frame % PATROL_GATE == 0);
+		for (int i = 0; i < PATROL_AGENTS; i++) {
+			PatrolAgent &a = agents[i];
+			switch (a.state) {
+			case PatrolAgent::IDLE:
+				a.timer -= PATROL_STEP;
+				if (a.timer > 0)
+					break;
+				world.x[i] += 1.0f;
+				world.actions++;
+				a.frames = patrolStep(a.seed);
+				a.state = PatrolAgent::STEPPING;
+				break;
+			case PatrolAgent::STEPPING:
+				if (--a.frames > 0)
+					break;
+				world.x[i] -= 1.0f;
+				world.actions++;
+				a.state = PatrolAgent::GATE;
+				// fall through to test the gate this frame
+			case PatrolAgent::GATE:
+				if (!open)
+					break;
+				world.actions++;
+				a.timer = patrolIdle(a.seed);
+				a.state = PatrolAgent::IDLE;
+				break;
+			}
+		}
+		bench.endFrame();
+	}
+	bench.check(world.actions > (UINT64)PATROL_AGENTS * PATROL_ACTIONS, "patrols act");
+}
+
+namespace benchmarkNS {
+	const int   FLOW_SIZE = 512;			// cells across the grid
+	const int   FLOW_WALLS = 600;			// wall rectangles
+	const int   FLOW_MUD = 200;				// rectangles of cost FLOW_MUD_COST
+	const BYTE  FLOW_MUD_COST = 5;
+	const int   FLOW_CHECKS = 8;			// frames whose fields are checked against Dijkstra's algorithm
+	const int   FLOW_BLOCK = 8;				// size of the wall blocks placed and removed
+	const int   FLOW_BLOCKS_UP = 10;		// frames a wall block stays
+	const int   FLOW_AGENTS = 100000;
+	const float FLOW_SPEED = 0.75f;			// cells each agent moves per frame
+}
+
+//=============================================================================
+// Fill a FlowGrid with random walls and mud
+//=============================================================================
+static void flowMap(FlowGrid &grid, UINT &seed) {
+	using namespace benchmarkNS;
+	grid.initialize(FLOW_SIZE, FLOW_SIZE, 1.0f);
+	for (int i = 0; i < FLOW_WALLS + FLOW_MUD; i++) {
+		seed = seed * 1664525 + 1013904223;
+		int x = (seed >> 8) % FLOW_SIZE, y = (seed >> 20) % FLOW_SIZE;
+		seed = seed * 1664525 + 1013904223;
+		bool wall = (i < FLOW_WALLS);
+		int w = wall ? 1 + (seed >> 8) % 24 : 4 + (seed >> 8) % 32;
+		int h = wall ? 1 + (seed >> 20) % 24 : 4 + (seed >> 20) % 32;
+		if (wall && (seed & 0x100))				// mostly long thin walls
+			w = 1 + w / 8;
+		else if (wall)
+			h = 1 + h / 8;
+		for (int cy = y; cy < y + h && cy < FLOW_SIZE; cy++)
+			for (int cx = x; cx < x + w && cx < FLOW_SIZE; cx++)
+				grid.setCost(cx, cy, wall ? flowNS::WALL : FLOW_MUD_COST);
+	}
+}
+
+//=============================================================================
+// Pick a random cell that is not a wall
+//=============================================================================
+static void flowFreeCell(const FlowGrid &grid, UINT &seed, int &x, int &y) {
+	do {
+		seed = seed * 1664525 + 1013904223;
+		x = (seed >> 8) % grid.getWidth();
+		y = (seed >> 20) % grid.getHeight();
+	} while (grid.getCost(x, y) == flowNS::WALL);
+}
+
+//=============================================================================
+// Check a field against Dijkstra's algorithm over the whole grid
+// Every direction must lead to a cell that is not a wall and has a lower
+// integration, and every reachable cell but the goal must have one.
+//=============================================================================
+static void checkFlowField(Benchmark &bench, const FlowGrid &grid, const FlowField &f) {
+	using namespace flowNS;
+	int w = grid.getWidth(), h = grid.getHeight();
+	std::vector<UINT> dist(w * h, UNREACHABLE);
+	typedef std::pair<UINT, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+	dist[f.goalY * w + f.goalX] = 0;
+	queue.push(Entry(0, f.goalY * w + f.goalX));
+	while (!queue.empty()) {
+		Entry e = queue.top();
+		queue.pop();
+		if (e.first > dist[e.second])
+			continue;
+		int x = e.second % w, y = e.second / w;
+		for (int d = 0; d < 8; d += 2) {
+			int nx = x + DX[d], ny = y + DY[d];
+			if (nx < 0 || ny < 0 || nx >= w || ny >= h || grid.getCost(nx, ny) == WALL)
+				continue;
+			UINT nd = e.first + grid.getCost(nx, ny);
+			if (nd < dist[ny * w + nx]) {
+				dist[ny * w + nx] = nd;
+				queue.push(Entry(nd, ny * w + nx));
+			}
+		}
+	}
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			UINT v = f.getIntegration(x, y);
+			bench.check(v == dist[y * w + x], "integration matches Dijkstra");
+			BYTE d = f.getDirection(x, y);
+			bench.check((d == NO_DIRECTION) == (v == UNREACHABLE || v == 0), "every reachable cell has a direction");
+			if (d == NO_DIRECTION)
+				continue;
+			int nx = x + DX[d], ny = y + DY[d];
+			bench.check(grid.getCost(nx, ny) != WALL && f.getIntegration(nx, ny) < v, "direction leads downhill");
+		}
+	}
+}
+
+//=============================================================================
+// Build a field toward a new goal each frame, checking the first few
+//=============================================================================
+static void flowBuildRun(Benchmark &bench, JobSystem *jobs) {
+	using namespace benchmarkNS;
+	UINT seed = 1;
+	FlowGrid grid;
+	flowMap(grid, seed);
+	int gx, gy;
+	flowFreeCell(grid, seed, gx, gy);
+	const FlowField *cached = grid.getField(gx, gy, jobs);
+	const FlowField *again = grid.getField(gx, gy, jobs);
+	bench.check(cached != NULL && again == cached && grid.getFieldsBuilt() == 1, "field for the same goal is cached");
+	const FlowField *outside = grid.getField(-1, 0, jobs);
+	bench.check(outside == NULL, "no field for a goal off the grid");
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		flowFreeCell(grid, seed, gx, gy);
+		bench.beginFrame();
+		const FlowField *f = grid.getField(gx, gy, jobs);
+		bench.endFrame();
+		if (!bench.check(f != NULL && f->goalX == gx && f->goalY == gy, "field leads to its goal"))
+			continue;
+		if (frame < FLOW_CHECKS)
+			checkFlowField(bench, grid, *f);
+	}
+	bench.check(grid.getFieldsBuilt() == (UINT)FRAMES + 1, "one build per new goal");
+}
+
+//=============================================================================
+// Flow field builds on all CPU cores
+//=============================================================================
+void benchmarkNS::flowFieldBuild(Benchmark &bench) {
+	JobSystem jobs;
+	jobs.initialize();
+	flowBuildRun(bench, &jobs);
+}
+
+//=============================================================================
+// Flow field builds on one thread
+//=============================================================================
+void benchmarkNS::flowFieldBuildSerial(Benchmark &bench) {
+	flowBuildRun(bench, NULL);
+}
+
+//=============================================================================
+// Flow fields updated as walls come and go
+// Each frame a wall block is placed and the one placed FLOW_BLOCKS_UP
+// frames before is taken away, then both cached fields are fetched. The
+// goals are kept clear, so the fields are only ever updated, not rebuilt.
+//=============================================================================
+void benchmarkNS::flowFieldUpdate(Benchmark &bench) {
+	UINT seed = 1;
+	FlowGrid grid;
+	flowMap(grid, seed);
+	JobSystem jobs;
+	jobs.initialize();
+	int goalX[2], goalY[2];
+	for (int i = 0; i < 2; i++) {
+		flowFreeCell(grid, seed, goalX[i], goalY[i]);
+		grid.getField(goalX[i], goalY[i], &jobs);
+	}
+	std::vector<int> blockX(FRAMES), blockY(FRAMES);
+	std::vector<BYTE> saved(FRAMES * FLOW_BLOCK * FLOW_BLOCK);
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		int bx, by;
+		do {
+			seed = seed * 1664525 + 1013904223;
+			bx = (seed >> 8) % (FLOW_SIZE - FLOW_BLOCK);
+			by = (seed >> 20) % (FLOW_SIZE - FLOW_BLOCK);
+		} while ((goalX[0] >= bx && goalX[0] < bx + FLOW_BLOCK && goalY[0] >= by && goalY[0] < by + FLOW_BLOCK) ||
+			(goalX[1] >= bx && goalX[1] < bx + FLOW_BLOCK && goalY[1] >= by && goalY[1] < by + FLOW_BLOCK));
+		blockX[frame] = bx;
+		blockY[frame] = by;
+		BYTE *s = &saved[frame * FLOW_BLOCK * FLOW_BLOCK];
+		for (int y = 0; y < FLOW_BLOCK; y++)
+			for (int x = 0; x < FLOW_BLOCK; x++)
+				s[y * FLOW_BLOCK + x] = grid.getCost(bx + x, by + y);
+
+		bench.beginFrame();
+		for (int y = 0; y < FLOW_BLOCK; y++)
+			for (int x = 0; x < FLOW_BLOCK; x++)
+				grid.setCost(bx + x, by + y, flowNS::WALL);
+		if (frame >= FLOW_BLOCKS_UP) {			// blocks placed later are restored first
+			int old = frame - FLOW_BLOCKS_UP;
+			const BYTE *o = &saved[old * FLOW_BLOCK * FLOW_BLOCK];
+			for (int y = 0; y < FLOW_BLOCK; y++)
+				for (int x = 0; x < FLOW_BLOCK; x++)
+					if (grid.getCost(blockX[old] + x, blockY[old] + y) == flowNS::WALL)
+						grid.setCost(blockX[old] + x, blockY[old] + y, o[y * FLOW_BLOCK + x]);
+		}
+		const FlowField *f0 = grid.getField(goalX[0], goalY[0], &jobs);
+		const FlowField *f1 = grid.getField(goalX[1], goalY[1], &jobs);
+		bench.endFrame();
+
+		if (frame < FLOW_CHECKS || frame == FRAMES - 1) {
+			checkFlowField(bench, grid, *f0);
+			checkFlowField(bench, grid, *f1);
+		}
+	}
+	bench.check(grid.getFieldsBuilt() == 2 && grid.getFieldsUpdated() == 2 * (UINT)FRAMES,
+		"cached fields are updated, not built again");
+}
+
+//=============================================================================
+// Agents steering by a shared flow field
+// 100k agents on free cells sample the field and move each frame on this
+// thread. Checks they get closer to the goal.
+//=============================================================================
+void benchmarkNS::flowFieldQuery(Benchmark &bench) {
+	UINT seed = 1;
+	FlowGrid grid;
+	flowMap(grid, seed);
+	int gx, gy;
+	flowFreeCell(grid, seed, gx, gy);
+	const FlowField *f = grid.getField(gx, gy);
+	std::vector<float> x(FLOW_AGENTS), y(FLOW_AGENTS), dx(FLOW_AGENTS), dy(FLOW_AGENTS);
+	UINT64 before = 0;
+	for (int i = 0; i < FLOW_AGENTS; i++) {
+		int cx, cy;
+		do {
+			flowFreeCell(grid, seed, cx, cy);
+		} while (f->getIntegration(cx, cy) == flowNS::UNREACHABLE);
+		x[i] = cx + 0.5f;
+		y[i] = cy + 0.5f;
+		before += f->getIntegration(cx, cy);
+	}
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		grid.getDirections(*f, FLOW_AGENTS, &x[0], &y[0], &dx[0], &dy[0]);
+		for (int i = 0; i < FLOW_AGENTS; i++) {
+			x[i] += dx[i] * FLOW_SPEED;
+			y[i] += dy[i] * FLOW_SPEED;
+		}
+		bench.endFrame();
+	}
+
+	UINT64 after = 0;
+	for (int i = 0; i < FLOW_AGENTS; i++) {
+		UINT v = f->getIntegration((int)x[i], (int)y[i]);
+		bench.check(v != flowNS::UNREACHABLE, "agent never steered into a wall");
+		after += v;
+	}
+	bench.check(after < before / 2, "agents get closer to the goal");
+}
+
+namespace benchmarkNS {
+	const int   FLOCK_AGENTS = 50000;
+	const float FLOCK_WORLD = 5000.0f;		// pixels across the square the agents start in
+	const int   FLOCK_OBSTACLES = 24;
+	const float FLOCK_STEP = 1.0f / 60.0f;	// seconds each frame
+	const int   FLOCK_CHECK_AGENTS = 3000;	// agents in the checked flocks
+	const float FLOCK_CHECK_WORLD = 800.0f;
+	const int   FLOCK_CHECK_FRAMES = 30;
+}
+
+//=============================================================================
+// Fill a Flock with agents at random places and headings
+//=============================================================================
+static void flockFill(Flock &flock, int agents, float world, UINT &seed) {
+	for (int i = 0; i < agents; i++) {
+		seed = seed * 1664525 + 1013904223;
+		float x = world * (float)(seed >> 8) * (1.0f / 16777216.0f);
+		seed = seed * 1664525 + 1013904223;
+		float y = world * (float)(seed >> 8) * (1.0f / 16777216.0f);
+		seed = seed * 1664525 + 1013904223;
+		float a = 2 * (float)PI * (float)(seed >> 8) * (1.0f / 16777216.0f);
+		flock.add(x, y, sinf(a) * 60.0f, -cosf(a) * 60.0f);
+	}
+}
+
+//=============================================================================
+// Check neighbour counts against every pair, the same result on one thread
+// and many, speed limits, and id reuse on a small flock
+//=============================================================================
+static void checkFlock(Benchmark &bench, JobSystem *jobs) {
+	using namespace benchmarkNS;
+	Flock serial, threaded;
+	serial.initialize(FLOCK_CHECK_AGENTS);
+	threaded.initialize(FLOCK_CHECK_AGENTS);
+	UINT seed = 7, seed2 = 7;
+	flockFill(serial, FLOCK_CHECK_AGENTS, FLOCK_CHECK_WORLD, seed);
+	flockFill(threaded, FLOCK_CHECK_AGENTS, FLOCK_CHECK_WORLD, seed2);
+	for (int i = 0; i < 2; i++) {
+		Flock &f = i ? threaded : serial;
+		f.setSeekTarget(FLOCK_CHECK_WORLD / 2, FLOCK_CHECK_WORLD / 2);
+		f.setFleeTarget(FLOCK_CHECK_WORLD / 4, FLOCK_CHECK_WORLD / 4);
+		f.addObstacle(FLOCK_CHECK_WORLD * 0.7f, FLOCK_CHECK_WORLD * 0.6f, 60);
+	}
+	int overflow = serial.add(0, 0);
+	bench.check(overflow == flockNS::NONE, "full flock refuses an agent");
+	float r2 = serial.getParams().neighborRadius * serial.getParams().neighborRadius;
+	std::vector<float> x(FLOCK_CHECK_AGENTS), y(FLOCK_CHECK_AGENTS);
+
+	for (int frame = 0; frame < FLOCK_CHECK_FRAMES; frame++) {
+		for (int i = 0; i < FLOCK_CHECK_AGENTS; i++) {
+			x[i] = serial.getX(i);
+			y[i] = serial.getY(i);
+		}
+		serial.update(FLOCK_STEP);
+		threaded.update(FLOCK_STEP, jobs);
+		if (frame == 0 || frame == FLOCK_CHECK_FRAMES - 1) {
+			UINT64 pairs = 0;
+			for (int i = 0; i < FLOCK_CHECK_AGENTS; i++) {
+				for (int j = 0; j < FLOCK_CHECK_AGENTS; j++) {
+					float dx = x[j] - x[i], dy = y[j] - y[i];
+					if (i != j && dx * dx + dy * dy < r2)
+						pairs++;
+				}
+			}
+			bench.check(serial.getNeighborPairs() == pairs && pairs > 0, "neighbours match every pair");
+		}
+		bench.check(threaded.getNeighborPairs() == serial.getNeighborPairs(), "threads count the same neighbours");
+		float maxSpeed = serial.getParams().maxSpeed * 1.001f;
+		for (int i = 0; i < FLOCK_CHECK_AGENTS; i++) {
+			bench.check(serial.getX(i) == threaded.getX(i) && serial.getY(i) == threaded.getY(i),
+				"threads move agents the same");
+			float vx = serial.getVelocityX(i), vy = serial.getVelocityY(i);
+			bench.check(vx * vx + vy * vy <= maxSpeed * maxSpeed, "speed within maxSpeed");
+		}
+	}
+
+	bool removed = serial.remove(5);
+	bool agent = serial.isAgent(5);
+	bool removedAgain = serial.remove(5);
+	bench.check(removed && !agent && !removedAgain, "removed agent is gone");
+	bench.check(serial.getCount() == FLOCK_CHECK_AGENTS - 1, "count after remove");
+	int reused = serial.add(1, 2);
+	bench.check(reused == 5 && serial.getX(5) == 1 && serial.getY(5) == 2, "removed id is reused");
+	serial.clear();
+	bench.check(serial.getCount() == 0 && !serial.isAgent(0), "clear() removes every agent");
+}
+
+//=============================================================================
+// 50k agents steering around obstacles, written back to Images
+// The seek target circles the middle of the world and the flee target
+// crosses it, so the crowd keeps moving.
+//=============================================================================
+static void flockRun(Benchmark &bench, JobSystem *jobs) {
+	using namespace benchmarkNS;
+	checkFlock(bench, jobs);
+	TextureManager texture;
+	std::vector<Image> images(FLOCK_AGENTS);
+	std::vector<Image*> imagePointers(FLOCK_AGENTS);
+	for (int i = 0; i < FLOCK_AGENTS; i++) {
+		images[i].initialize(NULL, 16, 16, 1, &texture);
+		imagePointers[i] = &images[i];
+	}
+	Flock flock;
+	flock.initialize(FLOCK_AGENTS);
+	UINT seed = 1;
+	flockFill(flock, FLOCK_AGENTS, FLOCK_WORLD, seed);
+	for (int i = 0; i < FLOCK_OBSTACLES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		flock.addObstacle(FLOCK_WORLD * (float)(seed >> 8) * (1.0f / 16777216.0f),
+			FLOCK_WORLD * (float)(seed & 0xffff) * (1.0f / 65536.0f), 40.0f + (seed >> 26) * 2);
+	}
+	UINT64 pairs = 0;
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		float t = frame * FLOCK_STEP;
+		flock.setSeekTarget(FLOCK_WORLD / 2 + cosf(t) * FLOCK_WORLD / 4, FLOCK_WORLD / 2 + sinf(t) * FLOCK_WORLD / 4);
+		flock.setFleeTarget(FLOCK_WORLD * t / (FRAMES * FLOCK_STEP), FLOCK_WORLD / 2);
+		bench.beginFrame();
+		flock.update(FLOCK_STEP, jobs);
+		flock.writeImages(&imagePointers[0], jobs);
+		bench.endFrame();
+		pairs += flock.getNeighborPairs();
+	}
+	for (int i = 0; i < FLOCK_AGENTS; i += 997)
+		bench.check(images[i].getCenterX() == flock.getX(i) && images[i].getCenterY() == flock.getY(i),
+			"images follow their agents");
+	bench.check(pairs > (UINT64)FLOCK_AGENTS * FRAMES,		// more than one neighbour each on average
+		"agents flock together");
+}
+
+//=============================================================================
+// Flock on all CPU cores
+//=============================================================================
+void benchmarkNS::flockThreaded(Benchmark &bench) {
+	JobSystem jobs;
+	jobs.initialize();
+	flockRun(bench, &jobs);
+}
+
+//=============================================================================
+// Flock on one thread
+//=============================================================================
+void benchmarkNS::flockSerial(Benchmark &bench) {
+	flockRun(bench, NULL);
+}
+
+namespace benchmarkNS {
+	const int SPAWN_LIVE = 20000;			// Images alive at once
+	const int SPAWN_CHURN = 5000;			// Images replaced each frame
+}
+
+//=============================================================================
+// ObjectPool spawn and despawn
+// Despawned handles are kept and checked to make sure they are stale, even
+// after their slots are reused.
+//=============================================================================
+void benchmarkNS::poolSpawn(Benchmark &bench) {
+	TextureManager texture;
+	ObjectPool<Image> pool;
+	pool.initialize(SPAWN_LIVE);
+	std::vector<PoolHandle> handles, stale;
+	handles.reserve(SPAWN_LIVE);
+	stale.reserve(SPAWN_CHURN);
+	UINT seed = 1;
+
+	for (int i = 0; i < SPAWN_LIVE; i++) {
+		PoolHandle h = pool.spawn();
+		pool.get(h)->initialize(NULL, 16, 16, 1, &texture);
+		handles.push_back(h);
+	}
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		stale.clear();
+		for (int i = 0; i < SPAWN_CHURN; i++) {
+			seed = seed * 1664525 + 1013904223;
+			size_t n = (seed >> 8) % handles.size();
+			pool.despawn(handles[n]);
+			stale.push_back(handles[n]);
+			handles[n] = handles.back();
+			handles.pop_back();
+		}
+		for (int i = 0; i < SPAWN_CHURN; i++) {
+			PoolHandle h = pool.spawn();
+			Image *image = pool.get(h);
+			image->initialize(NULL, 16, 16, 1, &texture);
+			image->setX((float)(i % GAME_WIDTH));
+			handles.push_back(h);
+		}
+		pool.forEach([](Image &image, PoolHandle) {
+			image.setY(image.getY() + 1.0f);
+		});
+		bench.endFrame();
+
+		for (size_t i = 0; i < stale.size(); i++)
+			bench.check(pool.get(stale[i]) == NULL, "despawned handle is stale");
+		bench.check(pool.getCount() == (UINT)SPAWN_LIVE, "pool count");
+	}
+}
+
+//=============================================================================
+// The same churn with new and delete
+//=============================================================================
+void benchmarkNS::heapSpawn(Benchmark &bench) {
+	TextureManager texture;
+	std::vector<Image*> images;
+	images.reserve(SPAWN_LIVE);
+	UINT seed = 1;
+
+	for (int i = 0; i < SPAWN_LIVE; i++) {
+		Image *image = new Image();
+		image->initialize(NULL, 16, 16, 1, &texture);
+		images.push_back(image);
+	}
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (int i = 0; i < SPAWN_CHURN; i++) {
+			seed = seed * 1664525 + 1013904223;
+			size_t n = (seed >> 8) % images.size();
+			delete images[n];
+			images[n] = images.back();
+			images.pop_back();
+		}
+		for (int i = 0; i < SPAWN_CHURN; i++) {
+			Image *image = new Image();
+			image->initialize(NULL, 16, 16, 1, &texture);
+			image->setX((float)(i % GAME_WIDTH));
+			images.push_back(image);
+		}
+		for (size_t i = 0; i < images.size(); i++)
+			images[i]->setY(images[i]->getY() + 1.0f);
+		bench.endFrame();
+	}
+
+	for (size_t i = 0; i < images.size(); i++)
+		delete images[i];
+}
+
+namespace benchmarkNS {
+	const int   ASSET_COUNT = 1000;
+	const char  ASSET_DIR[] = "bench_assets";
+	const char  ASSET_PACK_FILE[] = "bench_assets.pak";
+
+	//=========================================================================
+	// Write ASSET_COUNT files of 1 to 8 KB into ASSET_DIR and pack them
+	// Contents mix repeated runs with noise so LZ4 has something to find.
+	//=========================================================================
+	static bool makeAssets(std::vector<std::string> &names, bool compress) {
+		CreateDirectory(ASSET_DIR, NULL);
+		UINT seed = 1;
+		std::vector<char> data;
+		for (int i = 0; i < ASSET_COUNT; i++) {
+			std::ostringstream name;
+			name << ASSET_DIR << "/asset_" << i << ".bin";
+			names.push_back(name.str());
+			seed = seed * 1664525 + 1013904223;
+			data.resize(1024 + (seed >> 8) % (7 * 1024));
+			for (size_t b = 0; b < data.size(); b++) {
+				seed = seed * 1664525 + 1013904223;
+				data[b] = (b % 64 < 48) ? (char)(b / 64) : (char)(seed >> 24);
+			}
+			std::ofstream out(names[i].c_str(), std::ios::binary);
+			out.write(&data[0], data.size());
+			if (!out)
+				return false;
+		}
+		return assetPackNS::build(ASSET_DIR, ASSET_PACK_FILE, compress);
+	}
+
+	//=========================================================================
+	// Delete the files made by makeAssets()
+	//=========================================================================
+	static void removeAssets(const std::vector<std::string> &names) {
+		for (size_t i = 0; i < names.size(); i++)
+			DeleteFile(names[i].c_str());
+		RemoveDirectory(ASSET_DIR);
+		DeleteFile(ASSET_PACK_FILE);
+	}
+
+	//=========================================================================
+	// Open the pack and touch every asset, decompressing if needed
+	//=========================================================================
+	static void packRun(Benchmark &bench, bool compress) {
+		std::vector<std::string> names;
+		if (!makeAssets(names, compress)) {
+			removeAssets(names);
+			return;
+		}
+		std::vector<BYTE> buffer;
+		UINT sum = 0;
+		for (int frame = 0; frame < FRAMES; frame++) {
+			bench.beginFrame();
+			AssetPack pack;
+			pack.initialize(ASSET_PACK_FILE);
+			for (size_t i = 0; i < names.size(); i++) {
+				AssetView view;
+				if (!pack.find(names[i].c_str(), view))
+					continue;
+				if (view.compressed) {
+					pack.read(names[i].c_str(), buffer);
+					sum += buffer[view.size - 1];
+				}
+				else
+					sum += view.data[view.size - 1];	// touch the asset's pages
+			}
+			bench.endFrame();
+		}
+		removeAssets(names);
+		if (sum == 1)
+			OutputDebugString("");					// keep sum from being optimized away
+	}
+}
+
+//=============================================================================
+// Loose files
+// Every frame opens and reads each file, as startup does today. After the
+// first frame the files are in the OS cache, so this measures the per-file
+// open and read overhead rather than disk speed.
+//=============================================================================
+void benchmarkNS::assetsLoose(Benchmark &bench) {
+	std::vector<std::string> names;
+	if (!makeAssets(names, false)) {
+		removeAssets(names);
+		return;
+	}
+	std::vector<char> buffer(8 * 1024);
+	UINT sum = 0;
+	for (int frame = 0; frame < FRAMES; frame++) {
+		bench.beginFrame();
+		for (size_t i = 0; i < names.size(); i++) {
+			std::ifstream in(names[i].c_str(), std::ios::binary);
+			in.read(&buffer[0], buffer.size());
+			sum += buffer[(size_t)in.gcount() - 1];
+		}
+		bench.endFrame();
+	}
+	removeAssets(names);
+	if (sum == 1)
+		OutputDebugString("");
+}
+
+//=============================================================================
+// Uncompressed pack, assets used in place
+//=============================================================================
+void benchmarkNS::assetsPack(Benchmark &bench) {
+	packRun(bench, false);
+}
+
+//=============================================================================
+// LZ4 compressed pack
+//=============================================================================
+void benchmarkNS::assetsPackLz4(Benchmark &bench) {
+	packRun(bench, true);
+}
@@ -0,0 +1,167 @@
+#ifndef _BENCHMARKS_H
+#define _BENCHMARKS_H
+#define WIN32_LEAN_AND_MEAN
+
+#include "benchmark.h"
+
+// Headless benchmarks of engine subsystems.
+// Each runs without a window or graphics device and saves one sample per
+// iteration in the Benchmark.
+namespace benchmarkNS {
+	const int FRAMES = 300;					// iterations of each benchmark
+
+	// Run the named benchmark and write its report.
+	// Returns false if name is unknown, a check failed or the report could
+	// not be written. Failed checks are listed in the report.
+	bool runBenchmark(const char *name, const char *report);
+
+	// Print thousands of labels per frame with a bitmap font, some changing each frame.
+	void fontLabels(Benchmark &bench);
+
+	// Update 200k particles on one thread.
+	void particles(Benchmark &bench);
+
+	// Update 200k particles on all CPU cores.
+	void particlesThreaded(Benchmark &bench);
+
+	// Spawn and despawn 5000 Images per frame in an ObjectPool, checking stale handles.
+	void poolSpawn(Benchmark &bench);
+
+	// Spawn and despawn 5000 Images per frame with new and delete, for comparison.
+	void heapSpawn(Benchmark &bench);
+
+	// Read 1000 small assets as loose files.
+	void assetsLoose(Benchmark &bench);
+
+	// Open an asset pack of the same 1000 assets and find each one in place.
+	void assetsPack(Benchmark &bench);
+
+	// Open an LZ4 compressed asset pack and decompress each asset.
+	void assetsPackLz4(Benchmark &bench);
+
+	// Update a 50k node transform hierarchy with 5% of nodes moving each frame.
+	void transformsDirty(Benchmark &bench);
+
+	// Update a 50k node transform hierarchy with every node moving, for comparison.
+	void transformsFull(Benchmark &bench);
+
+	// Scroll a zooming camera over 100k world sprites and a 20k sprite parallax layer, culled to the view.
+	void cameraCulled(Benchmark &bench);
+
+	// The same scrolling world with every sprite submitted, for comparison.
+	void cameraUnculled(Benchmark &bench);
+
+	// Radix sort 100k sprite sort keys with their sprite numbers.
+	void sortRadix(Benchmark &bench);
+
+	// std::sort the same 100k keys and sprite numbers, for comparison.
+	void sortStd(Benchmark &bench);
+
+	// Build the vertex stream of 100k sprites on 1, 2, 4, 8 or 16 threads,
+	// checking it is the same as on one thread.
+	void batchThreads1(Benchmark &bench);
+	void batchThreads2(Benchmark &bench);
+	void batchThreads4(Benchmark &bench);
+	void batchThreads8(Benchmark &bench);
+	void batchThreads16(Benchmark &bench);
+
+	// Scroll over 1000 textures of 64 to 512 pixels with a 32 MB texture budget
+	// on a simulated device, checking the budget and hit and miss counts.
+	void textureResidency(Benchmark &bench);
+
+	// Log 1000 records with four arguments per frame, flushing between frames.
+	void logHotPath(Benchmark &bench);
+
+	// The same records from one call site, so all but RATE_LIMIT a second are dropped.
+	void logRateLimited(Benchmark &bench);
+
+	// Drive the dynamic resolution controller with synthetic fill rate bound
+	// frame time traces, checking it settles, ignores noise and recovers.
+	void resolutionTraces(Benchmark &bench);
+
+	// Run the game loop on a simulated clock through playing, an idle menu with
+	// occasional input, no focus and minimized, reporting CPU milli-seconds per
+	// simulated second with on demand drawing and throttling.
+	void idleThrottled(Benchmark &bench);
+
+	// The same timeline with every frame drawn at the full frame rate.
+	void idleAlwaysOn(Benchmark &bench);
+
+	// Draw a screen sized background, 300 cutout ships, 150 blended smoke
+	// sprites and 8 HUD panels with a software rasterizer, opaque sprites
+	// front to back with depth writes, then blended sprites. Checks every
+	// pixel shows the same sprite as one pass and far fewer are shaded.
+	void overdrawSplit(Benchmark &bench);
+
+	// The same scene drawn in one pass in key order.
+	void overdrawSingle(Benchmark &bench);
+
+	// Draw the overdraw scene in split passes with a software rasterizer and
+	// make its heatmap and fill totals each frame. Checks the totals against
+	// the rasterizer and writes the heatmap of the first frame to
+	// HEATMAP_FILE.
+	void overdrawHeatmap(Benchmark &bench);
+
+	// Draw 2000 rotated, scaled and flipped sprites from a synthetic sheet of
+	// 8 shapes with a software rasterizer, each frame as its trimmed mesh.
+	// Checks the same pixels are written as with quads, fewer are shaded,
+	// and the batcher emits the fans of the meshes.
+	void meshesTrimmed(Benchmark &bench);
+
+	// The same sprites drawn as quads.
+	void meshesQuads(Benchmark &bench);
+
+	// Keep 1M timers pending on a TimerWheel, one in 8 repeating, advancing
+	// a 60 Hz frame at a time and replacing 2000 timers each frame. Checks
+	// every timer is called on its due tick, and that cancelled handles go
+	// stale.
+	void timersWheel(Benchmark &bench);
+
+	// The same timers counted down each frame, as Image animation and
+	// controller vibration timers were.
+	void timersPolled(Benchmark &bench);
+
+	// Poll two connected controllers and two empty slots with a counting
+	// backend, plugging in a third with a hot-plug probe and vibrating one
+	// every second. Checks connected pads are read once a frame, empty
+	// slots only when a probe is due, and vibration only sent on changes.
+	void controllersPolled(Benchmark &bench);
+
+	// Run 100k patrol behaviors on a BehaviorScheduler, each waiting 0.5 to
+	// 3 seconds, stepping, waiting 1 to 20 frames, then waiting for a gate
+	// that opens every 30 frames. Checks every wait resumes on time.
+	void behaviorsScheduled(Benchmark &bench);
+
+	// The same patrols as state machines polled every frame.
+	void behaviorsPolled(Benchmark &bench);
+
+	// Build a flow field toward a new goal each frame on a 512x512 grid of
+	// walls and mud, on all CPU cores. Checks the first fields against
+	// Dijkstra's algorithm over the whole grid.
+	void flowFieldBuild(Benchmark &bench);
+
+	// The same builds on one thread.
+	void flowFieldBuildSerial(Benchmark &bench);
+
+	// Place an 8x8 wall block each frame and take away the one placed 10
+	// frames before, updating two cached fields. Checks the updated fields
+	// are the same as built ones.
+	void flowFieldUpdate(Benchmark &bench);
+
+	// Steer 100k agents on one thread by sampling a shared field each frame.
+	void flowFieldQuery(Benchmark &bench);
+
+	// Steer 50k flocking agents around 24 obstacles toward a moving seek
+	// target and away from a flee target on all CPU cores, writing them back
+	// to Images each frame. Checks a small flock's neighbour counts against
+	// every pair and its agents against the same flock on one thread.
+	void flockThreaded(Benchmark &bench);
+
+	// The same flock on one thread.
+	void flockSerial(Benchmark &bench);
+
+	// Scroll across a 4096x4096 tile, two layer map, changing some tiles each frame.
+	void tilemapScroll(Benchmark &bench);
+}
+
+#endif
@@ -0,0 +1,341 @@
+#include "bitmapFont.h"
+#include <fstream>
+#include <sstream>
+
+//=============================================================================
+// Find key=value in a BMFont line and save the value
+// Returns false if key is not in line
+//=============================================================================
+static bool fontValue(const std::string &line, const char *key, std::string &value) {
+	std::string k = std::string(" ") + key + "=";
+	size_t pos = line.find(k);
+	if (pos == std::string::npos)
+		return false;
+	pos += k.length();
+	if (pos < line.length() && line[pos] == '"') {		// quoted value
+		size_t end = line.find('"', pos + 1);
+		if (end == std::string::npos)
+			return false;
+		value = line.substr(pos + 1, end - pos - 1);
+	}
+	else {
+		size_t end = line.find_first_of(" \t\r", pos);
+		value = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+	}
+	return true;
+}
+
+//=============================================================================
+// Find key=value in a BMFont line and save the integer value
+// Returns false if key is not in line
+//=============================================================================
+static bool fontValue(const std::string &line, const char *key, int &value) {
+	std::string s;
+	if (!fontValue(line, key, s))
+		return false;
+	value = atoi(s.c_str());
+	return true;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+BitmapFont::BitmapFont() {
+	graphics = NULL;
+	ZeroMemory(glyphs, sizeof(glyphs));
+	lineHeight = 0;
+	base = 0;
+	frame = 0;
+	initialized = false;
+	resetStats();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+BitmapFont::~BitmapFont() {
+	for (size_t i = 0; i < pages.size(); i++)
+		SAFE_DELETE(pages[i]);
+}
+
+//=============================================================================
+// Load a BMFont text format font and its atlas pages
+//=============================================================================
+bool BitmapFont::initialize(Graphics *g, const char *file) {
+	try {
+		graphics = g;
+
+		std::ifstream in(file);
+		if (!in)
+			return false;
+		std::stringstream text;
+		text << in.rdbuf();
+
+		// page files are relative to the .fnt file
+		std::string dir = file;
+		size_t slash = dir.find_last_of("\\/");
+		dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+
+		if (!parse(text.str(), dir))
+			return false;
+
+		if (graphics) {
+			// pageFiles does not change after this, so TextureManager may keep pointers into it
+			for (size_t i = 0; i < pageFiles.size(); i++) {
+				TextureManager *page = new TextureManager();
+				pages.push_back(page);
+				if (!page->initialize(graphics, pageFiles[i].c_str()))
+					return false;
+			}
+		}
+	}
+	catch (...) { return false; }
+	initialized = true;
+	return true;
+}
+
+//=============================================================================
+// Read glyph metrics from BMFont text
+//=============================================================================
+bool BitmapFont::parse(const std::string &text, const std::string &dir) {
+	std::istringstream lines(text);
+	std::string line;
+	int value;
+
+	ZeroMemory(glyphs, sizeof(glyphs));
+	pageFiles.clear();
+	cache.clear();
+
+	while (std::getline(lines, line)) {
+		size_t tagEnd = line.find(' ');
+		std::string tag = line.substr(0, tagEnd);
+
+		if (tag == "common") {
+			fontValue(line, "lineHeight", lineHeight);
+			fontValue(line, "base", base);
+		}
+		else if (tag == "page") {
+			int id;
+			std::string name;
+			if (!fontValue(line, "id", id) || !fontValue(line, "file", name))
+				return false;
+			if (id < 0 || id >= (int)bitmapFontNS::MAX_PAGES)
+				return false;
+			if ((int)pageFiles.size() <= id)
+				pageFiles.resize(id + 1);
+			pageFiles[id] = dir + name;
+		}
+		else if (tag == "char") {
+			int id, x, y, w, h;
+			if (!fontValue(line, "id", id) || id < 0 || id >= bitmapFontNS::MAX_CHARS)
+				continue;					// only 8 bit characters are used
+			if (!fontValue(line, "x", x) || !fontValue(line, "y", y) ||
+				!fontValue(line, "width", w) || !fontValue(line, "height", h))
+				return false;
+			Glyph &g = glyphs[id];
+			g.rect.left = x;
+			g.rect.top = y;
+			g.rect.right = x + w;
+			g.rect.bottom = y + h;
+			g.xOffset = fontValue(line, "xoffset", value) ? (short)value : 0;
+			g.yOffset = fontValue(line, "yoffset", value) ? (short)value : 0;
+			g.xAdvance = fontValue(line, "xadvance", value) ? (short)value : (short)w;
+			g.page = fontValue(line, "page", value) ? (UCHAR)value : 0;
+			if (g.page >= bitmapFontNS::MAX_PAGES)
+				return false;
+			g.valid = true;
+		}
+	}
+	return lineHeight > 0 && !pageFiles.empty();
+}
+
+//=============================================================================
+// Lay out str into run
+// Lines are wrapped at the last space before style.wrapWidth and aligned
+// with style.align. Quads are then grouped by atlas page.
+//=============================================================================
+void BitmapFont::layout(const std::string &str, const TextStyle &style, TextRun &run) const {
+	std::vector<SpriteQuad> quads;
+	std::vector<UCHAR> quadPages;
+	std::vector<size_t> lineStart;		// first quad of each line
+	std::vector<int> lineWidth;			// width of each line
+	int x = 0, y = 0;
+	size_t spaceQuad = 0;				// first quad after the last space on this line
+	int spaceX = 0;						// line width before the last space
+	int afterSpaceX = -1;				// x after the last space, -1 if none on this line
+
+	lineStart.push_back(0);
+	for (size_t i = 0; i < str.length(); i++) {
+		UCHAR c = (UCHAR)str[i];
+		if (c == '\n') {
+			lineWidth.push_back(x);
+			lineStart.push_back(quads.size());
+			x = 0;
+			y += lineHeight;
+			afterSpaceX = -1;
+			continue;
+		}
+		const Glyph &g = glyphs[c];
+		if (!g.valid)
+			continue;
+
+		int right = x + g.xOffset + (g.rect.right - g.rect.left);
+		if (style.wrapWidth > 0 && c != ' ' && right > style.wrapWidth && afterSpaceX > 0) {
+			// move the word after the last space to a new line
+			lineWidth.push_back(spaceX);
+			lineStart.push_back(spaceQuad);
+			y += lineHeight;
+			for (size_t q = spaceQuad; q < quads.size(); q++) {
+				quads[q].position.x -= (float)afterSpaceX;
+				quads[q].position.y += (float)lineHeight;
+			}
+			x -= afterSpaceX;
+			afterSpaceX = -1;
+		}
+
+		if (c == ' ') {
+			spaceQuad = quads.size();
+			spaceX = x;
+			afterSpaceX = x + g.xAdvance;
+		}
+
+		if (g.rect.right > g.rect.left && g.rect.bottom > g.rect.top) {
+			SpriteQuad q;
+			q.rect = g.rect;
+			q.position = D3DXVECTOR3((float)(x + g.xOffset), (float)(y + g.yOffset), 0.0f);
+			quads.push_back(q);
+			quadPages.push_back(g.page);
+		}
+		x += g.xAdvance;
+	}
+	lineWidth.push_back(x);
+
+	// size and alignment
+	run.width = 0;
+	for (size_t i = 0; i < lineWidth.size(); i++) {
+		if (lineWidth[i] > run.width)
+			run.width = lineWidth[i];
+	}
+	run.height = (int)lineWidth.size() * lineHeight;
+	if (style.align != bitmapFontNS::LEFT) {
+		for (size_t i = 0; i < lineStart.size(); i++) {
+			size_t end = (i + 1 < lineStart.size()) ? lineStart[i + 1] : quads.size();
+			float shift = (float)(run.width - lineWidth[i]);
+			if (style.align == bitmapFontNS::CENTER)
+				shift = (float)(int)(shift / 2);	// keep glyphs on whole pixels
+			for (size_t q = lineStart[i]; q < end; q++)
+				quads[q].position.x += shift;
+		}
+	}
+
+	// group quads by page
+	UINT count[bitmapFontNS::MAX_PAGES + 1];
+	ZeroMemory(count, sizeof(count));
+	for (size_t i = 0; i < quadPages.size(); i++)
+		count[quadPages[i] + 1]++;
+	for (UINT p = 0; p < bitmapFontNS::MAX_PAGES; p++)
+		count[p + 1] += count[p];
+	memcpy(run.pageStart, count, sizeof(count));
+	run.quads.resize(quads.size());
+	for (size_t i = 0; i < quads.size(); i++)
+		run.quads[count[quadPages[i]]++] = quads[i];
+}
+
+//=============================================================================
+// Return the cached layout of str
+//=============================================================================
+const TextRun& BitmapFont::getRun(const std::string &str, const TextStyle &style) {
+	// key is the string followed by the style
+	key.assign(str);
+	key.push_back('\0');
+	key.push_back((char)style.align);
+	key.append((const char*)&style.wrapWidth, sizeof(style.wrapWidth));
+
+	std::unordered_map<std::string, TextRun>::iterator it = cache.find(key);
+	if (it == cache.end()) {
+		it = cache.insert(std::make_pair(key, TextRun())).first;
+		layout(str, style, it->second);
+		layouts++;
+	}
+	it->second.lastUsed = frame;
+	return it->second;
+}
+
+//=============================================================================
+// Queue text for drawing
+//=============================================================================
+void BitmapFont::print(const std::string &str, float x, float y, float scale,
+	COLOR_ARGB color, const TextStyle &style) {
+	QueuedText t;
+	t.run = &getRun(str, style);
+	t.x = x;
+	t.y = y;
+	t.scale = scale;
+	t.color = color;
+	queue.push_back(t);
+}
+
+//=============================================================================
+// Draw all queued text, one batch per atlas page
+//=============================================================================
+void BitmapFont::flush() {
+	for (UINT p = 0; p < pageFiles.size(); p++) {
+		bool drawn = false;
+		for (size_t i = 0; i < queue.size(); i++) {
+			const QueuedText &t = queue[i];
+			UINT first = t.run->pageStart[p];
+			UINT count = t.run->pageStart[p + 1] - first;
+			if (count == 0)
+				continue;
+			if (graphics && p < pages.size())
+				graphics->drawSpriteRun(pages[p]->getTexture(), &t.run->quads[first], count,
+					t.x, t.y, t.scale, t.color);
+			quadsDrawn += count;
+			drawn = true;
+		}
+		if (drawn)
+			batches++;
+	}
+	queue.clear();
+
+	// drop layouts that have not been printed recently
+	frame++;
+	if (frame % bitmapFontNS::CACHE_FRAMES == 0) {
+		std::unordered_map<std::string, TextRun>::iterator it = cache.begin();
+		while (it != cache.end()) {
+			if (frame - it->second.lastUsed > bitmapFontNS::CACHE_FRAMES)
+				it = cache.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+//=============================================================================
+// Return width and height in pixels of str
+//=============================================================================
+void BitmapFont::measure(const std::string &str, int &width, int &height, const TextStyle &style) {
+	const TextRun &run = getRun(str, style);
+	width = run.width;
+	height = run.height;
+}
+
+//=============================================================================
+// Called when graphics device is lost
+//=============================================================================
+void BitmapFont::onLostDevice() {
+	if (!initialized)
+		return;
+	for (size_t i = 0; i < pages.size(); i++)
+		pages[i]->onLostDevice();
+}
+
+//=============================================================================
+// Called when graphics device is reset
+//=============================================================================
+void BitmapFont::onResetDevice() {
+	if (!initialized)
+		return;
+	for (size_t i = 0; i < pages.size(); i++)
+		pages[i]->onResetDevice();
+}
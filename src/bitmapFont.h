@@ -0,0 +1,138 @@
+#ifndef _BITMAPFONT_H
+#define _BITMAPFONT_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "textureManager.h"
+#include "constants.h"
+
+namespace bitmapFontNS {
+	const int  MAX_CHARS = 256;			// glyphs for char codes 0 to 255
+	const UINT MAX_PAGES = 32;			// atlas textures per font
+	const UINT CACHE_FRAMES = 120;		// frames a layout is kept after its last use
+	enum ALIGNMENT { LEFT, CENTER, RIGHT };
+}
+
+// One character in the glyph atlas
+struct Glyph {
+	RECT    rect;			// location in the atlas page
+	short   xOffset;		// offset from cursor to top left of rect
+	short   yOffset;
+	short   xAdvance;		// cursor movement after this glyph
+	UCHAR   page;			// atlas page
+	bool    valid;			// true if the font has this character
+};
+
+// Layout options that change where glyphs are placed
+struct TextStyle {
+	bitmapFontNS::ALIGNMENT align;	// alignment of each line
+	int     wrapWidth;				// wrap lines longer than this many pixels, 0 for no wrap
+
+	TextStyle() : align(bitmapFontNS::LEFT), wrapWidth(0) {}
+};
+
+// A string laid out into quads, sorted by atlas page
+struct TextRun {
+	std::vector<SpriteQuad> quads;	// glyph quads in pixels relative to the run
+	UINT    pageStart[bitmapFontNS::MAX_PAGES + 1];	// first quad of each page
+	int     width;					// size of the laid out text in pixels
+	int     height;
+	UINT    lastUsed;				// frame the run was last printed
+};
+
+// Text drawn from a glyph atlas built offline in AngelCode BMFont text
+// format (.fnt and one image per page). Laid out strings are cached by
+// string and style, so unchanged text is not laid out again. Printed text
+// is queued and flush() draws all of it with one batch per atlas page.
+class BitmapFont {
+private:
+	// A run waiting to be drawn
+	struct QueuedText {
+		const TextRun *run;
+		float       x, y;
+		float       scale;
+		COLOR_ARGB  color;
+	};
+
+	Graphics    *graphics;			// pointer to graphics
+	Glyph       glyphs[bitmapFontNS::MAX_CHARS];
+	int         lineHeight;			// distance between lines in pixels
+	int         base;				// distance from top of line to baseline
+	std::vector<std::string> pageFiles;		// atlas page image files
+	std::vector<TextureManager*> pages;		// atlas page textures
+	std::unordered_map<std::string, TextRun> cache;	// layouts by string and style
+	std::vector<QueuedText> queue;	// text printed since last flush
+	std::string key;				// cache key, kept to reuse its memory
+	UINT        frame;				// flush() count, for cache aging
+	UINT        layouts;			// layouts since last resetStats()
+	UINT        quadsDrawn;			// quads drawn since last resetStats()
+	UINT        batches;			// page batches since last resetStats()
+	bool        initialized;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Lay out str into run.
+	void layout(const std::string &str, const TextStyle &style, TextRun &run) const;
+
+	// Return the cached layout of str, laying it out if needed.
+	const TextRun& getRun(const std::string &str, const TextStyle &style);
+
+public:
+	// Constructor
+	BitmapFont();
+
+	// Destructor
+	virtual ~BitmapFont();
+
+	// Load a BMFont text format font and its atlas pages.
+	// Pre: *g points to Graphics object, or NULL to load metrics only
+	//      *file points to the name of the .fnt file
+	// Post: returns false on error
+	virtual bool initialize(Graphics *g, const char *file);
+
+	// Read glyph metrics from the contents of a BMFont text format file.
+	// Page file names are relative to dir.
+	// Post: returns false on error
+	bool parse(const std::string &text, const std::string &dir);
+
+	// Queue text for drawing at x, y. Call flush() to draw queued text.
+	void print(const std::string &str, float x, float y, float scale = 1.0f,
+		COLOR_ARGB color = graphicsNS::WHITE, const TextStyle &style = TextStyle());
+
+	// Draw all queued text, one batch per atlas page, and age the layout cache.
+	// Pre: graphics->spriteBegin() has been called
+	void flush();
+
+	// Return width and height in pixels of str drawn with scale 1.
+	void measure(const std::string &str, int &width, int &height, const TextStyle &style = TextStyle());
+
+	// Return distance between lines in pixels.
+	int getLineHeight() const { return lineHeight; }
+
+	// Return number of atlas pages.
+	UINT getPageCount() const { return (UINT)pageFiles.size(); }
+
+	// Return number of cached layouts.
+	size_t getCacheSize() const { return cache.size(); }
+
+	// Return strings laid out since resetStats().
+	UINT getLayoutCount() const { return layouts; }
+
+	// Return glyph quads drawn since resetStats().
+	UINT getQuadCount() const { return quadsDrawn; }
+
+	// Return page batches drawn since resetStats().
+	UINT getBatchCount() const { return batches; }
+
+	// Reset layout, quad and batch counts.
+	void resetStats() { layouts = 0; quadsDrawn = 0; batches = 0; }
+
+	// Release resources
+	virtual void onLostDevice();
+
+	// Restore resources
+	virtual void onResetDevice();
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "camera.h"
+#include "image.h"
+#include <math.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+Camera2D::Camera2D() {
+	x = y = 0.0f;
+	zoom = 1.0f;
+	angle = 0.0f;
+	viewWidth = (float)GAME_WIDTH;
+	viewHeight = (float)GAME_HEIGHT;
+	layerCount = 1;
+	layers[cameraNS::WORLD_LAYER].scrollX = 1.0f;
+	layers[cameraNS::WORLD_LAYER].scrollY = 1.0f;
+	updateLayers();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+Camera2D::~Camera2D() {}
+
+//=============================================================================
+// Set the size of the view
+//=============================================================================
+void Camera2D::initialize(float width, float height) {
+	viewWidth = width;
+	viewHeight = height;
+	updateLayers();
+}
+
+//=============================================================================
+// Add a parallax layer
+//=============================================================================
+int Camera2D::addLayer(float scrollX, float scrollY) {
+	if (layerCount >= cameraNS::MAX_LAYERS)
+		return cameraNS::NONE;
+	Layer &layer = layers[layerCount];
+	layer.scrollX = scrollX;
+	layer.scrollY = scrollY;
+	updateLayer(layer);
+	return layerCount++;
+}
+
+//=============================================================================
+// Change the scroll factors of a layer
+//=============================================================================
+void Camera2D::setLayerScroll(int layer, float scrollX, float scrollY) {
+	if (layer < 0 || layer >= layerCount)
+		return;
+	layers[layer].scrollX = scrollX;
+	layers[layer].scrollY = scrollY;
+	updateLayer(layers[layer]);
+}
+
+//=============================================================================
+// Recompute the view of every layer
+//=============================================================================
+void Camera2D::updateLayers() {
+	for (int i = 0; i < layerCount; i++)
+		updateLayer(layers[i]);
+}
+
+//=============================================================================
+// Recompute the view of one layer
+// The layer point at the center of the view moves scroll times as far as
+// the camera from the screen center, so a layer with scroll 0 shows its
+// 0,0 at the top left like the screen. Points are moved to that center,
+// rotated by -angle, zoomed and moved to the middle of the view.
+// Row vectors, as D3DXMATRIX. Everything drawn through the layer moves, so
+// it is marked changed for drawing on demand.
+//=============================================================================
+void Camera2D::updateLayer(Layer &layer) {
+	imageNS::markChanged();
+	float c = cosf(angle);
+	float s = sinf(angle);
+	float halfViewWidth = viewWidth / 2;
+	float halfViewHeight = viewHeight / 2;
+	float cx = halfViewWidth + (x - halfViewWidth) * layer.scrollX;
+	float cy = halfViewHeight + (y - halfViewHeight) * layer.scrollY;
+
+	D3DXMATRIX &m = layer.view;
+	D3DXMatrixIdentity(&m);
+	m._11 = c * zoom;	m._12 = -s * zoom;
+	m._21 = s * zoom;	m._22 = c * zoom;
+	m._41 = -(cx * m._11 + cy * m._21) + halfViewWidth;
+	m._42 = -(cx * m._12 + cy * m._22) + halfViewHeight;
+
+	// bounding rectangle of the rotated view
+	float halfWidth = halfViewWidth / zoom;
+	float halfHeight = halfViewHeight / zoom;
+	float extentX = fabsf(c) * halfWidth + fabsf(s) * halfHeight;
+	float extentY = fabsf(s) * halfWidth + fabsf(c) * halfHeight;
+	layer.bounds.left = cx - extentX;
+	layer.bounds.right = cx + extentX;
+	layer.bounds.top = cy - extentY;
+	layer.bounds.bottom = cy + extentY;
+}
+
+//=============================================================================
+// Return true if a sprite may be visible
+// Sprites rotate about their center, so the test uses the square that
+// holds the sprite at any angle.
+//=============================================================================
+bool Camera2D::isVisible(const SpriteData &sprite, int layer) const {
+	float width = sprite.width * sprite.scale;
+	float height = sprite.height * sprite.scale;
+	if (sprite.angle == 0.0f)
+		return isVisible(sprite.x, sprite.y, width, height, layer);
+	float radius = sqrtf(width * width + height * height) / 2;
+	float centerX = sprite.x + width / 2;
+	float centerY = sprite.y + height / 2;
+	return isVisible(centerX - radius, centerY - radius, radius * 2, radius * 2, layer);
+}
+
+//=============================================================================
+// Convert world x,y to screen pixels
+//=============================================================================
+void Camera2D::worldToScreen(float wx, float wy, float &sx, float &sy) const {
+	const D3DXMATRIX &m = layers[cameraNS::WORLD_LAYER].view;
+	sx = wx * m._11 + wy * m._21 + m._41;
+	sy = wx * m._12 + wy * m._22 + m._42;
+}
+
+//=============================================================================
+// Convert screen pixels to world x,y
+//=============================================================================
+void Camera2D::screenToWorld(float sx, float sy, float &wx, float &wy) const {
+	// undo the offset, zoom and rotation
+	float dx = (sx - viewWidth / 2) / zoom;
+	float dy = (sy - viewHeight / 2) / zoom;
+	float c = cosf(angle);
+	float s = sinf(angle);
+	wx = dx * c - dy * s + x;
+	wy = dx * s + dy * c + y;
+}
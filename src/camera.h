@@ -0,0 +1,122 @@
+#ifndef _CAMERA_H
+#define _CAMERA_H
+#define WIN32_LEAN_AND_MEAN
+
+#include "graphics.h"
+
+namespace cameraNS {
+	const int   MAX_LAYERS = 8;			// parallax layers, including the world layer
+	const int   WORLD_LAYER = 0;		// layer that scrolls with the camera
+	const int   NONE = -1;				// no layer
+	const float MIN_ZOOM = 0.01f;
+}
+
+// Rectangle of a layer seen by the camera, in that layer's coordinates.
+struct ViewBounds {
+	float       left, top;
+	float       right, bottom;
+};
+
+// 2D camera looking at a world. The camera position is the world point at
+// the center of the view. Zoom and rotation turn about that point.
+// Each parallax layer scrolls by its own fraction of the camera position;
+// layer 0 is the world itself. The view matrix and visible rectangle of
+// every layer are computed when the camera changes, so drawing and culling
+// only read them.
+class Camera2D {
+private:
+	// Cached view of one layer
+	struct Layer {
+		float       scrollX, scrollY;	// fraction of camera movement, 1 for the world
+		D3DXMATRIX  view;				// layer coordinates to screen pixels
+		ViewBounds  bounds;				// visible rectangle in layer coordinates
+	};
+
+	Layer       layers[cameraNS::MAX_LAYERS];
+	int         layerCount;
+	float       x, y;					// world position of the view center
+	float       zoom;					// > 1 magnifies
+	float       angle;					// rotation in radians, clockwise
+	float       viewWidth;				// view size in screen pixels
+	float       viewHeight;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Recompute the view of every layer.
+	void updateLayers();
+
+	// Recompute the view of one layer.
+	void updateLayer(Layer &layer);
+
+public:
+	// Constructor
+	Camera2D();
+
+	// Destructor
+	virtual ~Camera2D();
+
+	// Set the size of the view in screen pixels.
+	void initialize(float width, float height);
+
+	// Add a parallax layer that moves scrollX, scrollY times as far as the
+	// camera; 0 stays fixed on screen, with layer 0,0 at the top left when
+	// not zoomed or rotated. Returns the layer, NONE if full.
+	int addLayer(float scrollX, float scrollY);
+
+	// Change the scroll factors of a layer.
+	void setLayerScroll(int layer, float scrollX, float scrollY);
+
+	// Center the view on world x,y.
+	void setPosition(float newX, float newY) { x = newX; y = newY; updateLayers(); }
+
+	// Move the camera by dx,dy world units.
+	void move(float dx, float dy) { x += dx; y += dy; updateLayers(); }
+
+	// Set zoom. 1 shows one world unit per pixel.
+	void setZoom(float z) { zoom = (z < cameraNS::MIN_ZOOM) ? cameraNS::MIN_ZOOM : z; updateLayers(); }
+
+	// Set rotation in radians.
+	void setAngle(float a) { angle = a; updateLayers(); }
+
+	// Return world X of the view center.
+	float getX() const { return x; }
+
+	// Return world Y of the view center.
+	float getY() const { return y; }
+
+	// Return zoom.
+	float getZoom() const { return zoom; }
+
+	// Return rotation in radians.
+	float getAngle() const { return angle; }
+
+	// Return number of layers.
+	int getLayerCount() const { return layerCount; }
+
+	// Return the view matrix of a layer, which maps layer coordinates to screen pixels.
+	const D3DXMATRIX& getViewMatrix(int layer = cameraNS::WORLD_LAYER) const { return layers[layer].view; }
+
+	// Return the rectangle of a layer that the camera sees. When rotated this
+	// is the bounding rectangle of the view.
+	const ViewBounds& getBounds(int layer = cameraNS::WORLD_LAYER) const { return layers[layer].bounds; }
+
+	// Return true if the rectangle left, top, width, height of a layer may be visible.
+	bool isVisible(float left, float top, float width, float height, int layer = cameraNS::WORLD_LAYER) const {
+		const ViewBounds &b = layers[layer].bounds;
+		return left < b.right && left + width > b.left && top < b.bottom && top + height > b.top;
+	}
+
+	// Return true if a sprite may be visible. Rotated sprites are tested by
+	// the square that holds them at any angle.
+	bool isVisible(const SpriteData &sprite, int layer = cameraNS::WORLD_LAYER) const;
+
+	// Draw sprites of a layer through this camera until the next setView().
+	void apply(Graphics *g, int layer = cameraNS::WORLD_LAYER) const { g->setView(&layers[layer].view); }
+
+	// Convert world x,y to screen pixels.
+	void worldToScreen(float wx, float wy, float &sx, float &sy) const;
+
+	// Convert screen pixels to world x,y.
+	void screenToWorld(float sx, float sy, float &wx, float &wy) const;
+};
+
+#endif
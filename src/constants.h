@@ -36,6 +36,15 @@ const float FRAME_RATE = 200.0f;
 const float MIN_FRAME_RATE = 10.0f;
 const float MIN_FRAME_TIME = 1.0f / FRAME_RATE;
 const float MAX_FRAME_TIME = 1.0f / MIN_FRAME_RATE;
+const float SPIKE_FRAME_TIME = 0.05f;			// frames slower than this are logged
+const bool DYNAMIC_RESOLUTION = false;			// true to lower the scene resolution when frames are slow
+const float RESOLUTION_FRAME_TIME = 1.0f / 60.0f;	// frame time dynamic resolution aims for
+const bool ON_DEMAND_RENDERING = false;			// true to draw only frames where something changed
+const float IDLE_FRAME_RATE = 30.0f;			// frame rate while nothing changes, when drawn on demand or paused
+const float BACKGROUND_FRAME_RATE = 10.0f;		// frame rate while the window does not have focus
+const UINT64 TEXTURE_BUDGET = 256 * 1024 * 1024;	// bytes of managed textures kept loaded, 0 for no limit
+const UINT MAX_TIMERS = 16384;					// timers scheduled at once on the game's TimerWheel
+const UINT MAX_BEHAVIORS = 4096;				// behaviors running at once on the game's BehaviorScheduler
 
 // Key Mappings
 const UCHAR ESC_KEY = VK_ESCAPE;
@@ -45,6 +54,16 @@ const UCHAR LEFT_KEY = VK_LEFT;
 const UCHAR RIGHT_KEY = VK_RIGHT;
 const UCHAR UP_KEY = VK_UP;
 const UCHAR DOWN_KEY = VK_DOWN;
+const UCHAR HUD_KEY = VK_F1;					// toggle performance HUD
+const UCHAR OVERDRAW_KEY = VK_F2;				// toggle overdraw heatmap
+
+// Engine diagnostics
+const char LOG_FILE[] = "game.log";
+const float OVERDRAW_LOG_INTERVAL = 1.0f;		// seconds between fill totals logged with the overdraw heatmap
+
+// Assets are read from ASSET_PACK when it exists, otherwise from loose files.
+// Build it with: -pack sprites sprites.pak
+const char ASSET_PACK[] = "sprites.pak";
 
 // Sprites
 const char BACKGROUND_IMAGE[] = "sprites\\background.png";
@@ -54,6 +73,8 @@ const float BACKGROUND_SCALE = 0.5f;
 const int SHIP_START_FRAME = 0;					// starting frame of ship animation
 const int SHIP_END_FRAME = 3;					// last frame of ship animation
 const float SHIP_ANIMATION_DELAY = 0.2f;		// time between frames of ship animation
+const float SHIP_FLASH_INTERVAL = 3.0f;			// seconds between flashes of the ship
+const UINT SHIP_FLASH_FRAMES = 6;				// frames a flash lasts
 const int SHIP_HEIGHT = 32;						// height of ship image
 const int SHIP_WIDTH = 32;						// width of ship image
 const int SHIP_COLS = 2;						// ship texture has 2 columns
@@ -0,0 +1,153 @@
+#include "controllerManager.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+ControllerManager::ControllerManager() {
+	backend = &xinput;
+	pollInterval = controllerNS::POLL_INTERVAL;
+	probeInterval = controllerNS::PROBE_INTERVAL;
+	vibrationTimers.initialize(MAX_CONTROLLERS * 2);
+	reset();
+}
+
+//=============================================================================
+// Clear the state of all controllers
+//=============================================================================
+void ControllerManager::reset() {
+	ZeroMemory(controllers, sizeof(ControllerState)* MAX_CONTROLLERS);
+	ZeroMemory(sentVibration, sizeof(sentVibration));
+	for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
+		vibrationSent[i] = false;
+		vibrationTimer[i][0] = vibrationTimer[i][1] = PoolHandle();
+	}
+	vibrationTimers.clear();
+	pollTimer = 0;
+	probeTimer = 0;
+	probePending = false;
+	nextProbe = 0;
+	resetCallCounts();
+}
+
+//=============================================================================
+// Set the controller backend
+//=============================================================================
+void ControllerManager::setBackend(ControllerBackend *b) {
+	if (b == NULL)
+		b = &xinput;
+	backend = b;
+	for (DWORD i = 0; i < MAX_CONTROLLERS; i++)
+		vibrationSent[i] = false;
+}
+
+//=============================================================================
+// Read slot n
+// Returns the bit for n if the controller was connected, disconnected or
+// its state changed.
+//=============================================================================
+DWORD ControllerManager::readSlot(DWORD n) {
+	bool wasConnected = controllers[n].connected;
+	DWORD packet = controllers[n].state.dwPacketNumber;
+
+	DWORD result = backend->getState(n, &controllers[n].state);
+	getStateCalls++;
+	controllers[n].connected = (result == ERROR_SUCCESS);
+
+	if (wasConnected != controllers[n].connected) {
+		vibrationSent[n] = false;				// send vibration to a new controller
+		return 1 << n;
+	}
+	if (controllers[n].connected && packet != controllers[n].state.dwPacketNumber)
+		return 1 << n;
+	return 0;
+}
+
+//=============================================================================
+// Read all slots now
+//=============================================================================
+DWORD ControllerManager::probeAll() {
+	DWORD changed = 0;
+	for (DWORD i = 0; i < MAX_CONTROLLERS; i++)
+		changed |= readSlot(i);
+	probePending = false;
+	probeTimer = 0;
+	return changed;
+}
+
+//=============================================================================
+// Read controllers that are due
+//=============================================================================
+DWORD ControllerManager::poll(float frameTime) {
+	DWORD changed = 0;
+
+	// connected controllers
+	pollTimer += frameTime;
+	if (pollTimer >= pollInterval) {
+		pollTimer = 0;
+		for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
+			if (controllers[i].connected)
+				changed |= readSlot(i);
+		}
+	}
+
+	// empty slots
+	probeTimer += frameTime;
+	if (probePending) {							// hot-plug, check every empty slot
+		for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
+			if (!controllers[i].connected && !(changed & (1 << i)))
+				changed |= readSlot(i);
+		}
+		probePending = false;
+		probeTimer = 0;
+	}
+	else if (probeTimer >= probeInterval) {		// background, check one empty slot
+		probeTimer = 0;
+		for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
+			DWORD n = (nextProbe + i) % MAX_CONTROLLERS;
+			if (!controllers[n].connected && !(changed & (1 << n))) {
+				changed |= readSlot(n);
+				nextProbe = (n + 1) % MAX_CONTROLLERS;
+				break;
+			}
+		}
+	}
+	return changed;
+}
+
+//=============================================================================
+// Run a motor for sec seconds
+// The motor's timer is replaced, so the last call sets when it stops.
+//=============================================================================
+void ControllerManager::vibrate(DWORD n, int motor, WORD speed, float sec) {
+	if (n > MAX_CONTROLLERS - 1)
+		n = MAX_CONTROLLERS - 1;
+	WORD &motorSpeed = (motor == 0) ? controllers[n].vibration.wLeftMotorSpeed : controllers[n].vibration.wRightMotorSpeed;
+	motorSpeed = speed;
+	vibrationTimers.cancel(vibrationTimer[n][motor]);
+	vibrationTimer[n][motor] = vibrationTimers.schedule(sec, [this, n, motor, &motorSpeed](PoolHandle) {
+		motorSpeed = 0;
+		vibrationTimer[n][motor] = PoolHandle();
+	});
+}
+
+//=============================================================================
+// Advance the vibration timers and send changed motor speeds
+//=============================================================================
+void ControllerManager::updateVibration(float frameTime, bool send) {
+	vibrationTimers.advance(frameTime);
+	if (!send)
+		return;
+	for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
+		if (!controllers[i].connected)
+			continue;
+		// only send when the motor speeds change
+		if (vibrationSent[i] &&
+			sentVibration[i].wLeftMotorSpeed == controllers[i].vibration.wLeftMotorSpeed &&
+			sentVibration[i].wRightMotorSpeed == controllers[i].vibration.wRightMotorSpeed)
+			continue;
+		backend->setState(i, &controllers[i].vibration);
+		setStateCalls++;
+		sentVibration[i] = controllers[i].vibration;
+		vibrationSent[i] = true;
+	}
+}
@@ -0,0 +1,134 @@
+#ifndef _CONTROLLERMANAGER_H
+#define _CONTROLLERMANAGER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <XInput.h>
+#include "timerWheel.h"
+
+const DWORD MAX_CONTROLLERS = 4;									// Maximum number of controllers supported by XInput
+
+namespace controllerNS {
+	const float POLL_INTERVAL = 0.0f;		// seconds between reads of connected controllers, 0 for every frame
+	const float PROBE_INTERVAL = 1.0f;		// seconds between probes of one empty slot
+}
+
+struct ControllerState {
+	XINPUT_STATE        state;
+	XINPUT_VIBRATION    vibration;
+	bool                connected;
+};
+
+// Interface to the controller hardware.
+// Replace the default XInput backend to run without controllers or to
+// count hardware calls.
+class ControllerBackend {
+public:
+	// Destructor
+	virtual ~ControllerBackend() {}
+
+	// Read state of controller n.
+	// Returns ERROR_SUCCESS, or ERROR_DEVICE_NOT_CONNECTED if slot n is empty.
+	virtual DWORD getState(DWORD n, XINPUT_STATE *state) = 0;
+
+	// Set motor speeds of controller n.
+	virtual DWORD setState(DWORD n, XINPUT_VIBRATION *vibration) = 0;
+};
+
+// ControllerBackend using XInput
+class XInputBackend : public ControllerBackend {
+public:
+	DWORD getState(DWORD n, XINPUT_STATE *state) { return XInputGetState(n, state); }
+	DWORD setState(DWORD n, XINPUT_VIBRATION *vibration) { return XInputSetState(n, vibration); }
+};
+
+// Schedules controller reads so empty slots, which are slow to query,
+// are not read every frame. Connected controllers are read every
+// pollInterval seconds. Empty slots are probed one at a time every
+// probeInterval seconds, or all together after requestProbe().
+// Vibration is only sent when the motor speeds change, and each motor is
+// stopped by a one-shot timer, so controllers that are not vibrating cost
+// nothing per frame.
+class ControllerManager {
+private:
+	ControllerState controllers[MAX_CONTROLLERS];		// state of controllers
+	XINPUT_VIBRATION sentVibration[MAX_CONTROLLERS];	// last vibration sent to backend
+	bool    vibrationSent[MAX_CONTROLLERS];				// false to force sending vibration
+	ControllerBackend *backend;		// controller hardware
+	XInputBackend xinput;			// default backend
+	float   pollInterval;			// seconds between reads of connected controllers
+	float   probeInterval;			// seconds between probes of an empty slot
+	float   pollTimer;				// time since connected controllers were read
+	float   probeTimer;				// time since an empty slot was probed
+	bool    probePending;			// true to probe all empty slots on next poll
+	DWORD   nextProbe;				// next slot checked by the background probe
+	UINT    getStateCalls;			// backend getState calls since resetCallCounts()
+	UINT    setStateCalls;			// backend setState calls since resetCallCounts()
+	TimerWheel vibrationTimers;		// stop the motors
+	PoolHandle vibrationTimer[MAX_CONTROLLERS][2];		// timer of the left and right motor
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Read slot n from the backend. Returns the bit for n if its state changed.
+	DWORD readSlot(DWORD n);
+
+	// Run motor 0 (left) or 1 (right) of controller n at speed for sec seconds.
+	void vibrate(DWORD n, int motor, WORD speed, float sec);
+
+	// Managers hold timers that call back into them, so they are not copied
+	ControllerManager(const ControllerManager&);
+	ControllerManager& operator=(const ControllerManager&);
+
+public:
+	// Constructor
+	ControllerManager();
+
+	// Clear the state of all controllers.
+	void reset();
+
+	// Set the controller backend. NULL restores the XInput backend.
+	void setBackend(ControllerBackend *b);
+
+	// Set seconds between reads of connected controllers. 0 reads every frame.
+	void setPollInterval(float sec) { pollInterval = sec; }
+
+	// Set seconds between probes of an empty slot.
+	void setProbeInterval(float sec) { probeInterval = sec; }
+
+	// Read all slots now.
+	// Returns a bit mask of the controllers whose state changed.
+	DWORD probeAll();
+
+	// Probe all empty slots on the next poll, e.g. after WM_DEVICECHANGE.
+	void requestProbe() { probePending = true; }
+
+	// Read controllers that are due.
+	// Returns a bit mask of the controllers whose state changed.
+	DWORD poll(float frameTime);
+
+	// Run the left, low frequency, motor of controller n at speed for sec seconds.
+	void vibrateLeft(DWORD n, WORD speed, float sec) { vibrate(n, 0, speed, sec); }
+
+	// Run the right, high frequency, motor of controller n at speed for sec seconds.
+	void vibrateRight(DWORD n, WORD speed, float sec) { vibrate(n, 1, speed, sec); }
+
+	// Advance the vibration timers and send changed motor speeds to the backend.
+	// send = false updates the timers only.
+	void updateVibration(float frameTime, bool send);
+
+	// Return state of controller n.
+	ControllerState& operator[](UINT n) { return controllers[n]; }
+
+	// Return state of controller n.
+	const ControllerState& operator[](UINT n) const { return controllers[n]; }
+
+	// Return number of backend getState calls.
+	UINT getGetStateCalls() const { return getStateCalls; }
+
+	// Return number of backend setState calls.
+	UINT getSetStateCalls() const { return setStateCalls; }
+
+	// Reset backend call counts.
+	void resetCallCounts() { getStateCalls = 0; setStateCalls = 0; }
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "drawList.h"
+#include "radixSort.h"
+#include "softwareRasterizer.h"
+#include "spriteBatcher.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+DrawList::DrawList() {
+	graphics = NULL;
+	sorted = true;
+	split = true;
+	rasterizer = NULL;
+	memset(&stats, 0, sizeof(stats));
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+DrawList::~DrawList() {}
+
+//=============================================================================
+// Reserve room for maxSprites sprites
+//=============================================================================
+bool DrawList::initialize(Graphics *g, UINT maxSprites) {
+	graphics = g;
+	clear();
+	if (!meshArena.initialize(drawListNS::MESH_ARENA_BYTES))
+		return false;
+	try {
+		items.reserve(maxSprites);
+		keys.reserve(maxSprites);
+		order.reserve(maxSprites);
+		tempKeys.reserve(maxSprites);
+		tempOrder.reserve(maxSprites);
+		opaque.reserve(maxSprites);
+		blended.reserve(maxSprites);
+	}
+	catch (...) { return false; }
+	return true;
+}
+
+//=============================================================================
+// Sort the submitted sprites by key
+//=============================================================================
+void DrawList::sort() {
+	if (sorted || keys.empty())
+		return;
+	tempKeys.resize(keys.size());
+	tempOrder.resize(order.size());
+	radixSortNS::sort(&keys[0], &order[0], (UINT)keys.size(), &tempKeys[0], &tempOrder[0]);
+	sorted = true;
+}
+
+//=============================================================================
+// Return true if sprite key i can be drawn in the opaque pass
+//=============================================================================
+bool DrawList::isOpaque(UINT i) const {
+	const Item &item = items[order[i]];
+	if (item.opacity == NULL || item.sprite.texture == NULL || (item.color >> 24) != 0xff)
+		return false;
+	if (((keys[i] >> drawListNS::BLEND_SHIFT) & drawListNS::BLEND_MASK) != graphicsNS::BLEND_ALPHA)
+		return false;
+	return item.opacity->getOpacity(item.sprite.rect) != opacityNS::OPACITY_BLENDED;
+}
+
+//=============================================================================
+// Draw sprite key i at depth z
+// A mesh is built into quads in world coordinates by a SpriteBucket, with
+// texture coordinates from the size of the opacity map, which is the size
+// of the texture.
+//=============================================================================
+void DrawList::drawItem(UINT i, float z) {
+	const Item &item = items[order[i]];
+	if (graphics) {
+		graphics->setSpriteDepth(z);
+		if (item.mesh == NULL)
+			graphics->drawSprite(item.sprite, item.color);
+		else if (item.mesh->count >= 3) {		// else nothing of the frame is visible
+			meshArena.reset();
+			SpriteBucket bucket;
+			bucket.begin(&meshArena, NULL, graphicsNS::MESH_QUADS);
+			bucket.add(item.sprite, item.opacity->getWidth(), item.opacity->getHeight(),
+				item.color, item.mesh);
+			graphics->drawSpriteMesh(item.sprite.texture, bucket.getVertices(), bucket.getQuadCount());
+		}
+	}
+	if (rasterizer) {
+		rasterizer->setId(order[i]);
+		rasterizer->setCoverage(item.opacity);
+		rasterizer->drawSprite(item.sprite, z, item.mesh);
+	}
+}
+
+//=============================================================================
+// Draw the submitted sprites in key order
+// Split passes give each sprite a depth from its place in key order, nearer
+// for later sprites, so depth tests hide what drawing in key order would
+// have drawn over. The blend mode is changed only where it differs from the
+// sprite before.
+//=============================================================================
+void DrawList::flush() {
+	sort();
+	memset(&stats, 0, sizeof(stats));
+	opaque.clear();
+	blended.clear();
+	UINT count = (UINT)keys.size();
+	for (UINT i = 0; i < count; i++) {
+		const SpriteData &sd = items[order[i]].sprite;
+		float area = sd.width * sd.height * sd.scale * sd.scale;
+		if (split && isOpaque(i)) {
+			opaque.push_back(i);
+			stats.opaqueArea += area;
+		}
+		else {
+			blended.push_back(i);
+			stats.blendedArea += area;
+		}
+	}
+	stats.opaqueSprites = (UINT)opaque.size();
+	stats.blendedSprites = (UINT)blended.size();
+
+	bool passes = !opaque.empty();
+	float depthStep = 1.0f / (count + 1);
+	if (passes) {
+		if (graphics)
+			graphics->setSpritePass(graphicsNS::PASS_OPAQUE);
+		if (rasterizer)
+			rasterizer->setDepth(true, true);
+		for (size_t n = opaque.size(); n-- > 0;)		// front to back
+			drawItem(opaque[n], 1.0f - (opaque[n] + 1) * depthStep);
+		if (graphics)
+			graphics->setSpritePass(graphicsNS::PASS_BLENDED);
+		if (rasterizer)
+			rasterizer->setDepth(true, false);
+	}
+	else if (rasterizer)
+		rasterizer->setDepth(false, false);
+
+	graphicsNS::BLEND_MODE blend = graphicsNS::BLEND_ALPHA;
+	for (size_t n = 0; n < blended.size(); n++) {		// back to front
+		UINT i = blended[n];
+		graphicsNS::BLEND_MODE b = (graphicsNS::BLEND_MODE)((keys[i] >> drawListNS::BLEND_SHIFT) & drawListNS::BLEND_MASK);
+		if (b != blend && graphics) {
+			graphics->setSpriteBlend(b);
+			blend = b;
+		}
+		drawItem(i, passes ? 1.0f - (i + 1) * depthStep : 0.0f);
+	}
+	if (graphics) {
+		if (blend != graphicsNS::BLEND_ALPHA)
+			graphics->setSpriteBlend(graphicsNS::BLEND_ALPHA);
+		if (passes)
+			graphics->setSpritePass(graphicsNS::PASS_SINGLE);
+	}
+	clear();
+}
+
+//=============================================================================
+// Remove all sprites
+//=============================================================================
+void DrawList::clear() {
+	items.clear();
+	keys.clear();
+	order.clear();
+	sorted = true;
+}
@@ -0,0 +1,172 @@
+#ifndef _DRAWLIST_H
+#define _DRAWLIST_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include <string.h>
+#include "graphics.h"
+#include "opacityMap.h"
+#include "memoryArena.h"
+
+class SoftwareRasterizer;
+struct SpriteMesh;
+
+namespace drawListNS {
+	// Sort key fields, most significant first. Keys use 40 bits, so the
+	// radix sort skips the passes over the top bits, which are always 0.
+	const int   LAYER_SHIFT = 32;		// 8 bits, drawn in increasing layer
+	const int   DEPTH_SHIFT = 12;		// DEPTH_BITS bits, drawn in increasing depth within a layer
+	const int   BLEND_SHIFT = 10;		// 2 bits, graphicsNS::BLEND_MODE
+	const int   TEXTURE_SHIFT = 0;		// TEXTURE_BITS bits, so sprites with one texture batch together
+	const int   DEPTH_BITS = 20;		// top bits of depthBits(), 11 bits of mantissa
+	const int   TEXTURE_BITS = 10;
+	const UINT  BLEND_MASK = 3;
+	const size_t MESH_ARENA_BYTES = 4096;	// room for the quads and batch of one mesh
+
+	// Return depth as an unsigned number that sorts in the same order.
+	inline UINT depthBits(float depth) {
+		UINT u;
+		memcpy(&u, &depth, sizeof(u));
+		return (u & 0x80000000) ? ~u : (u | 0x80000000);
+	}
+
+	// Return a TEXTURE_BITS bit number for a texture. Different textures may
+	// share a number, which only costs batching.
+	inline UINT textureId(LP_TEXTURE texture) {
+		UINT64 p = (UINT64)(UINT_PTR)texture >> 4;
+		return (UINT)((p * 0x9E3779B97F4A7C15ULL) >> (64 - TEXTURE_BITS));
+	}
+
+	// Return the sort key of a sprite.
+	// depth = any order within the layer, such as Y for y-sorting. Depths
+	// are kept to DEPTH_BITS bits, so at Y of 2048 to 4096 sprites less than
+	// a pixel apart may share a depth, and draw in texture, then submitted,
+	// order.
+	inline UINT64 makeKey(UINT layer, float depth, graphicsNS::BLEND_MODE blend, LP_TEXTURE texture) {
+		return ((UINT64)(layer & 0xff) << LAYER_SHIFT) |
+			((UINT64)(depthBits(depth) >> (32 - DEPTH_BITS)) << DEPTH_SHIFT) |
+			((UINT64)(blend & BLEND_MASK) << BLEND_SHIFT) | ((UINT64)textureId(texture) << TEXTURE_SHIFT);
+	}
+}
+
+// Sprites and their area in each pass of a flush()
+struct DrawListStats {
+	UINT        opaqueSprites;		// drawn front to back with depth writes
+	UINT        blendedSprites;		// drawn back to front with blending
+	float       opaqueArea;			// screen pixels covered, counting overlaps
+	float       blendedArea;
+};
+
+// Sprites submitted during a frame, drawn in sort key order by flush().
+// Games submit in any order and set the order with each sprite's layer and
+// depth instead of ordering their draw calls. Keys are sorted with a radix
+// sort, and sprites with equal keys draw in the order submitted.
+// Sprites with no partly transparent pixels, no alpha in their color and
+// alpha blending are opaque. When passes are split, opaque sprites are drawn
+// first, front to back with depth writes, so hidden pixels are not shaded,
+// then the rest back to front with depth tests. The result is the same as
+// drawing everything in key order.
+class DrawList {
+private:
+	// A submitted sprite
+	struct Item {
+		SpriteData  sprite;
+		COLOR_ARGB  color;
+		const OpacityMap *opacity;		// of sprite.texture, NULL if unknown
+		const SpriteMesh *mesh;			// drawn instead of the quad, NULL for the quad
+	};
+
+	Graphics    *graphics;
+	std::vector<Item> items;
+	std::vector<UINT64> keys;			// sort key of each item, sorted by sort()
+	std::vector<UINT> order;			// item of each key
+	std::vector<UINT64> tempKeys;		// radix sort scratch
+	std::vector<UINT> tempOrder;
+	std::vector<UINT> opaque;			// keys of opaque sprites, in key order
+	std::vector<UINT> blended;			// keys of the other sprites
+	bool        sorted;
+	bool        split;					// draw opaque and blended passes
+	SoftwareRasterizer *rasterizer;		// also counts pixels here, NULL for none
+	DrawListStats stats;
+	MemoryArena meshArena;				// vertices of the mesh being drawn
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return true if sprite key i can be drawn in the opaque pass.
+	bool isOpaque(UINT i) const;
+
+	// Draw sprite key i at depth z in a pass, with the graphics device and
+	// the rasterizer.
+	void drawItem(UINT i, float z);
+
+	// Lists hold copies of sprites, so they are not copied
+	DrawList(const DrawList&);
+	DrawList& operator=(const DrawList&);
+
+public:
+	// Constructor
+	DrawList();
+
+	// Destructor
+	virtual ~DrawList();
+
+	// Reserve room for maxSprites sprites per frame.
+	// Pre: *g points to Graphics object, or NULL to sort without drawing
+	// Post: returns false on error
+	bool initialize(Graphics *g, UINT maxSprites);
+
+	// Submit a sprite with a sort key from drawListNS::makeKey().
+	// opacity = of the sprite's texture, such as TextureManager::getOpacity(),
+	// NULL to draw the sprite blended
+	// mesh = drawn instead of the quad, from a SpriteMeshSheet built from
+	// opacity, NULL for the quad. Ignored when opacity is NULL.
+	void add(UINT64 key, const SpriteData &sprite, COLOR_ARGB color = graphicsNS::WHITE,
+		const OpacityMap *opacity = NULL, const SpriteMesh *mesh = NULL) {
+		Item item;
+		item.sprite = sprite;
+		item.color = color;
+		item.opacity = opacity;
+		item.mesh = opacity ? mesh : NULL;
+		items.push_back(item);
+		keys.push_back(key);
+		order.push_back((UINT)order.size());
+		sorted = false;
+	}
+
+	// Submit a sprite on layer at depth.
+	void add(UINT layer, float depth, const SpriteData &sprite, COLOR_ARGB color = graphicsNS::WHITE,
+		graphicsNS::BLEND_MODE blend = graphicsNS::BLEND_ALPHA, const OpacityMap *opacity = NULL,
+		const SpriteMesh *mesh = NULL) {
+		add(drawListNS::makeKey(layer, depth, blend, sprite.texture), sprite, color, opacity, mesh);
+	}
+
+	// Sort the submitted sprites by key.
+	void sort();
+
+	// Draw the submitted sprites in key order and empty the list.
+	// Pre: graphics->spriteBegin() has been called
+	void flush();
+
+	// Split opaque and blended passes, true by default.
+	void setSplitPasses(bool s) { split = s; }
+
+	// Also draw flushed sprites with r, to count the pixels drawn. r is not
+	// cleared. NULL for none.
+	void setRasterizer(SoftwareRasterizer *r) { rasterizer = r; }
+
+	// Return the sprites and areas of each pass of the last flush().
+	const DrawListStats& getStats() const { return stats; }
+
+	// Remove all sprites.
+	void clear();
+
+	// Return number of sprites submitted.
+	UINT getCount() const { return (UINT)items.size(); }
+
+	// Return key i, in key order after sort().
+	UINT64 getKey(UINT i) const { return keys[i]; }
+
+	// Return the sprite with key i.
+	const SpriteData& getSprite(UINT i) const { return items[order[i]].sprite; }
+};
+
+#endif
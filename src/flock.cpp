@@ -0,0 +1,436 @@
+#include "flock.h"
+#include "image.h"
+#include <malloc.h>
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace flockNS {
+	const float EPSILON = 1e-6f;		// smallest length divided by
+}
+
+//=============================================================================
+// Return the sum of the four floats of v
+//=============================================================================
+static inline float horizontalSum(__m128 v) {
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+Flock::Flock() {
+	capacity = 0;
+	count = 0;
+	posX = posY = velX = velY = NULL;
+	sortX = sortY = sortVelX = sortVelY = NULL;
+	forceX = forceY = NULL;
+	ids = sortIds = slots = NULL;
+	keys = NULL;
+	cellStart = NULL;
+	hashMask = 0;
+	seekX = seekY = 0;
+	fleeX = fleeY = 0;
+	seeking = false;
+	fleeing = false;
+	memset(pairs, 0, sizeof(pairs));
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+Flock::~Flock() {
+	freeArrays();
+}
+
+//=============================================================================
+// Free the agent arrays
+//=============================================================================
+void Flock::freeArrays() {
+	void **arrays[] = { (void**)&posX, (void**)&posY, (void**)&velX, (void**)&velY,
+		(void**)&sortX, (void**)&sortY, (void**)&sortVelX, (void**)&sortVelY,
+		(void**)&forceX, (void**)&forceY, (void**)&ids, (void**)&sortIds, (void**)&slots,
+		(void**)&keys, (void**)&cellStart };
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+		if (*arrays[i])
+			_aligned_free(*arrays[i]);
+		*arrays[i] = NULL;
+	}
+	freeIds.clear();
+	capacity = 0;
+	count = 0;
+}
+
+//=============================================================================
+// Allocate agent storage
+// The hash has a power of 2 cells, at least twice the agents, so few
+// cells with agents share a hash cell, and at least 4 rows, so the rows
+// around an agent never share one.
+//=============================================================================
+bool Flock::initialize(int maxAgents) {
+	using namespace flockNS;
+	freeArrays();
+	capacity = (maxAgents + SIMD_WIDTH - 1) & ~(SIMD_WIDTH - 1);
+	if (capacity <= 0)
+		return false;
+	UINT cells = HASH_ROW * 4;
+	while (cells < (UINT)capacity * 2)
+		cells <<= 1;
+	hashMask = cells - 1;
+
+	size_t bytes = (capacity + SIMD_WIDTH) * sizeof(float);
+	void **arrays[] = { (void**)&posX, (void**)&posY, (void**)&velX, (void**)&velY,
+		(void**)&sortX, (void**)&sortY, (void**)&sortVelX, (void**)&sortVelY,
+		(void**)&forceX, (void**)&forceY, (void**)&ids, (void**)&sortIds, (void**)&slots,
+		(void**)&keys, (void**)&cellStart };
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+		size_t n = (arrays[i] == (void**)&cellStart) ? (cells + 1) * sizeof(int) : bytes;
+		*arrays[i] = _aligned_malloc(n, 16);
+		if (*arrays[i] == NULL) {
+			freeArrays();
+			return false;
+		}
+		memset(*arrays[i], 0, n);
+	}
+	try {
+		freeIds.resize(capacity);
+	}
+	catch (...) {
+		freeArrays();
+		return false;
+	}
+	for (int i = 0; i < capacity; i++) {
+		slots[i] = NONE;
+		freeIds[i] = capacity - 1 - i;		// id 0 is used first
+	}
+	count = 0;
+	return true;
+}
+
+//=============================================================================
+// Add an agent
+//=============================================================================
+int Flock::add(float x, float y, float vx, float vy) {
+	if (freeIds.empty())
+		return flockNS::NONE;
+	int id = freeIds.back();
+	freeIds.pop_back();
+	int s = count++;
+	posX[s] = x;
+	posY[s] = y;
+	velX[s] = vx;
+	velY[s] = vy;
+	ids[s] = id;
+	slots[id] = s;
+	return id;
+}
+
+//=============================================================================
+// Remove an agent
+// The last agent is moved into its slot, so slots do not stay in order
+// until the next update sorts them.
+//=============================================================================
+bool Flock::remove(int id) {
+	if (!isAgent(id))
+		return false;
+	int s = slots[id];
+	int last = --count;
+	posX[s] = posX[last];
+	posY[s] = posY[last];
+	velX[s] = velX[last];
+	velY[s] = velY[last];
+	ids[s] = ids[last];
+	slots[ids[s]] = s;
+	slots[id] = flockNS::NONE;
+	freeIds.push_back(id);
+	return true;
+}
+
+//=============================================================================
+// Remove all agents
+//=============================================================================
+void Flock::clear() {
+	while (count > 0)
+		remove(ids[count - 1]);
+}
+
+//=============================================================================
+// Set how agents steer
+//=============================================================================
+void Flock::setParams(const SteeringParams &p) {
+	params = p;
+	if (params.neighborRadius <= 0)
+		params.neighborRadius = 1;
+	if (params.separationRadius > params.neighborRadius)
+		params.separationRadius = params.neighborRadius;
+}
+
+//=============================================================================
+// Add an obstacle
+//=============================================================================
+bool Flock::addObstacle(float x, float y, float radius) {
+	if ((int)obstacles.size() >= flockNS::MAX_OBSTACLES)
+		return false;
+	SteeringObstacle o;
+	o.x = x;
+	o.y = y;
+	o.radius = radius;
+	obstacles.push_back(o);
+	return true;
+}
+
+//=============================================================================
+// Sort agents by hash cell
+// A counting sort: count the agents of each cell, turn the counts into the
+// end of each cell's run, then place agents from the last, so each cell's
+// entry ends up at the start of its run.
+// Cells are made a little wider than neighborRadius, so rounding never
+// puts a neighbour two cells away.
+//=============================================================================
+void Flock::sort() {
+	float inv = 0.999f / params.neighborRadius;
+	memset(cellStart, 0, (hashMask + 2) * sizeof(int));
+	for (int i = 0; i < count; i++) {
+		UINT k = hash((int)floorf(posX[i] * inv), (int)floorf(posY[i] * inv));
+		keys[i] = k;
+		cellStart[k]++;
+	}
+	int sum = 0;
+	for (UINT k = 0; k <= hashMask; k++) {
+		sum += cellStart[k];
+		cellStart[k] = sum;
+	}
+	cellStart[hashMask + 1] = count;
+	for (int i = count - 1; i >= 0; i--) {
+		int s = --cellStart[keys[i]];
+		sortX[s] = posX[i];
+		sortY[s] = posY[i];
+		sortVelX[s] = velX[i];
+		sortVelY[s] = velY[i];
+		sortIds[s] = ids[i];
+	}
+	std::swap(ids, sortIds);
+	for (int s = 0; s < count; s++)
+		slots[ids[s]] = s;
+}
+
+//=============================================================================
+// Sum the neighbours of sorted slot s
+// The 3 cells of each row around the agent are consecutive in the hash, so
+// their agents are one run, unless the row wraps at the end of the hash.
+// Each run is read four agents at a time, with lanes past the run or on the
+// agent itself masked off.
+//=============================================================================
+int Flock::flockForce(int s) {
+	using namespace flockNS;
+	float px = sortX[s], py = sortY[s];
+	float vx = sortVelX[s], vy = sortVelY[s];
+	float inv = 0.999f / params.neighborRadius;
+	int cx = (int)floorf(px * inv), cy = (int)floorf(py * inv);
+	int runBegin[9], runEnd[9];
+	int runs = 0;
+	for (int y = cy - 1; y <= cy + 1; y++) {
+		UINT k = hash(cx - 1, y);
+		if (k + 2 <= hashMask) {
+			runBegin[runs] = cellStart[k];
+			runEnd[runs++] = cellStart[k + 3];
+			continue;
+		}
+		for (int x = cx - 1; x <= cx + 1; x++) {
+			k = hash(x, y);
+			runBegin[runs] = cellStart[k];
+			runEnd[runs++] = cellStart[k + 1];
+		}
+	}
+
+	const __m128 x = _mm_set1_ps(px), y = _mm_set1_ps(py);
+	const __m128 r2 = _mm_set1_ps(params.neighborRadius * params.neighborRadius);
+	const __m128 sr2 = _mm_set1_ps(params.separationRadius * params.separationRadius);
+	const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+	const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i self = _mm_set1_epi32(s);
+	__m128 n = zero, sumX = zero, sumY = zero, sumVX = zero, sumVY = zero, sepX = zero, sepY = zero;
+	for (int r = 0; r < runs; r++) {
+		int begin = runBegin[r], end = runEnd[r];
+		const __m128i last = _mm_set1_epi32(end);
+		for (int j = begin; j < end; j += SIMD_WIDTH) {
+			__m128i index = _mm_add_epi32(_mm_set1_epi32(j), lane);
+			__m128 valid = _mm_castsi128_ps(_mm_andnot_si128(_mm_cmpeq_epi32(index, self), _mm_cmplt_epi32(index, last)));
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(sortX + j), x);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(sortY + j), y);
+			__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			__m128 m = _mm_and_ps(valid, _mm_cmplt_ps(d2, r2));
+			n = _mm_add_ps(n, _mm_and_ps(m, one));
+			sumX = _mm_add_ps(sumX, _mm_and_ps(m, dx));
+			sumY = _mm_add_ps(sumY, _mm_and_ps(m, dy));
+			sumVX = _mm_add_ps(sumVX, _mm_and_ps(m, _mm_loadu_ps(sortVelX + j)));
+			sumVY = _mm_add_ps(sumVY, _mm_and_ps(m, _mm_loadu_ps(sortVelY + j)));
+			// push away by 1 / distance, from neighbours that are not on top of it
+			__m128 near = _mm_and_ps(m, _mm_and_ps(_mm_cmplt_ps(d2, sr2), _mm_cmpgt_ps(d2, zero)));
+			__m128 push = _mm_and_ps(near, _mm_div_ps(one, d2));
+			sepX = _mm_sub_ps(sepX, _mm_mul_ps(dx, push));
+			sepY = _mm_sub_ps(sepY, _mm_mul_ps(dy, push));
+		}
+	}
+
+	int neighbors = (int)horizontalSum(n);
+	float fx = 0, fy = 0;
+	if (neighbors > 0) {
+		float maxSpeed = params.maxSpeed;
+		float ax = horizontalSum(sumVX), ay = horizontalSum(sumVY);	// alignment
+		float len = sqrtf(ax * ax + ay * ay);
+		if (len > EPSILON) {
+			fx += params.alignment * (ax / len * maxSpeed - vx);
+			fy += params.alignment * (ay / len * maxSpeed - vy);
+		}
+		float ox = horizontalSum(sumX), oy = horizontalSum(sumY);	// cohesion
+		len = sqrtf(ox * ox + oy * oy);
+		if (len > EPSILON) {
+			fx += params.cohesion * (ox / len * maxSpeed - vx);
+			fy += params.cohesion * (oy / len * maxSpeed - vy);
+		}
+		float sx = horizontalSum(sepX), sy = horizontalSum(sepY);	// separation
+		len = sqrtf(sx * sx + sy * sy);
+		if (len > EPSILON) {
+			fx += params.separation * (sx / len * maxSpeed - vx);
+			fy += params.separation * (sy / len * maxSpeed - vy);
+		}
+	}
+	forceX[s] = fx;
+	forceY[s] = fy;
+	return neighbors;
+}
+
+//=============================================================================
+// Steer agents [begin, end)
+// Neighbour forces are summed one agent at a time, then seek, flee and
+// obstacle avoidance are added, the force and speed limited and the agents
+// moved four at a time.
+//=============================================================================
+void Flock::step(int begin, int end, int worker, float frameTime) {
+	using namespace flockNS;
+	int last = std::min(end, count);
+	UINT64 neighbors = 0;
+	for (int s = begin; s < last; s++)
+		neighbors += flockForce(s);
+	for (int s = last; s < end; s++)		// slots past count are harmless scratch
+		forceX[s] = forceY[s] = 0;
+	pairs[worker] += neighbors;
+
+	const __m128 dt = _mm_set1_ps(frameTime);
+	const __m128 eps = _mm_set1_ps(EPSILON);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 maxSpeed = _mm_set1_ps(params.maxSpeed);
+	const __m128 maxForce = _mm_set1_ps(params.maxForce);
+	const __m128 seek = _mm_set1_ps(params.seek), flee = _mm_set1_ps(params.flee);
+	const __m128 avoid = _mm_set1_ps(params.avoid * params.maxSpeed / params.avoidDistance);
+	const __m128 fleeR2 = _mm_set1_ps(params.fleeRadius * params.fleeRadius);
+
+	for (int i = begin; i < end; i += SIMD_WIDTH) {
+		__m128 px = _mm_load_ps(sortX + i), py = _mm_load_ps(sortY + i);
+		__m128 vx = _mm_load_ps(sortVelX + i), vy = _mm_load_ps(sortVelY + i);
+		__m128 fx = _mm_load_ps(forceX + i), fy = _mm_load_ps(forceY + i);
+
+		if (seeking) {
+			__m128 dx = _mm_sub_ps(_mm_set1_ps(seekX), px);
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(seekY), py);
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+			__m128 scale = _mm_div_ps(maxSpeed, _mm_max_ps(len, eps));
+			fx = _mm_add_ps(fx, _mm_mul_ps(seek, _mm_sub_ps(_mm_mul_ps(dx, scale), vx)));
+			fy = _mm_add_ps(fy, _mm_mul_ps(seek, _mm_sub_ps(_mm_mul_ps(dy, scale), vy)));
+		}
+		if (fleeing) {
+			__m128 dx = _mm_sub_ps(px, _mm_set1_ps(fleeX));
+			__m128 dy = _mm_sub_ps(py, _mm_set1_ps(fleeY));
+			__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			__m128 m = _mm_cmplt_ps(d2, fleeR2);
+			__m128 scale = _mm_div_ps(maxSpeed, _mm_max_ps(_mm_sqrt_ps(d2), eps));
+			fx = _mm_add_ps(fx, _mm_and_ps(m, _mm_mul_ps(flee, _mm_sub_ps(_mm_mul_ps(dx, scale), vx))));
+			fy = _mm_add_ps(fy, _mm_and_ps(m, _mm_mul_ps(flee, _mm_sub_ps(_mm_mul_ps(dy, scale), vy))));
+		}
+		for (size_t o = 0; o < obstacles.size(); o++) {
+			// push out along the line from the center, harder the deeper in
+			const SteeringObstacle &ob = obstacles[o];
+			__m128 reach = _mm_set1_ps(ob.radius + params.avoidDistance);
+			__m128 dx = _mm_sub_ps(px, _mm_set1_ps(ob.x));
+			__m128 dy = _mm_sub_ps(py, _mm_set1_ps(ob.y));
+			__m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			__m128 m = _mm_cmplt_ps(d2, _mm_mul_ps(reach, reach));
+			if (_mm_movemask_ps(m) == 0)
+				continue;						// none of the four is near
+			__m128 len = _mm_sqrt_ps(d2);
+			__m128 scale = _mm_and_ps(m, _mm_div_ps(_mm_mul_ps(avoid, _mm_sub_ps(reach, len)), _mm_max_ps(len, eps)));
+			fx = _mm_add_ps(fx, _mm_mul_ps(dx, scale));
+			fy = _mm_add_ps(fy, _mm_mul_ps(dy, scale));
+		}
+
+		__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(fx, fx), _mm_mul_ps(fy, fy)));
+		__m128 scale = _mm_min_ps(one, _mm_div_ps(maxForce, _mm_max_ps(len, eps)));
+		vx = _mm_add_ps(vx, _mm_mul_ps(_mm_mul_ps(fx, scale), dt));
+		vy = _mm_add_ps(vy, _mm_mul_ps(_mm_mul_ps(fy, scale), dt));
+		len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+		scale = _mm_min_ps(one, _mm_div_ps(maxSpeed, _mm_max_ps(len, eps)));
+		vx = _mm_mul_ps(vx, scale);
+		vy = _mm_mul_ps(vy, scale);
+		_mm_store_ps(velX + i, vx);
+		_mm_store_ps(velY + i, vy);
+		_mm_store_ps(posX + i, _mm_add_ps(px, _mm_mul_ps(vx, dt)));
+		_mm_store_ps(posY + i, _mm_add_ps(py, _mm_mul_ps(vy, dt)));
+	}
+}
+
+//=============================================================================
+// Steer and move all agents
+//=============================================================================
+void Flock::update(float frameTime, JobSystem *jobs) {
+	if (count == 0)
+		return;
+	sort();
+	memset(pairs, 0, sizeof(pairs));
+
+	// round up to whole SIMD steps, slots past count are harmless scratch
+	int end = (count + flockNS::SIMD_WIDTH - 1) & ~(flockNS::SIMD_WIDTH - 1);
+	if (jobs)
+		jobs->parallelFor(end, flockNS::JOB_GRAIN, [this, frameTime](int begin, int last, int worker) {
+			step(begin, last, worker, frameTime);
+		});
+	else
+		step(0, end, 0, frameTime);
+}
+
+//=============================================================================
+// Move images to their agents
+// Agents are visited in id order, so images kept in id order are written
+// in memory order; the agent arrays are small enough to stay in cache.
+// Agents that are not moving keep the image's angle.
+//=============================================================================
+void Flock::writeImages(Image *const *images, JobSystem *jobs) const {
+	auto write = [this, images](int begin, int end, int) {
+		for (int id = begin; id < end; id++) {
+			int s = slots[id];
+			Image *image = images[id];
+			if (s == flockNS::NONE || image == NULL)
+				continue;
+			float vx = velX[s], vy = velY[s];
+			float angle = (vx == 0 && vy == 0) ? image->getRadians() : atan2f(vx, -vy);	// 0 is up
+			image->setPose(posX[s], posY[s], angle);
+		}
+	};
+	if (jobs)
+		jobs->parallelFor(capacity, flockNS::JOB_GRAIN, write);
+	else
+		write(0, capacity, 0);
+}
+
+//=============================================================================
+// Return neighbours counted by the last update
+//=============================================================================
+UINT64 Flock::getNeighborPairs() const {
+	UINT64 n = 0;
+	for (int i = 0; i < jobSystemNS::MAX_THREADS; i++)
+		n += pairs[i];
+	return n;
+}
@@ -0,0 +1,190 @@
+#ifndef _FLOCK_H
+#define _FLOCK_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+#include "jobSystem.h"
+
+class Image;
+
+namespace flockNS {
+	const int   SIMD_WIDTH = 4;			// floats per SSE register
+	const int   JOB_GRAIN = 1024;		// agents per job chunk, multiple of SIMD_WIDTH
+	const int   MAX_OBSTACLES = 64;
+	const int   HASH_ROW = 256;			// hash cells per row of grid cells, a power of 2
+	const int   NONE = -1;				// no agent
+}
+
+// How the agents of a Flock steer. Each behaviour gives a desired velocity;
+// its steering force is the desired velocity less the current one, times
+// its weight. Distances are in pixels, speeds in pixels per second.
+struct SteeringParams {
+	float   neighborRadius;		// agents closer than this are neighbours
+	float   separationRadius;	// neighbours closer than this are pushed away from
+	float   separation;			// weight of moving away from close neighbours
+	float   alignment;			// weight of matching the neighbours' heading
+	float   cohesion;			// weight of moving toward the neighbours' center
+	float   seek;				// weight of moving toward the seek target
+	float   flee;				// weight of moving away from the flee target
+	float   fleeRadius;			// agents farther than this from the flee target ignore it
+	float   avoid;				// weight of moving away from obstacles
+	float   avoidDistance;		// agents start avoiding this far from an obstacle's edge
+	float   maxSpeed;
+	float   maxForce;			// largest change of velocity, pixels per second squared
+
+	SteeringParams() : neighborRadius(48), separationRadius(20), separation(2.0f),
+		alignment(1.0f), cohesion(0.5f), seek(0.5f), flee(2.0f), fleeRadius(150),
+		avoid(3.0f), avoidDistance(40), maxSpeed(120), maxForce(400) {}
+};
+
+// A circle agents steer around
+struct SteeringObstacle {
+	float   x, y;
+	float   radius;
+};
+
+// Steers crowds of agents with separation, alignment, cohesion, seek, flee
+// and obstacle avoidance. Agents are stored as structure of arrays. Each
+// update they are sorted by the cell of a spatial hash with cells
+// neighborRadius wide, so an agent's neighbours are in the 9 cells around
+// it, and agents of one row of 3 cells are next to each other in memory.
+// Neighbours are summed four at a time with SSE2, and seek, flee, avoidance and
+// integration run four agents at a time.
+// Agents are read from one set of arrays and written to another, so every
+// agent sees its neighbours where they were at the start of the update,
+// and the update can be split between JobSystem threads with the same
+// result as on one thread.
+// Agents keep their id while their storage slot moves with the sort.
+class Flock {
+private:
+	int         capacity;			// maximum agents, multiple of SIMD_WIDTH
+	int         count;				// live agents
+
+	// agent arrays in hash order, 16 byte aligned, capacity + SIMD_WIDTH
+	// entries each so neighbour sums can read four past the end
+	float       *posX, *posY;		// center location
+	float       *velX, *velY;		// pixels per second
+	float       *sortX, *sortY;		// the same, sorted by update()
+	float       *sortVelX, *sortVelY;
+	float       *forceX, *forceY;	// steering from neighbours, this update
+	int         *ids, *sortIds;		// id of the agent in each slot
+	int         *slots;				// slot of each id, NONE if free
+	UINT        *keys;				// hash cell of each slot
+	int         *cellStart;			// first sorted slot of each hash cell, then count
+	UINT        hashMask;			// hash cells - 1, a power of 2 less one
+	std::vector<int> freeIds;		// ids of removed agents
+
+	SteeringParams params;
+	std::vector<SteeringObstacle> obstacles;
+	float       seekX, seekY;		// seek target
+	float       fleeX, fleeY;		// flee target
+	bool        seeking, fleeing;	// true while a target is set
+	UINT64      pairs[jobSystemNS::MAX_THREADS];	// neighbours counted by each worker this update
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return the hash cell of grid cell cx, cy. Cells of a row are next to
+	// each other in the hash, and grid cells HASH_ROW apart share one.
+	UINT hash(int cx, int cy) const {
+		return ((UINT)cy * flockNS::HASH_ROW + (UINT)cx) & hashMask;
+	}
+
+	// Sort agents into sort arrays by hash cell.
+	void sort();
+
+	// Steer agents [begin, end) from the sort arrays into the agent arrays.
+	// begin is a multiple of SIMD_WIDTH.
+	void step(int begin, int end, int worker, float frameTime);
+
+	// Sum the neighbours of sorted slot s into forceX[s], forceY[s].
+	// Returns the number of neighbours.
+	int flockForce(int s);
+
+	// Free the agent arrays.
+	void freeArrays();
+
+	// Flocks own aligned arrays, so they are not copied
+	Flock(const Flock&);
+	Flock& operator=(const Flock&);
+
+public:
+	// Constructor
+	Flock();
+
+	// Destructor
+	virtual ~Flock();
+
+	// Allocate storage for maxAgents agents.
+	// Post: returns false if out of memory
+	bool initialize(int maxAgents);
+
+	// Add an agent at x, y moving at vx, vy. Returns its id, or NONE if the
+	// flock is full. Ids of removed agents are reused.
+	int add(float x, float y, float vx = 0, float vy = 0);
+
+	// Remove agent id. Returns false if there is no such agent.
+	bool remove(int id);
+
+	// Remove all agents.
+	void clear();
+
+	// Set how agents steer. separationRadius is kept no larger than
+	// neighborRadius.
+	void setParams(const SteeringParams &p);
+
+	// Return how agents steer.
+	const SteeringParams& getParams() const { return params; }
+
+	// Steer all agents toward x, y.
+	void setSeekTarget(float x, float y) { seekX = x; seekY = y; seeking = true; }
+
+	// Stop seeking.
+	void clearSeekTarget() { seeking = false; }
+
+	// Steer agents within fleeRadius away from x, y.
+	void setFleeTarget(float x, float y) { fleeX = x; fleeY = y; fleeing = true; }
+
+	// Stop fleeing.
+	void clearFleeTarget() { fleeing = false; }
+
+	// Add a circle to steer around. Returns false if there are MAX_OBSTACLES.
+	bool addObstacle(float x, float y, float radius);
+
+	// Remove all obstacles.
+	void clearObstacles() { obstacles.clear(); }
+
+	// Steer and move all agents over frameTime.
+	// jobs = NULL to update on the calling thread.
+	void update(float frameTime, JobSystem *jobs = NULL);
+
+	// Move images[id] to each agent, centered and turned to its heading.
+	// 0 radians is up as in Image. images has getCapacity() entries, which
+	// may be NULL.
+	void writeImages(Image *const *images, JobSystem *jobs = NULL) const;
+
+	// Return center x of agent id.
+	float getX(int id) const { return posX[slots[id]]; }
+
+	// Return center y of agent id.
+	float getY(int id) const { return posY[slots[id]]; }
+
+	// Return x velocity of agent id.
+	float getVelocityX(int id) const { return velX[slots[id]]; }
+
+	// Return y velocity of agent id.
+	float getVelocityY(int id) const { return velY[slots[id]]; }
+
+	// Return true if id is a live agent.
+	bool isAgent(int id) const { return id >= 0 && id < capacity && slots[id] != flockNS::NONE; }
+
+	// Return number of live agents.
+	int getCount() const { return count; }
+
+	// Return maximum number of agents.
+	int getCapacity() const { return capacity; }
+
+	// Return neighbours counted by the last update, each pair twice.
+	UINT64 getNeighborPairs() const;
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include "flowField.h"
+#include <algorithm>
+#include <functional>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+FlowGrid::FlowGrid() {
+	width = 0;
+	height = 0;
+	tilesX = 0;
+	tilesY = 0;
+	cellSize = 1.0f;
+	fieldCount = 0;
+	uses = 0;
+	for (int i = 0; i < flowNS::MAX_FIELDS; i++) {
+		fields[i].goalX = flowNS::NONE;
+		fields[i].goalY = flowNS::NONE;
+		fields[i].width = 0;
+		fields[i].lastUsed = 0;
+	}
+	resetStats();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+FlowGrid::~FlowGrid() {}
+
+//=============================================================================
+// Make a w x h grid with room for maxFields fields
+// All storage is allocated here, so building and updating fields make no
+// heap calls once the Dijkstra queues have grown to their largest.
+//=============================================================================
+bool FlowGrid::initialize(int w, int h, float size, int maxFields) {
+	using namespace flowNS;
+	width = w;
+	height = h;
+	cellSize = size;
+	tilesX = (w + TILE - 1) / TILE;
+	tilesY = (h + TILE - 1) / TILE;
+	fieldCount = (maxFields < 1) ? 1 : (maxFields > MAX_FIELDS) ? MAX_FIELDS : maxFields;
+	uses = 0;
+	int cells = w * h;
+	int tiles = tilesX * tilesY;
+	try {
+		costs.assign(cells, 1);
+		for (int i = 0; i < MAX_FIELDS; i++) {
+			fields[i].goalX = NONE;
+			fields[i].goalY = NONE;
+			fields[i].width = w;
+			fields[i].lastUsed = 0;
+			fields[i].integration.assign((i < fieldCount) ? cells : 0, UNREACHABLE);
+			fields[i].directions.assign((i < fieldCount) ? cells : 0, NO_DIRECTION);
+		}
+		changed.clear();
+		changed.reserve(TILE * TILE);
+		tileActive.assign(tiles, 0);
+		tileResult.assign(tiles, 0);
+		tileDirty.assign(tiles, 0);
+		phaseTiles.reserve(tiles);
+		for (int i = 0; i < jobSystemNS::MAX_THREADS; i++)
+			heaps[i].reserve(TILE * TILE * 2);
+		cleared.reserve(TILE * TILE);
+	}
+	catch (...) {
+		costs.clear();
+		for (int i = 0; i < MAX_FIELDS; i++) {
+			fields[i].integration.clear();
+			fields[i].directions.clear();
+		}
+		width = height = tilesX = tilesY = 0;
+		return false;
+	}
+	resetStats();
+	return true;
+}
+
+//=============================================================================
+// Set the cost to enter a cell
+// The change is only recorded while fields are cached, since a new field is
+// built from the costs as they are.
+//=============================================================================
+void FlowGrid::setCost(int x, int y, BYTE cost) {
+	if (x < 0 || y < 0 || x >= width || y >= height)
+		return;
+	if (cost == 0)
+		cost = 1;
+	int c = y * width + x;
+	if (costs[c] == cost)
+		return;
+	costs[c] = cost;
+	for (int i = 0; i < fieldCount; i++) {
+		if (fields[i].goalX != flowNS::NONE) {
+			changed.push_back(c);
+			return;
+		}
+	}
+}
+
+//=============================================================================
+// Bring cached fields up to date with cost changes
+// A field whose goal cell changed is built again; the others are only
+// solved again where paths ran through changed cells.
+//=============================================================================
+void FlowGrid::update(JobSystem *jobs) {
+	if (changed.empty())
+		return;
+	for (int i = 0; i < fieldCount; i++) {
+		FlowField &f = fields[i];
+		if (f.goalX == flowNS::NONE)
+			continue;
+		int goal = f.goalY * width + f.goalX;
+		if (std::find(changed.begin(), changed.end(), goal) != changed.end()) {
+			build(f, jobs);
+			continue;
+		}
+		invalidate(f);
+		solve(f, jobs);
+		fieldsUpdated++;
+	}
+	changed.clear();
+}
+
+//=============================================================================
+// Return the field toward a goal, building it if it is not cached
+//=============================================================================
+const FlowField* FlowGrid::getField(int goalX, int goalY, JobSystem *jobs) {
+	if (goalX < 0 || goalY < 0 || goalX >= width || goalY >= height)
+		return NULL;
+	update(jobs);
+	uses++;
+	FlowField *f = NULL;
+	for (int i = 0; i < fieldCount; i++) {
+		if (fields[i].goalX == goalX && fields[i].goalY == goalY) {
+			fields[i].lastUsed = uses;
+			return &fields[i];
+		}
+		if (f == NULL || fields[i].goalX == flowNS::NONE ||
+			(f->goalX != flowNS::NONE && fields[i].lastUsed < f->lastUsed))
+			f = &fields[i];					// unused, or least recently used
+	}
+	f->goalX = goalX;
+	f->goalY = goalY;
+	f->lastUsed = uses;
+	build(*f, jobs);
+	return f;
+}
+
+//=============================================================================
+// Drop all cached fields
+//=============================================================================
+void FlowGrid::clearFields() {
+	for (int i = 0; i < fieldCount; i++) {
+		fields[i].goalX = flowNS::NONE;
+		fields[i].goalY = flowNS::NONE;
+	}
+	changed.clear();
+}
+
+//=============================================================================
+// Clear a field and solve it from its goal
+//=============================================================================
+void FlowGrid::build(FlowField &f, JobSystem *jobs) {
+	using namespace flowNS;
+	std::fill(f.integration.begin(), f.integration.end(), UNREACHABLE);
+	int goal = f.goalY * width + f.goalX;
+	f.integration[goal] = 0;
+	tileActive[tileOf(goal)] = 1;
+	std::fill(tileDirty.begin(), tileDirty.end(), 1);
+	solve(f, jobs);
+	fieldsBuilt++;
+}
+
+//=============================================================================
+// Mark a tile and its 8 neighbours for rebuilding directions
+//=============================================================================
+void FlowGrid::markDirty(int t) {
+	int tx = t % tilesX, ty = t / tilesX;
+	for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, tilesY - 1); y++)
+		for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, tilesX - 1); x++)
+			tileDirty[y * tilesX + x] = 1;
+}
+
+//=============================================================================
+// Clear the cells whose paths ran through changed cells
+// A cell's path ran through a neighbour if its integration is the
+// neighbour's old integration plus its own cost. Such cells are cleared in
+// turn, breadth first, and the tiles they are in are activated. Cells on a
+// path of the same cost that avoids the changed cells are cleared too,
+// which costs time but not correctness, as solving finds them again.
+//=============================================================================
+void FlowGrid::invalidate(FlowField &f) {
+	using namespace flowNS;
+	UINT *v = &f.integration[0];
+	cleared.clear();
+	for (size_t i = 0; i < changed.size(); i++) {
+		int c = changed[i];
+		Node n = { v[c], (UINT)c };
+		cleared.push_back(n);
+		v[c] = UNREACHABLE;
+	}
+	for (size_t i = 0; i < cleared.size(); i++) {
+		int c = (int)cleared[i].cell;
+		int t = tileOf(c);
+		if (!tileActive[t]) {
+			tileActive[t] = 1;
+			markDirty(t);
+		}
+		UINT old = cleared[i].cost;
+		if (old == UNREACHABLE)
+			continue;							// nothing went through it
+		int x = c % width, y = c / width;
+		for (int d = 0; d < 8; d += 2) {		// up, right, down, left
+			int nx = x + DX[d], ny = y + DY[d];
+			if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+				continue;
+			int n = ny * width + nx;
+			if (v[n] == UNREACHABLE || costs[n] == WALL || v[n] != old + costs[n])
+				continue;
+			Node node = { v[n], (UINT)n };
+			cleared.push_back(node);
+			v[n] = UNREACHABLE;
+		}
+	}
+}
+
+//=============================================================================
+// Solve active tiles until none is active
+// Each pass solves the active tiles of one checkerboard colour, at once on
+// JobSystem threads, then activates the neighbours across the edges that
+// changed. Tiles of one colour share no edge, and a tile reads only the
+// cells across its edges, so no tile reads cells another is writing.
+// Directions are rebuilt once the integration is final.
+//=============================================================================
+void FlowGrid::solve(FlowField &f, JobSystem *jobs) {
+	using namespace flowNS;
+	int tiles = tilesX * tilesY;
+	for (;;) {
+		bool any = false;
+		for (int colour = 0; colour < 2; colour++) {
+			phaseTiles.clear();
+			for (int t = 0; t < tiles; t++) {
+				if (tileActive[t] && ((t % tilesX + t / tilesX) & 1) == colour) {
+					tileActive[t] = 0;
+					phaseTiles.push_back(t);
+				}
+			}
+			if (phaseTiles.empty())
+				continue;
+			any = true;
+			int n = (int)phaseTiles.size();
+			tilesSolved += n;
+			if (jobs)
+				jobs->parallelFor(n, 1, [this, &f](int begin, int end, int worker) {
+					for (int i = begin; i < end; i++)
+						tileResult[phaseTiles[i]] = solveTile(f, phaseTiles[i], worker);
+				});
+			else
+				for (int i = 0; i < n; i++)
+					tileResult[phaseTiles[i]] = solveTile(f, phaseTiles[i], 0);
+
+			for (int i = 0; i < n; i++) {
+				int t = phaseTiles[i];
+				BYTE r = tileResult[t];
+				int tx = t % tilesX, ty = t / tilesX;
+				if ((r & EDGE_UP) && ty > 0)
+					tileActive[t - tilesX] = 1;
+				if ((r & EDGE_DOWN) && ty < tilesY - 1)
+					tileActive[t + tilesX] = 1;
+				if ((r & EDGE_LEFT) && tx > 0)
+					tileActive[t - 1] = 1;
+				if ((r & EDGE_RIGHT) && tx < tilesX - 1)
+					tileActive[t + 1] = 1;
+				if (r & EDGES)
+					markDirty(t);				// the neighbours' edge cells may turn
+				else if (r & CHANGED)
+					tileDirty[t] = 1;
+			}
+		}
+		if (!any)
+			break;
+	}
+
+	phaseTiles.clear();
+	for (int t = 0; t < tiles; t++) {
+		if (tileDirty[t]) {
+			tileDirty[t] = 0;
+			phaseTiles.push_back(t);
+		}
+	}
+	int n = (int)phaseTiles.size();
+	if (jobs)
+		jobs->parallelFor(n, 1, [this, &f](int begin, int end, int) {
+			for (int i = begin; i < end; i++)
+				buildDirections(f, phaseTiles[i]);
+		});
+	else
+		for (int i = 0; i < n; i++)
+			buildDirections(f, phaseTiles[i]);
+}
+
+//=============================================================================
+// Solve the cells of one tile
+// Edge cells first take cheaper paths through the cells across the edge.
+// Then every cell that can lower an inside neighbour is queued, and
+// Dijkstra's algorithm runs over the tile alone. Only cells that lower a
+// neighbour are queued, so a tile woken by a small change does little work.
+//=============================================================================
+BYTE FlowGrid::solveTile(FlowField &f, int t, int worker) {
+	using namespace flowNS;
+	int x0 = (t % tilesX) * TILE, y0 = (t / tilesX) * TILE;
+	int x1 = std::min(x0 + TILE, width), y1 = std::min(y0 + TILE, height);
+	UINT *v = &f.integration[0];
+	const BYTE *cost = &costs[0];
+	std::vector<Node> &heap = heaps[worker];
+	std::greater<Node> later;
+	heap.clear();
+	BYTE result = 0;
+
+	// Edge bits of cell x, y
+	auto edges = [x0, y0, x1, y1](int x, int y) -> BYTE {
+		return (BYTE)(CHANGED | ((y == y0) ? EDGE_UP : 0) | ((y == y1 - 1) ? EDGE_DOWN : 0) |
+			((x == x0) ? EDGE_LEFT : 0) | ((x == x1 - 1) ? EDGE_RIGHT : 0));
+	};
+	// Lower cell x, y to a path through cell nx, ny across the edge
+	auto pull = [&](int x, int y, int nx, int ny) {
+		if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+			return;
+		int c = y * width + x;
+		UINT nv = v[ny * width + nx];
+		if (nv == UNREACHABLE || cost[c] == WALL || nv + cost[c] >= v[c])
+			return;
+		v[c] = nv + cost[c];
+		result |= edges(x, y);
+	};
+	for (int x = x0; x < x1; x++) {
+		pull(x, y0, x, y0 - 1);
+		pull(x, y1 - 1, x, y1);
+	}
+	for (int y = y0; y < y1; y++) {
+		pull(x0, y, x0 - 1, y);
+		pull(x1 - 1, y, x1, y);
+	}
+
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			int c = y * width + x;
+			UINT cv = v[c];
+			if (cv == UNREACHABLE)
+				continue;
+			if ((y > y0 && v[c - width] > cv + cost[c - width] && cost[c - width] != WALL) ||
+				(y < y1 - 1 && v[c + width] > cv + cost[c + width] && cost[c + width] != WALL) ||
+				(x > x0 && v[c - 1] > cv + cost[c - 1] && cost[c - 1] != WALL) ||
+				(x < x1 - 1 && v[c + 1] > cv + cost[c + 1] && cost[c + 1] != WALL)) {
+				Node n = { cv, (UINT)c };
+				heap.push_back(n);
+			}
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), later);
+
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), later);
+		Node n = heap.back();
+		heap.pop_back();
+		int c = (int)n.cell;
+		if (n.cost > v[c])
+			continue;							// lowered again since it was queued
+		int x = c % width, y = c / width;
+		for (int d = 0; d < 8; d += 2) {		// up, right, down, left
+			int nx = x + DX[d], ny = y + DY[d];
+			if (nx < x0 || ny < y0 || nx >= x1 || ny >= y1)
+				continue;
+			int m = ny * width + nx;
+			if (cost[m] == WALL || n.cost + cost[m] >= v[m])
+				continue;
+			v[m] = n.cost + cost[m];
+			result |= edges(nx, ny);
+			Node next = { v[m], (UINT)m };
+			heap.push_back(next);
+			std::push_heap(heap.begin(), heap.end(), later);
+		}
+	}
+	return result;
+}
+
+//=============================================================================
+// Rebuild the directions of one tile
+// Each cell points at the neighbour with the lowest integration, an edge
+// neighbour on ties. A diagonal is only taken if neither cell beside it is
+// a wall, so agents do not cut corners.
+//=============================================================================
+void FlowGrid::buildDirections(FlowField &f, int t) {
+	using namespace flowNS;
+	int x0 = (t % tilesX) * TILE, y0 = (t / tilesX) * TILE;
+	int x1 = std::min(x0 + TILE, width), y1 = std::min(y0 + TILE, height);
+	const UINT *v = &f.integration[0];
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			int c = y * width + x;
+			UINT best = v[c];
+			BYTE dir = NO_DIRECTION;
+			if (best != UNREACHABLE && best != 0) {
+				for (int d = 0; d < 8; d += 2) {
+					int nx = x + DX[d], ny = y + DY[d];
+					if (nx >= 0 && ny >= 0 && nx < width && ny < height && v[ny * width + nx] < best) {
+						best = v[ny * width + nx];
+						dir = (BYTE)d;
+					}
+				}
+				for (int d = 1; d < 8; d += 2) {
+					int nx = x + DX[d], ny = y + DY[d];
+					if (nx < 0 || ny < 0 || nx >= width || ny >= height || v[ny * width + nx] >= best)
+						continue;
+					if (costs[y * width + nx] == WALL || costs[ny * width + x] == WALL)
+						continue;
+					best = v[ny * width + nx];
+					dir = (BYTE)d;
+				}
+			}
+			f.directions[c] = dir;
+		}
+	}
+}
+
+//=============================================================================
+// Directions for many agents
+//=============================================================================
+void FlowGrid::getDirections(const FlowField &f, int count, const float *x, const float *y,
+	float *dx, float *dy, JobSystem *jobs) const {
+	if (jobs)
+		jobs->parallelFor(count, flowNS::QUERY_GRAIN, [&](int begin, int end, int) {
+			for (int i = begin; i < end; i++)
+				getDirection(f, x[i], y[i], dx[i], dy[i]);
+		});
+	else
+		for (int i = 0; i < count; i++)
+			getDirection(f, x[i], y[i], dx[i], dy[i]);
+}
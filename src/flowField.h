@@ -0,0 +1,187 @@
+#ifndef _FLOWFIELD_H
+#define _FLOWFIELD_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+#include "jobSystem.h"
+
+namespace flowNS {
+	const int   TILE = 32;					// wavefront tile width and height in cells
+	const BYTE  WALL = 255;					// cost of a cell agents cannot enter
+	const UINT  UNREACHABLE = 0xffffffff;	// integration of a cell with no path to the goal
+	const BYTE  NO_DIRECTION = 8;			// direction at the goal, in walls and where there is no path
+	const int   MAX_FIELDS = 8;				// fields cached, the least recently used is replaced
+	const int   QUERY_GRAIN = 4096;			// agents per job chunk of getDirections()
+	const int   NONE = -1;
+
+	// Results of solving a tile: the edges whose cells changed, and any change
+	const BYTE  EDGE_UP = 1;
+	const BYTE  EDGE_RIGHT = 2;
+	const BYTE  EDGE_DOWN = 4;
+	const BYTE  EDGE_LEFT = 8;
+	const BYTE  EDGES = 15;
+	const BYTE  CHANGED = 16;
+
+	// Cell offsets of the 8 directions, clockwise from up
+	const int   DX[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+	const int   DY[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+	// Unit vector of each direction, then 0,0 for NO_DIRECTION
+	const float DIAGONAL = 0.70710678f;
+	const float DIR_X[9] = { 0, DIAGONAL, 1, DIAGONAL, 0, -DIAGONAL, -1, -DIAGONAL, 0 };
+	const float DIR_Y[9] = { -1, -DIAGONAL, 0, DIAGONAL, 1, DIAGONAL, 0, -DIAGONAL, 0 };
+}
+
+// Paths from every cell of a FlowGrid to one goal cell
+struct FlowField {
+	int         goalX, goalY;			// NONE if the field is unused
+	int         width;
+	std::vector<UINT> integration;		// cost of the cheapest path to the goal from each cell
+	std::vector<BYTE> directions;		// direction of the next cell on that path
+	UINT        lastUsed;				// getField() call that last returned it
+
+	// Return the integration of cell x, y.
+	UINT getIntegration(int x, int y) const { return integration[y * width + x]; }
+
+	// Return the direction of cell x, y, NO_DIRECTION if there is none.
+	BYTE getDirection(int x, int y) const { return directions[y * width + x]; }
+};
+
+// Grid navigation for crowds. Each cell has a cost to enter, 1 to 254, or
+// WALL. A flow field holds, for every cell, the cost of the cheapest path
+// to a goal (the integration field, over 4 neighbours) and the neighbour
+// of the 8 that is cheapest to go on to. Any number of agents steer toward
+// the goal by sampling the field at their positions, instead of searching
+// a path each.
+// Fields are built by a wavefront over TILE square tiles. Each tile solves
+// its cells with Dijkstra's algorithm from the values on its edges, and
+// tiles whose edges changed wake their neighbours. Tiles are solved in two
+// checkerboard phases, so the tiles solved at once on JobSystem threads
+// share no edge. Fields are cached per goal. When costs change, the
+// cells whose paths ran through the changed cells are cleared and only
+// their tiles are solved again.
+class FlowGrid {
+private:
+	// A cell waiting in a tile's Dijkstra queue
+	struct Node {
+		UINT        cost;
+		UINT        cell;
+		bool operator>(const Node &n) const { return cost > n.cost; }
+	};
+
+	int         width, height;		// size in cells
+	int         tilesX, tilesY;		// size in tiles
+	float       cellSize;			// world units per cell
+	std::vector<BYTE> costs;		// cost to enter each cell
+	FlowField   fields[flowNS::MAX_FIELDS];
+	int         fieldCount;			// fields cached at most
+	std::vector<int> changed;		// cells whose cost changed since the fields were updated
+	std::vector<BYTE> tileActive;	// tiles to solve in the current wavefront
+	std::vector<BYTE> tileResult;	// edges of each tile changed by its last solve
+	std::vector<BYTE> tileDirty;	// tiles whose directions are rebuilt after the wavefront
+	std::vector<int> phaseTiles;	// tiles solved in one phase
+	std::vector<Node> heaps[jobSystemNS::MAX_THREADS];	// Dijkstra queue of each worker
+	std::vector<Node> cleared;		// cells cleared by invalidate(), with their old integration
+	UINT        uses;				// getField() calls
+	UINT64      tilesSolved;		// tile solves since resetStats()
+	UINT        fieldsBuilt;		// fields built from scratch since resetStats()
+	UINT        fieldsUpdated;		// fields updated after cost changes since resetStats()
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Solve active tiles until no tile is active, then rebuild the
+	// directions of dirty tiles.
+	void solve(FlowField &f, JobSystem *jobs);
+
+	// Solve the cells of tile t from its edges and its own values.
+	// Returns the tileResult bits of the edges that changed.
+	BYTE solveTile(FlowField &f, int t, int worker);
+
+	// Rebuild the directions of tile t.
+	void buildDirections(FlowField &f, int t);
+
+	// Clear f from the cells changed since the last update and the cells
+	// whose paths ran through them, and activate their tiles.
+	void invalidate(FlowField &f);
+
+	// Clear f and solve it from its goal.
+	void build(FlowField &f, JobSystem *jobs);
+
+	// Mark tile t and its 8 neighbours for rebuilding directions.
+	void markDirty(int t);
+
+	// Return the tile of cell c.
+	int tileOf(int c) const { return (c % width) / flowNS::TILE + (c / width) / flowNS::TILE * tilesX; }
+
+	// Grids own large fields, so they are not copied
+	FlowGrid(const FlowGrid&);
+	FlowGrid& operator=(const FlowGrid&);
+
+public:
+	// Constructor
+	FlowGrid();
+
+	// Destructor
+	virtual ~FlowGrid();
+
+	// Make a w x h grid of cells cellSize world units square, all cost 1,
+	// caching up to maxFields fields, at most MAX_FIELDS.
+	// Post: returns false if out of memory
+	bool initialize(int w, int h, float cellSize, int maxFields = flowNS::MAX_FIELDS);
+
+	// Set the cost to enter cell x, y: 1 to 254, or WALL. Cached fields are
+	// updated on the next getField() or update().
+	void setCost(int x, int y, BYTE cost);
+
+	// Return the cost to enter cell x, y.
+	BYTE getCost(int x, int y) const { return costs[y * width + x]; }
+
+	// Bring cached fields up to date with cost changes.
+	void update(JobSystem *jobs = NULL);
+
+	// Return the field toward cell goalX, goalY, building it if it is not
+	// cached. The field stays valid until a getField() for another goal
+	// replaces it. Costs changed since the last call are applied first.
+	// Returns NULL if the goal is outside the grid.
+	const FlowField* getField(int goalX, int goalY, JobSystem *jobs = NULL);
+
+	// Drop all cached fields.
+	void clearFields();
+
+	// Set dx, dy to the unit direction to steer at world position x, y,
+	// 0,0 at the goal, outside the grid or where there is no path.
+	void getDirection(const FlowField &f, float x, float y, float &dx, float &dy) const {
+		int cx = (int)(x / cellSize), cy = (int)(y / cellSize);
+		BYTE d = (x < 0 || y < 0 || cx >= width || cy >= height) ? flowNS::NO_DIRECTION : f.directions[cy * width + cx];
+		dx = flowNS::DIR_X[d];
+		dy = flowNS::DIR_Y[d];
+	}
+
+	// getDirection() for count agents, split between JobSystem threads if
+	// jobs is not NULL.
+	void getDirections(const FlowField &f, int count, const float *x, const float *y,
+		float *dx, float *dy, JobSystem *jobs = NULL) const;
+
+	// Return width in cells.
+	int getWidth() const { return width; }
+
+	// Return height in cells.
+	int getHeight() const { return height; }
+
+	// Return world units per cell.
+	float getCellSize() const { return cellSize; }
+
+	// Return tile solves since resetStats().
+	UINT64 getTilesSolved() const { return tilesSolved; }
+
+	// Return fields built from scratch since resetStats().
+	UINT getFieldsBuilt() const { return fieldsBuilt; }
+
+	// Return fields updated after cost changes since resetStats().
+	UINT getFieldsUpdated() const { return fieldsUpdated; }
+
+	// Reset statistics.
+	void resetStats() { tilesSolved = 0; fieldsBuilt = 0; fieldsUpdated = 0; }
+};
+
+#endif
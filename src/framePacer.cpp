@@ -0,0 +1,83 @@
+#include "framePacer.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+FramePacer::FramePacer() {
+	initialize(60.0f, 30.0f, 10.0f);
+	active = true;
+	minimized = false;
+	onDemand = false;
+	paused = false;
+	redraw = true;
+	drewLast = true;
+	framesRun = 0;
+	framesDrawn = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+FramePacer::~FramePacer() {}
+
+//=============================================================================
+// Set frame rates
+//=============================================================================
+void FramePacer::initialize(float foreground, float idle, float background) {
+	frameRate = foreground;
+	idleRate = idle;
+	backgroundRate = background;
+}
+
+//=============================================================================
+// Return seconds between frames
+// A game drawn on demand runs at the idle rate after a frame with no
+// changes, and at the full rate while things keep changing or as soon as a
+// redraw is requested, so input is not held back by the idle rate.
+//=============================================================================
+float FramePacer::getInterval() const {
+	if (minimized)
+		return 0;
+	float rate = frameRate;
+	if (!active)
+		rate = backgroundRate;
+	else if (isIdle() && idleRate < rate)
+		rate = idleRate;
+	return 1.0f / rate;
+}
+
+//=============================================================================
+// Return true if frames run slower than the foreground rate
+//=============================================================================
+bool FramePacer::isThrottled() const {
+	return minimized || !active || isIdle();
+}
+
+//=============================================================================
+// Return milli-seconds until the next frame is due
+//=============================================================================
+DWORD FramePacer::getWait(float elapsed) const {
+	if (minimized)
+		return pacerNS::BLOCK;
+	float remaining = getInterval() - elapsed;
+	if (remaining <= 0)
+		return 0;
+	return (DWORD)(remaining * 1000.0f) + 1;	// round up, so the frame is due on waking
+}
+
+//=============================================================================
+// Return true if the frame being run should be drawn
+//=============================================================================
+bool FramePacer::shouldDraw(bool changed) {
+	framesRun++;
+	if (minimized) {					// nothing to see; a redraw stays requested
+		drewLast = false;
+		return false;
+	}
+	bool draw = !(onDemand || paused) || changed || redraw;
+	redraw = false;
+	drewLast = draw;
+	if (draw)
+		framesDrawn++;
+	return draw;
+}
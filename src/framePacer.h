@@ -0,0 +1,100 @@
+#ifndef _FRAMEPACER_H
+#define _FRAMEPACER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+namespace pacerNS {
+	const DWORD BLOCK = INFINITE;		// wait until a window message arrives
+}
+
+// Decides when the game loop runs a frame and whether the frame is drawn,
+// so a game that is idle, in the background or minimized stops using CPU.
+// - Foreground: frames run at the full frame rate.
+// - On demand or paused: a frame is drawn only if something changed or a
+//   redraw was requested. Until then frames run at the idle rate, only to
+//   notice changes, and draw nothing.
+// - Background: frames run at the background rate.
+// - Minimized: no frames run until a window message arrives.
+// The pacer only does arithmetic on elapsed times and flags, so the policy
+// can be driven by a simulated clock.
+class FramePacer {
+private:
+	float       frameRate;				// frames per second in the foreground
+	float       idleRate;				// frames per second while nothing changes
+	float       backgroundRate;			// frames per second without focus
+	bool        active;					// window has focus
+	bool        minimized;
+	bool        onDemand;				// draw only frames where something changed
+	bool        paused;					// game is paused, so nothing moves by itself
+	bool        redraw;					// redraw requested since the last drawn frame
+	bool        drewLast;				// the last frame was drawn
+	UINT        framesRun;
+	UINT        framesDrawn;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return true if frames are drawn on demand and nothing is pending.
+	bool isIdle() const { return (onDemand || paused) && !drewLast && !redraw; }
+
+public:
+	// Constructor
+	FramePacer();
+
+	// Destructor
+	virtual ~FramePacer();
+
+	// Set frame rates in frames per second.
+	void initialize(float foreground, float idle, float background);
+
+	// Set whether the window has focus.
+	void setActive(bool a) { active = a; redraw = true; }
+
+	// Set whether the window is minimized.
+	void setMinimized(bool m) { minimized = m; redraw = true; }
+
+	// Draw only frames where something changed.
+	void setOnDemand(bool d) { onDemand = d; redraw = true; }
+
+	// Set whether the game is paused. Paused games are drawn on demand.
+	void setPaused(bool p) {
+		if (p != paused)
+			redraw = true;
+		paused = p;
+	}
+
+	// Draw the next frame, such as after input or a window repaint.
+	void requestRedraw() { redraw = true; }
+
+	// Return seconds between frames under the current state, 0 when
+	// minimized, as frames then wait for a window message.
+	float getInterval() const;
+
+	// Return true if frames run slower than the foreground rate now.
+	bool isThrottled() const;
+
+	// Return milli-seconds the message loop may wait before the next frame
+	// is due, elapsed seconds after the last one. 0 to run a frame now,
+	// BLOCK to wait for a window message.
+	DWORD getWait(float elapsed) const;
+
+	// Return true if the frame being run should be drawn.
+	// changed = true if game state changed during the frame
+	bool shouldDraw(bool changed);
+
+	// Return number of frames run.
+	UINT getFramesRun() const { return framesRun; }
+
+	// Return number of frames drawn.
+	UINT getFramesDrawn() const { return framesDrawn; }
+
+	// Return true if the window has focus.
+	bool isActive() const { return active; }
+
+	// Return true if the window is minimized.
+	bool isMinimized() const { return minimized; }
+
+	// Return true if frames are drawn on demand.
+	bool isOnDemand() const { return onDemand; }
+};
+
+#endif
@@ -11,6 +11,19 @@ Game::Game() {
 	paused = false;             // game is not paused
 	graphics = NULL;
 	initialized = false;
+	replayFrameTime = 0;
+	benchmark = NULL;
+	perfHud = NULL;
+	hudVisible = false;
+	strictAllocations = false;
+	framesRun = 0;
+	deviceLost = false;
+	dynamicResolution = false;
+	waitTime = 0;
+	paced = false;
+	overdrawVisible = false;
+	overdrawLogTimer = 0;
+	fps = 100;
 }
 
 //=============================================================================
@@ -26,10 +39,28 @@ Game::~Game() {
 //=============================================================================
 LRESULT Game::messageHandler(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 	if (initialized) {
+		// during replay all input comes from the replay file
+		if (input->isReplaying() && msg != WM_DESTROY)
+			return DefWindowProc(hwnd, msg, wParam, lParam);
+
+		// input is drawn promptly when drawing on demand
+		if ((msg >= WM_KEYFIRST && msg <= WM_KEYLAST) ||
+			(msg >= WM_MOUSEFIRST && msg <= WM_MOUSELAST) || msg == WM_INPUT)
+			pacer.requestRedraw();
+
 		switch (msg) {
 		case WM_DESTROY:
 			PostQuitMessage(0);					// tell Windows to kill this program
 			return 0;
+		case WM_ACTIVATE:                       // gained or lost focus
+			pacer.setActive(LOWORD(wParam) != WA_INACTIVE);
+			break;
+		case WM_SIZE:                           // minimized or restored
+			pacer.setMinimized(wParam == SIZE_MINIMIZED);
+			break;
+		case WM_PAINT:                          // window uncovered
+			pacer.requestRedraw();
+			break;
 		case WM_KEYDOWN: case WM_SYSKEYDOWN:    // key down
 			input->keyDown(wParam);
 			return 0;
@@ -75,7 +106,7 @@ LRESULT Game::messageHandler(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 			input->mouseIn(lParam);             // mouse position
 			return 0;
 		case WM_DEVICECHANGE:                   // check for controller insert
-			input->checkControllers();
+			input->onDeviceChange();
 			return 0;
 		}
 	}
@@ -89,6 +120,9 @@ LRESULT Game::messageHandler(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 void Game::initialize(HWND hw) {
 	hwnd = hw;                                  // save window handle
 
+	// diagnostics; the game runs without them if the file cannot be opened
+	logger.initialize(LOG_FILE);
+
 	// initialize graphics
 	graphics = new Graphics();
 	// throws GameError
@@ -97,12 +131,45 @@ void Game::initialize(HWND hw) {
 	// initialize input, do not capture mouse
 	input->initialize(hwnd, false);             // throws GameError
 
+	// start worker threads, one per CPU core
+	jobs.initialize();
+
+	// packed assets, loose files are used if there is no pack
+	assetPack.initialize(ASSET_PACK);
+
+	// scene resolution follows frame time when enabled
+	resolution.initialize(RESOLUTION_FRAME_TIME);
+	setDynamicResolution(DYNAMIC_RESOLUTION);
+
+	// frames slow down when nothing changes or the window is in the background
+	pacer.initialize(FRAME_RATE, IDLE_FRAME_RATE, BACKGROUND_FRAME_RATE);
+	pacer.setOnDemand(ON_DEMAND_RENDERING);
+
+	// textures added to residency share the video memory budget
+	residency.initialize(TEXTURE_BUDGET);
+
+	// per-frame memory
+	if (!frameArena.initialize(memoryNS::FRAME_ARENA_BYTES))
+		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing frame arena"));
+
+	// game timers
+	if (!timers.initialize(MAX_TIMERS))
+		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing timers"));
+	if (!behaviors.initialize(MAX_BEHAVIORS))
+		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing behaviors"));
+
+	// initialize performance HUD
+	perfHud = new PerfHud();
+	if (!perfHud->initialize(graphics))
+		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing performance HUD"));
+
 	// attempt to set up high resolution timer
 	if (QueryPerformanceFrequency(&timerFreq) == false)
 		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing high resolution timer"));
 
 	QueryPerformanceCounter(&timeStart);        // get starting time
 
+	logger.info("game initialized {}x{}, {} worker threads", GAME_WIDTH, GAME_HEIGHT, jobs.getThreadCount());
 	initialized = true;
 }
 
@@ -114,7 +181,23 @@ void Game::renderGame() {
 	if (SUCCEEDED(graphics->beginScene())) {
 		// render is a pure virtual function that must be provided in the
 		// inheriting class.
+		perfStats.beginPhase();
+		if (overdrawVisible)
+			overdraw.clear();
 		render();               // call render in derived class
+		perfStats.endPhase(perfStatsNS::RENDER);
+		if (overdrawVisible && heatmap.analyze(overdraw))
+			logOverdraw();
+		perfStats.setCounts(graphics->getSpriteCount(), graphics->getDrawCallCount(),
+			graphics->getTextureMemory());
+
+		// upscale a reduced resolution scene, then draw the HUD at full resolution
+		graphics->resolveScene();
+
+		// draw performance HUD over the game, in screen pixels
+		graphics->setView(NULL);
+		if (hudVisible)
+			perfHud->draw(perfStats);
 
 		//stop rendering
 		graphics->endScene();
@@ -123,7 +206,9 @@ void Game::renderGame() {
 	handleLostGraphicsDevice();
 
 	//display the back buffer on the screen
+	perfStats.beginPhase();
 	graphics->showBackbuffer();
+	perfStats.endPhase(perfStatsNS::PRESENT);
 }
 
 //=============================================================================
@@ -135,6 +220,9 @@ void Game::handleLostGraphicsDevice() {
 	if (FAILED(hr)) {				// if graphics device is not in a valid state
 		// if the device is lost and not available for reset
 		if (hr == D3DERR_DEVICELOST) {
+			if (!deviceLost)
+				logger.warning("graphics device lost");
+			deviceLost = true;
 			Sleep(100);             // yield cpu time (100 mili-seconds)
 			return;
 		}
@@ -142,12 +230,18 @@ void Game::handleLostGraphicsDevice() {
 		else if (hr == D3DERR_DEVICENOTRESET) {
 			releaseAll();
 			hr = graphics->reset(); // attempt to reset graphics device
-			if (FAILED(hr))         // if reset failed
+			if (FAILED(hr)) {       // if reset failed
+				logger.warning("graphics device reset failed, hr {}", (UINT)hr);
 				return;
+			}
 			resetAll();
+			deviceLost = false;
+			logger.info("graphics device reset");
 		}
-		else
+		else {
+			logger.error("graphics device error, hr {}", (UINT)hr);
 			return;					// other device error
+		}
 	}
 }
 
@@ -155,16 +249,36 @@ void Game::handleLostGraphicsDevice() {
 // Call repeatedly by the main message loop in WinMain
 //=============================================================================
 void Game::run(HWND hwnd) {
+	waitTime = 0;
 	if (graphics == NULL)            // if graphics not initialized
 		return;
+	pacer.setPaused(paused);
 
 	// calculate elapsed time of last frame, save in frameTime
 	QueryPerformanceCounter(&timeEnd);
 	frameTime = (float)(timeEnd.QuadPart - timeStart.QuadPart) / (float)timerFreq.QuadPart;
 
+	// replayed frames run back to back with the recorded frameTime
+	if (input->isReplaying()) {
+		if (input->replayFinished()) {
+			endReplay();
+			return;
+		}
+		frameTime = (replayFrameTime > 0) ? replayFrameTime : input->getReplayFrameTime();
+		if (benchmark)
+			benchmark->beginFrame();
+	}
+	// idle, in the background or minimized, WinMain waits for messages
+	// until the next frame is due
+	else if (pacer.isThrottled()) {
+		paced = true;
+		waitTime = pacer.getWait(frameTime);
+		if (waitTime > 0)
+			return;
+	}
 	// Power saving code, requires winmm.lib
 	// if not enough time has elapsed for desired frame rate
-	if (frameTime < MIN_FRAME_TIME) {
+	else if (frameTime < MIN_FRAME_TIME) {
 		sleepTime = (DWORD)((MIN_FRAME_TIME - frameTime) * 1000);
 		timeBeginPeriod(1);         // Request 1mS resolution for windows timer
 		Sleep(sleepTime);           // release cpu for sleepTime
@@ -172,29 +286,179 @@ void Game::run(HWND hwnd) {
 		return;
 	}
 
-	if (frameTime > 0.0)
-		fps = (fps * 0.99f) + (0.01f / frameTime);  // average fps
-
 	if (frameTime > MAX_FRAME_TIME) // if frame rate is very slow
 		frameTime = MAX_FRAME_TIME; // limit maximum frameTime
 
+	if (frameTime > 0.0)
+		fps = (fps * 0.99f) + (0.01f / frameTime);  // average fps
+	// throttled frames, and the first frame after them or after a minimize,
+	// are slow by design, so they are neither spikes nor load for the scaler
+	bool sampled = framesRun > 0 && !paced;
+	paced = !input->isReplaying() && pacer.isThrottled();
+	if (frameTime > SPIKE_FRAME_TIME && sampled)
+		logger.warning("frame spike {} ms", frameTime * 1000.0f);
+	if (dynamicResolution && sampled) {
+		float scale = resolution.update(frameTime);
+		if (scale != graphics->getSceneScale()) {
+			graphics->setSceneScale(scale);
+			logger.info("scene scale {} at {} ms average", scale, resolution.getAverage() * 1000.0f);
+		}
+	}
+
 	timeStart = timeEnd;
+	if (strictAllocations && framesRun >= memoryNS::STRICT_WARMUP_FRAMES)
+		memoryNS::setStrict(true);  // steady state, heap allocations are errors
+	input->beginFrame();            // apply replayed input
 
 	// update(), ai(), and collisions() are pure virtual functions.
 	// These functions must be provided in the class that inherits from Game.
 	if (!paused) {
+		perfStats.beginPhase();
+		timers.advance(frameTime);  // call game timers that are due
 		update();                   // update all game items
+		perfStats.endPhase(perfStatsNS::UPDATE);
+		perfStats.beginPhase();
+		behaviors.update(frameTime); // resume behaviors that are due
 		ai();                       // artificial intelligence
+		perfStats.endPhase(perfStatsNS::AI);
+		perfStats.beginPhase();
 		collisions();               // handle collisions
+		perfStats.endPhase(perfStatsNS::COLLISIONS);
 		input->vibrateControllers(frameTime); // handle controller vibration
 	}
 
-	renderGame();                   // draw all game items
-	input->readControllers();       // read state of controllers
+	if (input->wasKeyPressed(HUD_KEY))  // show or hide performance HUD
+		hudVisible = !hudVisible;
+	if (input->wasKeyPressed(OVERDRAW_KEY)) // show or hide overdraw heatmap
+		setOverdrawVisible(!overdrawVisible);
+
+	// when drawing on demand, frames where nothing changed are not drawn
+	bool changed = imageNS::takeChanged() || hudVisible;
+	if (input->isReplaying() || pacer.shouldDraw(changed))
+		renderGame();               // draw all game items
+	else
+		handleLostGraphicsDevice();
+	perfStats.endFrame(frameTime, fps);
+	input->readControllers(frameTime); // read state of controllers
 
 	// Clear input
 	// Call this after all key checks are done
 	input->clear(inputNS::KEYS_PRESSED);
+	input->endFrame(frameTime);
+
+	residency.endFrame();           // reload evicted textures drawn this frame, on the device thread
+	memoryNS::setStrict(false);
+	frameArena.reset();             // free this frame's transient data, growing it outside strict mode
+	framesRun++;
+
+	if (benchmark && input->isReplaying())
+		benchmark->endFrame();
+}
+
+//=============================================================================
+// Turn dynamic resolution on or off
+//=============================================================================
+void Game::setDynamicResolution(bool on) {
+	dynamicResolution = on;
+	if (graphics)
+		graphics->setSceneScale(on ? resolution.getScale() : 1.0f);
+}
+
+//=============================================================================
+// Show or hide the overdraw heatmap
+// The rasterizer is only created the first time it is shown.
+//=============================================================================
+void Game::setOverdrawVisible(bool v) {
+	if (v && overdraw.getWidth() == 0 && !overdraw.initialize(GAME_WIDTH, GAME_HEIGHT)) {
+		logger.warning("no memory for the overdraw heatmap");
+		v = false;
+	}
+	overdrawVisible = v;
+	overdrawLogTimer = 0;
+	if (graphics)
+		graphics->setOverdrawView(v);
+	pacer.requestRedraw();
+}
+
+//=============================================================================
+// Log the fill totals of the overdraw heatmap
+// Sprite ids are the order sprites were submitted to the DrawList.
+//=============================================================================
+void Game::logOverdraw() {
+	overdrawLogTimer -= frameTime;
+	if (overdrawLogTimer > 0)
+		return;
+	overdrawLogTimer = OVERDRAW_LOG_INTERVAL;
+	const HeatmapStats &stats = heatmap.getStats();
+	logger.info("overdraw {}x, {} shaded, {} written, {} hidden by depth, at most {} at one pixel",
+		stats.overdraw, stats.shaded, stats.written, stats.rejected, stats.maxCount);
+	for (int i = 0; i < stats.topCount; i++)
+		logger.info("overdraw sprite {} shaded {}", stats.top[i].id, stats.top[i].shaded);
+}
+
+//=============================================================================
+// Load all registered assets
+// throws GameError on error
+//=============================================================================
+void Game::loadAssets() {
+	bool loaded = assets.load(graphics, getAssetPack(), &jobs, [this](int done, int total, const char *name) {
+		loadingProgress(done, total, name);
+	});
+	if (!loaded) {
+		logger.error("error loading {}", assets.getFailed());
+		throw(GameError(gameErrorNS::FATAL_ERROR, std::string("Error loading ") + assets.getFailed()));
+	}
+	logger.info("loaded {} assets", assets.getCount());
+}
+
+//=============================================================================
+// Write the asset loading timeline
+// throws GameError on error
+//=============================================================================
+void Game::writeStartupTimeline(const char *file) {
+	if (!assets.writeTimeline(file))
+		throw(GameError(gameErrorNS::WARNING, std::string("Error writing startup timeline ") + file));
+}
+
+//=============================================================================
+// Record all input to file
+//=============================================================================
+void Game::startRecording(const char *file) {
+	input->startRecording(file);
+}
+
+//=============================================================================
+// Replace live input with a recorded replay
+// throws GameError on error
+//=============================================================================
+void Game::startReplay(const char *file, float fixedFrameTime) {
+	if (!input->startPlayback(file))
+		throw(GameError(gameErrorNS::FATAL_ERROR, std::string("Error loading replay ") + file));
+	replayFrameTime = fixedFrameTime;
+}
+
+//=============================================================================
+// Run a replay and time every frame
+// throws GameError on error
+//=============================================================================
+void Game::startBenchmark(const char *file, const char *report, float fixedFrameTime) {
+	startReplay(file, fixedFrameTime);
+	SAFE_DELETE(benchmark);
+	benchmark = new Benchmark();
+	benchmark->initialize(file);
+	benchmarkReport = report;
+}
+
+//=============================================================================
+// The replay has played its last frame
+//=============================================================================
+void Game::endReplay() {
+	if (benchmark) {
+		if (!benchmark->writeReport(benchmarkReport.c_str()))
+			throw(GameError(gameErrorNS::WARNING, "Error writing benchmark report " + benchmarkReport));
+		SAFE_DELETE(benchmark);
+	}
+	exitGame();
 }
 
 //=============================================================================
@@ -213,6 +477,11 @@ void Game::resetAll() {}
 //=============================================================================
 void Game::deleteAll() {
 	releaseAll();			// call onLostDevice() for every graphics item
+	if (input && input->isRecording())
+		input->stopRecording();			// write the replay file
+	SAFE_DELETE(benchmark);
+	SAFE_DELETE(perfHud);
+	jobs.shutdown();
 	SAFE_DELETE(graphics);
 	SAFE_DELETE(input);
 	initialized = false;
@@ -6,6 +6,21 @@
 #include <mmsystem.h>
 #include "graphics.h"
 #include "input.h"
+#include "benchmark.h"
+#include "perfStats.h"
+#include "perfHud.h"
+#include "jobSystem.h"
+#include "memoryArena.h"
+#include "memoryStats.h"
+#include "assetPack.h"
+#include "assetLoader.h"
+#include "textureResidency.h"
+#include "logger.h"
+#include "resolutionScaler.h"
+#include "framePacer.h"
+#include "overdrawHeatmap.h"
+#include "timerWheel.h"
+#include "behavior.h"
 #include "constants.h"
 #include "gameError.h"
 
@@ -23,6 +38,47 @@ protected:
 	DWORD   sleepTime;          // number of milli-seconds to sleep between frames
 	bool    paused;             // true if game is paused
 	bool    initialized;
+	float   replayFrameTime;    // fixed frameTime during replay, 0 to use recorded times
+	Benchmark *benchmark;       // frame timings of a replay benchmark, NULL if none
+	std::string benchmarkReport; // file written when the benchmark replay ends
+	PerfStats perfStats;        // frame timings and render counts
+	PerfHud *perfHud;           // performance overlay
+	bool    hudVisible;         // true to draw perfHud
+	JobSystem jobs;             // worker threads for parallel updates
+	MemoryArena frameArena;     // per-frame allocations, reset at the end of run()
+	bool    strictAllocations;  // true to forbid heap allocations in steady-state frames
+	UINT    framesRun;          // frames run since initialize()
+	AssetPack assetPack;        // ASSET_PACK, if it exists
+	AssetLoader assets;         // asset manifest filled in by the derived game
+	TextureResidency residency; // evicts textures added to it when over TEXTURE_BUDGET
+	Logger  logger;             // engine diagnostics written to LOG_FILE
+	bool    deviceLost;         // true while waiting to reset the graphics device
+	ResolutionScaler resolution; // scene scale chosen from frame times
+	bool    dynamicResolution;  // true to draw the scene at resolution.getScale()
+	FramePacer pacer;           // throttles frames when idle, in the background or minimized
+	DWORD   waitTime;           // milli-seconds WinMain may wait for messages after run()
+	bool    paced;              // last frame was throttled or waited for, so frameTime is not a load sample
+	bool    overdrawVisible;    // true to show the overdraw heatmap
+	SoftwareRasterizer overdraw; // counts the fill of the scene while overdrawVisible
+	OverdrawHeatmap heatmap;    // fill totals of the last frame drawn with overdrawVisible
+	float   overdrawLogTimer;   // seconds until the fill totals are logged again
+	TimerWheel timers;          // game timers, advanced by frameTime while not paused
+	BehaviorScheduler behaviors; // per-entity behaviors, resumed before ai() while not paused
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Called when a replay has played its last frame.
+	void endReplay();
+
+	// Load everything registered in assets, reading files on worker threads.
+	// Call from initialize() after registering assets.
+	// Throws GameError
+	void loadAssets();
+
+	// Called after each asset loading step. Override to draw a loading screen.
+	virtual void loadingProgress(int done, int total, const char *name) {}
+
+	// Log the fill totals and top sprites of heatmap every OVERDRAW_LOG_INTERVAL.
+	void logOverdraw();
 
 public:
 	// Constructor
@@ -63,9 +119,104 @@ public:
 	// Return pointer to Input.
 	Input* getInput() { return input; }
 
+	// Return worker threads for parallel updates.
+	JobSystem* getJobSystem() { return &jobs; }
+
+	// Return frame timings and render counts.
+	const PerfStats& getPerfStats() const { return perfStats; }
+
+	// Return the asset pack, NULL if ASSET_PACK was not found.
+	// TextureManager::initialize() loads loose files when given NULL.
+	const AssetPack* getAssetPack() const { return assetPack.isOpen() ? &assetPack : NULL; }
+
+	// Draw the scene below screen resolution when frames are slower than
+	// RESOLUTION_FRAME_TIME, upscaled before the HUD is drawn.
+	void setDynamicResolution(bool on);
+
+	// Return the dynamic resolution controller.
+	const ResolutionScaler& getResolution() const { return resolution; }
+
+	// Draw only frames where something drawn changed (Image setters, Camera2D,
+	// ParticleSystem, Tilemap and TransformHierarchy mark changes), input
+	// arrived or a redraw was requested, and run frames at IDLE_FRAME_RATE
+	// in between.
+	void setOnDemandRendering(bool on) { pacer.setOnDemand(on); }
+
+	// Draw the next frame when drawing on demand, for changes nothing marked,
+	// such as a Tilemap drawn at a new view without a Camera2D.
+	void requestRedraw() { pacer.requestRedraw(); }
+
+	// Return milli-seconds the message loop may wait for a message before
+	// calling run() again, pacerNS::BLOCK to wait until one arrives.
+	DWORD getWaitTime() const { return waitTime; }
+
+	// Return the frame pacer.
+	const FramePacer& getPacer() const { return pacer; }
+
+	// Return the diagnostics log.
+	Logger* getLogger() { return &logger; }
+
+	// Return the texture residency manager.
+	TextureResidency* getResidency() { return &residency; }
+
+	// Write the asset loading timeline of loadAssets() as a Chrome trace.
+	// Throws GameError
+	void writeStartupTimeline(const char *file);
+
+	// Return the frame arena. Memory from it is freed at the end of the frame.
+	MemoryArena* getFrameArena() { return &frameArena; }
+
+	// Forbid heap allocations in frames after memoryNS::STRICT_WARMUP_FRAMES.
+	// Each allocation fails an assert in debug builds and is counted in
+	// memoryNS::getStrictViolations().
+	void setStrictAllocations(bool strict) { strictAllocations = strict; }
+
+	// Show or hide the performance HUD. HUD_KEY toggles it.
+	void setHudVisible(bool v) { hudVisible = v; }
+
+	// Show how many times each pixel is written as a heatmap in place of the
+	// scene, and total the fill of each frame drawn in getHeatmap().
+	// OVERDRAW_KEY toggles it.
+	void setOverdrawVisible(bool v);
+
+	// Return the rasterizer that counts the fill of the scene while the
+	// overdraw heatmap is shown, NULL otherwise. Give it to
+	// DrawList::setRasterizer() with the view sprites are drawn with.
+	SoftwareRasterizer* getOverdrawRasterizer() { return overdrawVisible ? &overdraw : NULL; }
+
+	// Return the heatmap and fill totals of the last frame drawn with the
+	// overdraw heatmap shown.
+	const OverdrawHeatmap& getHeatmap() const { return heatmap; }
+
+	// Return the wheel of game timers. It is advanced by frameTime before
+	// update() while the game is not paused, so its callbacks see the
+	// state of the last frame.
+	TimerWheel* getTimers() { return &timers; }
+
+	// Return the scheduler of per-entity behaviors. Behaviors that are due
+	// are resumed before ai() while the game is not paused. Stop a
+	// behavior before the objects it refers to are destroyed.
+	BehaviorScheduler* getBehaviors() { return &behaviors; }
+
 	// Exit the game
 	void exitGame() { PostMessage(hwnd, WM_DESTROY, 0, 0); }
 
+	// Record all input to file until the game exits.
+	// Pre: initialize() has been called
+	void startRecording(const char *file);
+
+	// Replace live input with a recorded replay and run its frames back to back.
+	// The game exits when the replay ends.
+	// fixedFrameTime > 0 overrides the recorded frameTime of every frame.
+	// Throws GameError
+	// Pre: initialize() has been called
+	void startReplay(const char *file, float fixedFrameTime = 0);
+
+	// Run a replay as startReplay() does and write per-frame timings to report.
+	// Throws GameError
+	// Pre: initialize() has been called
+	void startBenchmark(const char *file, const char *report, float fixedFrameTime = 0);
+
 	// Pure virtual function declarations
 	// These functions MUST be written in any class that inherits from Game
 
@@ -1,4 +1,7 @@
 #include "graphics.h"
+#include "opacityMap.h"
+#include <wincodec.h>		// WIC, requires windowscodecs.lib
+#include "overdrawHeatmap.h"
 
 //=============================================================================
 // Constructor
@@ -10,6 +13,19 @@ Graphics::Graphics() {
 	width = GAME_WIDTH;    // width & height are replaced in initialize()
 	height = GAME_HEIGHT;
 	backColor = SETCOLOR_ARGB(255, 0, 0, 128); // dark blue
+	spriteCount = 0;
+	batchCount = 0;
+	batchTexture = NULL;
+	textureMemory = 0;
+	viewSet = false;
+	cameraViewSet = false;
+	sceneTarget = NULL;
+	backBuffer = NULL;
+	sceneScale = 1.0f;
+	sceneBound = false;
+	spriteDepth = 0;
+	overdrawView = false;
+	overdrawShown = false;
 }
 
 //=============================================================================
@@ -23,6 +39,8 @@ Graphics::~Graphics() {
 // Release all
 //=============================================================================
 void Graphics::releaseAll() {
+	SAFE_RELEASE(backBuffer);
+	SAFE_RELEASE(sceneTarget);
 	SAFE_RELEASE(device3d);
 	SAFE_RELEASE(direct3d);
 }
@@ -76,6 +94,9 @@ void Graphics::initialize(HWND hw, int w, int h, bool full) {
 	if (FAILED(result))
 		throw(GameError(gameErrorNS::FATAL_ERROR, "Error creating Direct3D device"));
 
+	// the depth buffer is only used by split sprite passes
+	device3d->SetRenderState(D3DRS_ZENABLE, D3DZB_FALSE);
+
 	result = D3DXCreateSprite(device3d, &sprite);
 
 	if (FAILED(result))
@@ -100,6 +121,8 @@ void Graphics::initD3Dpp() {
 		d3dpp.hDeviceWindow = hwnd;
 		d3dpp.Windowed = (!fullscreen);
 		d3dpp.PresentationInterval = D3DPRESENT_INTERVAL_IMMEDIATE;
+		d3dpp.EnableAutoDepthStencil = TRUE;		// for opaque sprites drawn front to back
+		d3dpp.AutoDepthStencilFormat = D3DFMT_D24S8;	// stencil counts pixel writes for the overdraw view
 	}
 	catch (...) {
 		throw(GameError(gameErrorNS::FATAL_ERROR,
@@ -108,7 +131,7 @@ void Graphics::initD3Dpp() {
 }
 
 HRESULT Graphics::loadTexture(const char *filename, COLOR_ARGB transcolor,
-	UINT &width, UINT &height, LP_TEXTURE &texture) {
+	UINT &width, UINT &height, LP_TEXTURE &texture, OpacityMap *map) {
 	// The struct for reading file info
 	D3DXIMAGE_INFO info;
 	result = E_FAIL;
@@ -126,6 +149,16 @@ HRESULT Graphics::loadTexture(const char *filename, COLOR_ARGB transcolor,
 		width = info.Width;
 		height = info.Height;
 
+		if (map) {						// decode once to read the pixels, then copy to video memory
+			LP_TEXTURE staged = NULL;
+			result = D3DXCreateTextureFromFileEx(device3d, filename, info.Width, info.Height,
+				1, 0, D3DFMT_A8R8G8B8, D3DPOOL_SYSTEMMEM, D3DX_DEFAULT, D3DX_DEFAULT, transcolor,
+				&info, NULL, &staged);
+			if (FAILED(result))
+				return result;
+			return uploadTexture(staged, map, texture);
+		}
+
 		// Create the new texture by loading from file
 		result = D3DXCreateTextureFromFileEx(
 			device3d,           // 3D device
@@ -149,6 +182,301 @@ HRESULT Graphics::loadTexture(const char *filename, COLOR_ARGB transcolor,
 	return result;
 }
 
+//=============================================================================
+// Load the texture from an image file in memory
+//=============================================================================
+HRESULT Graphics::loadTextureFromMemory(const void *data, UINT size, COLOR_ARGB transcolor,
+	UINT &width, UINT &height, LP_TEXTURE &texture, OpacityMap *map) {
+	D3DXIMAGE_INFO info;
+	result = E_FAIL;
+
+	try {
+		if (data == NULL) {
+			texture = NULL;
+			return D3DERR_INVALIDCALL;
+		}
+
+		// Get width and height from the image
+		result = D3DXGetImageInfoFromFileInMemory(data, size, &info);
+		if (result != D3D_OK)
+			return result;
+		width = info.Width;
+		height = info.Height;
+
+		if (map) {						// decode once to read the pixels, then copy to video memory
+			LP_TEXTURE staged = NULL;
+			result = D3DXCreateTextureFromFileInMemoryEx(device3d, data, size, info.Width, info.Height,
+				1, 0, D3DFMT_A8R8G8B8, D3DPOOL_SYSTEMMEM, D3DX_DEFAULT, D3DX_DEFAULT, transcolor,
+				&info, NULL, &staged);
+			if (FAILED(result))
+				return result;
+			return uploadTexture(staged, map, texture);
+		}
+
+		result = D3DXCreateTextureFromFileInMemoryEx(device3d, data, size, info.Width, info.Height,
+			1, 0, D3DFMT_UNKNOWN, D3DPOOL_DEFAULT, D3DX_DEFAULT, D3DX_DEFAULT, transcolor,
+			&info, NULL, &texture);
+	}
+	catch (...) {
+		throw(GameError(gameErrorNS::FATAL_ERROR, "Error in Graphics::loadTextureFromMemory"));
+	}
+	return result;
+}
+
+//=============================================================================
+// Create a managed vertex buffer
+//=============================================================================
+HRESULT Graphics::createVertexBuffer(UINT bytes, DWORD fvf, LP_VERTEXBUFFER &vb) {
+	result = device3d->CreateVertexBuffer(bytes, D3DUSAGE_WRITEONLY, fvf, D3DPOOL_MANAGED, &vb, NULL);
+	return result;
+}
+
+//=============================================================================
+// Create a managed 16 bit index buffer
+//=============================================================================
+HRESULT Graphics::createIndexBuffer(UINT count, LP_INDEXBUFFER &ib) {
+	result = device3d->CreateIndexBuffer(count * sizeof(WORD), D3DUSAGE_WRITEONLY, D3DFMT_INDEX16,
+		D3DPOOL_MANAGED, &ib, NULL);
+	return result;
+}
+
+//=============================================================================
+// Set up drawing of textured geometry in screen pixels
+//=============================================================================
+void Graphics::setScreenTransform(float viewX, float viewY) {
+	D3DXMATRIX viewMatrix;
+	D3DXMatrixTranslation(&viewMatrix, -viewX, -viewY, 0.0f);
+	setScreenTransform(viewMatrix);
+}
+
+//=============================================================================
+// Set up drawing of textured geometry through a view matrix
+//=============================================================================
+void Graphics::setScreenTransform(const D3DXMATRIX &viewMatrix) {
+	D3DXMATRIX world, view, projection;
+	// -0.5 lines texels up with pixels
+	world = viewMatrix;
+	if (sceneBound) {					// screen pixels to scene pixels
+		D3DXMATRIX scaling;
+		D3DXMatrixScaling(&scaling, sceneScale, sceneScale, 1.0f);
+		D3DXMatrixMultiply(&world, &world, &scaling);
+	}
+	world._41 -= 0.5f;
+	world._42 -= 0.5f;
+	D3DXMatrixIdentity(&view);
+	D3DXMatrixOrthoOffCenterLH(&projection, 0.0f, (float)width, (float)height, 0.0f, 0.0f, 1.0f);
+	device3d->SetTransform(D3DTS_WORLD, &world);
+	device3d->SetTransform(D3DTS_VIEW, &view);
+	device3d->SetTransform(D3DTS_PROJECTION, &projection);
+
+	device3d->SetRenderState(D3DRS_LIGHTING, FALSE);
+	device3d->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+	device3d->SetRenderState(D3DRS_ZENABLE, D3DZB_FALSE);
+	device3d->SetRenderState(D3DRS_ALPHABLENDENABLE, TRUE);
+	device3d->SetRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+	device3d->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+	device3d->SetTextureStageState(0, D3DTSS_ALPHAOP, D3DTOP_MODULATE);	// vertex color alpha
+	device3d->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_POINT);
+	device3d->SetSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_POINT);
+}
+
+//=============================================================================
+// Draw indexed quads from static buffers
+//=============================================================================
+void Graphics::drawQuads(LP_TEXTURE texture, LP_VERTEXBUFFER vb, LP_INDEXBUFFER ib, UINT quads) {
+	if (quads == 0)
+		return;
+	device3d->SetFVF(QUADVERTEX_FVF);
+	device3d->SetStreamSource(0, vb, 0, sizeof(QuadVertex));
+	device3d->SetIndices(ib);
+	device3d->SetTexture(0, texture);
+	device3d->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, quads * 4, 0, quads * 2);
+	spriteCount += quads;
+	batchCount++;						// every call is a draw call
+}
+
+//=============================================================================
+// Decode an image file in memory to 32 bit ARGB pixels with WIC
+// WIC's 32bppBGRA is A8R8G8B8 in memory. COM is initialized on the calling
+// thread for the decode if it is not already.
+//=============================================================================
+HRESULT Graphics::decodeImage(const void *data, UINT size, COLOR_ARGB transcolor, DecodedImage &image) {
+	if (data == NULL || size == 0)
+		return D3DERR_INVALIDCALL;
+	HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+	bool uninitialize = SUCCEEDED(hr);		// else COM is already set up another way
+	IWICImagingFactory *factory = NULL;
+	IWICStream *stream = NULL;
+	IWICBitmapDecoder *decoder = NULL;
+	IWICBitmapFrameDecode *frame = NULL;
+	IWICFormatConverter *converter = NULL;
+	hr = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+	if (SUCCEEDED(hr))
+		hr = factory->CreateStream(&stream);
+	if (SUCCEEDED(hr))
+		hr = stream->InitializeFromMemory((BYTE*)data, size);
+	if (SUCCEEDED(hr))
+		hr = factory->CreateDecoderFromStream(stream, NULL, WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr))
+		hr = decoder->GetFrame(0, &frame);
+	if (SUCCEEDED(hr))
+		hr = factory->CreateFormatConverter(&converter);
+	if (SUCCEEDED(hr))
+		hr = converter->Initialize(frame, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone,
+			NULL, 0.0, WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr))
+		hr = converter->GetSize(&image.width, &image.height);
+	if (SUCCEEDED(hr)) {
+		try {
+			image.pixels.resize((size_t)image.width * image.height);
+		}
+		catch (...) { hr = E_OUTOFMEMORY; }
+	}
+	if (SUCCEEDED(hr) && !image.pixels.empty())
+		hr = converter->CopyPixels(NULL, image.width * 4, image.width * image.height * 4,
+			(BYTE*)&image.pixels[0]);
+	if (SUCCEEDED(hr)) {
+		for (size_t i = 0; i < image.pixels.size(); i++) {
+			if (image.pixels[i] == transcolor)	// color key, as D3DX applies it
+				image.pixels[i] = 0;
+		}
+	}
+	else
+		std::vector<DWORD>().swap(image.pixels);
+	SAFE_RELEASE(converter);
+	SAFE_RELEASE(frame);
+	SAFE_RELEASE(decoder);
+	SAFE_RELEASE(stream);
+	SAFE_RELEASE(factory);
+	if (uninitialize)
+		CoUninitialize();
+	return hr;
+}
+
+//=============================================================================
+// Create a texture from decoded pixels
+// The pixels are copied to a system memory texture, then to video memory.
+//=============================================================================
+HRESULT Graphics::createTexture(const DecodedImage &image, LP_TEXTURE &texture, OpacityMap *map) {
+	texture = NULL;
+	if (image.pixels.empty())
+		return D3DERR_INVALIDCALL;
+	LP_TEXTURE staged = NULL;
+	result = device3d->CreateTexture(image.width, image.height, 1, 0, D3DFMT_A8R8G8B8,
+		D3DPOOL_SYSTEMMEM, &staged, NULL);
+	if (FAILED(result))
+		return result;
+	D3DLOCKED_RECT locked;
+	result = staged->LockRect(0, &locked, NULL, 0);
+	if (FAILED(result)) {
+		SAFE_RELEASE(staged);
+		return result;
+	}
+	for (UINT y = 0; y < image.height; y++)
+		memcpy((BYTE*)locked.pBits + y * locked.Pitch, &image.pixels[(size_t)y * image.width],
+			image.width * 4);
+	staged->UnlockRect(0);
+	return uploadTexture(staged, map, texture);
+}
+
+//=============================================================================
+// Copy a decoded texture to video memory, finding its opacity on the way
+// staged holds 32 bit ARGB pixels in system memory and is released.
+//=============================================================================
+HRESULT Graphics::uploadTexture(LP_TEXTURE staged, OpacityMap *map, LP_TEXTURE &texture) {
+	D3DSURFACE_DESC desc;
+	texture = NULL;
+	staged->GetLevelDesc(0, &desc);
+	result = D3D_OK;
+	if (map) {
+		D3DLOCKED_RECT locked;
+		result = staged->LockRect(0, &locked, NULL, D3DLOCK_READONLY);
+		if (SUCCEEDED(result)) {
+			// alpha is the high byte of each little endian ARGB pixel
+			if (!map->initialize((const BYTE*)locked.pBits + 3, desc.Width, desc.Height, locked.Pitch, 4))
+				map->clear();			// drawn blended
+			staged->UnlockRect(0);
+		}
+	}
+	if (SUCCEEDED(result))
+		result = device3d->CreateTexture(desc.Width, desc.Height, 1, 0, D3DFMT_A8R8G8B8,
+			D3DPOOL_DEFAULT, &texture, NULL);
+	if (SUCCEEDED(result))
+		result = device3d->UpdateTexture(staged, texture);
+	if (FAILED(result))
+		SAFE_RELEASE(texture);
+	SAFE_RELEASE(staged);
+	return result;
+}
+
+//=============================================================================
+// Draw count copies of one texture rect
+// Each sprite's scale and position are followed by the view, as in
+// drawSprite(). The product is written out, since the sprite matrix only
+// has a scale and a translation.
+//=============================================================================
+void Graphics::drawSpriteBatch(LP_TEXTURE texture, const RECT &rect, const float *x, const float *y,
+	const float *scale, const COLOR_ARGB *color, UINT count) {
+	if (texture == NULL || count == 0)
+		return;
+
+	// scale around the center of the rect
+	D3DXVECTOR3 center((float)(rect.right - rect.left) / 2, (float)(rect.bottom - rect.top) / 2, 0.0f);
+	D3DXMATRIX v;
+	if (viewSet)
+		v = view;
+	else
+		D3DXMatrixIdentity(&v);
+	D3DXMATRIX matrix;
+	D3DXMatrixIdentity(&matrix);
+	for (UINT i = 0; i < count; i++) {
+		float s = scale[i];
+		matrix._11 = s * v._11;
+		matrix._12 = s * v._12;
+		matrix._21 = s * v._21;
+		matrix._22 = s * v._22;
+		matrix._41 = x[i] * v._11 + y[i] * v._21 + v._41;
+		matrix._42 = x[i] * v._12 + y[i] * v._22 + v._42;
+		matrix._43 = spriteDepth;
+		sprite->SetTransform(&matrix);
+		sprite->Draw(texture, &rect, &center, NULL, color[i]);
+	}
+	countSprites(texture, count);
+}
+
+//=============================================================================
+// Draw quads of SpriteVertex from memory
+//=============================================================================
+void Graphics::drawSpriteVertices(LP_TEXTURE texture, const SpriteVertex *vertices, UINT quads, const WORD *indices) {
+	if (quads == 0)
+		return;
+	device3d->SetFVF(SPRITEVERTEX_FVF);
+	device3d->SetTexture(0, texture);
+	device3d->DrawIndexedPrimitiveUP(D3DPT_TRIANGLELIST, 0, quads * 4, quads * 2,
+		indices, D3DFMT_INDEX16, vertices, sizeof(SpriteVertex));
+	countSprites(texture, quads);
+}
+
+//=============================================================================
+// Create a managed texture from 32 bit ARGB pixels
+//=============================================================================
+HRESULT Graphics::createTexture(UINT w, UINT h, const COLOR_ARGB *pixels, LP_TEXTURE &texture) {
+	result = device3d->CreateTexture(w, h, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &texture, NULL);
+	if (FAILED(result))
+		return result;
+
+	D3DLOCKED_RECT locked;
+	result = texture->LockRect(0, &locked, NULL, 0);
+	if (FAILED(result)) {
+		SAFE_RELEASE(texture);
+		return result;
+	}
+	for (UINT y = 0; y < h; y++)
+		memcpy((BYTE*)locked.pBits + y * locked.Pitch, pixels + y * w, w * sizeof(COLOR_ARGB));
+	texture->UnlockRect(0);
+	return result;
+}
+
 //=============================================================================
 // Draw Sprite
 //=============================================================================
@@ -194,11 +522,271 @@ void Graphics::drawSprite(const SpriteData &spriteData, COLOR_ARGB color) {
 		&spriteCenter,					// rotation center
 		(float)(spriteData.angle),		// rotation angle
 		&translate);					// X,Y location
+	if (viewSet)						// world to screen
+		D3DXMatrixMultiply(&matrix, &matrix, &view);
+	matrix._43 = spriteDepth;
 
 	sprite->SetTransform(&matrix);
 
 	// Draw the sprite
 	sprite->Draw(spriteData.texture, &spriteData.rect, NULL, NULL, color);
+	countSprites(spriteData.texture, 1);
+}
+
+//=============================================================================
+// Draw a sprite with a cached world matrix
+// The matrix is used as is, so nothing is rebuilt unless the sprite is
+// flipped or a view is set. The sprite center is placed on the matrix origin.
+//=============================================================================
+void Graphics::drawSprite(const SpriteData &spriteData, const D3DXMATRIX &world, COLOR_ARGB color) {
+	if (spriteData.texture == NULL)
+		return;
+
+	if (spriteData.flipHorizontal || spriteData.flipVertical || viewSet || spriteDepth != 0) {
+		D3DXMATRIX matrix = world;
+		if (spriteData.flipHorizontal || spriteData.flipVertical) {
+			D3DXMATRIX flip;
+			D3DXMatrixScaling(&flip, spriteData.flipHorizontal ? -1.0f : 1.0f,
+				spriteData.flipVertical ? -1.0f : 1.0f, 1.0f);
+			D3DXMatrixMultiply(&matrix, &flip, &world);
+		}
+		if (viewSet)
+			D3DXMatrixMultiply(&matrix, &matrix, &view);
+		matrix._43 = spriteDepth;
+		sprite->SetTransform(&matrix);
+	}
+	else
+		sprite->SetTransform(&world);
+
+	D3DXVECTOR3 center((float)(spriteData.width / 2), (float)(spriteData.height / 2), 0.0f);
+	sprite->Draw(spriteData.texture, &spriteData.rect, &center, NULL, color);
+	countSprites(spriteData.texture, 1);
+}
+
+//=============================================================================
+// Set how following sprites are blended
+// Sprites already in the batch are drawn first, with the old blend.
+//=============================================================================
+void Graphics::setSpriteBlend(graphicsNS::BLEND_MODE blend) {
+	sprite->Flush();
+	batchTexture = NULL;				// next sprite starts a new batch
+	device3d->SetRenderState(D3DRS_DESTBLEND,
+		blend == graphicsNS::BLEND_ADDITIVE ? D3DBLEND_ONE : D3DBLEND_INVSRCALPHA);
+}
+
+//=============================================================================
+// Set render states for following sprites
+// Opaque sprites write depth and are tested against it, so pixels hidden by
+// nearer opaque sprites are never shaded. Transparent texels of cutouts are
+// discarded by the alpha test before they write depth. Blended sprites only
+// test depth, so they are hidden by opaque sprites in front of them.
+//=============================================================================
+void Graphics::setSpritePass(graphicsNS::SPRITE_PASS pass) {
+	sprite->Flush();
+	batchTexture = NULL;				// next sprite starts a new batch
+	device3d->SetRenderState(D3DRS_ZENABLE, pass == graphicsNS::PASS_SINGLE ? D3DZB_FALSE : D3DZB_TRUE);
+	device3d->SetRenderState(D3DRS_ZWRITEENABLE, pass == graphicsNS::PASS_OPAQUE);
+	device3d->SetRenderState(D3DRS_ZFUNC, D3DCMP_LESS);
+	device3d->SetRenderState(D3DRS_ALPHABLENDENABLE, pass != graphicsNS::PASS_OPAQUE);
+	device3d->SetRenderState(D3DRS_ALPHATESTENABLE, TRUE);
+	device3d->SetRenderState(D3DRS_ALPHAFUNC, D3DCMP_GREATEREQUAL);
+	device3d->SetRenderState(D3DRS_ALPHAREF, pass == graphicsNS::PASS_OPAQUE ? opacityNS::ALPHA_REF : 1);
+	if (pass == graphicsNS::PASS_SINGLE)
+		spriteDepth = 0;
+}
+
+//=============================================================================
+// Draw a run of quads from one texture
+//=============================================================================
+void Graphics::drawSpriteRun(LP_TEXTURE texture, const SpriteQuad *quads, UINT count,
+	float x, float y, float scale, COLOR_ARGB color) {
+	if (texture == NULL || count == 0)
+		return;
+
+	// one transform for the whole run
+	D3DXVECTOR2 scaling(scale, scale);
+	D3DXVECTOR2 translate(x, y);
+	D3DXMATRIX matrix;
+	D3DXMatrixTransformation2D(&matrix, NULL, 0.0f, &scaling, NULL, 0.0f, &translate);
+	if (viewSet)
+		D3DXMatrixMultiply(&matrix, &matrix, &view);
+	matrix._43 = spriteDepth;
+	sprite->SetTransform(&matrix);
+
+	for (UINT i = 0; i < count; i++)
+		sprite->Draw(texture, &quads[i].rect, NULL, &quads[i].position, color);
+	countSprites(texture, count);
+}
+
+//=============================================================================
+// Draw quads of SpriteVertex as one sprite within the sprite batch
+// The batch is flushed so sprites before it draw first. The device keeps the
+// screen transforms spriteBegin() set, so vertices are moved to screen
+// pixels by the view here, and ID3DXSprite sets its own vertex format and
+// texture again when it next draws.
+//=============================================================================
+void Graphics::drawSpriteMesh(LP_TEXTURE texture, const SpriteVertex *vertices, UINT quads) {
+	if (texture == NULL || quads == 0)
+		return;
+	if (quads > graphicsNS::MESH_QUADS)
+		quads = graphicsNS::MESH_QUADS;
+
+	SpriteVertex v[graphicsNS::MESH_QUADS * 4];
+	WORD indices[graphicsNS::MESH_QUADS * 6];
+	for (UINT i = 0; i < quads * 4; i++) {
+		v[i] = vertices[i];
+		if (viewSet) {
+			v[i].x = vertices[i].x * view._11 + vertices[i].y * view._21 + view._41;
+			v[i].y = vertices[i].x * view._12 + vertices[i].y * view._22 + view._42;
+		}
+		v[i].z = spriteDepth;
+	}
+	for (UINT q = 0; q < quads; q++) {
+		WORD first = (WORD)(q * 4);
+		WORD *index = &indices[q * 6];
+		index[0] = first;     index[1] = first + 1; index[2] = first + 2;
+		index[3] = first;     index[4] = first + 2; index[5] = first + 3;
+	}
+
+	sprite->Flush();
+	batchTexture = NULL;				// next sprite starts a new batch
+	device3d->SetFVF(SPRITEVERTEX_FVF);
+	device3d->SetTexture(0, texture);
+	device3d->DrawIndexedPrimitiveUP(D3DPT_TRIANGLELIST, 0, quads * 4, quads * 2,
+		indices, D3DFMT_INDEX16, v, sizeof(SpriteVertex));
+	countSprites(texture, 1);
+}
+
+//=============================================================================
+// Combine the camera view and the scene scale
+// The scale is last, so everything is drawn in screen pixels and then
+// shrunk to the scene target.
+//=============================================================================
+void Graphics::updateView() {
+	viewSet = cameraViewSet || sceneBound;
+	if (cameraViewSet)
+		view = cameraView;
+	else
+		D3DXMatrixIdentity(&view);
+	if (sceneBound) {
+		D3DXMATRIX scaling;
+		D3DXMatrixScaling(&scaling, sceneScale, sceneScale, 1.0f);
+		D3DXMatrixMultiply(&view, &view, &scaling);
+	}
+}
+
+//=============================================================================
+// Draw into the scene target
+// The target is the full screen size, so changing the scale never
+// recreates it; only its top left sceneScale part is used.
+//=============================================================================
+bool Graphics::bindScene() {
+	if (device3d == NULL)
+		return false;
+	if (sceneBound)
+		return true;
+	if (FAILED(device3d->GetRenderTarget(0, &backBuffer)))
+		return false;
+	if (sceneTarget == NULL) {
+		D3DSURFACE_DESC desc;
+		backBuffer->GetDesc(&desc);
+		result = device3d->CreateRenderTarget(width, height, desc.Format, D3DMULTISAMPLE_NONE, 0,
+			FALSE, &sceneTarget, NULL);
+		if (FAILED(result)) {
+			SAFE_RELEASE(backBuffer);
+			return false;
+		}
+	}
+	device3d->SetRenderTarget(0, sceneTarget);
+	sceneBound = true;
+	updateView();
+	return true;
+}
+
+//=============================================================================
+// Stretch the scene to the back buffer
+// StretchRect is done between scenes, then a new scene is begun on the
+// back buffer.
+//=============================================================================
+HRESULT Graphics::resolveScene() {
+	if (overdrawView && !overdrawShown)
+		drawOverdraw();
+	if (!sceneBound)
+		return S_OK;
+	device3d->EndScene();
+	RECT source = { 0, 0, (LONG)(width * sceneScale + 0.5f), (LONG)(height * sceneScale + 0.5f) };
+	result = device3d->StretchRect(sceneTarget, &source, backBuffer, NULL, D3DTEXF_LINEAR);
+	device3d->SetRenderTarget(0, backBuffer);
+	SAFE_RELEASE(backBuffer);
+	sceneBound = false;
+	updateView();
+	device3d->BeginScene();
+	return result;
+}
+
+//=============================================================================
+// Count pixel writes in the stencil buffer
+// ID3DXSprite restores the states it found at Begin() when it ends, so
+// spriteBegin() sets these again. The alpha test still discards transparent
+// texels, so the counts are pixels written rather than fragments shaded.
+//=============================================================================
+void Graphics::countOverdraw() {
+	device3d->SetRenderState(D3DRS_STENCILENABLE, TRUE);
+	device3d->SetRenderState(D3DRS_STENCILFUNC, D3DCMP_ALWAYS);
+	device3d->SetRenderState(D3DRS_STENCILPASS, D3DSTENCILOP_INCRSAT);
+	device3d->SetRenderState(D3DRS_STENCILFAIL, D3DSTENCILOP_KEEP);
+	device3d->SetRenderState(D3DRS_STENCILZFAIL, D3DSTENCILOP_KEEP);
+	device3d->SetRenderState(D3DRS_COLORWRITEENABLE, 0);
+}
+
+//=============================================================================
+// Draw the heatmap of the write counts
+// One screen sized quad per count passes the stencil test only where the
+// count is equal, or at least LEVELS for the last color. Pixels with no
+// writes keep the black they were cleared to.
+//=============================================================================
+void Graphics::drawOverdraw() {
+	struct HeatVertex {
+		float       x, y, z, rhw;
+		COLOR_ARGB  color;
+	};
+	overdrawShown = true;
+	IDirect3DStateBlock9 *saved = NULL;
+	device3d->CreateStateBlock(D3DSBT_ALL, &saved);
+
+	D3DVIEWPORT9 viewport;
+	device3d->GetViewport(&viewport);
+	float left = viewport.X - 0.5f, top = viewport.Y - 0.5f;
+	float right = left + viewport.Width, bottom = top + viewport.Height;
+	device3d->SetRenderState(D3DRS_COLORWRITEENABLE, 0xf);
+	device3d->SetRenderState(D3DRS_ZENABLE, D3DZB_FALSE);
+	device3d->SetRenderState(D3DRS_ALPHABLENDENABLE, FALSE);
+	device3d->SetRenderState(D3DRS_ALPHATESTENABLE, FALSE);
+	device3d->SetRenderState(D3DRS_STENCILPASS, D3DSTENCILOP_KEEP);
+	device3d->SetTexture(0, NULL);
+	device3d->SetTextureStageState(0, D3DTSS_COLOROP, D3DTOP_SELECTARG1);
+	device3d->SetTextureStageState(0, D3DTSS_COLORARG1, D3DTA_DIFFUSE);
+	device3d->SetTextureStageState(0, D3DTSS_ALPHAOP, D3DTOP_SELECTARG1);
+	device3d->SetTextureStageState(0, D3DTSS_ALPHAARG1, D3DTA_DIFFUSE);
+	device3d->SetFVF(D3DFVF_XYZRHW | D3DFVF_DIFFUSE);
+	for (int level = 1; level <= heatmapNS::LEVELS; level++) {
+		COLOR_ARGB c = heatmapNS::COLORS[level];
+		HeatVertex quad[4] = {
+			{ left, top, 0.0f, 1.0f, c }, { right, top, 0.0f, 1.0f, c },
+			{ left, bottom, 0.0f, 1.0f, c }, { right, bottom, 0.0f, 1.0f, c }
+		};
+		device3d->SetRenderState(D3DRS_STENCILREF, level);
+		device3d->SetRenderState(D3DRS_STENCILFUNC,
+			level == heatmapNS::LEVELS ? D3DCMP_LESSEQUAL : D3DCMP_EQUAL);
+		device3d->DrawPrimitiveUP(D3DPT_TRIANGLESTRIP, 2, quad, sizeof(HeatVertex));
+	}
+
+	if (saved) {
+		saved->Apply();
+		saved->Release();
+	}
+	device3d->SetRenderState(D3DRS_STENCILENABLE, FALSE);
+	device3d->SetRenderState(D3DRS_COLORWRITEENABLE, 0xf);
 }
 
 //=============================================================================
@@ -251,6 +839,12 @@ HRESULT Graphics::getDeviceState() {
 HRESULT Graphics::reset() {
 	result = E_FAIL;					// default to fail, replace on success
 	initD3Dpp();                        // init D3D presentation parameters
+	SAFE_RELEASE(backBuffer);           // default pool surfaces must go before Reset
+	SAFE_RELEASE(sceneTarget);          // recreated by the next beginScene()
+	sceneBound = false;
+	updateView();
 	result = device3d->Reset(&d3dpp);   // attempt to reset graphics device
+	if (SUCCEEDED(result))
+		device3d->SetRenderState(D3DRS_ZENABLE, D3DZB_FALSE);
 	return result;
 }
@@ -8,6 +8,7 @@
 
 #include <d3d9.h>
 #include <d3dx9.h>
+#include <vector>
 #include "constants.h"
 #include "gameError.h"
 
@@ -16,6 +17,8 @@
 #define LP_SPRITE	LPD3DXSPRITE
 #define LP_3DDEVICE LPDIRECT3DDEVICE9
 #define LP_3D		LPDIRECT3D9
+#define LP_VERTEXBUFFER	LPDIRECT3DVERTEXBUFFER9
+#define LP_INDEXBUFFER	LPDIRECT3DINDEXBUFFER9
 
 // Color
 #define COLOR_ARGB DWORD
@@ -50,6 +53,16 @@ namespace graphicsNS {
 	const COLOR_ARGB BACK_COLOR = NAVY;								// background color
 
 	enum DISPLAY_MODE { TOGGLE, FULLSCREEN, WINDOW };
+
+	// How sprites are combined with what is behind them
+	enum BLEND_MODE { BLEND_ALPHA, BLEND_ADDITIVE };
+
+	// Sprites drawn in one pass in order, or split into an opaque pass drawn
+	// front to back with depth writes, then a blended pass drawn back to front
+	// over it with depth tests
+	enum SPRITE_PASS { PASS_SINGLE, PASS_OPAQUE, PASS_BLENDED };
+
+	const UINT MESH_QUADS = 8;		// most quads drawSpriteMesh() draws, enough for a SpriteMesh fan
 }
 
 struct SpriteData {
@@ -65,6 +78,35 @@ struct SpriteData {
 	bool        flipVertical;   // true to flip sprite vertically
 };
 
+// One rectangle of a texture drawn at position, used by Graphics::drawSpriteRun().
+struct SpriteQuad {
+	RECT        rect;			// selects an image from a larger texture
+	D3DXVECTOR3 position;		// top left corner relative to the run
+};
+
+// Vertex of static textured geometry drawn by Graphics::drawQuads().
+struct QuadVertex {
+	float       x, y, z;		// screen pixels before the screen transform
+	float       u, v;			// texture coordinates
+};
+const DWORD QUADVERTEX_FVF = D3DFVF_XYZ | D3DFVF_TEX1;
+
+// Vertex of a sprite quad drawn by Graphics::drawSpriteVertices().
+struct SpriteVertex {
+	float       x, y, z;		// screen pixels before the screen transform
+	COLOR_ARGB  color;			// color filter
+	float       u, v;			// texture coordinates
+};
+const DWORD SPRITEVERTEX_FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE | D3DFVF_TEX1;
+
+// Pixels of an image file decoded by Graphics::decodeImage().
+struct DecodedImage {
+	UINT        width, height;
+	std::vector<DWORD> pixels;	// 32 bit ARGB, width per row, top row first
+};
+
+class OpacityMap;
+
 class Graphics {
 private:
 	// DirectX pointers and stuff
@@ -81,11 +123,56 @@ private:
 	int         width;
 	int         height;
 	COLOR_ARGB  backColor;      // background color
+	UINT        spriteCount;    // sprites drawn since beginScene()
+	UINT        batchCount;     // sprite batches (texture changes) since beginScene()
+	LP_TEXTURE  batchTexture;   // texture of the current sprite batch
+	UINT64      textureMemory;  // estimated bytes of loaded textures
+	D3DXMATRIX  view;           // applied to every sprite after its own transform
+	bool        viewSet;        // false to draw sprites in screen pixels
+	D3DXMATRIX  cameraView;     // view set by setView()
+	bool        cameraViewSet;
+	LPDIRECT3DSURFACE9 sceneTarget; // scene drawn below screen resolution, NULL if not created
+	LPDIRECT3DSURFACE9 backBuffer;  // held while the scene target is bound
+	float       sceneScale;     // fraction of width and height the scene is drawn at
+	bool        sceneBound;     // true while drawing into sceneTarget
+	float       spriteDepth;    // depth of following sprites, 0 near to 1 far
+	bool        overdrawView;   // show pixel write counts instead of the scene
+	bool        overdrawShown;  // the counts of this frame have been drawn
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Count a sprite drawn with texture
+	void countSprites(LP_TEXTURE texture, UINT count) {
+		spriteCount += count;
+		if (texture != batchTexture) {	// sprite batch is flushed on texture change
+			batchCount++;
+			batchTexture = texture;
+		}
+	}
 
 	// (For internal engine use only. No user serviceable parts inside.)
 	// Initialize D3D presentation parameters
 	void		initD3Dpp();
 
+	// Combine the camera view and the scene scale into view.
+	void		updateView();
+
+	// Draw into the scene target, creating it if needed.
+	// Post: returns false if it could not be created
+	bool		bindScene();
+
+	// Count the pixels written by following drawing in the stencil buffer,
+	// without writing colors.
+	void		countOverdraw();
+
+	// Replace the scene with the heatmap colors of the counts, then draw
+	// normally for the rest of the frame.
+	void		drawOverdraw();
+
+	// Copy staged, 32 bit ARGB pixels in system memory, to a new texture in
+	// default D3D memory, initializing map from them if it is not NULL.
+	// staged is released.
+	HRESULT		uploadTexture(LP_TEXTURE staged, OpacityMap *map, LP_TEXTURE &texture);
+
 public:
 	// Constructor
 	Graphics();
@@ -105,16 +192,157 @@ public:
 	void initialize(HWND hw, int width, int height, bool fullscreen);
 
 	// Load the texture into default D3D memory (normal texture use)
-	HRESULT loadTexture(const char * filename, COLOR_ARGB transcolor, UINT &width, UINT &height, LP_TEXTURE &texture);
+	// If map is not NULL it is initialized from the alpha of every pixel,
+	// from the same decode.
+	HRESULT loadTexture(const char * filename, COLOR_ARGB transcolor, UINT &width, UINT &height,
+		LP_TEXTURE &texture, OpacityMap *map = NULL);
+
+	// Load the texture from an image file held in memory, as loadTexture() does.
+	HRESULT loadTextureFromMemory(const void *data, UINT size, COLOR_ARGB transcolor,
+		UINT &width, UINT &height, LP_TEXTURE &texture, OpacityMap *map = NULL);
+
+	// Decode an image file held in memory to pixels with WIC, pixels that
+	// match transcolor made transparent black as loadTexture() does. Uses no
+	// device, so it may be called on any thread. Formats WIC cannot decode
+	// fail, and can still be loaded with loadTextureFromMemory().
+	static HRESULT decodeImage(const void *data, UINT size, COLOR_ARGB transcolor, DecodedImage &image);
+
+	// Create a texture in default D3D memory from decoded pixels. If map is
+	// not NULL it is initialized from their alpha.
+	HRESULT createTexture(const DecodedImage &image, LP_TEXTURE &texture, OpacityMap *map = NULL);
+
+	// Draw count copies of one texture rect, centered on x[i], y[i] with
+	// scale[i] and color[i], in world coordinates like drawSprite(). The
+	// sprite batch combines them into one draw call.
+	// Pre: spriteBegin() has been called
+	void drawSpriteBatch(LP_TEXTURE texture, const RECT &rect, const float *x, const float *y,
+		const float *scale, const COLOR_ARGB *color, UINT count);
+
+	// Create a vertex buffer of bytes size in managed memory.
+	// Managed buffers survive a device reset.
+	HRESULT createVertexBuffer(UINT bytes, DWORD fvf, LP_VERTEXBUFFER &vb);
+
+	// Create a 16 bit index buffer of count indices in managed memory.
+	HRESULT createIndexBuffer(UINT count, LP_INDEXBUFFER &ib);
+
+	// Set transforms and render states for drawing alpha blended, textured
+	// geometry in screen pixels, with (viewX, viewY) at the top left of the screen.
+	// Call outside spriteBegin() and spriteEnd().
+	void setScreenTransform(float viewX, float viewY);
+
+	// As setScreenTransform(), with a view matrix from world to screen pixels,
+	// such as Camera2D::getViewMatrix().
+	void setScreenTransform(const D3DXMATRIX &viewMatrix);
+
+	// Draw quads from a vertex buffer of QuadVertex, four vertices per quad,
+	// indexed by a quad index buffer (0,1,2, 0,2,3 per quad).
+	// Pre: setScreenTransform() has been called
+	void drawQuads(LP_TEXTURE texture, LP_VERTEXBUFFER vb, LP_INDEXBUFFER ib, UINT quads);
+
+	// Draw quads of SpriteVertex from memory, four vertices per quad,
+	// indexed by quad indices (0,1,2, 0,2,3 per quad) for at least quads quads.
+	// Pre: setScreenTransform() has been called
+	//      quads <= 16384, so indices fit 16 bits
+	void drawSpriteVertices(LP_TEXTURE texture, const SpriteVertex *vertices, UINT quads, const WORD *indices);
+
+	// Create a texture in managed memory from 32 bit ARGB pixels.
+	// Managed textures survive a device reset.
+	HRESULT createTexture(UINT width, UINT height, const COLOR_ARGB *pixels, LP_TEXTURE &texture);
+
+	// Add bytes to the estimated texture memory. Use negative bytes when a texture is released.
+	void addTextureMemory(INT64 bytes) { textureMemory += bytes; }
+
+	// Return estimated bytes of loaded textures.
+	UINT64 getTextureMemory() const { return textureMemory; }
+
+	// Return sprites drawn since beginScene().
+	UINT getSpriteCount() const { return spriteCount; }
+
+	// Return sprite draw calls since beginScene(), estimated from texture changes.
+	UINT getDrawCallCount() const { return batchCount; }
+
+	// Set the view matrix applied to every sprite drawn after this, such as
+	// Camera2D::getViewMatrix(). NULL to draw sprites in screen pixels.
+	void setView(const D3DXMATRIX *viewMatrix) {
+		cameraViewSet = (viewMatrix != NULL);
+		if (cameraViewSet)
+			cameraView = *viewMatrix;
+		updateView();
+	}
+
+	// Return the view matrix, NULL if sprites are drawn in screen pixels.
+	const D3DXMATRIX* getView() const { return cameraViewSet ? &cameraView : NULL; }
+
+	// Draw following scenes at scale times the screen width and height into
+	// an off-screen target, which resolveScene() stretches to the back buffer.
+	// Sprites and geometry are still given in screen pixels. 1 draws straight
+	// to the back buffer. Takes effect at the next beginScene().
+	void setSceneScale(float scale) { sceneScale = (scale > 1.0f) ? 1.0f : scale; }
+
+	// Return the scale scenes are drawn at.
+	float getSceneScale() const { return sceneScale; }
+
+	// Stretch the scene to the back buffer and draw there for the rest of
+	// the frame, such as a HUD at full resolution. Does nothing at scale 1,
+	// other than draw the heatmap of the overdraw view.
+	// Pre: beginScene() has been called, sprite drawing has ended
+	HRESULT resolveScene();
+
+	// Show how many times each pixel of following scenes is written, in the
+	// colors of heatmapNS::COLORS, in place of the scene. Counts stop at
+	// resolveScene(), so a HUD drawn after it shows over the heatmap.
+	// Takes effect at the next beginScene().
+	void setOverdrawView(bool on) { overdrawView = on; }
+
+	// Return true if scenes are shown as a heatmap of pixel writes.
+	bool getOverdrawView() const { return overdrawView; }
 
 	// Draw the sprite described in SpriteData structure.
 	void drawSprite(const SpriteData &spriteData, COLOR_ARGB color = graphicsNS::WHITE);
 
+	// Draw the sprite centered on the origin of a cached world matrix, such as
+	// one from TransformHierarchy. SpriteData x, y, scale and angle are not used.
+	void drawSprite(const SpriteData &spriteData, const D3DXMATRIX &world,
+		COLOR_ARGB color = graphicsNS::WHITE);
+
+	// Draw count quads from one texture with a single transform.
+	// The sprite batch combines them into one draw call.
+	// Pre: spriteBegin() has been called
+	//      x, y = screen location of the run
+	//      scale = applied to positions and sizes of all quads
+	void drawSpriteRun(LP_TEXTURE texture, const SpriteQuad *quads, UINT count,
+		float x, float y, float scale, COLOR_ARGB color = graphicsNS::WHITE);
+
+	// Draw quads of SpriteVertex in world coordinates, four vertices per
+	// quad, such as the fan of a SpriteMesh built by SpriteBucket, as one
+	// sprite at the view and sprite depth drawSprite() would use. Sprites
+	// already in the batch are drawn first.
+	// Pre: spriteBegin() has been called
+	//      quads <= MESH_QUADS
+	void drawSpriteMesh(LP_TEXTURE texture, const SpriteVertex *vertices, UINT quads);
+
 	// Sprite Begin
 	void spriteBegin() {
 		sprite->Begin(D3DXSPRITE_ALPHABLEND);
+		batchTexture = NULL;
+		if (overdrawView && !overdrawShown)
+			countOverdraw();
 	}
 
+	// Set how following sprites are blended. spriteBegin() starts with BLEND_ALPHA.
+	// Pre: spriteBegin() has been called
+	void setSpriteBlend(graphicsNS::BLEND_MODE blend);
+
+	// Set render states for following sprites to draw in pass. PASS_SINGLE
+	// is the state spriteBegin() starts with. Opaque sprites are drawn with an
+	// alpha test and no blending.
+	// Pre: spriteBegin() has been called
+	void setSpritePass(graphicsNS::SPRITE_PASS pass);
+
+	// Set the depth of following sprites, 0 near to 1 far. Only used with
+	// depth tests, in PASS_OPAQUE and PASS_BLENDED.
+	void setSpriteDepth(float z) { spriteDepth = z; }
+
 	// Sprite End
 	void spriteEnd() {
 		sprite->End();
@@ -154,17 +382,27 @@ public:
 		result = E_FAIL;
 		if (device3d == NULL)
 			return result;
-		// clear backbuffer to backColor
-		device3d->Clear(0, NULL, D3DCLEAR_TARGET, backColor, 1.0F, 0);
+		spriteCount = 0;
+		batchCount = 0;
+		if (sceneScale < 1.0f && !bindScene())
+			sceneScale = 1.0f;	// no off-screen target, draw at full resolution
+		// clear backbuffer to backColor, the depth buffer to far and write counts to 0
+		device3d->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER | D3DCLEAR_STENCIL,
+			overdrawView ? graphicsNS::BLACK : backColor, 1.0F, 0);
 		result = device3d->BeginScene(); // begin scene for drawing
+		overdrawShown = false;
+		if (overdrawView && SUCCEEDED(result))
+			countOverdraw();
 		return result;
 	}
 
-	// EndScene()
+	// EndScene(), resolving the scene first if it is still off-screen
 	HRESULT endScene() {
 		result = E_FAIL;
-		if (device3d)
+		if (device3d) {
+			resolveScene();
 			result = device3d->EndScene();
+		}
 		return result;
 	}
 };
@@ -1,4 +1,30 @@
 #include "image.h"
+#include "transformHierarchy.h"
+#include "drawList.h"
+#include "spriteBatcher.h"
+#include "spriteMesh.h"
+#include "timerWheel.h"
+#include <atomic>
+
+namespace imageNS {
+	static std::atomic<bool> changed(true);		// draw the first frame
+}
+
+//=============================================================================
+// Note that an Image changed
+// Most frames change many Images, so the flag is written only when clear.
+//=============================================================================
+void imageNS::markChanged() {
+	if (!changed.load(std::memory_order_relaxed))
+		changed.store(true, std::memory_order_relaxed);
+}
+
+//=============================================================================
+// Return true if an Image changed since the last call
+//=============================================================================
+bool imageNS::takeChanged() {
+	return changed.exchange(false, std::memory_order_relaxed);
+}
 
 //=============================================================================
 // Constructor
@@ -30,12 +56,68 @@ Image::Image() {
 	animComplete = false;
 	graphics = NULL;					// link to graphics system
 	colorFilter = graphicsNS::WHITE;	// WHITE for no change
+	transforms = NULL;					// not attached to a hierarchy
+	transformNode = 0;
+	meshes = NULL;						// draw quads
+	timers = NULL;						// animate in update()
+}
+
+//=============================================================================
+// Copy constructor
+//=============================================================================
+Image::Image(const Image &img) {
+	timers = NULL;
+	copy(img);
+}
+
+//=============================================================================
+// Assignment
+//=============================================================================
+Image& Image::operator=(const Image &img) {
+	if (this != &img)
+		copy(img);
+	return *this;
+}
+
+//=============================================================================
+// Copy everything but the frame timer
+// The timer's callback holds the image it was scheduled for, so this image
+// cancels its own timer and schedules a new one.
+//=============================================================================
+void Image::copy(const Image &img) {
+	if (timers)
+		timers->cancel(animHandle);
+	animHandle = PoolHandle();
+	graphics = img.graphics;
+	textureManager = img.textureManager;
+	spriteData = img.spriteData;
+	colorFilter = img.colorFilter;
+	cols = img.cols;
+	startFrame = img.startFrame;
+	endFrame = img.endFrame;
+	currentFrame = img.currentFrame;
+	frameDelay = img.frameDelay;
+	animTimer = img.animTimer;
+	hr = img.hr;
+	loop = img.loop;
+	visible = img.visible;
+	initialized = img.initialized;
+	animComplete = img.animComplete;
+	transforms = img.transforms;
+	transformNode = img.transformNode;
+	meshes = img.meshes;
+	timers = img.timers;
+	startAnimation();
+	imageNS::markChanged();
 }
 
 //=============================================================================
 // Destructor
 //=============================================================================
-Image::~Image() {}
+Image::~Image() {
+	if (timers)
+		timers->cancel(animHandle);
+}
 
 bool Image::initialize(Graphics *g, int width, int height, int ncols, TextureManager *textureM) {
 	try {
@@ -72,9 +154,14 @@ void Image::draw(COLOR_ARGB color) {
 	// get fresh texture in case onReset() was called
 	spriteData.texture = textureManager->getTexture();
 	if (color == graphicsNS::FILTER)                    // if draw with filter
-		graphics->drawSprite(spriteData, colorFilter);	// use colorFilter
+		color = colorFilter;							// use colorFilter
+	if (transforms) {									// if attached to a hierarchy
+		D3DXMATRIX world;
+		transforms->getWorldMatrix(transformNode, world);
+		graphics->drawSprite(spriteData, world, color);
+	}
 	else
-		graphics->drawSprite(spriteData, color);        // use color as filter
+		graphics->drawSprite(spriteData, color);
 }
 
 void Image::draw(SpriteData sd, COLOR_ARGB color) {
@@ -89,23 +176,102 @@ void Image::draw(SpriteData sd, COLOR_ARGB color) {
 		graphics->drawSprite(sd, color);			// use color as filter
 }
 
+void Image::draw(DrawList &list, UINT layer, float depth, COLOR_ARGB color) {
+	if (!visible || textureManager == NULL)
+		return;
+	spriteData.texture = textureManager->getTexture();
+	if (color == graphicsNS::FILTER)				// if draw with filter
+		color = colorFilter;						// use colorFilter
+	const OpacityMap *opacity = textureManager->getOpacity();
+	const SpriteMesh *mesh = meshes ? meshes->getMesh(currentFrame) : NULL;
+	if (transforms == NULL) {
+		list.add(layer, depth, spriteData, color, graphicsNS::BLEND_ALPHA, opacity, mesh);
+		return;
+	}
+	// centered on the world transform of the node, as draw() does
+	SpriteData sd = spriteData;
+	sd.scale = transforms->getWorldScale(transformNode);
+	sd.angle = transforms->getWorldAngle(transformNode);
+	sd.x = transforms->getWorldX(transformNode) - sd.width / 2 * sd.scale;
+	sd.y = transforms->getWorldY(transformNode) - sd.height / 2 * sd.scale;
+	list.add(layer, depth, sd, color, graphicsNS::BLEND_ALPHA, opacity, mesh);
+}
+
+void Image::draw(SpriteBucket &bucket, COLOR_ARGB color) {
+	if (!visible || textureManager == NULL)
+		return;
+	SpriteData sd = spriteData;
+	sd.texture = textureManager->getTexture();
+	if (color == graphicsNS::FILTER)				// if draw with filter
+		color = colorFilter;						// use colorFilter
+	if (transforms) {								// centered on the node, as draw() does
+		sd.scale = transforms->getWorldScale(transformNode);
+		sd.angle = transforms->getWorldAngle(transformNode);
+		sd.x = transforms->getWorldX(transformNode) - sd.width / 2 * sd.scale;
+		sd.y = transforms->getWorldY(transformNode) - sd.height / 2 * sd.scale;
+	}
+	bucket.add(sd, textureManager->getWidth(), textureManager->getHeight(), color,
+		meshes ? meshes->getMesh(currentFrame) : NULL);
+}
+
 void Image::update(float frameTime) {
-	if (endFrame - startFrame > 0) {				// if animated sprite
+	if (timers == NULL && endFrame - startFrame > 0) {	// if animated sprite
 		animTimer += frameTime;						// total elapsed time
 		if (animTimer > frameDelay) {
 			animTimer -= frameDelay;
-			currentFrame++;
-			if (currentFrame < startFrame || currentFrame > endFrame) {
-				if (loop == true)					// if looping animation
-					currentFrame = startFrame;
-				else {								// not looping animation
-					currentFrame = endFrame;
-					animComplete = true;
-				}
-			}
-			setRect();								// set spriteData.rect
+			nextFrame();
+		}
+	}
+}
+
+//=============================================================================
+// Show the next frame of the animation
+// A wheel's timer is cancelled once a non-looping animation completes.
+//=============================================================================
+void Image::nextFrame() {
+	currentFrame++;
+	if (currentFrame < startFrame || currentFrame > endFrame) {
+		if (loop == true)						// if looping animation
+			currentFrame = startFrame;
+		else {									// not looping animation
+			currentFrame = endFrame;
+			animComplete = true;
+			if (timers)
+				timers->cancel(animHandle);
 		}
 	}
+	setRect();									// set spriteData.rect
+}
+
+//=============================================================================
+// Time the animation with a wheel
+//=============================================================================
+void Image::setTimerWheel(TimerWheel *w) {
+	if (timers)
+		timers->cancel(animHandle);
+	animHandle = PoolHandle();
+	timers = w;
+	animTimer = 0.0;
+	startAnimation();
+}
+
+//=============================================================================
+// Schedule the frame timer again
+// Called when the frames, delay or current frame change, so the next frame
+// is a full frameDelay after the change. The delay is at least one tick, as
+// a period of 0 would make a one-shot timer and stall the animation.
+//=============================================================================
+void Image::startAnimation() {
+	if (timers == NULL)
+		return;
+	timers->cancel(animHandle);
+	animHandle = PoolHandle();
+	if (endFrame - startFrame > 0 && !animComplete) {
+		float delay = frameDelay;
+		if (delay < 1.0f / timerNS::TICKS_PER_SECOND)
+			delay = 1.0f / timerNS::TICKS_PER_SECOND;
+		animHandle = timers->schedule(delay, [this](PoolHandle) { nextFrame(); }, delay);
+	}
 }
 
 void Image::setCurrentFrame(int c) {
@@ -113,10 +279,12 @@ void Image::setCurrentFrame(int c) {
 		currentFrame = c;
 		animComplete = false;
 		setRect();										// set spriteData.rect
+		startAnimation();
 	}
 }
 
 inline void Image::setRect() {
+	LONG left = spriteData.rect.left, top = spriteData.rect.top;
 	// configure spriteData.rect to draw currentFrame
 	spriteData.rect.left = (currentFrame % cols) * spriteData.width;
 	// right edge + 1
@@ -124,4 +292,6 @@ inline void Image::setRect() {
 	spriteData.rect.top = (currentFrame / cols) * spriteData.height;
 	// bottom edge + 1
 	spriteData.rect.bottom = spriteData.rect.top + spriteData.height;
+	if (spriteData.rect.left != left || spriteData.rect.top != top)
+		imageNS::markChanged();
 }
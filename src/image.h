@@ -4,6 +4,22 @@
 
 #include "textureManager.h"
 #include "constants.h"
+#include "objectPool.h"
+
+class TransformHierarchy;
+class DrawList;
+class SpriteBucket;
+class SpriteMeshSheet;
+class TimerWheel;
+
+namespace imageNS {
+	// Note that something drawn changed, for drawing on demand. Called by
+	// Image setters, Camera2D, ParticleSystem, Tilemap and TransformHierarchy.
+	void markChanged();
+
+	// Return true if anything drawn changed since the last call, and clear the flag.
+	bool takeChanged();
+}
 
 class Image {
 protected:
@@ -17,17 +33,40 @@ protected:
 	int     endFrame;       // end frame of current animation
 	int     currentFrame;   // current frame of animation
 	float   frameDelay;     // how long between frames of animation
-	float   animTimer;      // animation timer
+	float   animTimer;      // animation timer, when no TimerWheel is set
 	HRESULT hr;             // standard return type
 	bool    loop;           // true to loop frames
 	bool    visible;        // true when visible
 	bool    initialized;    // true when successfully initialized
 	bool    animComplete;   // true when loop is false and endFrame has finished displaying
+	TransformHierarchy *transforms; // hierarchy the image is attached to, NULL if none
+	int     transformNode;  // node in transforms
+	const SpriteMeshSheet *meshes; // meshes of the frames, NULL to draw quads
+	TimerWheel *timers;     // wheel that times the animation, NULL to time it in update()
+	PoolHandle animHandle;  // repeating timer of the next frame
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Schedule the frame timer again if the animation is timed by a wheel.
+	void startAnimation();
+
+	// Show the next frame of the animation.
+	void nextFrame();
+
+	// Copy everything but the frame timer from img.
+	void copy(const Image &img);
 
 public:
 	// Constructor
 	Image();
 
+	// Copy constructor
+	// A copy timed by a TimerWheel gets its own frame timer, which calls back
+	// into the copy. Its next frame is a full frameDelay after the copy.
+	Image(const Image &img);
+
+	// Assignment, with its own frame timer as for a copy
+	Image& operator=(const Image &img);
+
 	// Destructor
 	virtual ~Image();
 
@@ -35,10 +74,14 @@ public:
 		int ncols, TextureManager *textureM);
 
 	// Flip image horizontally (mirror)
-	virtual void flipHorizontal(bool flip) { spriteData.flipHorizontal = flip; }
+	virtual void flipHorizontal(bool flip) {
+		if (spriteData.flipHorizontal != flip) { spriteData.flipHorizontal = flip; imageNS::markChanged(); }
+	}
 
 	// Flip image vertically
-	virtual void flipVertical(bool flip) { spriteData.flipVertical = flip; }
+	virtual void flipVertical(bool flip) {
+		if (spriteData.flipVertical != flip) { spriteData.flipVertical = flip; imageNS::markChanged(); }
+	}
 
 	// Draw Image using color as filter. Default color is WHITE.
 	virtual void draw(COLOR_ARGB color = graphicsNS::WHITE);
@@ -47,7 +90,17 @@ public:
 	// The current SpriteData.rect is used to select the texture.
 	virtual void draw(SpriteData sd, COLOR_ARGB color = graphicsNS::WHITE); // draw with SpriteData using color as filter
 
+	// Submit Image to a DrawList on layer at depth, using color as filter.
+	// The list draws it in layer and depth order when flushed, as the mesh
+	// of the current frame if meshes are set and the texture's opacity is known.
+	virtual void draw(DrawList &list, UINT layer, float depth, COLOR_ARGB color = graphicsNS::WHITE);
+
+	// Add Image to a SpriteBucket, using color as filter. May be called on
+	// a worker thread. The mesh of the current frame is drawn if meshes are set.
+	virtual void draw(SpriteBucket &bucket, COLOR_ARGB color = graphicsNS::WHITE);
+
 	// Update the animation. frameTime is used to regulate the speed.
+	// Does nothing to the animation when a TimerWheel times it.
 	virtual void update(float frameTime);
 
 	// Return reference to SpriteData structure.
@@ -105,30 +158,54 @@ public:
 	virtual COLOR_ARGB getColorFilter() { return colorFilter; }
 
 	// Set X location.
-	virtual void setX(float newX) { spriteData.x = newX; }
+	virtual void setX(float newX) {
+		if (spriteData.x != newX) { spriteData.x = newX; imageNS::markChanged(); }
+	}
 
 	// Set Y location.
-	virtual void setY(float newY) { spriteData.y = newY; }
+	virtual void setY(float newY) {
+		if (spriteData.y != newY) { spriteData.y = newY; imageNS::markChanged(); }
+	}
 
 	// Set scale.
-	virtual void setScale(float s) { spriteData.scale = s; }
+	virtual void setScale(float s) {
+		if (spriteData.scale != s) { spriteData.scale = s; imageNS::markChanged(); }
+	}
 
 	// Set rotation angle in degrees.
 	// 0 degrees is up. Angles progress clockwise.
-	virtual void setDegrees(float deg) { spriteData.angle = deg * ((float)PI / 180.0f); }
+	virtual void setDegrees(float deg) { setRadians(deg * ((float)PI / 180.0f)); }
 
 	// Set rotation angle in radians.
 	// 0 radians is up. Angles progress clockwise.
-	virtual void setRadians(float rad) { spriteData.angle = rad; }
+	virtual void setRadians(float rad) {
+		if (spriteData.angle != rad) { spriteData.angle = rad; imageNS::markChanged(); }
+	}
+
+	// Set center location and rotation angle in radians at once.
+	// Used to write many moving images back in bulk, as Flock does.
+	virtual void setPose(float centerX, float centerY, float rad) {
+		float x = centerX - spriteData.width / 2 * spriteData.scale;
+		float y = centerY - spriteData.height / 2 * spriteData.scale;
+		if (spriteData.x != x || spriteData.y != y || spriteData.angle != rad) {
+			spriteData.x = x;
+			spriteData.y = y;
+			spriteData.angle = rad;
+			imageNS::markChanged();
+		}
+	}
 
 	// Set visible.
-	virtual void setVisible(bool v) { visible = v; }
+	virtual void setVisible(bool v) {
+		if (visible != v) { visible = v; imageNS::markChanged(); }
+	}
 
 	// Set delay between frames of animation.
-	virtual void setFrameDelay(float d) { frameDelay = d; }
+	// A TimerWheel times delays shorter than one tick as one tick.
+	virtual void setFrameDelay(float d) { frameDelay = d; startAnimation(); }
 
 	// Set starting and ending frames of animation.
-	virtual void setFrames(int s, int e) { startFrame = s; endFrame = e; }
+	virtual void setFrames(int s, int e) { startFrame = s; endFrame = e; startAnimation(); }
 
 	// Set current frame of animation.
 	virtual void setCurrentFrame(int c);
@@ -137,20 +214,58 @@ public:
 	virtual void setRect();
 
 	// Set spriteData.rect to r.
-	virtual void setSpriteDataRect(RECT r) { spriteData.rect = r; }
+	virtual void setSpriteDataRect(RECT r) { spriteData.rect = r; imageNS::markChanged(); }
 
 	// Set animation loop. lp = true to loop.
 	virtual void setLoop(bool lp) { loop = lp; }
 
 	// Set animation complete Boolean.
-	virtual void setAnimationComplete(bool a) { animComplete = a; };
+	virtual void setAnimationComplete(bool a) { animComplete = a; startAnimation(); };
 
 	// Set color filter. (use WHITE for no change)
-	virtual void setColorFilter(COLOR_ARGB color) { colorFilter = color; }
+	virtual void setColorFilter(COLOR_ARGB color) {
+		if (colorFilter != color) { colorFilter = color; imageNS::markChanged(); }
+	}
+
+	// Attach the image to node of a TransformHierarchy, NULL to detach.
+	// An attached image is drawn centered on the node's cached world transform,
+	// so its X, Y, scale and angle are not used by draw().
+	virtual void setTransformNode(TransformHierarchy *h, int node) {
+		transforms = h;
+		transformNode = node;
+		imageNS::markChanged();
+	}
+
+	// Return the TransformHierarchy the image is attached to, NULL if none.
+	virtual TransformHierarchy* getTransforms() { return transforms; }
+
+	// Return the TransformHierarchy node.
+	virtual int getTransformNode() { return transformNode; }
+
+	// Draw the frames as meshes that trim transparent pixels, when drawn to a
+	// DrawList or SpriteBucket. NULL to draw quads.
+	// Pre: *m was built for this Image's frame size and columns
+	virtual void setMeshes(const SpriteMeshSheet *m) {
+		meshes = m;
+		imageNS::markChanged();
+	}
+
+	// Return the meshes of the frames, NULL if quads are drawn.
+	virtual const SpriteMeshSheet* getMeshes() { return meshes; }
+
+	// Time the animation with a repeating timer on w instead of in update(),
+	// so images that are not animating cost nothing per frame. NULL to time
+	// it in update().
+	// Pre: w outlives the image or is replaced first
+	virtual void setTimerWheel(TimerWheel *w);
+
+	// Return the wheel that times the animation, NULL if none.
+	virtual TimerWheel* getTimerWheel() { return timers; }
 
 	// Set TextureManager
 	virtual void setTextureManager(TextureManager *textureM) {
 		textureManager = textureM;
+		imageNS::markChanged();
 	}
 };
 
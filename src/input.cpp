@@ -1,4 +1,5 @@
 #include "input.h"
+#include <fstream>
 
 //=============================================================================
 // default constructor
@@ -26,10 +27,10 @@ Input::Input() {
 	mouseX1Button = false;		// true if X1 mouse button is down
 	mouseX2Button = false;		// true if X2 mouse button is down
 
-	for (int i = 0; i < MAX_CONTROLLERS; i++) {
-		controllers[i].vibrateTimeLeft = 0;
-		controllers[i].vibrateTimeRight = 0;
-	}
+	mouseCaptured = false;
+	replayMode = inputNS::LIVE;
+	replayCursor = 0;
+	frameIndex = 0;
 }
 
 //=============================================================================
@@ -60,7 +61,7 @@ void Input::initialize(HWND hwnd, bool capture) {
 			SetCapture(hwnd);	// capture mouse
 
 		// clear controllers state
-		ZeroMemory(controllers, sizeof(ControllerState)* MAX_CONTROLLERS);
+		controllers.reset();
 		// check for connected controllers
 		checkControllers();
 	}
@@ -79,6 +80,8 @@ void Input::keyDown(WPARAM wParam) {
 		keysDown[wParam] = true;    // update keysDown array
 		// key has been "pressed", erased by clear()
 		keysPressed[wParam] = true; // update keysPressed array
+		if (replayMode == inputNS::RECORDING)
+			recordEvent(inputNS::EVENT_KEY_DOWN, (UCHAR)wParam);
 	}
 }
 
@@ -88,8 +91,11 @@ void Input::keyDown(WPARAM wParam) {
 //=============================================================================
 void Input::keyUp(WPARAM wParam) {
 	// make sure key code is within buffer range
-	if (wParam < inputNS::KEYS_ARRAY_LEN)
+	if (wParam < inputNS::KEYS_ARRAY_LEN) {
 		keysDown[wParam] = false;
+		if (replayMode == inputNS::RECORDING)
+			recordEvent(inputNS::EVENT_KEY_UP, (UCHAR)wParam);
+	}
 }
 
 //=============================================================================
@@ -97,6 +103,9 @@ void Input::keyUp(WPARAM wParam) {
 // Pre: wParam contains the char
 //=============================================================================
 void Input::keyIn(WPARAM wParam) {
+	if (replayMode == inputNS::RECORDING)
+		recordEvent(inputNS::EVENT_CHAR, (UCHAR)wParam);
+
 	if (newLine) {								// if start of new line
 		textIn.clear();
 		newLine = false;
@@ -184,6 +193,8 @@ void Input::clear(UCHAR what) {
 void Input::mouseIn(LPARAM lParam) {
 	mouseX = GET_X_LPARAM(lParam);
 	mouseY = GET_Y_LPARAM(lParam);
+	if (replayMode == inputNS::RECORDING)
+		recordEvent(inputNS::EVENT_MOUSE, 0, (LONG)lParam);
 }
 
 //=============================================================================
@@ -198,61 +209,288 @@ void Input::mouseRawIn(LPARAM lParam) {
 
 	RAWINPUT* raw = (RAWINPUT*)lpb;
 
-	if (raw->header.dwType == RIM_TYPEMOUSE) {
-		mouseRawX = raw->data.mouse.lLastX;
-		mouseRawY = raw->data.mouse.lLastY;
-	}
+	if (raw->header.dwType == RIM_TYPEMOUSE)
+		setMouseRaw(raw->data.mouse.lLastX, raw->data.mouse.lLastY);
+}
+
+//=============================================================================
+// Save raw mouse movement
+//=============================================================================
+void Input::setMouseRaw(LONG x, LONG y) {
+	mouseRawX = x;
+	mouseRawY = y;
+	if (replayMode == inputNS::RECORDING)
+		recordEvent(inputNS::EVENT_MOUSE_RAW, 0, x, y);
 }
 
 //=============================================================================
 // Check for connected controllers
 //=============================================================================
 void Input::checkControllers() {
-	DWORD result;
-	for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
-		result = XInputGetState(i, &controllers[i].state);
-		if (result == ERROR_SUCCESS)
-			controllers[i].connected = true;
-		else
-			controllers[i].connected = false;
+	if (replayMode == inputNS::PLAYBACK)	// controller state comes from beginFrame()
+		return;
+	recordControllers(controllers.probeAll(), frameIndex);
+}
+
+//=============================================================================
+// Read state of controllers that are due
+//=============================================================================
+void Input::readControllers(float frameTime) {
+	if (replayMode == inputNS::PLAYBACK)
+		return;
+	// read at end of frame, so first used by the next frame
+	recordControllers(controllers.poll(frameTime), frameIndex + 1);
+}
+
+//=============================================================================
+// Vibrate connected controllers
+//=============================================================================
+void Input::vibrateControllers(float frameTime) {
+	// replayed controllers may not exist
+	controllers.updateVibration(frameTime, replayMode != inputNS::PLAYBACK);
+}
+
+//=============================================================================
+// Return the number of payload bytes stored after the frame, type and code
+// of each event in a replay file
+//=============================================================================
+static size_t eventPayloadSize(UCHAR type) {
+	switch (type) {
+	case inputNS::EVENT_MOUSE:			return 4;	// a
+	case inputNS::EVENT_MOUSE_RAW:		return 8;	// a, b
+	case inputNS::EVENT_MOUSE_BUTTON:	return 1;	// a
+	case inputNS::EVENT_MOUSE_XBUTTON:	return 4;	// a
+	case inputNS::EVENT_CONTROLLER:		return 1 + sizeof(XINPUT_GAMEPAD);	// a, gamepad
+	case inputNS::EVENT_FRAME_END:		return 4;	// b
+	default:							return 0;	// key and char events use code only
 	}
 }
 
 //=============================================================================
-// Read state of connected controllers
+// Append an event to the recording
+//=============================================================================
+void Input::recordEvent(UCHAR type, UCHAR code, LONG a, LONG b) {
+	InputEvent e;
+	ZeroMemory(&e, sizeof(e));
+	e.frame = frameIndex;
+	e.type = type;
+	e.code = code;
+	e.a = a;
+	e.b = b;
+	events.push_back(e);
+}
+
+//=============================================================================
+// Record state of controller n
+//=============================================================================
+void Input::recordController(DWORD n, DWORD frame) {
+	if (replayMode != inputNS::RECORDING)
+		return;
+	recordEvent(inputNS::EVENT_CONTROLLER, (UCHAR)n, controllers[n].connected ? 1 : 0);
+	events.back().frame = frame;
+	events.back().gamepad = controllers[n].state.Gamepad;
+}
+
+//=============================================================================
+// Record the controllers in the changed bit mask
 //=============================================================================
-void Input::readControllers() {
-	DWORD result;
+void Input::recordControllers(DWORD changed, DWORD frame) {
 	for (DWORD i = 0; i < MAX_CONTROLLERS; i++) {
-		if (controllers[i].connected) {
-			result = XInputGetState(i, &controllers[i].state);
-			if (result == ERROR_DEVICE_NOT_CONNECTED)    // if controller disconnected
-				controllers[i].connected = false;
-		}
+		if (changed & (1 << i))
+			recordController(i, frame);
 	}
 }
 
 //=============================================================================
-// Vibrate connected controllers
+// Start of frame. Apply replayed events for this frame.
 //=============================================================================
-void Input::vibrateControllers(float frameTime) {
-	for (int i = 0; i < MAX_CONTROLLERS; i++) {
-		if (controllers[i].connected) {
-			controllers[i].vibrateTimeLeft -= frameTime;
+void Input::beginFrame() {
+	if (replayMode != inputNS::PLAYBACK)
+		return;
 
-			if (controllers[i].vibrateTimeLeft < 0) {
-				controllers[i].vibrateTimeLeft = 0;
-				controllers[i].vibration.wLeftMotorSpeed = 0;
+	while (replayCursor < events.size() && events[replayCursor].frame <= frameIndex) {
+		const InputEvent &e = events[replayCursor++];
+		switch (e.type) {
+		case inputNS::EVENT_KEY_DOWN:		keyDown(e.code); break;
+		case inputNS::EVENT_KEY_UP:			keyUp(e.code); break;
+		case inputNS::EVENT_CHAR:			keyIn(e.code); break;
+		case inputNS::EVENT_MOUSE:			mouseIn(e.a); break;
+		case inputNS::EVENT_MOUSE_RAW:		setMouseRaw(e.a, e.b); break;
+		case inputNS::EVENT_MOUSE_XBUTTON:	setMouseXButton(e.a); break;
+		case inputNS::EVENT_MOUSE_BUTTON:
+			if (e.code == inputNS::MOUSE_L)
+				setMouseLButton(e.a != 0);
+			else if (e.code == inputNS::MOUSE_M)
+				setMouseMButton(e.a != 0);
+			else
+				setMouseRButton(e.a != 0);
+			break;
+		case inputNS::EVENT_CONTROLLER:
+			if (e.code < MAX_CONTROLLERS) {
+				controllers[e.code].connected = (e.a != 0);
+				controllers[e.code].state.Gamepad = e.gamepad;
+				controllers[e.code].state.dwPacketNumber++;
 			}
+			break;
+		}
+	}
+}
 
-			controllers[i].vibrateTimeRight -= frameTime;
+//=============================================================================
+// End of frame. Record the frameTime and advance the frame number.
+//=============================================================================
+void Input::endFrame(float frameTime) {
+	if (replayMode == inputNS::RECORDING) {
+		LONG bits = 0;
+		memcpy(&bits, &frameTime, sizeof(frameTime));
+		recordEvent(inputNS::EVENT_FRAME_END, 0, 0, bits);
+	}
+	frameIndex++;
+}
 
-			if (controllers[i].vibrateTimeRight < 0) {
-				controllers[i].vibrateTimeRight = 0;
-				controllers[i].vibration.wRightMotorSpeed = 0;
-			}
+//=============================================================================
+// Start recording input
+// Current controller states are saved so replay starts from the same state.
+//=============================================================================
+void Input::startRecording(const char *file) {
+	replayFile = file;
+	events.clear();
+	frameIndex = 0;
+	replayMode = inputNS::RECORDING;
+	for (DWORD i = 0; i < MAX_CONTROLLERS; i++)
+		recordController(i, 0);
+}
+
+//=============================================================================
+// Write recorded events to the replay file
+// File layout: magic, version, event count, then per event
+// frame (4 bytes), type (1), code (1) and the type's payload.
+// Returns false on error
+//=============================================================================
+bool Input::stopRecording() {
+	if (replayMode != inputNS::RECORDING)
+		return false;
+	replayMode = inputNS::LIVE;
+
+	std::ofstream out(replayFile.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+
+	DWORD header[3] = { inputNS::REPLAY_MAGIC, inputNS::REPLAY_VERSION, (DWORD)events.size() };
+	for (int i = 0; i < 3; i++) {
+		UINT32 h = (UINT32)header[i];
+		out.write((const char*)&h, 4);
+	}
+
+	for (size_t i = 0; i < events.size(); i++) {
+		const InputEvent &e = events[i];
+		UINT32 frame = (UINT32)e.frame;
+		INT32 a = (INT32)e.a;
+		INT32 b = (INT32)e.b;
+		UCHAR flag = (UCHAR)(e.a != 0);
+		out.write((const char*)&frame, 4);
+		out.put((char)e.type);
+		out.put((char)e.code);
+		switch (e.type) {
+		case inputNS::EVENT_MOUSE:
+		case inputNS::EVENT_MOUSE_XBUTTON:
+			out.write((const char*)&a, 4);
+			break;
+		case inputNS::EVENT_MOUSE_RAW:
+			out.write((const char*)&a, 4);
+			out.write((const char*)&b, 4);
+			break;
+		case inputNS::EVENT_MOUSE_BUTTON:
+			out.put((char)flag);
+			break;
+		case inputNS::EVENT_CONTROLLER:
+			out.put((char)flag);
+			out.write((const char*)&e.gamepad, sizeof(XINPUT_GAMEPAD));
+			break;
+		case inputNS::EVENT_FRAME_END:
+			out.write((const char*)&b, 4);
+			break;
+		}
+	}
+	events.clear();
+	return out.good();
+}
+
+//=============================================================================
+// Load a replay file and play it back in place of live input
+// Returns false on error
+//=============================================================================
+bool Input::startPlayback(const char *file) {
+	std::ifstream in(file, std::ios::binary);
+	if (!in)
+		return false;
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	UINT32 header[3];
+	if (data.size() < sizeof(header))
+		return false;
+	memcpy(header, &data[0], sizeof(header));
+	if (header[0] != inputNS::REPLAY_MAGIC || header[1] != inputNS::REPLAY_VERSION)
+		return false;
 
-			XInputSetState(i, &controllers[i].vibration);
+	events.clear();
+	replayFrameTimes.clear();
+	events.reserve(header[2]);
+	size_t pos = sizeof(header);
+	for (UINT32 i = 0; i < header[2]; i++) {
+		if (pos + 6 > data.size())
+			return false;
+		InputEvent e;
+		ZeroMemory(&e, sizeof(e));
+		UINT32 frame;
+		memcpy(&frame, &data[pos], 4);
+		e.frame = frame;
+		e.type = (UCHAR)data[pos + 4];
+		e.code = (UCHAR)data[pos + 5];
+		pos += 6;
+
+		size_t size = eventPayloadSize(e.type);
+		if (pos + size > data.size())
+			return false;
+		INT32 v;
+		switch (e.type) {
+		case inputNS::EVENT_MOUSE:
+		case inputNS::EVENT_MOUSE_XBUTTON:
+			memcpy(&v, &data[pos], 4);
+			e.a = v;
+			break;
+		case inputNS::EVENT_MOUSE_RAW:
+			memcpy(&v, &data[pos], 4);
+			e.a = v;
+			memcpy(&v, &data[pos + 4], 4);
+			e.b = v;
+			break;
+		case inputNS::EVENT_MOUSE_BUTTON:
+			e.a = data[pos];
+			break;
+		case inputNS::EVENT_CONTROLLER:
+			e.a = data[pos];
+			memcpy(&e.gamepad, &data[pos + 1], sizeof(XINPUT_GAMEPAD));
+			break;
+		case inputNS::EVENT_FRAME_END:
+			float t;
+			memcpy(&t, &data[pos], 4);
+			replayFrameTimes.push_back(t);
+			break;
 		}
+		pos += size;
+		events.push_back(e);
 	}
+
+	// start from a clean input state
+	clearAll();
+	mouseLButton = mouseMButton = mouseRButton = false;
+	mouseX1Button = mouseX2Button = false;
+	newLine = true;
+	charIn = 0;
+	controllers.reset();
+	replayCursor = 0;
+	frameIndex = 0;
+	replayMode = inputNS::PLAYBACK;
+	return true;
 }
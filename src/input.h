@@ -7,7 +7,9 @@ class Input;
 #include <Windows.h>
 #include <windowsx.h>
 #include <string>
+#include <vector>
 #include <XInput.h>
+#include "controllerManager.h"
 #include "constants.h"
 #include "gameError.h"
 
@@ -29,11 +31,34 @@ namespace inputNS {
 	const UCHAR MOUSE = 4;
 	const UCHAR TEXT_IN = 8;
 	const UCHAR KEYS_MOUSE_TEXT = KEYS_DOWN + KEYS_PRESSED + MOUSE + TEXT_IN;
+
+	// input record/replay modes
+	enum REPLAY_MODE { LIVE, RECORDING, PLAYBACK };
+
+	// recorded event types, stored as one byte in the replay file
+	enum EVENT_TYPE {
+		EVENT_KEY_DOWN = 1,
+		EVENT_KEY_UP,
+		EVENT_CHAR,
+		EVENT_MOUSE,
+		EVENT_MOUSE_RAW,
+		EVENT_MOUSE_BUTTON,
+		EVENT_MOUSE_XBUTTON,
+		EVENT_CONTROLLER,
+		EVENT_FRAME_END
+	};
+
+	// code values for EVENT_MOUSE_BUTTON
+	const UCHAR MOUSE_L = 0;
+	const UCHAR MOUSE_M = 1;
+	const UCHAR MOUSE_R = 2;
+
+	const DWORD REPLAY_MAGIC = 0x52495844;	// "DXIR"
+	const DWORD REPLAY_VERSION = 1;
 }
 
 const DWORD GAMEPAD_THUMBSTICK_DEADZONE = (DWORD)(0.20f * 0X7FFF);  // default to 20% of range as deadzone
 const DWORD GAMEPAD_TRIGGER_DEADZONE = 30;							// trigger range 0-255
-const DWORD MAX_CONTROLLERS = 4;									// Maximum number of controllers supported by XInput
 
 // Bit corresponding to gamepad button in state.Gamepad.wButtons
 const DWORD GAMEPAD_DPAD_UP = 0x0001;
@@ -51,12 +76,16 @@ const DWORD GAMEPAD_B = 0x2000;
 const DWORD GAMEPAD_X = 0x4000;
 const DWORD GAMEPAD_Y = 0x8000;
 
-struct ControllerState {
-	XINPUT_STATE        state;
-	XINPUT_VIBRATION    vibration;
-	float               vibrateTimeLeft;    // mSec
-	float               vibrateTimeRight;   // mSec
-	bool                connected;
+// One recorded input event.
+// frame is the index of the frame the event was delivered to. Replay files
+// store only the fields used by each event type.
+struct InputEvent {
+	DWORD           frame;          // frame index
+	UCHAR           type;           // inputNS::EVENT_TYPE
+	UCHAR           code;           // key, char, button or controller number
+	LONG            a;              // first value (lParam, raw X, wParam, connected)
+	LONG            b;              // second value (raw Y, frameTime bits)
+	XINPUT_GAMEPAD  gamepad;        // controller state for EVENT_CONTROLLER
 };
 
 class Input {
@@ -75,7 +104,29 @@ private:
 	bool mouseRButton;								// true if right mouse button down
 	bool mouseX1Button;								// true if X1 mouse button down
 	bool mouseX2Button;								// true if X2 mouse button down
-	ControllerState controllers[MAX_CONTROLLERS];   // state of controllers
+	ControllerManager controllers;					// state of controllers
+
+	// Record and replay
+	inputNS::REPLAY_MODE replayMode;				// LIVE, RECORDING or PLAYBACK
+	std::string replayFile;							// file written by stopRecording()
+	std::vector<InputEvent> events;					// recorded or loaded event stream
+	std::vector<float> replayFrameTimes;			// frameTime of each recorded frame
+	size_t replayCursor;							// next event to replay
+	DWORD frameIndex;								// current frame number
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Append an event to the recording.
+	void recordEvent(UCHAR type, UCHAR code, LONG a = 0, LONG b = 0);
+
+	// Record the state of controller n if recording.
+	// frame is the frame whose update() first sees the state.
+	void recordController(DWORD n, DWORD frame);
+
+	// Record the controllers in the changed bit mask if recording.
+	void recordControllers(DWORD changed, DWORD frame);
+
+	// Save raw mouse movement.
+	void setMouseRaw(LONG x, LONG y);
 
 public:
 	// Constructor
@@ -138,18 +189,32 @@ public:
 	void mouseRawIn(LPARAM);
 
 	// Save state of mouse button
-	void setMouseLButton(bool b) { mouseLButton = b; }
+	void setMouseLButton(bool b) {
+		mouseLButton = b;
+		if (replayMode == inputNS::RECORDING)
+			recordEvent(inputNS::EVENT_MOUSE_BUTTON, inputNS::MOUSE_L, b);
+	}
 
 	// Save state of mouse button
-	void setMouseMButton(bool b) { mouseMButton = b; }
+	void setMouseMButton(bool b) {
+		mouseMButton = b;
+		if (replayMode == inputNS::RECORDING)
+			recordEvent(inputNS::EVENT_MOUSE_BUTTON, inputNS::MOUSE_M, b);
+	}
 
 	// Save state of mouse button
-	void setMouseRButton(bool b) { mouseRButton = b; }
+	void setMouseRButton(bool b) {
+		mouseRButton = b;
+		if (replayMode == inputNS::RECORDING)
+			recordEvent(inputNS::EVENT_MOUSE_BUTTON, inputNS::MOUSE_R, b);
+	}
 
 	// Save state of mouse button
 	void setMouseXButton(WPARAM wParam) {
 		mouseX1Button = (wParam & MK_XBUTTON1) ? true : false;
 		mouseX2Button = (wParam & MK_XBUTTON2) ? true : false;
+		if (replayMode == inputNS::RECORDING)
+			recordEvent(inputNS::EVENT_MOUSE_XBUTTON, 0, (LONG)wParam);
 	}
 
 	// Return mouse X position
@@ -181,11 +246,18 @@ public:
 	// Return state of X2 mouse button.
 	bool getMouseX2Button() const { return mouseX2Button; }
 
-	// Update connection status of game controllers.
+	// Update connection status of all game controllers now.
 	void checkControllers();
 
-	// Save input from connected game controllers.
-	void readControllers();
+	// A device was added or removed. Empty controller slots are checked on
+	// the next readControllers().
+	void onDeviceChange() { controllers.requestProbe(); }
+
+	// Save input from game controllers that are due to be read.
+	void readControllers(float frameTime);
+
+	// Return the controller manager, used to set poll rates and backend.
+	ControllerManager* getControllerManager() { return &controllers; }
 
 	// Return state of specified game controller.
 	const ControllerState* getControllerState(UINT n) {
@@ -345,26 +417,55 @@ public:
 	// Left is low frequency vibration.
 	// speed 0=off, 65536=100 percent
 	// sec is time to vibrate in seconds
-	void gamePadVibrateLeft(UINT n, WORD speed, float sec) {
-		if (n > MAX_CONTROLLERS - 1)
-			n = MAX_CONTROLLERS - 1;
-		controllers[n].vibration.wLeftMotorSpeed = speed;
-		controllers[n].vibrateTimeLeft = sec;
-	}
+	void gamePadVibrateLeft(UINT n, WORD speed, float sec) { controllers.vibrateLeft(n, speed, sec); }
 
 	// Vibrate controller n right motor.
 	// Right is high frequency vibration.
 	// speed 0=off, 65536=100 percent
 	// sec is time to vibrate in seconds
-	void gamePadVibrateRight(UINT n, WORD speed, float sec) {
-		if (n > MAX_CONTROLLERS - 1)
-			n = MAX_CONTROLLERS - 1;
-		controllers[n].vibration.wRightMotorSpeed = speed;
-		controllers[n].vibrateTimeRight = sec;
-	}
+	void gamePadVibrateRight(UINT n, WORD speed, float sec) { controllers.vibrateRight(n, speed, sec); }
 
 	// Vibrates the connected controllers for the desired time.
 	void vibrateControllers(float frameTime);
+
+	// Start recording all input events to file.
+	// The file is written when stopRecording() is called.
+	void startRecording(const char *file);
+
+	// Write the recorded events to the file given to startRecording().
+	// Returns false if the file could not be written.
+	bool stopRecording();
+
+	// Load a replay file and replace live input with its events.
+	// Returns false if the file could not be read.
+	bool startPlayback(const char *file);
+
+	// Return true if recording input.
+	bool isRecording() const { return replayMode == inputNS::RECORDING; }
+
+	// Return true if input comes from a replay file instead of Windows.
+	bool isReplaying() const { return replayMode == inputNS::PLAYBACK; }
+
+	// Return true when a replay has played its last frame.
+	bool replayFinished() const {
+		return replayMode == inputNS::PLAYBACK && frameIndex >= replayFrameTimes.size();
+	}
+
+	// Return current frame number.
+	DWORD getFrameIndex() const { return frameIndex; }
+
+	// Return the frameTime recorded for the current frame, or 0 if not replaying.
+	float getReplayFrameTime() const {
+		if (replayMode != inputNS::PLAYBACK || frameIndex >= replayFrameTimes.size())
+			return 0;
+		return replayFrameTimes[frameIndex];
+	}
+
+	// Call at the start of each frame. Applies replayed events for this frame.
+	void beginFrame();
+
+	// Call at the end of each frame, after all input checks are done.
+	void endFrame(float frameTime);
 };
 
 #endif
\ No newline at end of file
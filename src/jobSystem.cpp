@@ -0,0 +1,128 @@
+#include "jobSystem.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+JobSystem::JobSystem() : next(0) {
+	job = NULL;
+	count = 0;
+	grain = 1;
+	generation = 0;
+	working = 0;
+	quit = false;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+JobSystem::~JobSystem() {
+	shutdown();
+}
+
+//=============================================================================
+// Start worker threads
+//=============================================================================
+void JobSystem::initialize(int threads) {
+	shutdown();
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads < 1)						// the core count is not known
+		threads = 1;
+	if (threads > jobSystemNS::MAX_THREADS)
+		threads = jobSystemNS::MAX_THREADS;
+	quit = false;
+	for (int i = 0; i < threads; i++)
+		scratch[i].initialize(memoryNS::SCRATCH_ARENA_BYTES);
+	for (int i = 1; i < threads; i++)		// the caller is worker 0
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+//=============================================================================
+// Stop and join worker threads
+//=============================================================================
+void JobSystem::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+	for (int i = 0; i < jobSystemNS::MAX_THREADS; i++)
+		scratch[i].release();
+}
+
+//=============================================================================
+// Worker thread main loop
+//=============================================================================
+void JobSystem::workerLoop(int worker) {
+	int seen = 0;
+	memoryNS::setScratchArena(&scratch[worker]);
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!quit && generation == seen)
+				wake.wait(lock);
+			if (quit)
+				return;
+			seen = generation;
+		}
+		runChunks(worker);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--working == 0)
+				done.notify_one();
+		}
+	}
+}
+
+//=============================================================================
+// Claim and run chunks of the current job
+//=============================================================================
+void JobSystem::runChunks(int worker) {
+	for (;;) {
+		int begin = next.fetch_add(grain);
+		if (begin >= count)
+			return;
+		int end = (begin + grain < count) ? begin + grain : count;
+		(*job)(begin, end, worker);
+	}
+}
+
+//=============================================================================
+// Run job over [0, count) on all threads
+//=============================================================================
+void JobSystem::parallelFor(int n, int g, const Job &j) {
+	if (n <= 0)
+		return;
+	if (g < 1)
+		g = 1;
+	MemoryArena *callerScratch = memoryNS::getScratchArena();
+	memoryNS::setScratchArena(&scratch[0]);
+	for (size_t i = 0; i <= workers.size(); i++)
+		scratch[i].reset();
+	if (workers.empty() || n <= g) {		// not worth waking workers
+		j(0, n, 0);
+		memoryNS::setScratchArena(callerScratch);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &j;
+		count = n;
+		grain = g;
+		next = 0;
+		working = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+	runChunks(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (working > 0)
+		done.wait(lock);
+	job = NULL;
+	memoryNS::setScratchArena(callerScratch);
+}
@@ -0,0 +1,71 @@
+#ifndef _JOBSYSTEM_H
+#define _JOBSYSTEM_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "memoryArena.h"
+
+namespace jobSystemNS {
+	const int MAX_THREADS = 16;		// worker threads including the calling thread
+}
+
+// Pool of worker threads that split a range of work between them.
+// Workers sleep between jobs, so an idle JobSystem costs no CPU time.
+class JobSystem {
+public:
+	// Work function, called with a range [begin, end) and the worker number.
+	// Worker 0 is the thread that called parallelFor().
+	typedef std::function<void(int begin, int end, int worker)> Job;
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex          mutex;
+	std::condition_variable wake;		// signalled when a job starts or on shutdown
+	std::condition_variable done;		// signalled when the last worker finishes
+	const Job           *job;			// current job
+	std::atomic<int>    next;			// start of the next unclaimed chunk
+	int                 count;			// size of the current range
+	int                 grain;			// chunk size of the current job
+	int                 generation;		// incremented for each job
+	int                 working;		// workers still running the current job
+	bool                quit;			// true to stop workers
+	MemoryArena         scratch[jobSystemNS::MAX_THREADS];	// scratch arena of each worker
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Worker thread main loop.
+	void workerLoop(int worker);
+
+	// Claim and run chunks of the current job until none are left.
+	void runChunks(int worker);
+
+public:
+	// Constructor
+	JobSystem();
+
+	// Destructor
+	virtual ~JobSystem();
+
+	// Start worker threads.
+	// threads = total threads including the caller, 0 for one per CPU core.
+	void initialize(int threads = 0);
+
+	// Stop and join worker threads.
+	void shutdown();
+
+	// Return number of threads that run jobs, including the caller.
+	int getThreadCount() const { return (int)workers.size() + 1; }
+
+	// Call job over [0, count) in chunks of grain and wait until all chunks are done.
+	// Chunk boundaries are multiples of grain.
+	// Inside the job memoryNS::getScratchArena() returns the arena of the
+	// worker; the arenas are reset before each job starts.
+	// Must not be called from inside a job.
+	void parallelFor(int count, int grain, const Job &job);
+};
+
+#endif
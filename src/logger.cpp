@@ -0,0 +1,363 @@
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace logNS {
+	const char *LEVEL_NAMES[] = { "debug", "info", "warning", "error" };
+
+	std::atomic<UINT> nextId(1);		// id of the next logger
+
+	// Logger and buffer of this thread
+	static __declspec(thread) UINT threadLogger = 0;
+	static __declspec(thread) void *threadBuffer = NULL;
+	static __declspec(thread) int threadNumber = 0;
+
+	// Append s to line as a JSON string
+	static void appendString(std::string &line, const char *s) {
+		line += '"';
+		for (; *s; s++) {
+			unsigned char c = (unsigned char)*s;
+			if (c == '"' || c == '\\') {
+				line += '\\';
+				line += (char)c;
+			}
+			else if (c < 0x20) {
+				char escape[8];
+				sprintf_s(escape, sizeof(escape), "\\u%04x", c);
+				line += escape;
+			}
+			else
+				line += (char)c;
+		}
+		line += '"';
+	}
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+Logger::Logger() : bufferCount(0), minLevel(logNS::LEVEL_INFO) {
+	for (int i = 0; i < logNS::MAX_THREADS; i++)
+		buffers[i] = NULL;
+	id = logNS::nextId++;
+	rateLimit = logNS::RATE_LIMIT;
+	rateWindow = 0;
+	startTime = 0;
+	running = false;
+	debugOutput = true;
+	flushRequested = 0;
+	flushCompleted = 0;
+	quit = false;
+	written = 0;
+	suppressed = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+Logger::~Logger() {
+	shutdown();
+	for (int i = 0; i < logNS::MAX_THREADS; i++)
+		delete buffers[i];
+}
+
+//=============================================================================
+// Open the file and start the flush thread
+//=============================================================================
+bool Logger::initialize(const char *file, logNS::LEVEL level) {
+	shutdown();
+	try {
+		out.open(file);
+		if (!out)
+			return false;
+		LARGE_INTEGER freq, now;
+		QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&now);
+		rateWindow = freq.QuadPart;
+		startTime = now.QuadPart;
+		minLevel.store((int)level);
+		quit = false;
+		running = true;
+		flusher = std::thread(&Logger::flushLoop, this);
+	}
+	catch (...) {
+		running = false;
+		return false;
+	}
+	return true;
+}
+
+//=============================================================================
+// Write everything, stop the flush thread and close the file
+//=============================================================================
+void Logger::shutdown() {
+	if (!running)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_one();
+	flusher.join();
+	running = false;
+	flushed.notify_all();
+	out.close();
+}
+
+//=============================================================================
+// Wait until everything logged so far is written
+//=============================================================================
+void Logger::flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!running || quit)
+		return;
+	UINT64 request = ++flushRequested;
+	wake.notify_one();
+	flushed.wait(lock, [this, request] { return flushCompleted >= request || !running; });
+}
+
+//=============================================================================
+// Return number of records dropped because a buffer was full
+//=============================================================================
+UINT64 Logger::getDropped() const {
+	UINT64 dropped = 0;
+	int count = bufferCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++)
+		dropped += buffers[i]->dropped.load(std::memory_order_relaxed);
+	return dropped;
+}
+
+//=============================================================================
+// Return the calling thread's buffer
+// The buffer of the last logger used on each thread is kept in thread local
+// storage. Otherwise the lock is taken to find the thread's buffer, or add
+// one on its first call.
+//=============================================================================
+Logger::Buffer* Logger::threadBuffer() {
+	if (logNS::threadLogger == id)
+		return (Buffer*)logNS::threadBuffer;
+	if (!running)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::thread::id thread = std::this_thread::get_id();
+	int n = bufferCount.load(std::memory_order_relaxed);
+	Buffer *buffer = NULL;
+	for (int b = 0; b < n && buffer == NULL; b++)
+		if (buffers[b]->owner == thread) {
+			buffer = buffers[b];
+			n = b;
+		}
+	if (buffer == NULL) {
+		if (n >= logNS::MAX_THREADS)
+			return NULL;
+		buffer = new (std::nothrow) Buffer;
+		if (buffer == NULL)
+			return NULL;
+		buffer->head.store(0);
+		buffer->tail.store(0);
+		buffer->dropped.store(0);
+		buffer->owner = thread;
+		memset(buffer->rates, 0, sizeof(buffer->rates));
+		buffers[n] = buffer;
+		bufferCount.store(n + 1, std::memory_order_release);
+	}
+	logNS::threadLogger = id;
+	logNS::threadBuffer = buffer;
+	logNS::threadNumber = n;
+	return buffer;
+}
+
+//=============================================================================
+// Claim the next record of the calling thread
+// The rate limit counts records of each format in one second windows.
+//=============================================================================
+LogRecord* Logger::beginRecord(logNS::LEVEL level, const char *format, Buffer *&buffer) {
+	buffer = threadBuffer();
+	if (buffer == NULL)
+		return NULL;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	UINT skipped = 0;
+	if (rateLimit > 0) {
+		// hash the format pointer; a format that loses its slot starts a new window
+		UINT slot = (UINT)(((UINT_PTR)format >> 3) * 2654435761u) >> 26 & (logNS::RATE_SLOTS - 1);
+		RateSlot &rate = buffer->rates[slot];
+		if (rate.format != format || now.QuadPart - rate.windowStart >= rateWindow) {
+			if (rate.format != format)
+				rate.suppressed = 0;
+			rate.format = format;
+			rate.windowStart = now.QuadPart;
+			rate.count = 0;
+		}
+		if (++rate.count > rateLimit) {
+			rate.suppressed++;
+			return NULL;
+		}
+		skipped = rate.suppressed;
+		rate.suppressed = 0;
+	}
+
+	UINT head = buffer->head.load(std::memory_order_relaxed);
+	if (head - buffer->tail.load(std::memory_order_acquire) >= logNS::BUFFER_RECORDS) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+	LogRecord &r = buffer->records[head & (logNS::BUFFER_RECORDS - 1)];
+	r.time = now.QuadPart;
+	r.format = format;
+	r.suppressed = skipped;
+	r.level = (BYTE)level;
+	r.argCount = 0;
+	r.textUsed = 0;
+	r.thread = (BYTE)logNS::threadNumber;
+	return &r;
+}
+
+//=============================================================================
+// Copy a string argument into the record's text, truncated to fit
+//=============================================================================
+void Logger::captureString(LogRecord &r, const char *v) {
+	UINT room = logNS::TEXT_BYTES - r.textUsed;
+	UINT length = 0;
+	while (v[length] && length + 1 < room)
+		length++;
+	if (room == 0) {						// empty, using the end of the last string
+		r.args[r.argCount].u = logNS::TEXT_BYTES - 1;
+		r.argTypes[r.argCount++] = logNS::ARG_STRING;
+		return;
+	}
+	memcpy(r.text + r.textUsed, v, length);
+	r.text[r.textUsed + length] = '\0';
+	r.args[r.argCount].u = r.textUsed;
+	r.argTypes[r.argCount++] = logNS::ARG_STRING;
+	r.textUsed = (BYTE)(r.textUsed + length + 1);
+}
+
+//=============================================================================
+// Flush thread main loop
+// Wakes every FLUSH_MS, or on flush() and shutdown().
+//=============================================================================
+void Logger::flushLoop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		wake.wait_for(lock, std::chrono::milliseconds(logNS::FLUSH_MS),
+			[this] { return quit || flushRequested != flushCompleted; });
+		UINT64 request = flushRequested;
+		bool stop = quit;
+		lock.unlock();
+		drain();
+		lock.lock();
+		flushCompleted = request;
+		flushed.notify_all();
+		if (stop)
+			break;
+	}
+}
+
+//=============================================================================
+// Drain every buffer and write the records in time order
+// Each buffer is already in time order, so the buffers are merged by
+// taking the earliest next record of any of them. Records stay in the
+// buffers until written, as the owners cannot reuse them before the tails
+// move, so nothing is copied or allocated.
+//=============================================================================
+void Logger::drain() {
+	UINT next[logNS::MAX_THREADS];
+	UINT end[logNS::MAX_THREADS];
+	int count = bufferCount.load(std::memory_order_acquire);
+	for (int b = 0; b < count; b++) {
+		next[b] = buffers[b]->tail.load(std::memory_order_relaxed);
+		end[b] = buffers[b]->head.load(std::memory_order_acquire);
+	}
+
+	bool any = false;
+	for (;;) {
+		const LogRecord *r = NULL;
+		int from = 0;
+		for (int b = 0; b < count; b++) {
+			if (next[b] == end[b])
+				continue;
+			const LogRecord *candidate = &buffers[b]->records[next[b] & (logNS::BUFFER_RECORDS - 1)];
+			if (r == NULL || candidate->time < r->time) {
+				r = candidate;
+				from = b;
+			}
+		}
+		if (r == NULL)
+			break;
+		line.clear();
+		formatRecord(*r);
+		out << line;
+		if (debugOutput && r->level >= logNS::LEVEL_WARNING)
+			OutputDebugString(line.c_str());
+		written++;
+		suppressed += r->suppressed;
+		next[from]++;
+		any = true;
+	}
+
+	for (int b = 0; b < count; b++)
+		buffers[b]->tail.store(end[b], std::memory_order_release);
+	if (any)
+		out.flush();
+}
+
+//=============================================================================
+// Append a record as a line of JSON
+// {"t":1.234567,"level":"info","thread":0,"msg":"...","args":[...],"suppressed":3}
+//=============================================================================
+void Logger::formatRecord(const LogRecord &r) {
+	using namespace logNS;
+	char number[64];
+	sprintf_s(number, sizeof(number), "{\"t\":%.6f,\"level\":\"",
+		(double)(r.time - startTime) / (double)rateWindow);
+	line += number;
+	line += LEVEL_NAMES[r.level];
+	sprintf_s(number, sizeof(number), "\",\"thread\":%d,\"msg\":", r.thread);
+	line += number;
+
+	// each argument as text, then the message with "{}" replaced
+	for (int a = 0; a < r.argCount; a++) {
+		switch (r.argTypes[a]) {
+		case ARG_INT:    sprintf_s(number, sizeof(number), "%lld", (long long)r.args[a].i); break;
+		case ARG_UINT:   sprintf_s(number, sizeof(number), "%llu", (unsigned long long)r.args[a].u); break;
+		case ARG_FLOAT:  sprintf_s(number, sizeof(number), "%g", r.args[a].f); break;
+		case ARG_BOOL:   sprintf_s(number, sizeof(number), "%s", r.args[a].u ? "true" : "false"); break;
+		case ARG_STRING: number[0] = '\0'; break;
+		}
+		argText[a] = (r.argTypes[a] == ARG_STRING) ? r.text + r.args[a].u : number;
+	}
+	message.clear();
+	int next = 0;
+	for (const char *f = r.format; *f; f++) {
+		if (f[0] == '{' && f[1] == '}' && next < r.argCount) {
+			message += argText[next++];
+			f++;
+		}
+		else
+			message += *f;
+	}
+	appendString(line, message.c_str());
+
+	if (r.argCount > 0) {
+		line += ",\"args\":[";
+		for (int a = 0; a < r.argCount; a++) {
+			if (a > 0)
+				line += ',';
+			if (r.argTypes[a] == ARG_STRING)
+				appendString(line, argText[a].c_str());
+			else if (r.argTypes[a] == ARG_FLOAT && r.args[a].f - r.args[a].f != 0)
+				line += "null";						// JSON has no infinity or NaN
+			else
+				line += argText[a];
+		}
+		line += ']';
+	}
+	if (r.suppressed > 0) {
+		sprintf_s(number, sizeof(number), ",\"suppressed\":%u", r.suppressed);
+		line += number;
+	}
+	line += "}\n";
+}
@@ -0,0 +1,232 @@
+#ifndef _LOGGER_H
+#define _LOGGER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace logNS {
+	enum LEVEL { LEVEL_DEBUG, LEVEL_INFO, LEVEL_WARNING, LEVEL_ERROR };
+	enum ARG_TYPE { ARG_INT, ARG_UINT, ARG_FLOAT, ARG_BOOL, ARG_STRING };
+
+	const int   MAX_THREADS = 32;		// threads that may log
+	const UINT  BUFFER_RECORDS = 8192;	// records buffered per thread, a power of 2
+	const int   MAX_ARGS = 4;			// arguments kept per record
+	const int   TEXT_BYTES = 64;		// bytes of string arguments per record
+	const int   RATE_SLOTS = 64;		// formats rate limited per thread, a power of 2
+	const UINT  RATE_LIMIT = 20;		// records per format per thread per second
+	const int   FLUSH_MS = 50;			// time between writes by the flush thread
+}
+
+// One log call, with its arguments captured but not formatted
+struct LogRecord {
+	INT64       time;					// Performance Counter
+	const char  *format;				// "{}" marks each argument
+	UINT        suppressed;				// records of this format dropped by the rate limit before this one
+	BYTE        level;
+	BYTE        argCount;
+	BYTE        argTypes[logNS::MAX_ARGS];
+	BYTE        textUsed;				// bytes of text holding string arguments
+	BYTE        thread;					// number of the logging thread's buffer
+	union {
+		INT64   i;
+		UINT64  u;
+		double  f;
+	} args[logNS::MAX_ARGS];			// string arguments are offsets into text
+	char        text[logNS::TEXT_BYTES];
+};
+
+// Structured log written by a background thread.
+// A log call only captures its format and arguments into a buffer owned by
+// the calling thread; there are no locks or I/O on the caller's side. The
+// flush thread drains every buffer, formats the records and writes them in
+// time order as one JSON object per line. The format must be a string that
+// lives as long as the logger, normally a literal; string arguments are
+// copied. A full buffer drops records rather than wait, and each format
+// logs at most RATE_LIMIT records per second on each thread; the count of
+// rate limited records is written with the next record of that format.
+class Logger {
+private:
+	// Rate of one format on one thread
+	struct RateSlot {
+		const char  *format;
+		INT64       windowStart;		// Performance Counter
+		UINT        count;				// records in this window
+		UINT        suppressed;			// records dropped since the last one written
+	};
+
+	// Single producer, single consumer ring of records for one thread
+	struct Buffer {
+		LogRecord   records[logNS::BUFFER_RECORDS];
+		std::atomic<UINT> head;			// next record to write, advanced by the owner
+		std::atomic<UINT> tail;			// next record to read, advanced by the flush thread
+		std::atomic<UINT> dropped;		// records dropped because the buffer was full
+		std::thread::id owner;			// thread that writes records
+		RateSlot    rates[logNS::RATE_SLOTS];	// used by the owner only
+	};
+
+	Buffer      *buffers[logNS::MAX_THREADS];
+	std::atomic<int> bufferCount;
+	UINT        id;						// tells apart loggers in thread local storage
+	std::atomic<int> minLevel;			// lower levels are ignored
+	UINT        rateLimit;				// records per format per thread per second, 0 for no limit
+	INT64       rateWindow;				// one second of Performance Counter
+	INT64       startTime;				// Performance Counter at initialize()
+	bool        running;
+	bool        debugOutput;			// also send warnings and errors to the debugger
+
+	// Flush thread
+	std::thread flusher;
+	std::mutex  mutex;
+	std::condition_variable wake;		// signalled on flush() and shutdown()
+	std::condition_variable flushed;	// signalled after each write
+	UINT64      flushRequested;
+	UINT64      flushCompleted;
+	bool        quit;
+	std::ofstream out;
+	std::string line;					// record being written
+	std::string message;				// its format with the arguments filled in
+	std::string argText[logNS::MAX_ARGS];	// its arguments as text
+	UINT64      written;
+	UINT64      suppressed;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return the calling thread's buffer, creating it on its first call.
+	// NULL if MAX_THREADS threads already have buffers.
+	Buffer* threadBuffer();
+
+	// Claim the next record of the calling thread for format.
+	// NULL if it is rate limited or the buffer is full.
+	LogRecord* beginRecord(logNS::LEVEL level, const char *format, Buffer *&buffer);
+
+	// Capture arguments into a record
+	static void capture(LogRecord &) {}
+	template<typename T, typename... Args>
+	static void capture(LogRecord &r, const T &value, const Args&... args) {
+		if (r.argCount < logNS::MAX_ARGS)
+			captureArg(r, value);
+		capture(r, args...);
+	}
+	static void captureArg(LogRecord &r, int v) { captureInt(r, v); }
+	static void captureArg(LogRecord &r, long v) { captureInt(r, v); }
+	static void captureArg(LogRecord &r, INT64 v) { captureInt(r, v); }
+	static void captureArg(LogRecord &r, unsigned int v) { captureUint(r, v); }
+	static void captureArg(LogRecord &r, unsigned long v) { captureUint(r, v); }
+	static void captureArg(LogRecord &r, UINT64 v) { captureUint(r, v); }
+	static void captureArg(LogRecord &r, float v) { captureFloat(r, v); }
+	static void captureArg(LogRecord &r, double v) { captureFloat(r, v); }
+	static void captureArg(LogRecord &r, bool v) {
+		r.args[r.argCount].u = v ? 1 : 0;
+		r.argTypes[r.argCount++] = logNS::ARG_BOOL;
+	}
+	static void captureArg(LogRecord &r, const char *v) { captureString(r, v ? v : "(null)"); }
+	static void captureArg(LogRecord &r, char *v) { captureString(r, v ? v : "(null)"); }
+	static void captureArg(LogRecord &r, const std::string &v) { captureString(r, v.c_str()); }
+	static void captureInt(LogRecord &r, INT64 v) {
+		r.args[r.argCount].i = v;
+		r.argTypes[r.argCount++] = logNS::ARG_INT;
+	}
+	static void captureUint(LogRecord &r, UINT64 v) {
+		r.args[r.argCount].u = v;
+		r.argTypes[r.argCount++] = logNS::ARG_UINT;
+	}
+	static void captureFloat(LogRecord &r, double v) {
+		r.args[r.argCount].f = v;
+		r.argTypes[r.argCount++] = logNS::ARG_FLOAT;
+	}
+	static void captureString(LogRecord &r, const char *v);
+
+	// Publish the record claimed by beginRecord().
+	static void commitRecord(Buffer *buffer) {
+		buffer->head.store(buffer->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Flush thread main loop.
+	void flushLoop();
+
+	// Drain every buffer and write the records in time order.
+	void drain();
+
+	// Append record r to line as JSON.
+	void formatRecord(const LogRecord &r);
+
+	// Loggers own a thread and buffers, so they are not copied
+	Logger(const Logger&);
+	Logger& operator=(const Logger&);
+
+public:
+	// Constructor
+	Logger();
+
+	// Destructor
+	virtual ~Logger();
+
+	// Open file and start the flush thread.
+	// level = lowest level logged
+	// Post: returns false on error
+	bool initialize(const char *file, logNS::LEVEL level = logNS::LEVEL_INFO);
+
+	// Write everything logged, stop the flush thread and close the file.
+	void shutdown();
+
+	// Log a record. Each "{}" in format is replaced by the next argument.
+	// Arguments may be integers, floats, bools, strings and std::strings;
+	// up to MAX_ARGS are kept.
+	template<typename... Args>
+	void log(logNS::LEVEL level, const char *format, const Args&... args) {
+		if ((int)level < minLevel.load(std::memory_order_relaxed))
+			return;
+		Buffer *buffer;
+		LogRecord *r = beginRecord(level, format, buffer);
+		if (r == NULL)
+			return;
+		capture(*r, args...);
+		commitRecord(buffer);
+	}
+
+	// Log at LEVEL_DEBUG.
+	template<typename... Args>
+	void debug(const char *format, const Args&... args) { log(logNS::LEVEL_DEBUG, format, args...); }
+
+	// Log at LEVEL_INFO.
+	template<typename... Args>
+	void info(const char *format, const Args&... args) { log(logNS::LEVEL_INFO, format, args...); }
+
+	// Log at LEVEL_WARNING.
+	template<typename... Args>
+	void warning(const char *format, const Args&... args) { log(logNS::LEVEL_WARNING, format, args...); }
+
+	// Log at LEVEL_ERROR.
+	template<typename... Args>
+	void error(const char *format, const Args&... args) { log(logNS::LEVEL_ERROR, format, args...); }
+
+	// Wait until everything logged before this call is written.
+	void flush();
+
+	// Set the lowest level logged.
+	void setLevel(logNS::LEVEL level) { minLevel.store((int)level); }
+
+	// Set records per format per thread per second, 0 for no limit.
+	// Pre: nothing has been logged yet
+	void setRateLimit(UINT perSecond) { rateLimit = perSecond; }
+
+	// Also send warnings and errors to the debugger with OutputDebugString().
+	void setDebugOutput(bool d) { debugOutput = d; }
+
+	// Return number of records written, as of the last flush().
+	UINT64 getWritten() const { return written; }
+
+	// Return number of records dropped because a buffer was full.
+	UINT64 getDropped() const;
+
+	// Return number of rate limited records reported with a later record,
+	// as of the last flush().
+	UINT64 getSuppressed() const { return suppressed; }
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "memoryArena.h"
+#include "memoryStats.h"
+#include <new>
+
+namespace memoryNS {
+	// Scratch arena of each thread
+	static __declspec(thread) MemoryArena *scratchArena = NULL;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+MemoryArena::MemoryArena() {
+	block = NULL;
+	blockRaw = NULL;
+	capacity = 0;
+	used = 0;
+	overflow = NULL;
+	overflowBytes = 0;
+	highWater = 0;
+	overflowCount = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+MemoryArena::~MemoryArena() {
+	release();
+}
+
+//=============================================================================
+// Allocate the main block
+//=============================================================================
+bool MemoryArena::initialize(size_t bytes) {
+	release();
+	blockRaw = new(std::nothrow) char[bytes + memoryNS::ARENA_ALIGN];
+	if (blockRaw == NULL)
+		return false;
+	block = (char*)(((UINT_PTR)blockRaw + memoryNS::ARENA_ALIGN - 1) & ~(UINT_PTR)(memoryNS::ARENA_ALIGN - 1));
+	capacity = bytes;
+	return true;
+}
+
+//=============================================================================
+// Free all memory
+//=============================================================================
+void MemoryArena::release() {
+	freeOverflow();
+	delete[] blockRaw;
+	blockRaw = NULL;
+	block = NULL;
+	capacity = 0;
+	used = 0;
+}
+
+//=============================================================================
+// Free overflow blocks
+//=============================================================================
+void MemoryArena::freeOverflow() {
+	while (overflow) {
+		Overflow *next = overflow->next;
+		delete[] (char*)overflow;
+		overflow = next;
+	}
+	overflowBytes = 0;
+}
+
+//=============================================================================
+// Allocate from the main block, or from a new overflow block if it is full
+//=============================================================================
+void* MemoryArena::alloc(size_t bytes, size_t align) {
+	size_t start = (used + align - 1) & ~(align - 1);
+	if (start + bytes <= capacity) {
+		used = start + bytes;
+		if (used + overflowBytes > highWater)
+			highWater = used + overflowBytes;
+		return block + start;
+	}
+
+	// the Overflow header is ARENA_ALIGN bytes so the data after it stays aligned
+	size_t size = memoryNS::ARENA_ALIGN * 2 + bytes;
+	char *raw = new(std::nothrow) char[size];
+	if (raw == NULL)
+		return NULL;
+	Overflow *o = (Overflow*)raw;
+	o->next = overflow;
+	overflow = o;
+	overflowBytes += size;
+	overflowCount++;
+	if (used + overflowBytes > highWater)
+		highWater = used + overflowBytes;
+	char *data = raw + memoryNS::ARENA_ALIGN;
+	return (char*)(((UINT_PTR)data + memoryNS::ARENA_ALIGN - 1) & ~(UINT_PTR)(memoryNS::ARENA_ALIGN - 1));
+}
+
+//=============================================================================
+// Free everything allocated since the last reset
+// If overflow blocks were needed the main block grows to the high water mark,
+// at the first reset outside strict mode, so no heap call is made during a
+// strict frame. Overflows until then are counted in getOverflowCount().
+//=============================================================================
+void MemoryArena::reset() {
+	freeOverflow();
+	if (highWater > capacity && !memoryNS::isStrict()) {
+		size_t oldCapacity = capacity;
+		if (!initialize(highWater))
+			initialize(oldCapacity);
+	}
+	used = 0;
+}
+
+//=============================================================================
+// Scratch arena of the calling thread
+//=============================================================================
+MemoryArena* memoryNS::getScratchArena() {
+	return scratchArena;
+}
+
+void memoryNS::setScratchArena(MemoryArena *arena) {
+	scratchArena = arena;
+}
@@ -0,0 +1,90 @@
+#ifndef _MEMORYARENA_H
+#define _MEMORYARENA_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+namespace memoryNS {
+	const size_t FRAME_ARENA_BYTES = 1024 * 1024;		// Game frame arena
+	const size_t SCRATCH_ARENA_BYTES = 256 * 1024;		// per JobSystem thread
+	const size_t ARENA_ALIGN = 16;						// default alignment, suits SSE
+}
+
+// Linear allocator. alloc() moves a pointer through one block and reset()
+// frees everything at once, so short lived data costs no heap calls.
+// Requests that do not fit go to overflow blocks from the heap; the next
+// reset() frees them and grows the main block to cover the peak use, or
+// the first reset() after memoryNS strict mode is turned off.
+// Not thread safe, use one arena per thread.
+class MemoryArena {
+private:
+	// Heap block used when the main block is full
+	struct Overflow {
+		Overflow *next;
+	};
+
+	char        *block;			// main block, ARENA_ALIGN aligned
+	char        *blockRaw;		// main block as allocated
+	size_t      capacity;		// bytes in main block
+	size_t      used;			// bytes used in main block
+	Overflow    *overflow;		// overflow blocks since reset()
+	size_t      overflowBytes;	// bytes in overflow blocks since reset()
+	size_t      highWater;		// most bytes used between resets
+	UINT        overflowCount;	// overflow blocks allocated since initialize()
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Free overflow blocks.
+	void freeOverflow();
+
+	// Arenas own memory, so they are not copied
+	MemoryArena(const MemoryArena&);
+	MemoryArena& operator=(const MemoryArena&);
+
+public:
+	// Constructor
+	MemoryArena();
+
+	// Destructor
+	virtual ~MemoryArena();
+
+	// Allocate the main block.
+	// Post: returns false on error
+	bool initialize(size_t bytes);
+
+	// Free all memory.
+	void release();
+
+	// Return bytes of memory aligned to align, a power of 2 up to ARENA_ALIGN.
+	// The memory is valid until reset(). Returns NULL if out of memory.
+	void* alloc(size_t bytes, size_t align = memoryNS::ARENA_ALIGN);
+
+	// Return uninitialized memory for n objects of type T.
+	template <class T>
+	T* allocArray(size_t n) { return (T*)alloc(n * sizeof(T), __alignof(T)); }
+
+	// Free everything allocated since the last reset().
+	void reset();
+
+	// Return bytes used since the last reset().
+	size_t getUsed() const { return used + overflowBytes; }
+
+	// Return bytes in the main block.
+	size_t getCapacity() const { return capacity; }
+
+	// Return most bytes used between resets.
+	size_t getHighWater() const { return highWater; }
+
+	// Return number of overflow blocks allocated since initialize().
+	UINT getOverflowCount() const { return overflowCount; }
+};
+
+namespace memoryNS {
+	// Return the scratch arena of the calling thread, NULL if it has none.
+	// JobSystem threads have one, reset at the start of every parallelFor().
+	MemoryArena* getScratchArena();
+
+	// Set the scratch arena of the calling thread.
+	void setScratchArena(MemoryArena *arena);
+}
+
+#endif
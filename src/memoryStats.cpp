@@ -0,0 +1,91 @@
+#include "memoryStats.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <atomic>
+#include <new>
+
+namespace memoryNS {
+	std::atomic<UINT64> allocations(0);
+	std::atomic<UINT64> bytes(0);
+	std::atomic<UINT64> strictViolations(0);
+	std::atomic<bool>   strict(false);
+
+	//=========================================================================
+	// Count one allocation of size bytes
+	//=========================================================================
+	static void count(size_t size) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+		if (strict.load(std::memory_order_relaxed)) {
+			strictViolations.fetch_add(1, std::memory_order_relaxed);
+			assert(!"Heap allocation during a strict frame");
+		}
+	}
+}
+
+//=============================================================================
+// Return allocation totals
+//=============================================================================
+memoryNS::AllocCounts memoryNS::getAllocCounts() {
+	AllocCounts counts;
+	counts.allocations = allocations.load(std::memory_order_relaxed);
+	counts.bytes = bytes.load(std::memory_order_relaxed);
+	return counts;
+}
+
+//=============================================================================
+// Strict mode
+//=============================================================================
+void memoryNS::setStrict(bool on) {
+	strict.store(on, std::memory_order_relaxed);
+}
+
+bool memoryNS::isStrict() {
+	return strict.load(std::memory_order_relaxed);
+}
+
+UINT64 memoryNS::getStrictViolations() {
+	return strictViolations.load(std::memory_order_relaxed);
+}
+
+//=============================================================================
+// Global allocation functions
+// All forms of new and delete go through these, so the counts include the
+// standard library.
+//=============================================================================
+void* operator new(size_t size) {
+	memoryNS::count(size);
+	void *p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw() {
+	memoryNS::count(size);
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw() {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) throw() {
+	free(p);
+}
+
+void operator delete[](void *p) throw() {
+	free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) throw() {
+	free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) throw() {
+	free(p);
+}
@@ -0,0 +1,33 @@
+#ifndef _MEMORYSTATS_H
+#define _MEMORYSTATS_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+// Counts of general heap use. The global operator new and delete are
+// replaced in memoryStats.cpp, so every allocation made with new, by
+// containers or by std::string is counted, on every thread.
+namespace memoryNS {
+	const UINT STRICT_WARMUP_FRAMES = 120;		// frames before Game enters strict mode
+
+	// Allocation totals since the program started.
+	struct AllocCounts {
+		UINT64  allocations;		// calls to operator new
+		UINT64  bytes;				// bytes requested from operator new
+	};
+
+	// Return allocation totals of all threads.
+	AllocCounts getAllocCounts();
+
+	// Turn strict mode on or off. In strict mode every heap allocation is a
+	// violation: it is counted and fails an assert in debug builds.
+	void setStrict(bool on);
+
+	// Return true in strict mode.
+	bool isStrict();
+
+	// Return heap allocations made in strict mode.
+	UINT64 getStrictViolations();
+}
+
+#endif
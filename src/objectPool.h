@@ -0,0 +1,174 @@
+#ifndef _OBJECTPOOL_H
+#define _OBJECTPOOL_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <malloc.h>
+#include <new>
+
+namespace objectPoolNS {
+	const size_t CACHE_LINE = 64;		// storage alignment in bytes
+	const UINT   INVALID_INDEX = 0xffffffff;
+}
+
+// Refers to an object in an ObjectPool. A handle goes stale when its object
+// is despawned, even if the slot is reused, because the slot's generation
+// changes. The default handle is never valid.
+struct PoolHandle {
+	UINT        index;				// slot number
+	UINT        generation;			// generation of the slot when spawned, 0 for none
+
+	PoolHandle() : index(objectPoolNS::INVALID_INDEX), generation(0) {}
+	bool operator==(const PoolHandle &h) const { return index == h.index && generation == h.generation; }
+	bool operator!=(const PoolHandle &h) const { return !(*this == h); }
+};
+
+// Fixed capacity pool of T in one cache line aligned block. Spawning takes
+// a slot from a free list and despawning returns it, so neither touches the
+// heap after initialize(). Objects do not move while alive, so pointers
+// from get() stay valid until despawn(). A packed list of live slots lets
+// forEach() visit only live objects.
+// Works with any default constructible type, such as Image and TextureManager.
+template <class T>
+class ObjectPool {
+private:
+	T           *slots;				// capacity slots, objects constructed in place
+	UINT        *generations;		// generation of each slot, odd while alive
+	UINT        *freeList;			// stack of free slots
+	UINT        freeCount;
+	UINT        *live;				// packed live slots
+	UINT        *livePosition;		// position of each live slot in live
+	UINT        liveCount;
+	UINT        capacity;
+
+	// Pools own memory, so they are not copied
+	ObjectPool(const ObjectPool&);
+	ObjectPool& operator=(const ObjectPool&);
+
+public:
+	// Constructor
+	ObjectPool() : slots(NULL), generations(NULL), freeList(NULL), freeCount(0),
+		live(NULL), livePosition(NULL), liveCount(0), capacity(0) {}
+
+	// Destructor
+	virtual ~ObjectPool() { release(); }
+
+	// Allocate storage for maxObjects objects.
+	// Post: returns false on error
+	bool initialize(UINT maxObjects) {
+		release();
+		slots = (T*)_aligned_malloc(maxObjects * sizeof(T), objectPoolNS::CACHE_LINE);
+		generations = new(std::nothrow) UINT[maxObjects];
+		freeList = new(std::nothrow) UINT[maxObjects];
+		live = new(std::nothrow) UINT[maxObjects];
+		livePosition = new(std::nothrow) UINT[maxObjects];
+		if (slots == NULL || generations == NULL || freeList == NULL || live == NULL || livePosition == NULL) {
+			release();
+			return false;
+		}
+		capacity = maxObjects;
+		for (UINT i = 0; i < capacity; i++) {
+			generations[i] = 0;
+			freeList[i] = capacity - 1 - i;		// slot 0 is used first
+			livePosition[i] = objectPoolNS::INVALID_INDEX;
+		}
+		freeCount = capacity;
+		liveCount = 0;
+		return true;
+	}
+
+	// Despawn all objects and free storage.
+	void release() {
+		clear();
+		if (slots)
+			_aligned_free(slots);
+		slots = NULL;
+		delete[] generations;
+		delete[] freeList;
+		delete[] live;
+		delete[] livePosition;
+		generations = freeList = live = livePosition = NULL;
+		freeCount = 0;
+		capacity = 0;
+	}
+
+	// Construct a new object.
+	// Returns its handle, or an invalid handle if the pool is full.
+	PoolHandle spawn() {
+		PoolHandle h;
+		if (freeCount == 0)
+			return h;
+		UINT index = freeList[--freeCount];
+		new(&slots[index]) T();
+		generations[index]++;					// odd while alive
+		livePosition[index] = liveCount;
+		live[liveCount++] = index;
+		h.index = index;
+		h.generation = generations[index];
+		return h;
+	}
+
+	// Destroy the object h refers to.
+	// Returns false if h is stale or invalid.
+	bool despawn(PoolHandle h) {
+		if (!isValid(h))
+			return false;
+		UINT index = h.index;
+		slots[index].~T();
+		generations[index]++;					// stale handles no longer match
+		UINT pos = livePosition[index];
+		UINT moved = live[--liveCount];			// last live slot fills the gap
+		live[pos] = moved;
+		livePosition[moved] = pos;
+		livePosition[index] = objectPoolNS::INVALID_INDEX;
+		freeList[freeCount++] = index;
+		return true;
+	}
+
+	// Despawn all objects.
+	void clear() {
+		while (liveCount > 0) {
+			UINT index = live[--liveCount];
+			slots[index].~T();
+			generations[index]++;
+			livePosition[index] = objectPoolNS::INVALID_INDEX;
+			freeList[freeCount++] = index;
+		}
+	}
+
+	// Return true if h refers to a live object.
+	bool isValid(PoolHandle h) const {
+		return h.index < capacity && generations[h.index] == h.generation && (h.generation & 1);
+	}
+
+	// Return the object h refers to, NULL if h is stale or invalid.
+	T* get(PoolHandle h) { return isValid(h) ? &slots[h.index] : NULL; }
+	const T* get(PoolHandle h) const { return isValid(h) ? &slots[h.index] : NULL; }
+
+	// Return live object i, 0 <= i < getCount(). Order changes on despawn.
+	T& getLive(UINT i) { return slots[live[i]]; }
+
+	// Return the handle of live object i.
+	PoolHandle getLiveHandle(UINT i) const {
+		PoolHandle h;
+		h.index = live[i];
+		h.generation = generations[live[i]];
+		return h;
+	}
+
+	// Call f(T&, PoolHandle) for every live object. f may despawn the object
+	// it is given, since objects are visited from the end of the live list.
+	template <class F>
+	void forEach(F f) {
+		for (UINT i = liveCount; i > 0; i--)
+			f(slots[live[i - 1]], getLiveHandle(i - 1));
+	}
+
+	// Return number of live objects.
+	UINT getCount() const { return liveCount; }
+
+	// Return maximum number of objects.
+	UINT getCapacity() const { return capacity; }
+};
+
+#endif
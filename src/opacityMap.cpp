@@ -0,0 +1,105 @@
+#include "opacityMap.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+OpacityMap::OpacityMap() {
+	clear();
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+OpacityMap::~OpacityMap() {}
+
+//=============================================================================
+// Class the pixels of an image
+//=============================================================================
+bool OpacityMap::initialize(const BYTE *alpha, UINT w, UINT h, UINT pitch, UINT stride) {
+	using namespace opacityNS;
+	clear();
+	if (alpha == NULL || w == 0 || h == 0)
+		return false;
+	UINT columns = (w + TILE - 1) >> TILE_SHIFT;
+	UINT rows = (h + TILE - 1) >> TILE_SHIFT;
+	UINT words = (w + 31) >> 5;
+	try {
+		tiles.assign(columns * rows, (BYTE)OPACITY_OPAQUE);
+		mask.assign(words * h, 0);
+	}
+	catch (...) {
+		clear();
+		return false;
+	}
+	width = w;
+	height = h;
+	tileColumns = columns;
+	tileRows = rows;
+	wordsPerRow = words;
+
+	opacity = OPACITY_OPAQUE;
+	for (UINT y = 0; y < h; y++) {
+		const BYTE *a = alpha + y * pitch;
+		BYTE *tileRow = &tiles[(y >> TILE_SHIFT) * columns];
+		UINT *maskRow = &mask[y * words];
+		for (UINT x = 0; x < w; x++, a += stride) {
+			BYTE o;
+			if (*a == 255)
+				o = OPACITY_OPAQUE;
+			else if (*a == 0)
+				o = OPACITY_CUTOUT;
+			else
+				o = OPACITY_BLENDED;
+			BYTE &tile = tileRow[x >> TILE_SHIFT];
+			if (o > tile)
+				tile = o;
+			if (*a != 0)
+				maskRow[x >> 5] |= 1u << (x & 31);
+		}
+	}
+	for (size_t i = 0; i < tiles.size(); i++)
+		if (tiles[i] > opacity)
+			opacity = (OPACITY)tiles[i];
+	return true;
+}
+
+//=============================================================================
+// Forget the pixels
+//=============================================================================
+void OpacityMap::clear() {
+	width = 0;
+	height = 0;
+	tileColumns = 0;
+	tileRows = 0;
+	wordsPerRow = 0;
+	tiles.clear();
+	mask.clear();
+	opacity = opacityNS::OPACITY_BLENDED;
+}
+
+//=============================================================================
+// Return the opacity of the pixels in a rect
+// A texture that is opaque or blended throughout needs no tiles looked at.
+//=============================================================================
+opacityNS::OPACITY OpacityMap::getOpacity(const RECT &r) const {
+	using namespace opacityNS;
+	if (opacity == OPACITY_OPAQUE || opacity == OPACITY_BLENDED)
+		return opacity;
+	LONG left = (r.left < 0) ? 0 : r.left;
+	LONG top = (r.top < 0) ? 0 : r.top;
+	LONG right = (r.right > (LONG)width) ? (LONG)width : r.right;
+	LONG bottom = (r.bottom > (LONG)height) ? (LONG)height : r.bottom;
+	if (left >= right || top >= bottom)
+		return OPACITY_BLENDED;				// nothing of the texture is drawn
+
+	BYTE o = OPACITY_OPAQUE;
+	UINT column0 = (UINT)left >> TILE_SHIFT, column1 = (UINT)(right - 1) >> TILE_SHIFT;
+	UINT row0 = (UINT)top >> TILE_SHIFT, row1 = (UINT)(bottom - 1) >> TILE_SHIFT;
+	for (UINT row = row0; row <= row1; row++) {
+		const BYTE *tile = &tiles[row * tileColumns];
+		for (UINT column = column0; column <= column1; column++)
+			if (tile[column] > o)
+				o = tile[column];
+	}
+	return (OPACITY)o;
+}
@@ -0,0 +1,78 @@
+#ifndef _OPACITYMAP_H
+#define _OPACITYMAP_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+
+namespace opacityNS {
+	// How the pixels of a sprite combine with what is behind them
+	enum OPACITY {
+		OPACITY_OPAQUE,		// every pixel has alpha 255
+		OPACITY_CUTOUT,		// alpha 0 or 255, drawn with alpha test instead of blending
+		OPACITY_BLENDED		// some pixels are partly transparent
+	};
+
+	const int   TILE_SHIFT = 3;			// tiles of 8x8 pixels
+	const int   TILE = 1 << TILE_SHIFT;
+	const BYTE  ALPHA_REF = 0x80;		// alpha test of opaque sprites, for clean filtered edges
+}
+
+// Opacity of the pixels of a texture, found when it is loaded.
+// The texture is split into 8x8 pixel tiles, each classed by its least
+// opaque pixel, so the class of any rect, such as one frame of a sprite
+// sheet, is the least opaque class of the tiles it touches. A rect that
+// does not line up with tiles may be classed less opaque than its pixels
+// are, which only costs drawing it in the blended pass. One bit per pixel
+// records which pixels are visible, with alpha above 0.
+class OpacityMap {
+private:
+	UINT        width;
+	UINT        height;
+	UINT        tileColumns;
+	UINT        tileRows;
+	std::vector<BYTE> tiles;			// opacityNS::OPACITY of each tile
+	UINT        wordsPerRow;
+	std::vector<UINT> mask;				// bit set where alpha > 0
+	opacityNS::OPACITY opacity;			// of the whole texture
+
+public:
+	// Constructor
+	OpacityMap();
+
+	// Destructor
+	virtual ~OpacityMap();
+
+	// Class the pixels of a width x height image.
+	// alpha = alpha of the top left pixel, pitch = bytes between rows,
+	// stride = bytes between pixels, such as 4 for the alpha of 32 bit ARGB
+	// Post: returns false if out of memory
+	bool initialize(const BYTE *alpha, UINT w, UINT h, UINT pitch, UINT stride);
+
+	// Forget the pixels. Everything is then OPACITY_BLENDED.
+	void clear();
+
+	// Return true if initialize() has been called.
+	bool isInitialized() const { return !tiles.empty(); }
+
+	// Return the opacity of the whole texture.
+	opacityNS::OPACITY getOpacity() const { return opacity; }
+
+	// Return the opacity of the pixels in rect r, clipped to the texture.
+	opacityNS::OPACITY getOpacity(const RECT &r) const;
+
+	// Return true if pixel x, y is visible. Pixels outside the texture are not.
+	bool isCovered(int x, int y) const {
+		if ((UINT)x >= width || (UINT)y >= height)
+			return false;
+		return (mask[y * wordsPerRow + (x >> 5)] >> (x & 31) & 1) != 0;
+	}
+
+	// Return width in pixels.
+	UINT getWidth() const { return width; }
+
+	// Return height in pixels.
+	UINT getHeight() const { return height; }
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "overdrawHeatmap.h"
+#include <fstream>
+#include <string.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+OverdrawHeatmap::OverdrawHeatmap() {
+	width = 0;
+	height = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+OverdrawHeatmap::~OverdrawHeatmap() {}
+
+//=============================================================================
+// Color the pixels and total the frame
+// The top sprites are kept sorted in a short array, so each sprite costs at
+// most TOP_SPRITES compares.
+//=============================================================================
+bool OverdrawHeatmap::analyze(const SoftwareRasterizer &rasterizer) {
+	using namespace heatmapNS;
+	memset(&stats, 0, sizeof(stats));
+	const UINT *counts = rasterizer.getShadedCounts();
+	size_t size = (size_t)rasterizer.getWidth() * rasterizer.getHeight();
+	try {
+		pixels.resize(size);
+	}
+	catch (...) {
+		pixels.clear();
+		width = height = 0;
+		return false;
+	}
+	width = rasterizer.getWidth();
+	height = rasterizer.getHeight();
+
+	for (size_t i = 0; i < size; i++) {
+		UINT count = counts[i];
+		pixels[i] = color(count);
+		stats.pixels[(count > (UINT)LEVELS) ? LEVELS : count]++;
+		if (count > stats.maxCount)
+			stats.maxCount = count;
+	}
+	stats.shaded = rasterizer.getShaded();
+	stats.written = rasterizer.getWritten();
+	stats.rejected = rasterizer.getRejected();
+	stats.overdraw = rasterizer.getOverdraw();
+
+	for (UINT id = 0; id < rasterizer.getIdCount(); id++) {
+		UINT64 shaded = rasterizer.getShadedById(id);
+		if (shaded == 0 || (stats.topCount == TOP_SPRITES && shaded <= stats.top[TOP_SPRITES - 1].shaded))
+			continue;
+		int i = (stats.topCount < TOP_SPRITES) ? stats.topCount++ : TOP_SPRITES - 1;
+		for (; i > 0 && stats.top[i - 1].shaded < shaded; i--)
+			stats.top[i] = stats.top[i - 1];
+		stats.top[i].id = id;
+		stats.top[i].shaded = shaded;
+	}
+	return true;
+}
+
+//=============================================================================
+// Write the heatmap as a 24 bit BMP
+// Rows are stored bottom up, in BGR order, padded to 4 bytes.
+//=============================================================================
+bool OverdrawHeatmap::saveBitmap(const char *filename) const {
+	if (pixels.empty())
+		return false;
+	UINT rowBytes = ((UINT)width * 3 + 3) & ~3u;
+	UINT imageBytes = rowBytes * height;
+	BYTE header[54];
+	memset(header, 0, sizeof(header));
+	UINT fields[][2] = {					// offset, value of each 32 bit field
+		{ 2, 54 + imageBytes }, { 10, 54 }, { 14, 40 }, { 18, (UINT)width }, { 22, (UINT)height },
+		{ 34, imageBytes }, { 38, 2835 }, { 42, 2835 }
+	};
+	header[0] = 'B';
+	header[1] = 'M';
+	for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++)
+		for (int b = 0; b < 4; b++)
+			header[fields[f][0] + b] = (BYTE)(fields[f][1] >> (8 * b));
+	header[26] = 1;							// planes
+	header[28] = 24;						// bits per pixel
+
+	std::ofstream out(filename, std::ios::binary);
+	if (!out)
+		return false;
+	out.write((const char*)header, sizeof(header));
+	std::vector<BYTE> row(rowBytes, 0);
+	for (int y = height; y-- > 0;) {
+		const COLOR_ARGB *p = &pixels[(size_t)y * width];
+		for (int x = 0; x < width; x++) {
+			row[x * 3] = (BYTE)p[x];
+			row[x * 3 + 1] = (BYTE)(p[x] >> 8);
+			row[x * 3 + 2] = (BYTE)(p[x] >> 16);
+		}
+		out.write((const char*)&row[0], rowBytes);
+	}
+	return out.good();
+}
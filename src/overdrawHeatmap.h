@@ -0,0 +1,89 @@
+#ifndef _OVERDRAWHEATMAP_H
+#define _OVERDRAWHEATMAP_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "graphics.h"
+#include "softwareRasterizer.h"
+
+namespace heatmapNS {
+	const int   LEVELS = 8;				// counts with their own color, higher counts share the last
+	const int   TOP_SPRITES = 8;		// sprites reported by area shaded
+
+	// Color of each count, black for pixels never drawn through white for LEVELS or more
+	const COLOR_ARGB COLORS[LEVELS + 1] = {
+		D3DCOLOR_ARGB(255, 0, 0, 0),
+		D3DCOLOR_ARGB(255, 0, 0, 160),
+		D3DCOLOR_ARGB(255, 0, 96, 255),
+		D3DCOLOR_ARGB(255, 0, 192, 192),
+		D3DCOLOR_ARGB(255, 0, 200, 0),
+		D3DCOLOR_ARGB(255, 240, 240, 0),
+		D3DCOLOR_ARGB(255, 255, 128, 0),
+		D3DCOLOR_ARGB(255, 255, 0, 0),
+		D3DCOLOR_ARGB(255, 255, 255, 255)
+	};
+
+	// Return the heatmap color of a pixel drawn count times.
+	inline COLOR_ARGB color(UINT count) { return COLORS[(count > (UINT)LEVELS) ? LEVELS : count]; }
+}
+
+// A sprite and the fragments shaded drawing it
+struct HeatmapSprite {
+	UINT        id;					// as given to SoftwareRasterizer::setId()
+	UINT64      shaded;
+};
+
+// Fill rate of one frame
+struct HeatmapStats {
+	UINT64      shaded;				// fragments shaded
+	UINT64      written;			// fragments that passed the alpha test
+	UINT64      rejected;			// fragments hidden by the depth test before shading
+	float       overdraw;			// fragments shaded per pixel of the target
+	UINT        maxCount;			// most fragments shaded at one pixel
+	UINT        pixels[heatmapNS::LEVELS + 1];	// pixels shaded each count, the last LEVELS or more
+	HeatmapSprite top[heatmapNS::TOP_SPRITES];	// sprites that shaded the most, most first
+	int         topCount;
+};
+
+// Turns the fragments a SoftwareRasterizer shaded at each pixel into a
+// color-mapped image and the fill rate totals of the frame, so fill cost
+// can be seen and tracked in headless runs. Graphics::setOverdrawView()
+// shows the same colors on the device, from pixels written instead of
+// fragments shaded.
+class OverdrawHeatmap {
+private:
+	int         width;
+	int         height;
+	std::vector<COLOR_ARGB> pixels;	// heatmap, width x height
+	HeatmapStats stats;
+
+public:
+	// Constructor
+	OverdrawHeatmap();
+
+	// Destructor
+	virtual ~OverdrawHeatmap();
+
+	// Color each pixel of the rasterizer's target by the fragments shaded
+	// there, and total the frame.
+	// Post: returns false if out of memory
+	bool analyze(const SoftwareRasterizer &rasterizer);
+
+	// Return the totals of the last analyze().
+	const HeatmapStats& getStats() const { return stats; }
+
+	// Return the heatmap, width x height 32 bit ARGB pixels, NULL if none.
+	const COLOR_ARGB* getPixels() const { return pixels.empty() ? NULL : &pixels[0]; }
+
+	// Return width in pixels.
+	int getWidth() const { return width; }
+
+	// Return height in pixels.
+	int getHeight() const { return height; }
+
+	// Write the heatmap as a 24 bit BMP file.
+	// Post: returns false if there is no heatmap or the file could not be written
+	bool saveBitmap(const char *filename) const;
+};
+
+#endif
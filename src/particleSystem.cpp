@@ -0,0 +1,248 @@
+#include "particleSystem.h"
+#include "image.h"
+#include <malloc.h>
+#include <emmintrin.h>
+#include <math.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+ParticleSystem::ParticleSystem() {
+	graphics = NULL;
+	textureManager = NULL;
+	ZeroMemory(&rect, sizeof(rect));
+	capacity = 0;
+	count = 0;
+	posX = posY = velX = velY = NULL;
+	age = ageRate = NULL;
+	scale = scaleStart = scaleDelta = NULL;
+	color = colorStart = colorEnd = NULL;
+	gravityX = 0;
+	gravityY = 0;
+	seed = 1;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+ParticleSystem::~ParticleSystem() {
+	freeArrays();
+}
+
+//=============================================================================
+// Free the particle arrays
+//=============================================================================
+void ParticleSystem::freeArrays() {
+	float **floats[] = { &posX, &posY, &velX, &velY, &age, &ageRate, &scale, &scaleStart, &scaleDelta };
+	for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++) {
+		if (*floats[i])
+			_aligned_free(*floats[i]);
+		*floats[i] = NULL;
+	}
+	COLOR_ARGB **colors[] = { &color, &colorStart, &colorEnd };
+	for (size_t i = 0; i < sizeof(colors) / sizeof(colors[0]); i++) {
+		if (*colors[i])
+			_aligned_free(*colors[i]);
+		*colors[i] = NULL;
+	}
+	capacity = 0;
+	count = 0;
+}
+
+//=============================================================================
+// Allocate particle storage
+//=============================================================================
+bool ParticleSystem::initialize(Graphics *g, TextureManager *textureM, int width, int height, int maxParticles) {
+	freeArrays();
+	graphics = g;
+	textureManager = textureM;
+	if (textureManager) {
+		if (width == 0)
+			width = textureManager->getWidth();		// use full width of texture
+		if (height == 0)
+			height = textureManager->getHeight();	// use full height of texture
+	}
+	rect.left = 0;
+	rect.top = 0;
+	rect.right = width;
+	rect.bottom = height;
+
+	// round up so SIMD loops never need a scalar tail
+	capacity = (maxParticles + particleNS::SIMD_WIDTH - 1) & ~(particleNS::SIMD_WIDTH - 1);
+	if (capacity <= 0)
+		return false;
+
+	size_t bytes = capacity * sizeof(float);
+	float **floats[] = { &posX, &posY, &velX, &velY, &age, &ageRate, &scale, &scaleStart, &scaleDelta };
+	for (size_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++) {
+		*floats[i] = (float*)_aligned_malloc(bytes, 16);
+		if (*floats[i] == NULL) {
+			freeArrays();
+			return false;
+		}
+		ZeroMemory(*floats[i], bytes);
+	}
+	COLOR_ARGB **colors[] = { &color, &colorStart, &colorEnd };
+	for (size_t i = 0; i < sizeof(colors) / sizeof(colors[0]); i++) {
+		*colors[i] = (COLOR_ARGB*)_aligned_malloc(capacity * sizeof(COLOR_ARGB), 16);
+		if (*colors[i] == NULL) {
+			freeArrays();
+			return false;
+		}
+		ZeroMemory(*colors[i], capacity * sizeof(COLOR_ARGB));
+	}
+	count = 0;
+	return true;
+}
+
+//=============================================================================
+// Add an emitter
+//=============================================================================
+int ParticleSystem::addEmitter(const ParticleEmitter &e) {
+	if ((int)emitters.size() >= particleNS::MAX_EMITTERS)
+		return -1;
+	emitters.push_back(e);
+	return (int)emitters.size() - 1;
+}
+
+//=============================================================================
+// Create n particles from emitter e
+//=============================================================================
+void ParticleSystem::burst(const ParticleEmitter &e, int n) {
+	if (n > capacity - count)
+		n = capacity - count;				// drop particles that do not fit
+	for (int i = 0; i < n; i++) {
+		int p = count++;
+		float a = e.angle + random(-e.spread, e.spread);
+		float speed = random(e.speedMin, e.speedMax);
+		posX[p] = e.x;
+		posY[p] = e.y;
+		velX[p] = sinf(a) * speed;			// 0 radians is up
+		velY[p] = -cosf(a) * speed;
+		age[p] = 0;
+		ageRate[p] = 1.0f / random(e.lifeMin, e.lifeMax);
+		scaleStart[p] = e.startScale;
+		scaleDelta[p] = e.endScale - e.startScale;
+		scale[p] = e.startScale;
+		colorStart[p] = e.startColor;
+		colorEnd[p] = e.endColor;
+		color[p] = e.startColor;
+	}
+}
+
+//=============================================================================
+// Remove all particles
+//=============================================================================
+void ParticleSystem::clear() {
+	if (count > 0)
+		imageNS::markChanged();
+	count = 0;
+}
+
+//=============================================================================
+// Integrate particles [begin, end)
+// Four particles per step: velocity, position, age, scale and color.
+//=============================================================================
+void ParticleSystem::integrate(int begin, int end, float frameTime) {
+	const __m128 dt = _mm_set1_ps(frameTime);
+	const __m128 gx = _mm_set1_ps(gravityX * frameTime);
+	const __m128 gy = _mm_set1_ps(gravityY * frameTime);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i byteMask = _mm_set1_epi32(0xff);
+
+	for (int i = begin; i < end; i += particleNS::SIMD_WIDTH) {
+		__m128 vx = _mm_add_ps(_mm_load_ps(velX + i), gx);
+		__m128 vy = _mm_add_ps(_mm_load_ps(velY + i), gy);
+		_mm_store_ps(velX + i, vx);
+		_mm_store_ps(velY + i, vy);
+		_mm_store_ps(posX + i, _mm_add_ps(_mm_load_ps(posX + i), _mm_mul_ps(vx, dt)));
+		_mm_store_ps(posY + i, _mm_add_ps(_mm_load_ps(posY + i), _mm_mul_ps(vy, dt)));
+
+		__m128 t = _mm_add_ps(_mm_load_ps(age + i), _mm_mul_ps(_mm_load_ps(ageRate + i), dt));
+		_mm_store_ps(age + i, t);
+		t = _mm_min_ps(t, one);				// dead particles keep their end values
+
+		_mm_store_ps(scale + i, _mm_add_ps(_mm_load_ps(scaleStart + i),
+			_mm_mul_ps(_mm_load_ps(scaleDelta + i), t)));
+
+		// lerp each 8 bit channel of start and end colors
+		__m128i c0 = _mm_load_si128((const __m128i*)(colorStart + i));
+		__m128i c1 = _mm_load_si128((const __m128i*)(colorEnd + i));
+		__m128i result = _mm_setzero_si128();
+		for (int shift = 0; shift < 32; shift += 8) {
+			__m128 a = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c0, shift), byteMask));
+			__m128 b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c1, shift), byteMask));
+			__m128i channel = _mm_cvttps_epi32(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)));
+			result = _mm_or_si128(result, _mm_slli_epi32(channel, shift));
+		}
+		_mm_store_si128((__m128i*)(color + i), result);
+	}
+}
+
+//=============================================================================
+// Remove dead particles
+// The last live particle is moved into each dead slot, so order is not kept.
+//=============================================================================
+void ParticleSystem::compact() {
+	int i = 0;
+	while (i < count) {
+		if (age[i] < 1.0f) {
+			i++;
+			continue;
+		}
+		int last = --count;
+		posX[i] = posX[last];
+		posY[i] = posY[last];
+		velX[i] = velX[last];
+		velY[i] = velY[last];
+		age[i] = age[last];
+		ageRate[i] = ageRate[last];
+		scale[i] = scale[last];
+		scaleStart[i] = scaleStart[last];
+		scaleDelta[i] = scaleDelta[last];
+		color[i] = color[last];
+		colorStart[i] = colorStart[last];
+		colorEnd[i] = colorEnd[last];
+	}
+}
+
+//=============================================================================
+// Emit, move and remove particles
+//=============================================================================
+void ParticleSystem::update(float frameTime, JobSystem *jobs) {
+	if (capacity == 0)
+		return;
+	int alive = count;
+
+	for (size_t e = 0; e < emitters.size(); e++) {
+		ParticleEmitter &emitter = emitters[e];
+		if (!emitter.active)
+			continue;
+		emitter.accumulator += emitter.rate * frameTime;
+		int n = (int)emitter.accumulator;
+		emitter.accumulator -= n;
+		burst(emitter, n);
+	}
+
+	// round up to whole SIMD steps, slots past count are harmless scratch
+	int end = (count + particleNS::SIMD_WIDTH - 1) & ~(particleNS::SIMD_WIDTH - 1);
+	if (jobs)
+		jobs->parallelFor(end, particleNS::JOB_GRAIN, [this, frameTime](int begin, int last, int) {
+			integrate(begin, last, frameTime);
+		});
+	else
+		integrate(0, end, frameTime);
+
+	compact();
+	if (alive > 0 || count > 0)				// particles moved or died, for drawing on demand
+		imageNS::markChanged();
+}
+
+//=============================================================================
+// Draw all particles in one sprite batch
+//=============================================================================
+void ParticleSystem::draw() {
+	if (graphics == NULL || textureManager == NULL || count == 0)
+		return;
+	graphics->drawSpriteBatch(textureManager->getTexture(), rect, posX, posY, scale, color, count);
+}
@@ -0,0 +1,124 @@
+#ifndef _PARTICLESYSTEM_H
+#define _PARTICLESYSTEM_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "textureManager.h"
+#include "jobSystem.h"
+#include "constants.h"
+
+namespace particleNS {
+	const int   SIMD_WIDTH = 4;			// floats per SSE register
+	const int   JOB_GRAIN = 8192;		// particles per job chunk, multiple of SIMD_WIDTH
+	const int   MAX_EMITTERS = 64;
+}
+
+// Describes how an emitter creates particles.
+// Angles are in radians, 0 is up and angles progress clockwise as in Image.
+struct ParticleEmitter {
+	float   x, y;				// screen location of new particles
+	float   rate;				// particles per second
+	float   angle;				// direction of travel
+	float   spread;				// random variation of angle, +/- radians
+	float   speedMin, speedMax;	// pixels per second
+	float   lifeMin, lifeMax;	// seconds
+	float   startScale;			// scale of new particles
+	float   endScale;			// scale at end of life
+	COLOR_ARGB startColor;		// color of new particles
+	COLOR_ARGB endColor;		// color at end of life
+	bool    active;				// true to emit particles
+	float   accumulator;		// fraction of a particle waiting to be emitted
+
+	ParticleEmitter() : x(0), y(0), rate(100), angle(0), spread((float)PI),
+		speedMin(50), speedMax(100), lifeMin(0.5f), lifeMax(1.0f),
+		startScale(1.0f), endScale(0.0f), startColor(graphicsNS::WHITE),
+		endColor(graphicsNS::WHITE & graphicsNS::ALPHA25), active(true), accumulator(0) {}
+};
+
+// Particles stored as structure of arrays and updated four at a time
+// with SSE2. All particles share one texture rect, so a system draws in
+// a single sprite batch. Dead particles are removed by moving the last
+// particle into their slot.
+class ParticleSystem {
+private:
+	Graphics    *graphics;		// pointer to graphics
+	TextureManager *textureManager;	// particle texture
+	RECT        rect;			// selects the particle image from the texture
+	int         capacity;		// maximum particles, multiple of SIMD_WIDTH
+	int         count;			// live particles
+
+	// particle arrays, 16 byte aligned, capacity entries each
+	float       *posX, *posY;		// screen location of particle center
+	float       *velX, *velY;		// pixels per second
+	float       *age;				// 0 at birth, 1 at death
+	float       *ageRate;			// 1 / lifetime in seconds
+	float       *scale;				// current scale
+	float       *scaleStart, *scaleDelta;	// scale at birth, change over life
+	COLOR_ARGB  *color;				// current color
+	COLOR_ARGB  *colorStart, *colorEnd;	// color at birth and death
+
+	std::vector<ParticleEmitter> emitters;
+	float       gravityX, gravityY;	// acceleration of all particles, pixels per second squared
+	UINT        seed;				// random number state, fixed so replays match
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Return a random float from lo to hi.
+	float random(float lo, float hi) {
+		seed = seed * 1664525 + 1013904223;
+		return lo + (hi - lo) * (float)(seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Integrate particles [begin, end) over frameTime. begin is a multiple of SIMD_WIDTH.
+	void integrate(int begin, int end, float frameTime);
+
+	// Remove dead particles by moving the last live particle into their slot.
+	void compact();
+
+	// Free the particle arrays.
+	void freeArrays();
+
+public:
+	// Constructor
+	ParticleSystem();
+
+	// Destructor
+	virtual ~ParticleSystem();
+
+	// Allocate storage for maxParticles particles.
+	// Pre: *g points to Graphics object, or NULL to update without drawing
+	//      *textureM holds the particle image, or NULL
+	//      width, height = size of the particle image, 0 for the full texture
+	// Post: returns false on error
+	bool initialize(Graphics *g, TextureManager *textureM, int width, int height, int maxParticles);
+
+	// Add an emitter. Returns its number, or -1 if there are MAX_EMITTERS.
+	int addEmitter(const ParticleEmitter &e);
+
+	// Return emitter n, used to move, start or stop it.
+	ParticleEmitter* getEmitter(int n) { return (n >= 0 && n < (int)emitters.size()) ? &emitters[n] : NULL; }
+
+	// Create n particles from emitter e at once.
+	void burst(const ParticleEmitter &e, int n);
+
+	// Set acceleration applied to all particles.
+	void setGravity(float x, float y) { gravityX = x; gravityY = y; }
+
+	// Emit new particles, move all particles and remove dead ones.
+	// jobs = NULL to update on the calling thread.
+	void update(float frameTime, JobSystem *jobs = NULL);
+
+	// Draw all particles in one sprite batch.
+	// Pre: graphics->spriteBegin() has been called
+	void draw();
+
+	// Remove all particles.
+	void clear();
+
+	// Return number of live particles.
+	int getCount() const { return count; }
+
+	// Return maximum number of particles.
+	int getCapacity() const { return capacity; }
+};
+
+#endif
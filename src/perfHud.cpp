@@ -0,0 +1,235 @@
+#include "perfHud.h"
+
+namespace perfHudNS {
+	// Built in 3x5 font, one string of rows per glyph, '1' is a set pixel
+	struct FontGlyph {
+		char c;
+		const char *rows;
+	};
+
+	const FontGlyph FONT[] = {
+		{ '0', "111101101101111" }, { '1', "010110010010111" }, { '2', "111001111100111" },
+		{ '3', "111001111001111" }, { '4', "101101111001001" }, { '5', "111100111001111" },
+		{ '6', "111100111101111" }, { '7', "111001001001001" }, { '8', "111101111101111" },
+		{ '9', "111101111001111" }, { 'A', "010101111101101" }, { 'B', "110101110101110" },
+		{ 'C', "011100100100011" }, { 'D', "110101101101110" }, { 'E', "111100110100111" },
+		{ 'F', "111100110100100" }, { 'G', "011100101101011" }, { 'H', "101101111101101" },
+		{ 'I', "111010010010111" }, { 'J', "001001001101010" }, { 'K', "101101110101101" },
+		{ 'L', "100100100100111" }, { 'M', "101111111101101" }, { 'N', "110101101101101" },
+		{ 'O', "010101101101010" }, { 'P', "110101110100100" }, { 'Q', "010101101110011" },
+		{ 'R', "110101110101101" }, { 'S', "011100010001110" }, { 'T', "111010010010010" },
+		{ 'U', "101101101101111" }, { 'V', "101101101101010" }, { 'W', "101101111111101" },
+		{ 'X', "101101010101101" }, { 'Y', "101101010010010" }, { 'Z', "111001010100111" },
+		{ '.', "000000000000010" }, { ':', "000010000010000" }, { '/', "001001010100100" },
+		{ '%', "101001010100101" }, { '-', "000000111000000" },
+	};
+	const int FONT_GLYPHS = sizeof(FONT) / sizeof(FONT[0]);
+	const int GLYPHS_PER_ROW = WHITE_X / CELL_WIDTH;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+PerfHud::PerfHud() {
+	graphics = NULL;
+	texture = NULL;
+	for (int i = 0; i < 256; i++)
+		glyphIndex[i] = -1;
+	textClear();
+	initialized = false;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+PerfHud::~PerfHud() {
+	SAFE_RELEASE(texture);
+}
+
+//=============================================================================
+// Create the HUD texture
+// The built in font is drawn at the top left, the white block at WHITE_X.
+//=============================================================================
+bool PerfHud::initialize(Graphics *g) {
+	using namespace perfHudNS;
+	graphics = g;
+
+	COLOR_ARGB *pixels = new COLOR_ARGB[TEXTURE_WIDTH * TEXTURE_HEIGHT];
+	for (int i = 0; i < TEXTURE_WIDTH * TEXTURE_HEIGHT; i++)
+		pixels[i] = 0;
+
+	for (int i = 0; i < FONT_GLYPHS; i++) {
+		int left = (i % GLYPHS_PER_ROW) * CELL_WIDTH;
+		int top = (i / GLYPHS_PER_ROW) * CELL_HEIGHT;
+		for (int y = 0; y < GLYPH_HEIGHT; y++) {
+			for (int x = 0; x < GLYPH_WIDTH; x++) {
+				if (FONT[i].rows[y * GLYPH_WIDTH + x] == '1')
+					pixels[(top + y) * TEXTURE_WIDTH + left + x] = graphicsNS::WHITE;
+			}
+		}
+		glyphIndex[(UCHAR)FONT[i].c] = (char)i;
+		if (FONT[i].c >= 'A' && FONT[i].c <= 'Z')				// lower case uses upper case glyphs
+			glyphIndex[(UCHAR)(FONT[i].c - 'A' + 'a')] = (char)i;
+	}
+	for (int y = 0; y < WHITE_SIZE; y++) {
+		for (int x = 0; x < WHITE_SIZE; x++)
+			pixels[y * TEXTURE_WIDTH + WHITE_X + x] = graphicsNS::WHITE;
+	}
+
+	HRESULT hr = graphics->createTexture(TEXTURE_WIDTH, TEXTURE_HEIGHT, pixels, texture);
+	delete[] pixels;
+	if (FAILED(hr))
+		return false;
+	initialized = true;
+	return true;
+}
+
+//=============================================================================
+// Append a string to the line
+//=============================================================================
+void PerfHud::textAdd(const char *s) {
+	while (*s && textLength < perfHudNS::MAX_TEXT - 1)
+		text[textLength++] = *s++;
+	text[textLength] = 0;
+}
+
+//=============================================================================
+// Append a number with the given number of decimals to the line
+//=============================================================================
+void PerfHud::textAdd(float value, int decimals) {
+	char digits[24];
+	int n = 0;
+	if (value < 0) {
+		textAdd("-");
+		value = -value;
+	}
+	float scale = 1;
+	for (int i = 0; i < decimals; i++)
+		scale *= 10;
+	UINT64 v = (UINT64)(value * scale + 0.5f);
+	for (int i = 0; i < decimals; i++) {		// fraction digits, least significant first
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	}
+	if (decimals > 0)
+		digits[n++] = '.';
+	do {
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v > 0 && n < (int)sizeof(digits));
+	while (n > 0 && textLength < perfHudNS::MAX_TEXT - 1)
+		text[textLength++] = digits[--n];
+	text[textLength] = 0;
+}
+
+//=============================================================================
+// Draw the line at x, y
+//=============================================================================
+void PerfHud::drawText(float x, float y) {
+	using namespace perfHudNS;
+	UINT count = 0;
+	for (int i = 0; i < textLength; i++) {
+		int g = glyphIndex[(UCHAR)text[i]];
+		if (g < 0)
+			continue;							// space or unknown
+		SpriteQuad &q = quads[count++];
+		q.rect.left = (g % GLYPHS_PER_ROW) * CELL_WIDTH;
+		q.rect.top = (g / GLYPHS_PER_ROW) * CELL_HEIGHT;
+		q.rect.right = q.rect.left + GLYPH_WIDTH;
+		q.rect.bottom = q.rect.top + GLYPH_HEIGHT;
+		q.position = D3DXVECTOR3((float)(i * CELL_WIDTH), 0.0f, 0.0f);
+	}
+	graphics->drawSpriteRun(texture, quads, count, x, y, SCALE, TEXT_COLOR);
+}
+
+//=============================================================================
+// Draw a filled rectangle in screen pixels
+//=============================================================================
+void PerfHud::drawRect(float x, float y, float w, float h, COLOR_ARGB color) {
+	using namespace perfHudNS;
+	// scale the white block so it covers the larger side
+	float scale = ((w > h) ? w : h) / WHITE_SIZE;
+	if (scale <= 0)
+		return;
+	SpriteQuad &q = quads[0];
+	q.rect.left = WHITE_X;
+	q.rect.top = 0;
+	q.rect.right = WHITE_X + (LONG)(w / scale + 0.5f);
+	q.rect.bottom = (LONG)(h / scale + 0.5f);
+	q.position = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+	graphics->drawSpriteRun(texture, quads, 1, x, y, scale, color);
+}
+
+//=============================================================================
+// Draw the HUD
+//=============================================================================
+void PerfHud::draw(const PerfStats &stats) {
+	using namespace perfHudNS;
+	if (!initialized)
+		return;
+
+	const float lineHeight = CELL_HEIGHT * SCALE;
+	const float width = perfStatsNS::HISTORY * SCALE;
+	const float graphTop = Y + lineHeight * 3 + SCALE;
+	float minMs, maxMs, averageMs;
+	stats.getHistoryRange(minMs, maxMs, averageMs);
+
+	graphics->spriteBegin();
+	drawRect(X - SCALE, Y - SCALE, width + SCALE * 2, graphTop + GRAPH_HEIGHT * SCALE - Y + SCALE * 2, BACK_COLOR);
+
+	textClear();
+	textAdd("FPS ");
+	textAdd(stats.getFps(), 1);
+	textAdd("  MS ");
+	textAdd(averageMs, 2);
+	textAdd("  MIN ");
+	textAdd(minMs, 2);
+	textAdd("  MAX ");
+	textAdd(maxMs, 2);
+	drawText(X, Y);
+
+	textClear();
+	for (int p = 0; p < perfStatsNS::PHASE_COUNT; p++) {
+		textAdd(perfStatsNS::PHASE_NAMES[p]);
+		textAdd(" ");
+		textAdd(stats.getPhaseAverage((perfStatsNS::PHASE)p), 2);
+		textAdd("  ");
+	}
+	drawText(X, Y + lineHeight);
+
+	textClear();
+	textAdd("SPRITES ");
+	textAdd((float)stats.getSprites(), 0);
+	textAdd("  DRAWS ");
+	textAdd((float)stats.getDrawCalls(), 0);
+	textAdd("  TEX ");
+	textAdd((float)stats.getTextureBytes() / (1024.0f * 1024.0f), 2);
+	textAdd(" MB  ALLOC ");
+	textAdd((float)stats.getFrameAllocations(), 0);
+	drawText(X, Y + lineHeight * 2);
+
+	// frame time graph, one bar per frame, one run per color
+	const COLOR_ARGB colors[3] = { GOOD_COLOR, SLOW_COLOR, BAD_COLOR };
+	for (int c = 0; c < 3; c++) {
+		UINT count = 0;
+		for (int i = 0; i < stats.getHistoryCount(); i++) {
+			float ms = stats.getHistory(i);
+			int band = (ms <= TARGET_MS) ? 0 : (ms <= TARGET_MS * 2) ? 1 : 2;
+			if (band != c)
+				continue;
+			LONG h = (LONG)(ms / GRAPH_MS * GRAPH_HEIGHT + 0.5f);
+			if (h > (LONG)GRAPH_HEIGHT)
+				h = (LONG)GRAPH_HEIGHT;
+			if (h < 1)
+				h = 1;
+			SpriteQuad &q = quads[count++];
+			q.rect.left = WHITE_X;
+			q.rect.top = 0;
+			q.rect.right = WHITE_X + 1;
+			q.rect.bottom = h;
+			q.position = D3DXVECTOR3((float)i, GRAPH_HEIGHT - h, 0.0f);
+		}
+		graphics->drawSpriteRun(texture, quads, count, X, graphTop, SCALE, colors[c]);
+	}
+	graphics->spriteEnd();
+}
@@ -0,0 +1,76 @@
+#ifndef _PERFHUD_H
+#define _PERFHUD_H
+#define WIN32_LEAN_AND_MEAN
+
+#include "graphics.h"
+#include "perfStats.h"
+#include "constants.h"
+
+namespace perfHudNS {
+	const int   TEXTURE_WIDTH = 128;		// HUD texture holds the font and a white block
+	const int   TEXTURE_HEIGHT = 64;
+	const int   GLYPH_WIDTH = 3;			// built in font size in pixels
+	const int   GLYPH_HEIGHT = 5;
+	const int   CELL_WIDTH = 4;				// glyph spacing in the texture
+	const int   CELL_HEIGHT = 6;
+	const int   WHITE_X = 64;				// white block used for graph bars
+	const int   WHITE_SIZE = 64;
+	const float SCALE = 2.0f;				// HUD pixels per texture pixel
+	const float X = 8.0f;					// screen location of the HUD
+	const float Y = 8.0f;
+	const float GRAPH_HEIGHT = 64.0f;		// height of the frame time graph at scale 1
+	const float GRAPH_MS = 50.0f;			// frame time at the top of the graph
+	const int   MAX_TEXT = 96;				// characters per HUD line
+	const int   MAX_QUADS = perfStatsNS::HISTORY + MAX_TEXT;
+	const COLOR_ARGB TEXT_COLOR = graphicsNS::WHITE;
+	const COLOR_ARGB GOOD_COLOR = graphicsNS::LIME;		// frame at or under target time
+	const COLOR_ARGB SLOW_COLOR = graphicsNS::YELLOW;	// frame under twice target time
+	const COLOR_ARGB BAD_COLOR = graphicsNS::RED;
+	const COLOR_ARGB BACK_COLOR = D3DCOLOR_ARGB(160, 0, 0, 0);
+	const float TARGET_MS = 1000.0f / 60.0f;			// frame time shown in GOOD_COLOR
+}
+
+// Overlay showing PerfStats: FPS, frame time graph, phase times,
+// sprite and draw call counts, texture memory and heap allocations per frame.
+// Uses its own built in font and fixed size buffers, so drawing does not
+// allocate memory.
+class PerfHud {
+private:
+	Graphics    *graphics;		// pointer to graphics
+	LP_TEXTURE  texture;		// built in font and white block
+	char        glyphIndex[256];	// glyph number of each char, -1 if none
+	SpriteQuad  quads[perfHudNS::MAX_QUADS];	// quads of the item being drawn
+	char        text[perfHudNS::MAX_TEXT];		// line being drawn
+	int         textLength;
+	bool        initialized;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Line building, does not allocate
+	void textClear() { textLength = 0; text[0] = 0; }
+	void textAdd(const char *s);
+	void textAdd(float value, int decimals);
+
+	// Draw text at x, y.
+	void drawText(float x, float y);
+
+	// Draw a filled rectangle in screen pixels.
+	void drawRect(float x, float y, float w, float h, COLOR_ARGB color);
+
+public:
+	// Constructor
+	PerfHud();
+
+	// Destructor
+	virtual ~PerfHud();
+
+	// Create the HUD texture.
+	// Pre: *g points to Graphics object
+	// Post: returns false on error
+	bool initialize(Graphics *g);
+
+	// Draw the HUD showing stats.
+	// Pre: graphics->beginScene() has been called, sprite drawing has ended
+	void draw(const PerfStats &stats);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "perfStats.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+PerfStats::PerfStats() {
+	QueryPerformanceFrequency(&timerFreq);
+	reset();
+}
+
+//=============================================================================
+// Clear all statistics
+//=============================================================================
+void PerfStats::reset() {
+	for (int i = 0; i < perfStatsNS::HISTORY; i++)
+		history[i] = 0;
+	historyNext = 0;
+	historyCount = 0;
+	for (int i = 0; i < perfStatsNS::PHASE_COUNT; i++) {
+		phaseTime[i] = 0;
+		phaseAverage[i] = 0;
+		phaseAllocs[i] = 0;
+	}
+	phaseStart.QuadPart = 0;
+	phaseAllocStart = 0;
+	frameAllocStart = memoryNS::getAllocCounts();
+	frameAllocs.allocations = 0;
+	frameAllocs.bytes = 0;
+	fps = 0;
+	sprites = 0;
+	drawCalls = 0;
+	textureBytes = 0;
+}
+
+//=============================================================================
+// Start timing a phase
+//=============================================================================
+void PerfStats::beginPhase() {
+	phaseAllocStart = memoryNS::getAllocCounts().allocations;
+	QueryPerformanceCounter(&phaseStart);
+}
+
+//=============================================================================
+// Stop timing and save the time of phase p
+//=============================================================================
+void PerfStats::endPhase(perfStatsNS::PHASE p) {
+	LARGE_INTEGER phaseEnd;
+	QueryPerformanceCounter(&phaseEnd);
+	setPhaseTime(p, (float)(phaseEnd.QuadPart - phaseStart.QuadPart) * 1000.0f / (float)timerFreq.QuadPart);
+	phaseAllocs[p] = memoryNS::getAllocCounts().allocations - phaseAllocStart;
+}
+
+//=============================================================================
+// Save the time of phase p
+//=============================================================================
+void PerfStats::setPhaseTime(perfStatsNS::PHASE p, float ms) {
+	phaseTime[p] = ms;
+	phaseAverage[p] += (ms - phaseAverage[p]) * perfStatsNS::SMOOTHING;
+}
+
+//=============================================================================
+// Save the frame time in the history
+//=============================================================================
+void PerfStats::endFrame(float frameTime, float framesPerSecond) {
+	history[historyNext] = frameTime * 1000.0f;
+	historyNext = (historyNext + 1) % perfStatsNS::HISTORY;
+	if (historyCount < perfStatsNS::HISTORY)
+		historyCount++;
+	fps = framesPerSecond;
+
+	memoryNS::AllocCounts now = memoryNS::getAllocCounts();
+	frameAllocs.allocations = now.allocations - frameAllocStart.allocations;
+	frameAllocs.bytes = now.bytes - frameAllocStart.bytes;
+	frameAllocStart = now;
+}
+
+//=============================================================================
+// Return frame time of history entry i, 0 is the oldest
+//=============================================================================
+float PerfStats::getHistory(int i) const {
+	if (i < 0 || i >= historyCount)
+		return 0;
+	int oldest = (historyNext - historyCount + perfStatsNS::HISTORY) % perfStatsNS::HISTORY;
+	return history[(oldest + i) % perfStatsNS::HISTORY];
+}
+
+//=============================================================================
+// Return smallest, largest and average frame time in the history
+//=============================================================================
+void PerfStats::getHistoryRange(float &minMs, float &maxMs, float &averageMs) const {
+	minMs = maxMs = averageMs = 0;
+	if (historyCount == 0)
+		return;
+	minMs = maxMs = getHistory(0);
+	float total = 0;
+	for (int i = 0; i < historyCount; i++) {
+		float t = getHistory(i);
+		if (t < minMs)
+			minMs = t;
+		if (t > maxMs)
+			maxMs = t;
+		total += t;
+	}
+	averageMs = total / historyCount;
+}
@@ -0,0 +1,95 @@
+#ifndef _PERFSTATS_H
+#define _PERFSTATS_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include "memoryStats.h"
+
+namespace perfStatsNS {
+	// timed phases of a frame
+	enum PHASE { UPDATE, AI, COLLISIONS, RENDER, PRESENT, PHASE_COUNT };
+	const char * const PHASE_NAMES[PHASE_COUNT] = { "UPD", "AI", "COL", "REN", "PRE" };
+	const int   HISTORY = 240;			// frame times kept for the graph
+	const float SMOOTHING = 0.05f;		// weight of the newest sample in averages
+}
+
+// Frame timing, heap allocation and rendering statistics shown by PerfHud.
+// Uses fixed size storage, so recording a frame does not allocate.
+class PerfStats {
+private:
+	float   history[perfStatsNS::HISTORY];		// frame times in milli-seconds, ring buffer
+	int     historyNext;						// next history slot to write
+	int     historyCount;						// number of valid history entries
+	float   phaseTime[perfStatsNS::PHASE_COUNT];	// last frame, milli-seconds
+	float   phaseAverage[perfStatsNS::PHASE_COUNT];	// smoothed, milli-seconds
+	LARGE_INTEGER timerFreq;					// Performance Counter frequency
+	LARGE_INTEGER phaseStart;					// Performance Counter at beginPhase()
+	UINT64  phaseAllocStart;					// heap allocations at beginPhase()
+	UINT64  phaseAllocs[perfStatsNS::PHASE_COUNT];	// heap allocations of each phase last frame
+	memoryNS::AllocCounts frameAllocStart;		// heap totals at the end of the previous frame
+	memoryNS::AllocCounts frameAllocs;			// heap allocations and bytes last frame
+	float   fps;								// frames per second
+	UINT    sprites;							// sprites drawn last frame
+	UINT    drawCalls;							// draw calls last frame
+	UINT64  textureBytes;						// estimated texture memory in use
+
+public:
+	// Constructor
+	PerfStats();
+
+	// Clear all statistics.
+	void reset();
+
+	// Start timing a phase and counting its heap allocations.
+	void beginPhase();
+
+	// Stop timing and save the time and heap allocations of phase p.
+	void endPhase(perfStatsNS::PHASE p);
+
+	// Save a phase time measured elsewhere.
+	void setPhaseTime(perfStatsNS::PHASE p, float ms);
+
+	// Save rendering counts of this frame.
+	void setCounts(UINT s, UINT d, UINT64 bytes) { sprites = s; drawCalls = d; textureBytes = bytes; }
+
+	// Call once per frame with the frame time in seconds and the average fps.
+	void endFrame(float frameTime, float framesPerSecond);
+
+	// Return number of frame times in the history.
+	int getHistoryCount() const { return historyCount; }
+
+	// Return frame time in milli-seconds of history entry i. 0 is the oldest.
+	float getHistory(int i) const;
+
+	// Return smallest, largest and average frame time in the history in milli-seconds.
+	void getHistoryRange(float &minMs, float &maxMs, float &averageMs) const;
+
+	// Return time of phase p in the last frame in milli-seconds.
+	float getPhaseTime(perfStatsNS::PHASE p) const { return phaseTime[p]; }
+
+	// Return smoothed time of phase p in milli-seconds.
+	float getPhaseAverage(perfStatsNS::PHASE p) const { return phaseAverage[p]; }
+
+	// Return heap allocations made during phase p in the last frame.
+	UINT64 getPhaseAllocations(perfStatsNS::PHASE p) const { return phaseAllocs[p]; }
+
+	// Return heap allocations made during the last frame.
+	UINT64 getFrameAllocations() const { return frameAllocs.allocations; }
+
+	// Return bytes allocated from the heap during the last frame.
+	UINT64 getFrameAllocBytes() const { return frameAllocs.bytes; }
+
+	// Return frames per second.
+	float getFps() const { return fps; }
+
+	// Return sprites drawn last frame.
+	UINT getSprites() const { return sprites; }
+
+	// Return draw calls last frame.
+	UINT getDrawCalls() const { return drawCalls; }
+
+	// Return estimated texture memory in bytes.
+	UINT64 getTextureBytes() const { return textureBytes; }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "radixSort.h"
+#include <string.h>
+
+//=============================================================================
+// LSD radix sort of keys and values
+// One read of the keys builds the histograms of every digit, then each
+// pass scatters by one digit from keys to temp and back.
+//=============================================================================
+void radixSortNS::sort(UINT64 *keys, UINT *values, UINT count, UINT64 *tempKeys, UINT *tempValues) {
+	if (count < 2)
+		return;
+
+	UINT counts[PASSES][BUCKETS];
+	memset(counts, 0, sizeof(counts));
+	for (UINT i = 0; i < count; i++) {
+		UINT64 key = keys[i];
+		for (int pass = 0; pass < PASSES; pass++)
+			counts[pass][(key >> (pass * DIGIT_BITS)) & (BUCKETS - 1)]++;
+	}
+
+	UINT64 *srcKeys = keys, *dstKeys = tempKeys;
+	UINT *srcValues = values, *dstValues = tempValues;
+	for (int pass = 0; pass < PASSES; pass++) {
+		UINT *bucket = counts[pass];
+		int shift = pass * DIGIT_BITS;
+		if (bucket[(srcKeys[0] >> shift) & (BUCKETS - 1)] == count)
+			continue;							// every key has this digit
+
+		// bucket counts to bucket starts
+		UINT start = 0;
+		for (int b = 0; b < BUCKETS; b++) {
+			UINT n = bucket[b];
+			bucket[b] = start;
+			start += n;
+		}
+		for (UINT i = 0; i < count; i++) {
+			UINT64 key = srcKeys[i];
+			UINT at = bucket[(key >> shift) & (BUCKETS - 1)]++;
+			dstKeys[at] = key;
+			dstValues[at] = srcValues[i];
+		}
+
+		UINT64 *k = srcKeys; srcKeys = dstKeys; dstKeys = k;
+		UINT *v = srcValues; srcValues = dstValues; dstValues = v;
+	}
+
+	if (srcKeys != keys) {						// odd number of passes
+		memcpy(keys, srcKeys, count * sizeof(UINT64));
+		memcpy(values, srcValues, count * sizeof(UINT));
+	}
+}
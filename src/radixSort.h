@@ -0,0 +1,21 @@
+#ifndef _RADIXSORT_H
+#define _RADIXSORT_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+namespace radixSortNS {
+	const int   DIGIT_BITS = 11;		// bits sorted per pass
+	const int   BUCKETS = 1 << DIGIT_BITS;
+	const int   PASSES = (64 + DIGIT_BITS - 1) / DIGIT_BITS;
+
+	// Sort count 64 bit keys, and the values that go with them, in ascending
+	// order with an LSD radix sort. Equal keys keep their order.
+	// Passes over digits that are the same in every key are skipped, so keys
+	// that use few bits sort in fewer passes.
+	// Pre: tempKeys and tempValues hold count entries each
+	// Post: keys and values are sorted
+	void sort(UINT64 *keys, UINT *values, UINT count, UINT64 *tempKeys, UINT *tempValues);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "resolutionScaler.h"
+#include <math.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+ResolutionScaler::ResolutionScaler() {
+	initialize(1.0f / 60.0f);
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+ResolutionScaler::~ResolutionScaler() {}
+
+//=============================================================================
+// Set the target frame time and range of scales
+//=============================================================================
+void ResolutionScaler::initialize(float targetFrameTime, float minimum, float maximum) {
+	target = targetFrameTime;
+	minScale = minimum;
+	maxScale = (maximum < minimum) ? minimum : maximum;
+	scale = maxScale;
+	average = 0;
+	overFrames = 0;
+	underFrames = 0;
+	settleFrames = 0;
+	changes = 0;
+}
+
+//=============================================================================
+// Round a scale down to a step within the bounds
+// The bounds themselves are allowed even when they are not on a step.
+//=============================================================================
+float ResolutionScaler::quantize(float s) const {
+	s = floorf(s / resolutionNS::SCALE_STEP + 0.001f) * resolutionNS::SCALE_STEP;
+	if (s < minScale)
+		return minScale;
+	if (s > maxScale)
+		return maxScale;
+	return s;
+}
+
+//=============================================================================
+// Switch to a new scale
+// The average is rescaled by the change in area, as a guess of the frame
+// time at the new scale until real frames replace it.
+//=============================================================================
+void ResolutionScaler::change(float s) {
+	average *= (s * s) / (scale * scale);
+	scale = s;
+	overFrames = 0;
+	underFrames = 0;
+	settleFrames = resolutionNS::SETTLE_FRAMES;
+	changes++;
+}
+
+//=============================================================================
+// Add the time of the last frame
+//=============================================================================
+float ResolutionScaler::update(float frameTime) {
+	using namespace resolutionNS;
+	if (average == 0)
+		average = frameTime;				// first frame
+	else
+		average += (frameTime - average) * AVERAGE_WEIGHT;
+
+	if (settleFrames > 0) {
+		settleFrames--;
+		return scale;
+	}
+
+	if (average > target) {
+		underFrames = 0;
+		if (++overFrames >= DOWN_FRAMES && scale > minScale) {
+			// area needed to meet the target, at least one step down
+			float s = quantize(scale * sqrtf(target / average));
+			if (s >= scale)
+				s = quantize(scale - SCALE_STEP);
+			change(s);
+		}
+	}
+	else if (average < target * HEADROOM) {
+		overFrames = 0;
+		if (++underFrames >= UP_FRAMES && scale < maxScale) {
+			// only if the next step up is predicted to stay under the target
+			float s = quantize(scale + SCALE_STEP);
+			if (average * (s * s) / (scale * scale) < target)
+				change(s);
+			else
+				underFrames = 0;
+		}
+	}
+	else {									// in the band, keep the scale
+		overFrames = 0;
+		underFrames = 0;
+	}
+	return scale;
+}
@@ -0,0 +1,76 @@
+#ifndef _RESOLUTIONSCALER_H
+#define _RESOLUTIONSCALER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+
+namespace resolutionNS {
+	const float MIN_SCALE = 0.5f;			// smallest fraction of the screen width and height
+	const float MAX_SCALE = 1.0f;
+	const float SCALE_STEP = 0.0625f;		// scales are multiples of this
+	const float AVERAGE_WEIGHT = 0.1f;		// weight of the newest frame in the moving average
+	const float HEADROOM = 0.85f;			// raise the scale only below this fraction of the target
+	const int   DOWN_FRAMES = 8;			// frames over the target before lowering the scale
+	const int   UP_FRAMES = 60;				// frames under the headroom before raising it
+	const int   SETTLE_FRAMES = 20;			// frames after a change before the next decision
+}
+
+// Chooses the fraction of the screen resolution to render the scene at, so
+// the average frame time stays under a target. The cost of a fill rate bound
+// frame grows with the scaled area, so a frame over the target lowers the
+// scale by the square root of the overrun. Raising is cautious, one step at
+// a time and only after a long run of frames well under the target.
+// Hysteresis comes from the band between HEADROOM and the target where the
+// scale is kept, the different frame counts needed to lower or raise, and a
+// settling time after each change for the average to catch up.
+// The controller only does arithmetic on frame times, so it can be driven
+// by recorded or synthetic traces.
+class ResolutionScaler {
+private:
+	float       target;					// frame time in seconds
+	float       minScale;
+	float       maxScale;
+	float       scale;					// current fraction of the screen resolution
+	float       average;				// moving average of frame time
+	int         overFrames;				// frames in a row with the average over target
+	int         underFrames;			// frames in a row with the average under the headroom
+	int         settleFrames;			// frames until decisions are made again
+	UINT        changes;				// scale changes since initialize()
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Round s down to a multiple of SCALE_STEP within the bounds.
+	float quantize(float s) const;
+
+	// Switch to scale s and start settling.
+	void change(float s);
+
+public:
+	// Constructor
+	ResolutionScaler();
+
+	// Destructor
+	virtual ~ResolutionScaler();
+
+	// Set the target frame time in seconds and the range of scales.
+	// Starts at maxScale.
+	void initialize(float targetFrameTime, float minimum = resolutionNS::MIN_SCALE,
+		float maximum = resolutionNS::MAX_SCALE);
+
+	// Add the time of the last frame in seconds.
+	// Returns the scale to render the next frame at.
+	float update(float frameTime);
+
+	// Return the scale to render at.
+	float getScale() const { return scale; }
+
+	// Return the moving average of frame time in seconds.
+	float getAverage() const { return average; }
+
+	// Return the target frame time in seconds.
+	float getTarget() const { return target; }
+
+	// Return number of scale changes since initialize().
+	UINT getChanges() const { return changes; }
+};
+
+#endif
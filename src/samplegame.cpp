@@ -20,30 +20,38 @@ SampleGame::~SampleGame() {
 void SampleGame::initialize(HWND hwnd) {
 	Game::initialize(hwnd); // throws GameError
 
-	// background texture
-	if (!backgroundTexture.initialize(graphics, BACKGROUND_IMAGE))
-		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing background texture"));
-
-	// ship texture
-	if (!shipTexture.initialize(graphics, SHIP_IMAGE))
-		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing ship texture"));
+	// textures are read in parallel, images are initialized when their texture is ready
+	assets.addTexture(&backgroundTexture, BACKGROUND_IMAGE);
+	assets.addTexture(&shipTexture, SHIP_IMAGE);
+	assets.addImage(&background, 0, 0, 0, &backgroundTexture);
+	assets.addImage(&ship, SHIP_WIDTH, SHIP_HEIGHT, SHIP_COLS, &shipTexture);
+	loadAssets();           // throws GameError
+	residency.add(&backgroundTexture);
+	residency.add(&shipTexture);
+
+	// trim the transparent texels around the ship's frames, drawn through drawList
+	if (shipTexture.getOpacity() &&
+		shipMeshes.initialize(*shipTexture.getOpacity(), SHIP_WIDTH, SHIP_HEIGHT, SHIP_COLS, SHIP_END_FRAME + 1)) {
+		ship.setMeshes(&shipMeshes);
+		logger.info("ship meshes cover {} of the area of its quads", shipMeshes.getFillRatio());
+	}
 
-	// background
-	if (!background.initialize(graphics, 0, 0, 0, &backgroundTexture))
-		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing background"));
+	background.setScale(BACKGROUND_SCALE);
 
-	// ship
-	if (!ship.initialize(graphics, SHIP_WIDTH, SHIP_HEIGHT, SHIP_COLS, &shipTexture))
-		throw(GameError(gameErrorNS::FATAL_ERROR, "Error initializing ship"));
+	// world units are pixels, with the screen showing 0,0 to GAME_WIDTH,GAME_HEIGHT
+	camera.initialize((float)GAME_WIDTH, (float)GAME_HEIGHT);
+	camera.setPosition(GAME_WIDTH / 2.0f, GAME_HEIGHT / 2.0f);
 
-	background.setScale(BACKGROUND_SCALE);
+	drawList.initialize(graphics, 64);
 
 	ship.setX(GAME_WIDTH / 2);
 	ship.setY(GAME_HEIGHT / 2);
 	ship.setFrames(SHIP_START_FRAME, SHIP_END_FRAME);	// animation frames
 	ship.setCurrentFrame(SHIP_START_FRAME);				// starting frame
 	ship.setFrameDelay(SHIP_ANIMATION_DELAY);
+	ship.setTimerWheel(getTimers());					// animated by a game timer
 	ship.setDegrees(45.0f);								// angle of ship
+	getBehaviors()->start(ShipFlash(&ship));
 
 	return;
 }
@@ -52,28 +60,27 @@ void SampleGame::initialize(HWND hwnd) {
 // Update all game items
 //=============================================================================
 void SampleGame::update() {
+	const ViewBounds &view = camera.getBounds();			// world area on screen
 	if (input->isKeyDown(RIGHT_KEY)) {
 		ship.setX(ship.getX() + frameTime * SHIP_SPEED);
-		if (ship.getX() > GAME_WIDTH)						// if off screen right
-			ship.setX((float)-ship.getWidth());				// position off screen left
+		if (ship.getX() > view.right)						// if off screen right
+			ship.setX(view.left - ship.getWidth());			// position off screen left
 	}
 	if (input->isKeyDown(LEFT_KEY)) {
 		ship.setX(ship.getX() - frameTime * SHIP_SPEED);
-		if (ship.getX() < -ship.getWidth())					// if off screen left
-			ship.setX((float)GAME_WIDTH);					// position off screen right
+		if (ship.getX() < view.left - ship.getWidth())		// if off screen left
+			ship.setX(view.right);							// position off screen right
 	}
 	if (input->isKeyDown(UP_KEY)) {
 		ship.setY(ship.getY() - frameTime * SHIP_SPEED);
-		if (ship.getY() < -ship.getHeight())				// if off screen top
-			ship.setY((float)GAME_HEIGHT);					// position off screen bottom
+		if (ship.getY() < view.top - ship.getHeight())		// if off screen top
+			ship.setY(view.bottom);							// position off screen bottom
 	}
 	if (input->isKeyDown(DOWN_KEY)) {
 		ship.setY(ship.getY() + frameTime * SHIP_SPEED);
-		if (ship.getY() > GAME_HEIGHT)						// if off screen bottom
-			ship.setY((float)-ship.getHeight());			// position off screen
+		if (ship.getY() > view.bottom)						// if off screen bottom
+			ship.setY(view.top - ship.getHeight());			// position off screen
 	}
-
-	ship.update(frameTime);									// animate ship
 }
 
 //=============================================================================
@@ -81,6 +88,20 @@ void SampleGame::update() {
 //=============================================================================
 void SampleGame::ai() {}
 
+//=============================================================================
+// Flash the ship
+//=============================================================================
+void ShipFlash::run() {
+	BEHAVIOR_BEGIN
+	for (;;) {
+		BEHAVIOR_WAIT_SECONDS(SHIP_FLASH_INTERVAL);
+		ship->setColorFilter(graphicsNS::ORANGE);
+		BEHAVIOR_WAIT_FRAMES(SHIP_FLASH_FRAMES);
+		ship->setColorFilter(graphicsNS::WHITE);
+	}
+	BEHAVIOR_END
+}
+
 //=============================================================================
 // Handle collisions
 //=============================================================================
@@ -91,9 +112,16 @@ void SampleGame::collisions() {}
 //=============================================================================
 void SampleGame::render() {
 	graphics->spriteBegin();                // begin drawing sprites
+	camera.apply(graphics);                 // draw in world coordinates
+
+	SoftwareRasterizer *fill = getOverdrawRasterizer();	// counts fill for the overdraw heatmap
+	if (fill)
+		fill->setView(graphics->getView());
+	drawList.setRasterizer(fill);
 
-	background.draw();                      // add the background to the scene
-	ship.draw();							// add the ship to the scene
+	background.draw(drawList, 0, 0.0f);     // add the background to the scene
+	ship.draw(drawList, 1, ship.getY(), graphicsNS::FILTER);	// over the background, in ShipFlash's color
+	drawList.flush();                       // draw in layer order
 
 	graphics->spriteEnd();                  // end drawing sprites
 }
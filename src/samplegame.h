@@ -5,6 +5,22 @@
 #include "game.h"
 #include "textureManager.h"
 #include "image.h"
+#include "camera.h"
+#include "drawList.h"
+#include "spriteMesh.h"
+
+// Flashes the ship every SHIP_FLASH_INTERVAL seconds
+class ShipFlash : public Behavior {
+private:
+	Image *ship;
+
+public:
+	// Constructor
+	ShipFlash(Image *s) : ship(s) {}
+
+	// Wait, flash, repeat.
+	void run();
+};
 
 class SampleGame : public Game {
 private:
@@ -13,6 +29,9 @@ private:
 	TextureManager shipTexture;
 	Image		   background;
 	Image		   ship;
+	SpriteMeshSheet shipMeshes;			// trimmed meshes of the ship's frames
+	Camera2D	   camera;
+	DrawList	   drawList;
 
 public:
 	// Constructor
@@ -0,0 +1,179 @@
+#include "softwareRasterizer.h"
+#include <math.h>
+#include <algorithm>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SoftwareRasterizer::SoftwareRasterizer() {
+	width = 0;
+	height = 0;
+	depthTest = false;
+	depthWrite = false;
+	coverage = NULL;
+	viewSet = false;
+	id = 0;
+	shadedCount = 0;
+	writtenCount = 0;
+	rejectedCount = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SoftwareRasterizer::~SoftwareRasterizer() {}
+
+//=============================================================================
+// Create buffers for a w x h target
+//=============================================================================
+bool SoftwareRasterizer::initialize(int w, int h) {
+	if (w <= 0 || h <= 0)
+		return false;
+	try {
+		shaded.resize((size_t)w * h);
+		depth.resize((size_t)w * h);
+		top.resize((size_t)w * h);
+	}
+	catch (...) { return false; }
+	width = w;
+	height = h;
+	clear();
+	return true;
+}
+
+//=============================================================================
+// Clear counts, depth and ids
+//=============================================================================
+void SoftwareRasterizer::clear() {
+	std::fill(shaded.begin(), shaded.end(), 0);
+	std::fill(depth.begin(), depth.end(), rasterNS::FAR_DEPTH);
+	std::fill(top.begin(), top.end(), rasterNS::NO_SPRITE);
+	shadedById.clear();
+	shadedCount = 0;
+	writtenCount = 0;
+	rejectedCount = 0;
+}
+
+//=============================================================================
+// Draw a convex polygon as a fan of triangles
+//=============================================================================
+void SoftwareRasterizer::drawPolygon(const RasterVertex *v, int count) {
+	for (int i = 1; i + 1 < count; i++)
+		drawTriangle(v[0], v[i], v[i + 1]);
+}
+
+//=============================================================================
+// Return the edge function of edge p to q at s, positive on its inside
+//=============================================================================
+static inline float edgeAt(const RasterVertex &p, const RasterVertex &q, float sx, float sy) {
+	return (q.x - p.x) * (sy - p.y) - (q.y - p.y) * (sx - p.x);
+}
+
+//=============================================================================
+// Return true if pixel centers exactly on edge p to q belong to its triangle
+// Of two triangles sharing an edge, each walks it the other way, so exactly
+// one of them owns it.
+//=============================================================================
+static inline bool ownsEdge(const RasterVertex &p, const RasterVertex &q) {
+	float dy = q.y - p.y;
+	return dy > 0 || (dy == 0 && q.x < p.x);
+}
+
+//=============================================================================
+// Rasterize one triangle
+// Depth and texels are interpolated with barycentric weights; sprites are
+// flat, so no perspective correction is needed.
+//=============================================================================
+void SoftwareRasterizer::drawTriangle(const RasterVertex &a, const RasterVertex &b0, const RasterVertex &c0) {
+	float area = edgeAt(a, b0, c0.x, c0.y);
+	if (area == 0 || width == 0)
+		return;
+	// wind so every edge function is positive inside
+	const RasterVertex &b = (area > 0) ? b0 : c0;
+	const RasterVertex &c = (area > 0) ? c0 : b0;
+	float inverseArea = 1.0f / fabsf(area);
+	bool ownA = ownsEdge(b, c), ownB = ownsEdge(c, a), ownC = ownsEdge(a, b);
+
+	// pixels with centers in the bounding box
+	float minX = (a.x < b.x) ? a.x : b.x, maxX = (a.x > b.x) ? a.x : b.x;
+	float minY = (a.y < b.y) ? a.y : b.y, maxY = (a.y > b.y) ? a.y : b.y;
+	minX = (c.x < minX) ? c.x : minX; maxX = (c.x > maxX) ? c.x : maxX;
+	minY = (c.y < minY) ? c.y : minY; maxY = (c.y > maxY) ? c.y : maxY;
+	int x0 = (int)floorf(minX - 0.5f), x1 = (int)ceilf(maxX - 0.5f);
+	int y0 = (int)floorf(minY - 0.5f), y1 = (int)ceilf(maxY - 0.5f);
+	x0 = (x0 < 0) ? 0 : x0; x1 = (x1 >= width) ? width - 1 : x1;
+	y0 = (y0 < 0) ? 0 : y0; y1 = (y1 >= height) ? height - 1 : y1;
+
+	UINT64 shadedBefore = shadedCount;
+	for (int y = y0; y <= y1; y++) {
+		float sy = y + 0.5f;
+		for (int x = x0; x <= x1; x++) {
+			float sx = x + 0.5f;
+			float ea = edgeAt(b, c, sx, sy);
+			float eb = edgeAt(c, a, sx, sy);
+			float ec = edgeAt(a, b, sx, sy);
+			if (ea < 0 || eb < 0 || ec < 0)
+				continue;
+			if ((ea == 0 && !ownA) || (eb == 0 && !ownB) || (ec == 0 && !ownC))
+				continue;
+			float wa = ea * inverseArea, wb = eb * inverseArea, wc = ec * inverseArea;
+			size_t p = (size_t)y * width + x;
+
+			float z = wa * a.z + wb * b.z + wc * c.z;
+			if (depthTest && !(z < depth[p])) {
+				rejectedCount++;
+				continue;
+			}
+			shaded[p]++;
+			shadedCount++;
+			if (coverage) {
+				float u = wa * a.u + wb * b.u + wc * c.u;
+				float v = wa * a.v + wb * b.v + wc * c.v;
+				if (!coverage->isCovered((int)floorf(u), (int)floorf(v)))
+					continue;
+			}
+			writtenCount++;
+			top[p] = id;
+			if (depthWrite)
+				depth[p] = z;
+		}
+	}
+
+	if (shadedCount != shadedBefore && id != rasterNS::NO_SPRITE) {
+		if (id >= shadedById.size())
+			shadedById.resize(id + 1, 0);
+		shadedById[id] += shadedCount - shadedBefore;
+	}
+}
+
+//=============================================================================
+// Draw the quad or mesh of a sprite
+// Mesh points are texels of the frame, so they are also its texture
+// coordinates.
+//=============================================================================
+void SoftwareRasterizer::drawSprite(const SpriteData &sd, float z, const SpriteMesh *mesh) {
+	SpritePlacement placement(sd, viewSet ? &view : NULL);
+	RasterVertex v[meshNS::MAX_VERTICES];
+	if (mesh == NULL) {
+		// corners clockwise from top left
+		const float cornerX[4] = { 0.0f, (float)sd.width, (float)sd.width, 0.0f };
+		const float cornerY[4] = { 0.0f, 0.0f, (float)sd.height, (float)sd.height };
+		const LONG cornerU[4] = { sd.rect.left, sd.rect.right, sd.rect.right, sd.rect.left };
+		const LONG cornerV[4] = { sd.rect.top, sd.rect.top, sd.rect.bottom, sd.rect.bottom };
+		for (int i = 0; i < 4; i++) {
+			placement.place(cornerX[i], cornerY[i], v[i].x, v[i].y);
+			v[i].z = z;
+			v[i].u = (float)cornerU[i];
+			v[i].v = (float)cornerV[i];
+		}
+		drawPolygon(v, 4);
+		return;
+	}
+	for (int i = 0; i < mesh->count; i++) {
+		placement.place(mesh->x[i], mesh->y[i], v[i].x, v[i].y);
+		v[i].z = z;
+		v[i].u = sd.rect.left + mesh->x[i];
+		v[i].v = sd.rect.top + mesh->y[i];
+	}
+	drawPolygon(v, mesh->count);
+}
@@ -0,0 +1,126 @@
+#ifndef _SOFTWARERASTERIZER_H
+#define _SOFTWARERASTERIZER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "graphics.h"
+#include "opacityMap.h"
+#include "spriteMesh.h"
+
+namespace rasterNS {
+	const float FAR_DEPTH = 1.0f;		// depth buffer is cleared to this
+	const UINT  NO_SPRITE = 0xffffffff;	// top id of pixels nothing was written to
+}
+
+// Vertex of a polygon drawn by SoftwareRasterizer.
+struct RasterVertex {
+	float       x, y;			// screen pixels
+	float       z;				// depth, 0 near to 1 far
+	float       u, v;			// texel in the coverage map
+};
+
+// Counts the pixel work of drawing sprites, without a graphics device, so
+// fill rate and overdraw can be measured in headless runs.
+// Polygons are rasterized at pixel centers, with shared edges drawn once.
+// Each fragment goes through the stages of the fixed function pipeline:
+// - Depth test, if on: fragments not nearer than the depth buffer are
+//   rejected before shading, as early Z does.
+// - Shading: counted at the pixel. This is the fill cost.
+// - Alpha test, if a coverage map is set: fragments on texels with alpha 0
+//   are discarded after shading. Texels are sampled nearest.
+// - Write: the pixel records the id of the sprite, and its depth if depth
+//   writes are on.
+// No colors are computed.
+class SoftwareRasterizer {
+private:
+	int         width;
+	int         height;
+	std::vector<UINT> shaded;			// fragments shaded at each pixel
+	std::vector<float> depth;
+	std::vector<UINT> top;				// id of the last sprite written at each pixel
+	bool        depthTest;
+	bool        depthWrite;
+	const OpacityMap *coverage;			// alpha test, NULL for none
+	D3DXMATRIX  view;
+	bool        viewSet;
+	UINT        id;						// id of the sprite being drawn
+	UINT64      shadedCount;
+	UINT64      writtenCount;
+	UINT64      rejectedCount;			// fragments rejected by the depth test
+	std::vector<UINT64> shadedById;		// fragments shaded of each sprite id
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Rasterize one triangle.
+	void drawTriangle(const RasterVertex &a, const RasterVertex &b, const RasterVertex &c);
+
+public:
+	// Constructor
+	SoftwareRasterizer();
+
+	// Destructor
+	virtual ~SoftwareRasterizer();
+
+	// Create buffers for a w x h pixel target.
+	// Post: returns false if out of memory
+	bool initialize(int w, int h);
+
+	// Clear counts, depth and ids.
+	void clear();
+
+	// Set the depth test and depth writes for following polygons.
+	void setDepth(bool test, bool write) { depthTest = test; depthWrite = write; }
+
+	// Alpha test following polygons against map, NULL for no alpha test.
+	void setCoverage(const OpacityMap *map) { coverage = map; }
+
+	// Set the view matrix applied by drawSprite(), NULL for screen pixels.
+	void setView(const D3DXMATRIX *viewMatrix) {
+		viewSet = (viewMatrix != NULL);
+		if (viewSet)
+			view = *viewMatrix;
+	}
+
+	// Set the id written by following polygons.
+	void setId(UINT i) { id = i; }
+
+	// Draw a convex polygon of count vertices, in order around it.
+	void drawPolygon(const RasterVertex *v, int count);
+
+	// Draw the quad of a sprite at depth z, as Graphics::drawSprite() places it.
+	// mesh = drawn instead of the quad, NULL for the quad
+	void drawSprite(const SpriteData &sd, float z, const SpriteMesh *mesh = NULL);
+
+	// Return fragments shaded since clear().
+	UINT64 getShaded() const { return shadedCount; }
+
+	// Return pixels written since clear().
+	UINT64 getWritten() const { return writtenCount; }
+
+	// Return fragments rejected by the depth test since clear().
+	UINT64 getRejected() const { return rejectedCount; }
+
+	// Return shaded fragments per pixel of the target.
+	float getOverdraw() const {
+		return (width > 0) ? (float)shadedCount / ((float)width * height) : 0.0f;
+	}
+
+	// Return fragments shaded at each pixel, width x height.
+	const UINT* getShadedCounts() const { return shaded.empty() ? NULL : &shaded[0]; }
+
+	// Return fragments shaded of sprite id since clear().
+	UINT64 getShadedById(UINT i) const { return (i < shadedById.size()) ? shadedById[i] : 0; }
+
+	// Return one more than the highest sprite id drawn since clear().
+	UINT getIdCount() const { return (UINT)shadedById.size(); }
+
+	// Return the id of the last sprite written at x, y, NO_SPRITE for none.
+	UINT getTop(int x, int y) const { return top[y * width + x]; }
+
+	// Return width in pixels.
+	int getWidth() const { return width; }
+
+	// Return height in pixels.
+	int getHeight() const { return height; }
+};
+
+#endif
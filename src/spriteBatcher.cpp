@@ -0,0 +1,349 @@
+#include "spriteBatcher.h"
+#include <math.h>
+#include <string.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SpriteBucket::SpriteBucket() {
+	begin(NULL, NULL, 0);
+}
+
+//=============================================================================
+// Start empty
+// Space is taken from the arena as quads are added.
+//=============================================================================
+void SpriteBucket::begin(MemoryArena *a, const D3DXMATRIX *viewMatrix, UINT expected) {
+	arena = a;
+	view = viewMatrix;
+	vertices = NULL;
+	quads = 0;
+	quadCapacity = 0;
+	batches = NULL;
+	batchCount = 0;
+	batchCapacity = 0;
+	outOfMemory = false;
+	if (arena && expected > 0) {
+		vertices = arena->allocArray<SpriteVertex>(expected * 4);
+		if (vertices)
+			quadCapacity = expected;
+	}
+}
+
+//=============================================================================
+// Make room for count more quads with texture
+// Arrays that are full move to a block twice the size; the old block is
+// freed with the rest of the arena.
+//=============================================================================
+bool SpriteBucket::reserve(LP_TEXTURE texture, UINT count) {
+	if (arena == NULL)
+		return false;
+	if (quads + count > quadCapacity) {
+		UINT capacity = (quadCapacity < 16) ? 16 : quadCapacity * 2;
+		if (capacity < quads + count)
+			capacity = quads + count;
+		SpriteVertex *v = arena->allocArray<SpriteVertex>(capacity * 4);
+		if (v == NULL)
+			return false;
+		if (quads > 0)
+			memcpy(v, vertices, quads * 4 * sizeof(SpriteVertex));
+		vertices = v;
+		quadCapacity = capacity;
+	}
+	if (batchCount > 0 && batches[batchCount - 1].texture == texture)
+		return true;
+	if (batchCount == batchCapacity) {
+		UINT capacity = (batchCapacity < 8) ? 8 : batchCapacity * 2;
+		SpriteBatch *b = arena->allocArray<SpriteBatch>(capacity);
+		if (b == NULL)
+			return false;
+		if (batchCount > 0)
+			memcpy(b, batches, batchCount * sizeof(SpriteBatch));
+		batches = b;
+		batchCapacity = capacity;
+	}
+	SpriteBatch &batch = batches[batchCount++];
+	batch.texture = texture;
+	batch.firstQuad = quads;
+	batch.quads = 0;
+	return true;
+}
+
+//=============================================================================
+// Add the quad of a sprite
+// The sprite is scaled from its top left corner and rotated about its
+// center, as Graphics::drawSprite() does.
+//=============================================================================
+void SpriteBucket::add(const SpriteData &sd, UINT textureWidth, UINT textureHeight, COLOR_ARGB color,
+	const SpriteMesh *mesh) {
+	if (mesh && mesh->count < 3)
+		return;								// nothing of the frame is visible
+	if (!reserve(sd.texture, mesh ? (mesh->count - 1) / 2 : 1)) {
+		outOfMemory = true;
+		return;
+	}
+	if (mesh) {
+		addMesh(sd, textureWidth, textureHeight, color, *mesh);
+		return;
+	}
+
+	float halfWidth = sd.width * sd.scale / 2;
+	float halfHeight = sd.height * sd.scale / 2;
+	float centerX = sd.x + halfWidth;
+	float centerY = sd.y + halfHeight;
+	float c = 1.0f, s = 0.0f;
+	if (sd.angle != 0.0f) {
+		c = cosf(sd.angle);
+		s = sinf(sd.angle);
+	}
+
+	float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+	if (textureWidth > 0 && textureHeight > 0) {
+		u0 = (float)sd.rect.left / textureWidth;
+		u1 = (float)sd.rect.right / textureWidth;
+		v0 = (float)sd.rect.top / textureHeight;
+		v1 = (float)sd.rect.bottom / textureHeight;
+	}
+	if (sd.flipHorizontal) {
+		float t = u0; u0 = u1; u1 = t;
+	}
+	if (sd.flipVertical) {
+		float t = v0; v0 = v1; v1 = t;
+	}
+
+	// corners clockwise from top left
+	const float cornerX[4] = { -halfWidth, halfWidth, halfWidth, -halfWidth };
+	const float cornerY[4] = { -halfHeight, -halfHeight, halfHeight, halfHeight };
+	const float cornerU[4] = { u0, u1, u1, u0 };
+	const float cornerV[4] = { v0, v0, v1, v1 };
+	SpriteVertex *v = &vertices[quads * 4];
+	for (int i = 0; i < 4; i++) {
+		float x = centerX + cornerX[i] * c - cornerY[i] * s;
+		float y = centerY + cornerX[i] * s + cornerY[i] * c;
+		if (view) {
+			float vx = x * view->_11 + y * view->_21 + view->_41;
+			y = x * view->_12 + y * view->_22 + view->_42;
+			x = vx;
+		}
+		v[i].x = x;
+		v[i].y = y;
+		v[i].z = 0.0f;
+		v[i].color = color;
+		v[i].u = cornerU[i];
+		v[i].v = cornerV[i];
+	}
+	quads++;
+	batches[batchCount - 1].quads++;
+}
+
+//=============================================================================
+// Add the quads of the fan of a mesh
+// Quad q is mesh vertices 0, 2q+1, 2q+2 and 2q+3, two triangles of the fan.
+// With an odd number of triangles the last quad repeats its third vertex,
+// which makes its second triangle empty.
+//=============================================================================
+void SpriteBucket::addMesh(const SpriteData &sd, UINT textureWidth, UINT textureHeight, COLOR_ARGB color,
+	const SpriteMesh &mesh) {
+	SpritePlacement placement(sd, view);
+	float u0 = (float)sd.rect.left, v0 = (float)sd.rect.top;
+	float du = 1.0f, dv = 1.0f;
+	if (textureWidth > 0 && textureHeight > 0) {
+		du = 1.0f / textureWidth;
+		dv = 1.0f / textureHeight;
+	}
+	else {									// 0 to 1 across the frame, as add() does
+		u0 = v0 = 0.0f;
+		du = (sd.width > 0) ? 1.0f / sd.width : 0.0f;
+		dv = (sd.height > 0) ? 1.0f / sd.height : 0.0f;
+	}
+
+	SpriteVertex corners[meshNS::MAX_VERTICES];
+	for (int i = 0; i < mesh.count; i++) {
+		placement.place(mesh.x[i], mesh.y[i], corners[i].x, corners[i].y);
+		corners[i].z = 0.0f;
+		corners[i].color = color;
+		corners[i].u = (u0 + mesh.x[i]) * du;
+		corners[i].v = (v0 + mesh.y[i]) * dv;
+	}
+
+	UINT count = (mesh.count - 1) / 2;
+	SpriteVertex *v = &vertices[quads * 4];
+	for (UINT q = 0; q < count; q++, v += 4) {
+		v[0] = corners[0];
+		for (int j = 1; j < 4; j++) {
+			int corner = 2 * q + j;
+			v[j] = corners[(corner < mesh.count) ? corner : mesh.count - 1];
+		}
+	}
+	quads += count;
+	batches[batchCount - 1].quads += count;
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SpriteBatcher::SpriteBatcher() {
+	graphics = NULL;
+	viewSet = false;
+	failed = false;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SpriteBatcher::~SpriteBatcher() {}
+
+//=============================================================================
+// Reserve room for maxSprites sprites per frame
+// Each thread's arena starts with room for its share of the sprites and
+// grows to its peak use.
+//=============================================================================
+bool SpriteBatcher::initialize(Graphics *g, UINT maxSprites) {
+	using namespace spriteBatcherNS;
+	graphics = g;
+	try {
+		buckets.reserve((maxSprites + CHUNK_SPRITES - 1) / CHUNK_SPRITES);
+		firstQuads.reserve(buckets.capacity());
+		vertices.reserve(maxSprites * 4);
+		indices.resize(MAX_DRAW_QUADS * 6);
+	}
+	catch (...) { return false; }
+	for (int i = 0; i < jobSystemNS::MAX_THREADS; i++)
+		if (!arenas[i].initialize(ARENA_BYTES))
+			return false;
+
+	// two triangles per quad: 0,1,2 and 0,2,3
+	for (UINT q = 0; q < MAX_DRAW_QUADS; q++) {
+		WORD v = (WORD)(q * 4);
+		WORD *index = &indices[q * 6];
+		index[0] = v;
+		index[1] = v + 1;
+		index[2] = v + 2;
+		index[3] = v;
+		index[4] = v + 2;
+		index[5] = v + 3;
+	}
+	return true;
+}
+
+//=============================================================================
+// Fill the buckets of the chunks in [begin, end)
+//=============================================================================
+void SpriteBatcher::fillChunks(int begin, int end, int worker, const Submit &submit) {
+	using namespace spriteBatcherNS;
+	const D3DXMATRIX *viewMatrix = viewSet ? &view : NULL;
+	for (int first = begin; first < end; first += CHUNK_SPRITES) {
+		int last = (first + CHUNK_SPRITES < end) ? first + CHUNK_SPRITES : end;
+		SpriteBucket &bucket = buckets[first / CHUNK_SPRITES];
+		bucket.begin(&arenas[worker], viewMatrix, last - first);
+		submit(first, last, bucket);
+	}
+}
+
+//=============================================================================
+// Copy the vertices of buckets [begin, end) to the merged stream
+//=============================================================================
+void SpriteBatcher::copyBuckets(int begin, int end) {
+	for (int b = begin; b < end; b++) {
+		const SpriteBucket &bucket = buckets[b];
+		if (bucket.getQuadCount() > 0)
+			memcpy(&vertices[firstQuads[b] * 4], bucket.getVertices(),
+				bucket.getQuadCount() * 4 * sizeof(SpriteVertex));
+	}
+}
+
+//=============================================================================
+// Generate the vertices of count submissions
+// Buckets are merged in chunk order. A batch that continues the texture of
+// the batch before it is joined to it.
+//=============================================================================
+bool SpriteBatcher::build(JobSystem *jobs, int count, const Submit &submit) {
+	using namespace spriteBatcherNS;
+	vertices.clear();
+	batches.clear();
+	failed = false;
+	int threads = jobs ? jobs->getThreadCount() : 1;
+	for (int i = 0; i < threads; i++)
+		arenas[i].reset();
+	if (count <= 0)
+		return true;
+
+	int chunks = (count + CHUNK_SPRITES - 1) / CHUNK_SPRITES;
+	try {
+		buckets.resize(chunks);
+		firstQuads.resize(chunks);
+	}
+	catch (...) { return false; }
+	if (jobs)
+		jobs->parallelFor(count, CHUNK_SPRITES, [this, &submit](int begin, int end, int worker) {
+			fillChunks(begin, end, worker, submit);
+		});
+	else
+		fillChunks(0, count, 0, submit);
+
+	// positions and batches, in chunk order
+	UINT total = 0;
+	for (int b = 0; b < chunks; b++) {
+		const SpriteBucket &bucket = buckets[b];
+		failed = failed || bucket.isOutOfMemory();
+		firstQuads[b] = total;
+		for (UINT i = 0; i < bucket.getBatchCount(); i++) {
+			SpriteBatch batch = bucket.getBatches()[i];
+			batch.firstQuad += total;
+			if (!batches.empty() && batches.back().texture == batch.texture)
+				batches.back().quads += batch.quads;
+			else
+				batches.push_back(batch);
+		}
+		total += bucket.getQuadCount();
+	}
+
+	try {
+		vertices.resize(total * 4);
+	}
+	catch (...) { return false; }
+	if (jobs)
+		jobs->parallelFor(chunks, 8, [this](int begin, int end, int) {
+			copyBuckets(begin, end);
+		});
+	else
+		copyBuckets(0, chunks);
+	return !failed;
+}
+
+//=============================================================================
+// Draw the vertices from the last build()
+// Batches longer than MAX_DRAW_QUADS are drawn in parts.
+//=============================================================================
+void SpriteBatcher::draw() {
+	if (graphics == NULL || vertices.empty())
+		return;
+	graphics->setScreenTransform(0.0f, 0.0f);
+	for (size_t i = 0; i < batches.size(); i++) {
+		const SpriteBatch &batch = batches[i];
+		for (UINT q = 0; q < batch.quads; q += spriteBatcherNS::MAX_DRAW_QUADS) {
+			UINT n = batch.quads - q;
+			if (n > spriteBatcherNS::MAX_DRAW_QUADS)
+				n = spriteBatcherNS::MAX_DRAW_QUADS;
+			graphics->drawSpriteVertices(batch.texture, &vertices[(batch.firstQuad + q) * 4], n, &indices[0]);
+		}
+	}
+}
+
+//=============================================================================
+// Return the FNV-1a hash of the vertex stream and batches
+//=============================================================================
+UINT64 SpriteBatcher::hash() const {
+	UINT64 h = 14695981039346656037ULL;
+	const BYTE *p = (const BYTE*)getVertices();
+	size_t bytes = vertices.size() * sizeof(SpriteVertex);
+	for (size_t i = 0; i < bytes; i++)
+		h = (h ^ p[i]) * 1099511628211ULL;
+	for (size_t i = 0; i < batches.size(); i++) {
+		UINT64 fields[3] = { (UINT64)(UINT_PTR)batches[i].texture, batches[i].firstQuad, batches[i].quads };
+		p = (const BYTE*)fields;
+		for (size_t j = 0; j < sizeof(fields); j++)
+			h = (h ^ p[j]) * 1099511628211ULL;
+	}
+	return h;
+}
@@ -0,0 +1,160 @@
+#ifndef _SPRITEBATCHER_H
+#define _SPRITEBATCHER_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include <functional>
+#include "graphics.h"
+#include "jobSystem.h"
+#include "memoryArena.h"
+#include "spriteMesh.h"
+
+namespace spriteBatcherNS {
+	const int    CHUNK_SPRITES = 512;		// submissions per bucket, the same for any thread count
+	const UINT   MAX_DRAW_QUADS = 16384;	// quads per draw call, so indices fit 16 bits
+	const size_t ARENA_BYTES = 1024 * 1024;	// starting size of each thread's vertex arena
+}
+
+// Run of quads that share a texture
+struct SpriteBatch {
+	LP_TEXTURE  texture;
+	UINT        firstQuad;
+	UINT        quads;
+};
+
+// Quads generated from one chunk of submissions, in the vertex arena of the
+// thread that filled it.
+class SpriteBucket {
+private:
+	MemoryArena *arena;
+	const D3DXMATRIX *view;				// applied to vertices, NULL for none
+	SpriteVertex *vertices;
+	UINT        quads;
+	UINT        quadCapacity;
+	SpriteBatch *batches;
+	UINT        batchCount;
+	UINT        batchCapacity;
+	bool        outOfMemory;			// quads were dropped
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Make room for count more quads and a batch for texture. Returns false if out of memory.
+	bool reserve(LP_TEXTURE texture, UINT count);
+
+	// Add the quads of the fan of a mesh.
+	// Pre: reserve() made room for them
+	void addMesh(const SpriteData &sd, UINT textureWidth, UINT textureHeight, COLOR_ARGB color,
+		const SpriteMesh &mesh);
+
+public:
+	// Constructor
+	SpriteBucket();
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Start empty with room for expected quads from a.
+	void begin(MemoryArena *a, const D3DXMATRIX *viewMatrix, UINT expected);
+
+	// Add the quad of a sprite, as Graphics::drawSprite() would draw it.
+	// textureWidth, textureHeight = size of sd.texture in pixels
+	// mesh = drawn instead of the quad, from SpriteMeshSheet, NULL for the quad.
+	//        Its fan of triangles is drawn two at a time as quads.
+	void add(const SpriteData &sd, UINT textureWidth, UINT textureHeight,
+		COLOR_ARGB color = graphicsNS::WHITE, const SpriteMesh *mesh = NULL);
+
+	// Return number of quads.
+	UINT getQuadCount() const { return quads; }
+
+	// Return true if quads were dropped because the arena was out of memory.
+	bool isOutOfMemory() const { return outOfMemory; }
+
+	// Return the vertices, four per quad.
+	const SpriteVertex* getVertices() const { return vertices; }
+
+	// Return number of batches.
+	UINT getBatchCount() const { return batchCount; }
+
+	// Return the batches.
+	const SpriteBatch* getBatches() const { return batches; }
+};
+
+// Builds the vertex data of a frame's sprites on JobSystem threads.
+// Submissions are split into fixed chunks of CHUNK_SPRITES. Each chunk is
+// filled into its own bucket by whichever thread claims it, using that
+// thread's vertex arena, then the buckets are merged in chunk order into one
+// vertex stream and list of batches. Because chunks do not depend on the
+// thread count, the output is identical on any number of threads.
+class SpriteBatcher {
+public:
+	// Submit sprites [begin, end) to bucket with SpriteBucket::add().
+	// Called on worker threads, so must not use the graphics device.
+	typedef std::function<void(int begin, int end, SpriteBucket &bucket)> Submit;
+
+private:
+	Graphics    *graphics;
+	MemoryArena arenas[jobSystemNS::MAX_THREADS];	// vertex arena of each thread
+	std::vector<SpriteBucket> buckets;	// bucket of each chunk
+	std::vector<UINT> firstQuads;		// position of each bucket in vertices
+	std::vector<SpriteVertex> vertices;	// merged vertex stream
+	std::vector<SpriteBatch> batches;	// merged batches
+	std::vector<WORD> indices;			// quad indices for MAX_DRAW_QUADS quads
+	D3DXMATRIX  view;
+	bool        viewSet;
+	bool        failed;					// a bucket ran out of memory in the last build()
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Fill the buckets of the chunks in [begin, end) on thread worker.
+	void fillChunks(int begin, int end, int worker, const Submit &submit);
+
+	// Copy the vertices of buckets [begin, end) to the merged stream.
+	void copyBuckets(int begin, int end);
+
+	// Batchers own arenas, so they are not copied
+	SpriteBatcher(const SpriteBatcher&);
+	SpriteBatcher& operator=(const SpriteBatcher&);
+
+public:
+	// Constructor
+	SpriteBatcher();
+
+	// Destructor
+	virtual ~SpriteBatcher();
+
+	// Reserve room for maxSprites sprites per frame.
+	// Pre: *g points to Graphics object, or NULL to build without drawing
+	// Post: returns false on error
+	bool initialize(Graphics *g, UINT maxSprites);
+
+	// Set the view matrix applied to vertices by following builds, such as
+	// Camera2D::getViewMatrix(). NULL for screen pixels.
+	void setView(const D3DXMATRIX *viewMatrix) {
+		viewSet = (viewMatrix != NULL);
+		if (viewSet)
+			view = *viewMatrix;
+	}
+
+	// Generate the vertices of count submissions.
+	// *jobs runs the chunks, or NULL to run them on this thread
+	// Post: returns false if out of memory
+	bool build(JobSystem *jobs, int count, const Submit &submit);
+
+	// Draw the vertices from the last build().
+	// Pre: graphics->beginScene() has been called, sprite drawing has ended
+	void draw();
+
+	// Return the 64 bit FNV-1a hash of the vertex stream and batches, to
+	// compare builds.
+	UINT64 hash() const;
+
+	// Return number of quads from the last build().
+	UINT getQuadCount() const { return (UINT)vertices.size() / 4; }
+
+	// Return number of batches from the last build().
+	UINT getBatchCount() const { return (UINT)batches.size(); }
+
+	// Return the vertex stream.
+	const SpriteVertex* getVertices() const { return vertices.empty() ? NULL : &vertices[0]; }
+
+	// Return batch i.
+	const SpriteBatch& getBatch(UINT i) const { return batches[i]; }
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "spriteMesh.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+//=============================================================================
+// Place a sprite
+// The frame's axes are scaled, flipped and rotated, then the 2D part of the
+// view is folded in, so each texel costs two multiply-adds per coordinate.
+//=============================================================================
+SpritePlacement::SpritePlacement(const SpriteData &sd, const D3DXMATRIX *view) {
+	float c = 1.0f, s = 0.0f;
+	if (sd.angle != 0.0f) {
+		c = cosf(sd.angle);
+		s = sinf(sd.angle);
+	}
+	float flipX = sd.flipHorizontal ? -sd.scale : sd.scale;
+	float flipY = sd.flipVertical ? -sd.scale : sd.scale;
+	halfWidth = sd.width / 2.0f;
+	halfHeight = sd.height / 2.0f;
+	originX = sd.x + halfWidth * sd.scale;
+	originY = sd.y + halfHeight * sd.scale;
+	xx = c * flipX;
+	xy = s * flipX;
+	yx = -s * flipY;
+	yy = c * flipY;
+	if (view) {
+		float ox = originX * view->_11 + originY * view->_21 + view->_41;
+		originY = originX * view->_12 + originY * view->_22 + view->_42;
+		originX = ox;
+		float vxx = xx * view->_11 + xy * view->_21;
+		xy = xx * view->_12 + xy * view->_22;
+		xx = vxx;
+		float vyx = yx * view->_11 + yy * view->_21;
+		yy = yx * view->_12 + yy * view->_22;
+		yx = vyx;
+	}
+}
+
+//=============================================================================
+// Constructor
+//=============================================================================
+SpriteMeshSheet::SpriteMeshSheet() {
+	frameArea = 0;
+	meshArea = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+SpriteMeshSheet::~SpriteMeshSheet() {}
+
+//=============================================================================
+// Build the meshes of the frames of a sprite sheet
+//=============================================================================
+bool SpriteMeshSheet::initialize(const OpacityMap &map, int frameWidth, int frameHeight, int cols,
+	int frames, int budget) {
+	meshes.clear();
+	frameArea = 0;
+	meshArea = 0;
+	if (frameWidth <= 0 || frameHeight <= 0 || cols <= 0 || frames <= 0)
+		return false;
+	try {
+		meshes.resize(frames);
+	}
+	catch (...) { return false; }
+	for (int frame = 0; frame < frames; frame++) {
+		RECT rect;
+		rect.left = (frame % cols) * frameWidth;
+		rect.top = (frame / cols) * frameHeight;
+		rect.right = rect.left + frameWidth;
+		rect.bottom = rect.top + frameHeight;
+		build(map, rect, budget, meshes[frame]);
+		frameArea += (float)frameWidth * frameHeight;
+		meshArea += area(meshes[frame]);
+	}
+	return true;
+}
+
+namespace meshNS {
+	struct Point {
+		float x, y;
+	};
+
+	// Return > 0 if o, a, b turn counter-clockwise.
+	inline float turn(const Point &o, const Point &a, const Point &b) {
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	}
+
+	inline bool lessXY(const Point &a, const Point &b) {
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	}
+
+	// Make mesh the quad of a w x h frame.
+	void setQuad(SpriteMesh &mesh, int w, int h) {
+		mesh.count = 4;
+		mesh.x[0] = 0;			mesh.y[0] = 0;
+		mesh.x[1] = (float)w;	mesh.y[1] = 0;
+		mesh.x[2] = (float)w;	mesh.y[2] = (float)h;
+		mesh.x[3] = 0;			mesh.y[3] = (float)h;
+	}
+}
+
+//=============================================================================
+// Build the mesh of the pixels in a rect
+// The hull is taken around the corners of the first and last visible pixel
+// of each row, which are the only pixel corners that can be on it.
+//=============================================================================
+bool SpriteMeshSheet::build(const OpacityMap &map, const RECT &rect, int budget, SpriteMesh &mesh) {
+	using namespace meshNS;
+	int w = rect.right - rect.left;
+	int h = rect.bottom - rect.top;
+	budget = (budget < 4) ? 4 : (budget > MAX_VERTICES) ? MAX_VERTICES : budget;
+	setQuad(mesh, w, h);
+	if (w <= 0 || h <= 0)
+		return false;
+
+	std::vector<Point> points;
+	for (int y = 0; y < h; y++) {
+		int first = -1, last = -1;
+		for (int x = 0; x < w; x++)
+			if (map.isCovered(rect.left + x, rect.top + y)) {
+				if (first < 0)
+					first = x;
+				last = x;
+			}
+		if (first < 0)
+			continue;
+		float left = (first > 0) ? first - PADDING : 0.0f;
+		float right = (last + 1 < w) ? last + 1 + PADDING : (float)w;
+		float top = (y > 0) ? y - PADDING : 0.0f;
+		float bottom = (y + 1 < h) ? y + 1 + PADDING : (float)h;
+		Point p[4] = { { left, top }, { left, bottom }, { right, top }, { right, bottom } };
+		points.insert(points.end(), p, p + 4);
+	}
+	if (points.empty()) {					// nothing to draw
+		mesh.count = 0;
+		return true;
+	}
+
+	// convex hull, counter-clockwise, by the monotone chain
+	std::sort(points.begin(), points.end(), lessXY);
+	std::vector<Point> hull(points.size() * 2);
+	size_t k = 0;
+	for (size_t i = 0; i < points.size(); i++) {
+		while (k >= 2 && turn(hull[k - 2], hull[k - 1], points[i]) <= 0)
+			k--;
+		hull[k++] = points[i];
+	}
+	for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+		while (k >= lower && turn(hull[k - 2], hull[k - 1], points[i]) <= 0)
+			k--;
+		hull[k++] = points[i];
+	}
+	hull.resize(k - 1);						// the last point is the first
+
+	// replace the edge b-c that adds the least area with the meeting point
+	// of a-b and d-c extended, until within budget
+	while ((int)hull.size() > budget) {
+		size_t n = hull.size();
+		size_t best = n;
+		float bestArea = FLT_MAX;
+		Point bestPoint = { 0, 0 };
+		for (size_t i = 0; i < n; i++) {
+			const Point &a = hull[(i + n - 1) % n], &b = hull[i];
+			const Point &c = hull[(i + 1) % n], &d = hull[(i + 2) % n];
+			float d1x = b.x - a.x, d1y = b.y - a.y;
+			float d2x = c.x - d.x, d2y = c.y - d.y;
+			float denominator = d1x * d2y - d1y * d2x;
+			if (denominator == 0)
+				continue;					// parallel, they never meet
+			float ex = c.x - b.x, ey = c.y - b.y;
+			float t = (ex * d2y - ey * d2x) / denominator;
+			float s = (ex * d1y - ey * d1x) / denominator;
+			if (t <= 0 || s <= 0)
+				continue;					// they meet inside
+			Point p = { b.x + t * d1x, b.y + t * d1y };
+			if (p.x < 0 || p.y < 0 || p.x > w || p.y > h)
+				continue;					// would draw texels of other frames
+			float added = fabsf(turn(b, c, p)) / 2;
+			if (added < bestArea) {
+				bestArea = added;
+				best = i;
+				bestPoint = p;
+			}
+		}
+		if (best == n) {
+			setQuad(mesh, w, h);
+			return false;
+		}
+		hull[best] = bestPoint;
+		hull.erase(hull.begin() + (best + 1) % n);
+	}
+
+	mesh.count = (int)hull.size();
+	for (int i = 0; i < mesh.count; i++) {
+		mesh.x[i] = hull[i].x;
+		mesh.y[i] = hull[i].y;
+	}
+	if (area(mesh) > (1.0f - MIN_SAVING) * w * h)
+		setQuad(mesh, w, h);				// not worth the extra vertices
+	return true;
+}
+
+//=============================================================================
+// Return the area inside a mesh, by the shoelace formula
+//=============================================================================
+float SpriteMeshSheet::area(const SpriteMesh &mesh) {
+	float sum = 0;
+	for (int i = 0; i < mesh.count; i++) {
+		int j = (i + 1) % mesh.count;
+		sum += mesh.x[i] * mesh.y[j] - mesh.x[j] * mesh.y[i];
+	}
+	return fabsf(sum) / 2;
+}
@@ -0,0 +1,96 @@
+#ifndef _SPRITEMESH_H
+#define _SPRITEMESH_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "graphics.h"
+#include "opacityMap.h"
+
+namespace meshNS {
+	const int   MAX_VERTICES = 16;		// most vertices of a mesh
+	const int   VERTEX_BUDGET = 8;		// vertices of a mesh unless set otherwise
+	const float MIN_SAVING = 0.1f;		// fraction of the frame a mesh must save over its quad
+	const float PADDING = 1.0f / 16;	// texels the hull is widened by, so pixel centers
+										// on the edge of a visible texel are inside it
+}
+
+// Convex polygon around the visible pixels of one frame, drawn instead of
+// the frame's quad so transparent pixels around the sprite are not shaded.
+// Points are in texels from the top left of the frame, in order around it.
+struct SpriteMesh {
+	int         count;					// vertices, 0 if no pixel of the frame is visible
+	float       x[meshNS::MAX_VERTICES];
+	float       y[meshNS::MAX_VERTICES];
+};
+
+// Maps texels of a sprite's frame to the screen, as Graphics::drawSprite()
+// places the sprite: scaled from its top left corner, rotated about its
+// center and flipped within the frame, then transformed by a view.
+class SpritePlacement {
+private:
+	float       originX, originY;		// screen position of the frame center
+	float       xx, xy;					// screen offset of one texel along the frame's x
+	float       yx, yy;					// screen offset of one texel along the frame's y
+	float       halfWidth, halfHeight;	// of the frame in texels
+
+public:
+	// Place sd, with view applied after its own transform, NULL for none.
+	SpritePlacement(const SpriteData &sd, const D3DXMATRIX *view);
+
+	// Return the screen position of texel tx, ty of the frame in x, y.
+	void place(float tx, float ty, float &x, float &y) const {
+		tx -= halfWidth;
+		ty -= halfHeight;
+		x = originX + tx * xx + ty * yx;
+		y = originY + tx * xy + ty * yy;
+	}
+};
+
+// Meshes of the frames of a sprite sheet, built when its texture loads.
+// Each mesh is the convex hull of the frame's visible pixels, reduced to the
+// vertex budget by replacing the edge whose removal adds the least area with
+// the meeting point of its neighbours, which keeps every visible pixel
+// inside. A frame whose mesh saves less than MIN_SAVING of its area keeps
+// its quad, as four vertices at its corners.
+class SpriteMeshSheet {
+private:
+	std::vector<SpriteMesh> meshes;		// of each frame
+	float       frameArea;				// texels of all frames
+	float       meshArea;				// texels inside all meshes
+
+public:
+	// Constructor
+	SpriteMeshSheet();
+
+	// Destructor
+	virtual ~SpriteMeshSheet();
+
+	// Build the meshes of frames frames of frameWidth x frameHeight pixels in
+	// cols columns, numbered as Image numbers them.
+	// budget = most vertices of a mesh, 4 through MAX_VERTICES
+	// Post: returns false if out of memory
+	bool initialize(const OpacityMap &map, int frameWidth, int frameHeight, int cols, int frames,
+		int budget = meshNS::VERTEX_BUDGET);
+
+	// Return the mesh of frame, NULL if there is none.
+	const SpriteMesh* getMesh(int frame) const {
+		return ((UINT)frame < meshes.size()) ? &meshes[frame] : NULL;
+	}
+
+	// Return number of frames.
+	int getFrameCount() const { return (int)meshes.size(); }
+
+	// Return the area inside the meshes over the area of the frames, the
+	// fraction of fill the meshes cost compared to quads.
+	float getFillRatio() const { return (frameArea > 0) ? meshArea / frameArea : 1.0f; }
+
+	// Build the mesh of the pixels of map in rect.
+	// Post: returns false if the hull could not be brought within budget,
+	//       in which case mesh is the rect's quad
+	static bool build(const OpacityMap &map, const RECT &rect, int budget, SpriteMesh &mesh);
+
+	// Return the area inside mesh in texels.
+	static float area(const SpriteMesh &mesh);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "textureManager.h"
+#include "textureResidency.h"
 
 //=============================================================================
 // Constructor
@@ -8,7 +9,13 @@ TextureManager::TextureManager() {
 	width = 0;
 	height = 0;
 	file = NULL;
+	pack = NULL;
 	graphics = NULL;
+	bytes = 0;
+	evicted = false;
+	residency = NULL;
+	residencySlot = -1;
+	used = false;
 	initialized = false;	// set true when successfully initialized
 }
 
@@ -16,6 +23,10 @@ TextureManager::TextureManager() {
 // Destructor
 //=============================================================================
 TextureManager::~TextureManager() {
+	if (residency)
+		residency->remove(this);
+	if (texture && graphics)
+		graphics->addTextureMemory(-(INT64)bytes);
 	SAFE_RELEASE(texture);
 }
 
@@ -23,17 +34,68 @@ TextureManager::~TextureManager() {
 // Initialize TextureManager
 //=============================================================================
 bool TextureManager::initialize(Graphics *g, const char *f) {
+	return initialize(g, NULL, f);
+}
+
+//=============================================================================
+// Initialize TextureManager from an asset pack
+//=============================================================================
+bool TextureManager::initialize(Graphics *g, const AssetPack *p, const char *f) {
+	return initialize(g, p, f, NULL, 0);
+}
+
+//=============================================================================
+// Initialize TextureManager from file contents in memory
+// data = NULL to load file
+//=============================================================================
+bool TextureManager::initialize(Graphics *g, const AssetPack *p, const char *f,
+	const void *data, UINT size) {
 	try {
 		graphics = g;		// the graphics object
+		pack = p;			// the pack holding the file, or NULL
 		file = f;			// the texture file
 
-		hr = graphics->loadTexture(file, TRANSCOLOR, width, height, texture);
+		opacity.clear();
+		if (data)
+			hr = graphics->loadTextureFromMemory(data, size, TRANSCOLOR, width, height, texture, &opacity);
+		else
+			hr = load();
 		if (FAILED(hr)) {
 			SAFE_RELEASE(texture);
 			return false;
 		}
+		bytes = width * height * 4;		// 32 bit texels
+		graphics->addTextureMemory(bytes);
 	}
 	catch (...) { return false; }
+	evicted = false;
+	initialized = true;		// set true when successfully initialized
+	return true;
+}
+
+//=============================================================================
+// Initialize TextureManager from decoded pixels
+//=============================================================================
+bool TextureManager::initialize(Graphics *g, const AssetPack *p, const char *f,
+	const DecodedImage &image) {
+	try {
+		graphics = g;		// the graphics object
+		pack = p;			// the pack holding the file, or NULL
+		file = f;			// the texture file
+
+		opacity.clear();
+		hr = graphics->createTexture(image, texture, &opacity);
+		if (FAILED(hr)) {
+			SAFE_RELEASE(texture);
+			return false;
+		}
+		width = image.width;
+		height = image.height;
+		bytes = width * height * 4;		// 32 bit texels
+		graphics->addTextureMemory(bytes);
+	}
+	catch (...) { return false; }
+	evicted = false;
 	initialized = true;		// set true when successfully initialized
 	return true;
 }
@@ -44,6 +106,8 @@ bool TextureManager::initialize(Graphics *g, const char *f) {
 void TextureManager::onLostDevice() {
 	if (!initialized)
 		return;
+	if (texture)
+		graphics->addTextureMemory(-(INT64)bytes);
 	SAFE_RELEASE(texture);
 }
 
@@ -51,7 +115,61 @@ void TextureManager::onLostDevice() {
 // Called when graphics device is reset
 //=============================================================================
 void TextureManager::onResetDevice() {
-	if (!initialized)
+	if (!initialized || evicted)	// evicted textures are reloaded when used
 		return;
-	graphics->loadTexture(file, TRANSCOLOR, width, height, texture);
+	if (SUCCEEDED(load()))
+		graphics->addTextureMemory(bytes);
+}
+
+//=============================================================================
+// Release the texture to free video memory
+//=============================================================================
+void TextureManager::evict() {
+	if (!initialized || evicted)
+		return;
+	if (texture)
+		graphics->addTextureMemory(-(INT64)bytes);
+	SAFE_RELEASE(texture);
+	evicted = true;
+}
+
+//=============================================================================
+// Reload an evicted texture
+//=============================================================================
+bool TextureManager::restore() {
+	if (!initialized)
+		return false;
+	if (!evicted)
+		return true;
+	if (FAILED(load())) {
+		SAFE_RELEASE(texture);
+		return false;
+	}
+	bytes = width * height * 4;
+	graphics->addTextureMemory(bytes);
+	evicted = false;
+	return true;
+}
+
+//=============================================================================
+// Load the texture
+// Uncompressed packed images are read in place from the mapped pack.
+// The opacity is found by the first load that can find it, from the same
+// decode, and kept through resets and evictions. A texture whose opacity
+// is not known is drawn blended.
+//=============================================================================
+HRESULT TextureManager::load() {
+	OpacityMap *map = opacity.isInitialized() ? NULL : &opacity;
+	if (pack == NULL)
+		return graphics->loadTexture(file, TRANSCOLOR, width, height, texture, map);
+
+	AssetView view;
+	if (!pack->find(file, view))
+		return E_FAIL;
+	if (!view.compressed)
+		return graphics->loadTextureFromMemory(view.data, view.size, TRANSCOLOR, width, height, texture, map);
+	std::vector<BYTE> data;
+	if (!pack->read(file, data) || data.empty())
+		return E_FAIL;
+	return graphics->loadTextureFromMemory(&data[0], (UINT)data.size(), TRANSCOLOR, width, height, texture, map);
 }
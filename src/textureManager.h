@@ -3,17 +3,38 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include "graphics.h"
+#include "assetPack.h"
+#include "opacityMap.h"
 #include "constants.h"
+#include <atomic>
+
+class TextureResidency;
 
 class TextureManager {
-private:
+protected:
 	UINT		width;			// width of texture in pixels
 	UINT		height;			// height of texture in pixels
 	LP_TEXTURE	texture;		// pointer to texture
 	const char	*file;			// name of file
+	const AssetPack *pack;		// pack holding file, NULL for a loose file
 	Graphics	*graphics;		// save pointer to graphics
 	bool		initialized;    // true when successfully initialized
 	HRESULT		hr;             // standard return type
+	UINT		bytes;			// estimated memory of the loaded texture
+	bool		evicted;		// released to save memory until next used
+	TextureResidency *residency;	// manages this texture, NULL if none
+	int			residencySlot;	// entry in residency
+	OpacityMap	opacity;		// found once when first loaded
+	mutable std::atomic<bool> used;	// getTexture() was called since residency last looked
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Load the texture from file or pack. Finds the opacity of the pixels
+	// too, from the same decode, the first time it is loaded.
+	HRESULT load();
+
+	// Textures own a D3D texture, so they are not copied
+	TextureManager(const TextureManager&);
+	TextureManager& operator=(const TextureManager&);
 
 public:
 	// Constructor
@@ -23,7 +44,15 @@ public:
 	virtual ~TextureManager();
 
 	// Returns a pointer to the texture
-	LP_TEXTURE getTexture() const { return texture; }
+	// A texture managed by a TextureResidency is flagged as used this frame.
+	// Nothing else changes, so it may be called on worker threads. The
+	// residency reloads evicted textures in endFrame(), so an evicted texture
+	// is NULL until the frame after it is used.
+	LP_TEXTURE getTexture() const {
+		if (residency && !used.load(std::memory_order_relaxed))
+			used.store(true, std::memory_order_relaxed);
+		return texture;
+	}
 
 	// Returns the texture width
 	UINT getWidth() const { return width; }
@@ -31,17 +60,72 @@ public:
 	// Return the texture height
 	UINT getHeight() const { return height; }
 
+	// Return the opacity of the pixels, NULL if it is not known, in which
+	// case sprites of the texture are drawn blended.
+	const OpacityMap* getOpacity() const { return opacity.isInitialized() ? &opacity : NULL; }
+
+	// Return estimated memory of the loaded texture in bytes.
+	UINT getBytes() const { return bytes; }
+
 	// Initialize the textureManager
 	// Pre: *g points to Graphics object
 	//      *file points to name of texture file to load
 	// Post: The texture file is loaded
 	virtual bool initialize(Graphics *g, const char *file);
 
+	// Initialize the textureManager from a file in an asset pack
+	// Pre: *g points to Graphics object
+	//      *pack is open and stays open while the texture is in use
+	//      *file points to name of texture file in the pack
+	// Post: The texture file is loaded
+	virtual bool initialize(Graphics *g, const AssetPack *pack, const char *file);
+
+	// Initialize the textureManager from image file contents already in memory
+	// Pre: *g points to Graphics object
+	//      *pack, *file are used to reload the texture after a device reset
+	//      data, size = contents of file
+	// Post: The texture is created
+	virtual bool initialize(Graphics *g, const AssetPack *pack, const char *file,
+		const void *data, UINT size);
+
+	// Initialize the textureManager from pixels decoded by Graphics::decodeImage()
+	// Pre: *g points to Graphics object
+	//      *pack, *file are used to reload the texture after a device reset
+	// Post: The texture is created
+	virtual bool initialize(Graphics *g, const AssetPack *pack, const char *file,
+		const DecodedImage &image);
+
 	// Release resources
 	virtual void onLostDevice();
 
 	// Restore resourses
 	virtual void onResetDevice();
+
+	// Release the texture to free video memory until restore().
+	virtual void evict();
+
+	// Reload an evicted texture.
+	// Post: returns false on error
+	virtual bool restore();
+
+	// Return true unless the texture was evicted.
+	bool isResident() const { return !evicted; }
+
+	// Return the residency managing this texture, NULL if none.
+	TextureResidency* getResidency() const { return residency; }
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Set by TextureResidency::add() and remove().
+	void setResidency(TextureResidency *r, int slot) { residency = r; residencySlot = slot; }
+
+	// Return the entry of this texture in its residency.
+	int getResidencySlot() const { return residencySlot; }
+
+	// Return true if getTexture() was called since the last takeUsed().
+	bool wasUsed() const { return used.load(std::memory_order_relaxed); }
+
+	// Return wasUsed() and clear the flag. Called by the residency on the main thread.
+	bool takeUsed() { return used.exchange(false, std::memory_order_relaxed); }
 };
 
 #endif
@@ -0,0 +1,194 @@
+#include "textureResidency.h"
+
+//=============================================================================
+// Constructor
+//=============================================================================
+TextureResidency::TextureResidency() {
+	head = textureResidencyNS::NONE;
+	tail = textureResidencyNS::NONE;
+	budget = textureResidencyNS::NO_BUDGET;
+	residentBytes = 0;
+	frame = 0;
+	resetCounters();
+}
+
+//=============================================================================
+// Destructor
+// Textures that outlive the residency are left as they are, unmanaged.
+//=============================================================================
+TextureResidency::~TextureResidency() {
+	for (size_t e = 0; e < entries.size(); e++)
+		if (entries[e].texture)
+			entries[e].texture->setResidency(NULL, textureResidencyNS::NONE);
+}
+
+//=============================================================================
+// Set the budget and reset the counters
+//=============================================================================
+void TextureResidency::initialize(UINT64 budgetBytes) {
+	resetCounters();
+	setBudget(budgetBytes);
+}
+
+//=============================================================================
+// Change the budget
+//=============================================================================
+void TextureResidency::setBudget(UINT64 budgetBytes) {
+	budget = budgetBytes;
+	makeRoom(0);
+}
+
+//=============================================================================
+// Manage a texture
+// It counts as least recently used until it is drawn.
+//=============================================================================
+bool TextureResidency::add(TextureManager *t) {
+	using namespace textureResidencyNS;
+	if (t == NULL || t->getResidency() != NULL)
+		return false;
+	int e;
+	if (!freeEntries.empty()) {
+		e = freeEntries.back();
+		freeEntries.pop_back();
+	}
+	else {
+		e = (int)entries.size();
+		entries.push_back(Entry());
+	}
+	Entry &entry = entries[e];
+	entry.texture = t;
+	entry.bytes = t->getBytes();
+	entry.lastFrame = frame - 1;
+	entry.prev = entry.next = NONE;
+	entry.resident = t->isResident();
+	t->takeUsed();							// uses before it was managed are not counted
+	t->setResidency(this, e);
+	if (entry.resident) {
+		residentBytes += entry.bytes;
+		entry.prev = tail;					// at the tail, so evicted before drawn textures
+		if (tail != NONE)
+			entries[tail].next = e;
+		else
+			head = e;
+		tail = e;
+		makeRoom(0);
+	}
+	return true;
+}
+
+//=============================================================================
+// Stop managing a texture
+//=============================================================================
+void TextureResidency::remove(TextureManager *t) {
+	if (t == NULL || t->getResidency() != this)
+		return;
+	int e = t->getResidencySlot();
+	Entry &entry = entries[e];
+	if (entry.resident) {
+		unlink(e);
+		residentBytes -= entry.bytes;
+	}
+	entry.texture = NULL;
+	entry.resident = false;
+	freeEntries.push_back(e);
+	t->setResidency(NULL, textureResidencyNS::NONE);
+}
+
+//=============================================================================
+// Take the textures used this frame and start a new frame
+// Resident textures are moved first, so a reload never evicts a texture
+// used this frame. Only the first use in a frame is counted.
+//=============================================================================
+void TextureResidency::endFrame() {
+	reloads.clear();
+	for (int e = 0; e < (int)entries.size(); e++) {
+		Entry &entry = entries[e];
+		if (entry.texture == NULL || !entry.texture->takeUsed())
+			continue;
+		entry.lastFrame = frame;
+		if (!entry.resident) {
+			reloads.push_back(e);
+			continue;
+		}
+		hits++;
+		if (head != e) {
+			unlink(e);
+			pushFront(e);
+		}
+	}
+	for (size_t i = 0; i < reloads.size(); i++)
+		reload(reloads[i]);
+	frame++;
+}
+
+//=============================================================================
+// Reload the evicted texture of entry e
+//=============================================================================
+void TextureResidency::reload(int e) {
+	Entry &entry = entries[e];
+	misses++;
+	makeRoom(entry.bytes);
+	if (!entry.texture->restore()) {
+		failures++;
+		return;
+	}
+	entry.bytes = entry.texture->getBytes();	// size is known once loaded
+	entry.resident = true;
+	residentBytes += entry.bytes;
+	pushFront(e);
+}
+
+//=============================================================================
+// Evict least recently used textures until bytes more fit in the budget
+// Textures flagged used but not yet taken by endFrame() may be drawing, so
+// they are kept too.
+//=============================================================================
+void TextureResidency::makeRoom(UINT64 bytes) {
+	if (budget == textureResidencyNS::NO_BUDGET)
+		return;
+	while (residentBytes + bytes > budget && tail != textureResidencyNS::NONE &&
+		entries[tail].lastFrame != frame && !entries[tail].texture->wasUsed())
+		evict(tail);
+}
+
+//=============================================================================
+// Evict the texture of entry e
+//=============================================================================
+void TextureResidency::evict(int e) {
+	Entry &entry = entries[e];
+	unlink(e);
+	entry.resident = false;
+	residentBytes -= entry.bytes;
+	entry.texture->evict();
+	evictions++;
+}
+
+//=============================================================================
+// Remove entry e from the resident list
+//=============================================================================
+void TextureResidency::unlink(int e) {
+	Entry &entry = entries[e];
+	if (entry.prev != textureResidencyNS::NONE)
+		entries[entry.prev].next = entry.next;
+	else
+		head = entry.next;
+	if (entry.next != textureResidencyNS::NONE)
+		entries[entry.next].prev = entry.prev;
+	else
+		tail = entry.prev;
+	entry.prev = entry.next = textureResidencyNS::NONE;
+}
+
+//=============================================================================
+// Put entry e at the head of the resident list
+//=============================================================================
+void TextureResidency::pushFront(int e) {
+	Entry &entry = entries[e];
+	entry.prev = textureResidencyNS::NONE;
+	entry.next = head;
+	if (head != textureResidencyNS::NONE)
+		entries[head].prev = e;
+	else
+		tail = e;
+	head = e;
+}
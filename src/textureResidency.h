@@ -0,0 +1,119 @@
+#ifndef _TEXTURERESIDENCY_H
+#define _TEXTURERESIDENCY_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "textureManager.h"
+
+namespace textureResidencyNS {
+	const int   NONE = -1;				// no texture
+	const UINT64 NO_BUDGET = 0;			// keep every texture loaded
+}
+
+// Keeps the textures in use within a video memory budget. Each texture's
+// estimated size is tracked and TextureManager::getTexture() flags it used
+// in the current frame, which is safe on any thread. endFrame() runs on
+// the main thread: it moves the textures used this frame to the front of
+// the list and reloads the evicted ones. When loading a texture would go
+// over budget, the least recently used textures are evicted first;
+// textures used in the current frame are never evicted, so a frame that
+// needs more than the budget goes over it rather than reloading textures
+// every frame. An evicted texture is drawn from the frame after its use.
+// Hits and misses count the first use of a texture in each frame.
+class TextureResidency {
+private:
+	// One registered texture
+	struct Entry {
+		TextureManager *texture;		// NULL if the entry is free
+		UINT        bytes;				// estimated memory when loaded
+		UINT        lastFrame;			// frame of the last use
+		int         prev, next;			// neighbours in the resident list
+		bool        resident;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<int> freeEntries;		// entries of removed textures
+	std::vector<int> reloads;			// evicted entries used this frame, kept for its storage
+	int         head;					// most recently used resident texture
+	int         tail;					// least recently used resident texture
+	UINT64      budget;					// bytes, NO_BUDGET for no limit
+	UINT64      residentBytes;			// estimated memory of resident textures
+	UINT        frame;					// advanced by endFrame()
+	UINT        hits;					// first uses of resident textures
+	UINT        misses;					// first uses that reloaded a texture
+	UINT        evictions;
+	UINT        failures;				// reloads that failed
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Remove entry e from the resident list.
+	void unlink(int e);
+
+	// Put entry e at the head of the resident list.
+	void pushFront(int e);
+
+	// Evict least recently used textures until bytes more fit in the budget.
+	// Textures used this frame are kept.
+	void makeRoom(UINT64 bytes);
+
+	// Reload the evicted texture of entry e.
+	void reload(int e);
+
+	// Evict the texture of entry e.
+	void evict(int e);
+
+	// Textures point back at the residency, so it is not copied
+	TextureResidency(const TextureResidency&);
+	TextureResidency& operator=(const TextureResidency&);
+
+public:
+	// Constructor
+	TextureResidency();
+
+	// Destructor
+	virtual ~TextureResidency();
+
+	// Set the budget in bytes, NO_BUDGET for no limit, and reset the counters.
+	void initialize(UINT64 budgetBytes);
+
+	// Change the budget. Textures over it are evicted now, except those used this frame.
+	void setBudget(UINT64 budgetBytes);
+
+	// Manage a texture. It is evicted when over budget and reloaded when used.
+	// Pre: t has been initialized
+	// Returns false if t is already managed by a residency.
+	bool add(TextureManager *t);
+
+	// Stop managing a texture. An evicted texture stays evicted until restored.
+	void remove(TextureManager *t);
+
+	// Move the textures used this frame to the front of the list, reload the
+	// evicted ones, and start a new frame. Call once per frame after drawing,
+	// on the thread that owns the device, when no thread calls getTexture().
+	void endFrame();
+
+	// Reset the hit, miss, eviction and failure counters.
+	void resetCounters() { hits = misses = evictions = failures = 0; }
+
+	// Return the budget in bytes.
+	UINT64 getBudget() const { return budget; }
+
+	// Return estimated memory of the resident textures in bytes.
+	UINT64 getResidentBytes() const { return residentBytes; }
+
+	// Return number of first uses in a frame that found the texture loaded.
+	UINT getHits() const { return hits; }
+
+	// Return number of first uses in a frame that reloaded the texture.
+	UINT getMisses() const { return misses; }
+
+	// Return number of textures evicted.
+	UINT getEvictions() const { return evictions; }
+
+	// Return number of reloads that failed.
+	UINT getFailures() const { return failures; }
+
+	// Return number of frames ended.
+	UINT getFrame() const { return frame; }
+};
+
+#endif
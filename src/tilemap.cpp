@@ -0,0 +1,328 @@
+#include "tilemap.h"
+#include "image.h"
+#include <fstream>
+#include <math.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+Tilemap::Tilemap() {
+	graphics = NULL;
+	tileset = NULL;
+	width = height = 0;
+	layers = 0;
+	tileWidth = tileHeight = 0;
+	tilesetColumns = 1;
+	texWidth = texHeight = 1;
+	chunksX = chunksY = 0;
+	indices = NULL;
+	frame = 0;
+	chunksDrawn = 0;
+	quadsDrawn = 0;
+	chunksBuilt = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+Tilemap::~Tilemap() {
+	releaseAll();
+}
+
+//=============================================================================
+// Release all chunk geometry and the index buffer
+//=============================================================================
+void Tilemap::releaseAll() {
+	for (size_t i = 0; i < chunks.size(); i++)
+		SAFE_RELEASE(chunks[i].vb);
+	chunks.clear();
+	builtChunks.clear();
+	SAFE_RELEASE(indices);
+}
+
+//=============================================================================
+// Load a map file
+//=============================================================================
+bool Tilemap::initialize(Graphics *g, TextureManager *tilesetM, const char *file) {
+	try {
+		std::ifstream in(file, std::ios::binary);
+		if (!in)
+			return false;
+		TilemapHeader header;
+		if (!in.read((char*)&header, sizeof(header)))
+			return false;
+		if (header.magic != tilemapNS::FILE_MAGIC || header.version != tilemapNS::FILE_VERSION)
+			return false;
+		if (header.width > 0xffff || header.height > 0xffff)
+			return false;
+		if (!initialize(g, tilesetM, (int)header.width, (int)header.height, (int)header.layers,
+			(int)header.tileWidth, (int)header.tileHeight))
+			return false;
+		if (!in.read((char*)&tiles[0], tiles.size() * sizeof(WORD)))
+			return false;
+	}
+	catch (...) { return false; }
+	return true;
+}
+
+//=============================================================================
+// Create an empty map
+//=============================================================================
+bool Tilemap::initialize(Graphics *g, TextureManager *tilesetM, int w, int h,
+	int layerCount, int tileW, int tileH) {
+	if (w <= 0 || h <= 0 || layerCount <= 0 || layerCount > tilemapNS::MAX_LAYERS ||
+		tileW <= 0 || tileH <= 0)
+		return false;
+	releaseAll();
+	imageNS::markChanged();				// a new map is drawn
+	graphics = g;
+	tileset = tilesetM;
+	width = w;
+	height = h;
+	layers = layerCount;
+	tileWidth = tileW;
+	tileHeight = tileH;
+	if (tileset) {
+		texWidth = (float)tileset->getWidth();
+		texHeight = (float)tileset->getHeight();
+		tilesetColumns = (int)tileset->getWidth() / tileWidth;
+		if (tilesetColumns < 1)
+			tilesetColumns = 1;
+	}
+	else {
+		texWidth = (float)tileWidth;
+		texHeight = (float)tileHeight;
+		tilesetColumns = 1;
+	}
+	try {
+		tiles.assign((size_t)layers * width * height, tilemapNS::EMPTY);
+	}
+	catch (...) { return false; }
+	return createChunks();
+}
+
+//=============================================================================
+// Set up chunks and the shared index buffer
+//=============================================================================
+bool Tilemap::createChunks() {
+	chunksX = (width + tilemapNS::CHUNK_SIZE - 1) / tilemapNS::CHUNK_SIZE;
+	chunksY = (height + tilemapNS::CHUNK_SIZE - 1) / tilemapNS::CHUNK_SIZE;
+	Chunk empty;
+	empty.vb = NULL;
+	empty.quads = 0;
+	empty.capacity = 0;
+	empty.lastDrawn = 0;
+	empty.dirty = true;
+	empty.built = false;
+	chunks.assign((size_t)chunksX * chunksY, empty);
+	frame = 0;
+
+	if (graphics == NULL)
+		return true;
+
+	// two triangles per quad: 0,1,2 and 0,2,3
+	const UINT count = tilemapNS::MAX_CHUNK_QUADS * 6;
+	if (FAILED(graphics->createIndexBuffer(count, indices)))
+		return false;
+	WORD *index;
+	if (FAILED(indices->Lock(0, 0, (void**)&index, 0)))
+		return false;
+	for (UINT q = 0; q < (UINT)tilemapNS::MAX_CHUNK_QUADS; q++) {
+		WORD v = (WORD)(q * 4);
+		*index++ = v;
+		*index++ = v + 1;
+		*index++ = v + 2;
+		*index++ = v;
+		*index++ = v + 2;
+		*index++ = v + 3;
+	}
+	indices->Unlock();
+	return true;
+}
+
+//=============================================================================
+// Save the map
+//=============================================================================
+bool Tilemap::save(const char *file) const {
+	std::ofstream out(file, std::ios::binary);
+	if (!out)
+		return false;
+	TilemapHeader header;
+	header.magic = tilemapNS::FILE_MAGIC;
+	header.version = tilemapNS::FILE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.tileWidth = tileWidth;
+	header.tileHeight = tileHeight;
+	header.layers = layers;
+	out.write((const char*)&header, sizeof(header));
+	if (!tiles.empty())
+		out.write((const char*)&tiles[0], tiles.size() * sizeof(WORD));
+	return out.good();
+}
+
+//=============================================================================
+// Set a tile and mark its chunk for rebuilding
+//=============================================================================
+void Tilemap::setTile(int layer, int x, int y, WORD tile) {
+	if (layer < 0 || layer >= layers || x < 0 || x >= width || y < 0 || y >= height)
+		return;
+	WORD &t = tiles[((size_t)layer * height + y) * width + x];
+	if (t == tile)
+		return;
+	t = tile;
+	chunks[(y / tilemapNS::CHUNK_SIZE) * chunksX + x / tilemapNS::CHUNK_SIZE].dirty = true;
+	imageNS::markChanged();
+}
+
+//=============================================================================
+// Build the quads of one chunk
+// Vertices are in map pixels, layer 0 first so later layers draw on top.
+//=============================================================================
+void Tilemap::buildChunk(int cx, int cy) {
+	using namespace tilemapNS;
+	Chunk &chunk = chunks[cy * chunksX + cx];
+	int x0 = cx * CHUNK_SIZE;
+	int y0 = cy * CHUNK_SIZE;
+	int x1 = (x0 + CHUNK_SIZE < width) ? x0 + CHUNK_SIZE : width;
+	int y1 = (y0 + CHUNK_SIZE < height) ? y0 + CHUNK_SIZE : height;
+	float du = tileWidth / texWidth;
+	float dv = tileHeight / texHeight;
+
+	vertices.clear();
+	for (int layer = 0; layer < layers; layer++) {
+		for (int y = y0; y < y1; y++) {
+			const WORD *row = &tiles[((size_t)layer * height + y) * width];
+			float top = (float)(y * tileHeight);
+			float bottom = top + tileHeight;
+			for (int x = x0; x < x1; x++) {
+				if (row[x] == EMPTY)
+					continue;
+				int n = row[x] - 1;
+				float u = (n % tilesetColumns) * du;
+				float v = (n / tilesetColumns) * dv;
+				float left = (float)(x * tileWidth);
+				float right = left + tileWidth;
+				QuadVertex q[4] = {
+					{ left, top, 0.0f, u, v },
+					{ right, top, 0.0f, u + du, v },
+					{ right, bottom, 0.0f, u + du, v + dv },
+					{ left, bottom, 0.0f, u, v + dv },
+				};
+				vertices.insert(vertices.end(), q, q + 4);
+			}
+		}
+	}
+	chunk.quads = (UINT)vertices.size() / 4;
+	chunk.dirty = false;
+	chunksBuilt++;
+	if (!chunk.built) {
+		builtChunks.push_back(cy * chunksX + cx);
+		chunk.built = true;
+	}
+
+	if (graphics == NULL || chunk.quads == 0)
+		return;
+	if (chunk.quads > chunk.capacity) {
+		SAFE_RELEASE(chunk.vb);
+		chunk.capacity = 0;
+		UINT capacity = (chunk.quads + 63) & ~63;	// room for a few more tiles
+		if (FAILED(graphics->createVertexBuffer(capacity * 4 * sizeof(QuadVertex), QUADVERTEX_FVF, chunk.vb))) {
+			chunk.vb = NULL;
+			chunk.quads = 0;
+			return;
+		}
+		chunk.capacity = capacity;
+	}
+	void *data;
+	if (FAILED(chunk.vb->Lock(0, chunk.quads * 4 * sizeof(QuadVertex), &data, 0))) {
+		chunk.quads = 0;
+		return;
+	}
+	memcpy(data, &vertices[0], chunk.quads * 4 * sizeof(QuadVertex));
+	chunk.vb->Unlock();
+}
+
+//=============================================================================
+// Free geometry of chunks that have not been drawn recently
+//=============================================================================
+void Tilemap::evictChunks() {
+	size_t i = 0;
+	while (i < builtChunks.size()) {
+		Chunk &chunk = chunks[builtChunks[i]];
+		if (frame - chunk.lastDrawn <= tilemapNS::EVICT_FRAMES) {
+			i++;
+			continue;
+		}
+		SAFE_RELEASE(chunk.vb);
+		chunk.capacity = 0;
+		chunk.quads = 0;
+		chunk.dirty = true;
+		chunk.built = false;
+		builtChunks[i] = builtChunks.back();
+		builtChunks.pop_back();
+	}
+}
+
+//=============================================================================
+// Draw the chunks that intersect the view
+//=============================================================================
+void Tilemap::draw(float viewX, float viewY, float viewWidth, float viewHeight) {
+	D3DXMATRIX viewMatrix;
+	D3DXMatrixTranslation(&viewMatrix, -viewX, -viewY, 0.0f);
+	drawBounds(viewX, viewY, viewX + viewWidth, viewY + viewHeight, viewMatrix);
+}
+
+//=============================================================================
+// Draw the chunks the camera sees
+//=============================================================================
+void Tilemap::draw(const Camera2D &camera, int layer) {
+	const ViewBounds &b = camera.getBounds(layer);
+	drawBounds(b.left, b.top, b.right, b.bottom, camera.getViewMatrix(layer));
+}
+
+//=============================================================================
+// Draw the chunks that intersect a rectangle of the map
+//=============================================================================
+void Tilemap::drawBounds(float left, float top, float right, float bottom, const D3DXMATRIX &viewMatrix) {
+	frame++;
+	chunksDrawn = 0;
+	quadsDrawn = 0;
+	if (chunks.empty())
+		return;
+
+	float chunkWidth = (float)(tilemapNS::CHUNK_SIZE * tileWidth);
+	float chunkHeight = (float)(tilemapNS::CHUNK_SIZE * tileHeight);
+	int cx0 = (int)floorf(left / chunkWidth);
+	int cy0 = (int)floorf(top / chunkHeight);
+	int cx1 = (int)floorf(right / chunkWidth);
+	int cy1 = (int)floorf(bottom / chunkHeight);
+	if (cx0 < 0) cx0 = 0;
+	if (cy0 < 0) cy0 = 0;
+	if (cx1 >= chunksX) cx1 = chunksX - 1;
+	if (cy1 >= chunksY) cy1 = chunksY - 1;
+
+	bool transformSet = false;
+	for (int cy = cy0; cy <= cy1; cy++) {
+		for (int cx = cx0; cx <= cx1; cx++) {
+			Chunk &chunk = chunks[cy * chunksX + cx];
+			if (chunk.dirty)
+				buildChunk(cx, cy);
+			chunk.lastDrawn = frame;
+			if (chunk.quads == 0)
+				continue;
+			if (graphics && chunk.vb) {
+				if (!transformSet) {
+					graphics->setScreenTransform(viewMatrix);
+					transformSet = true;
+				}
+				graphics->drawQuads(tileset ? tileset->getTexture() : NULL, chunk.vb, indices, chunk.quads);
+			}
+			chunksDrawn++;
+			quadsDrawn += chunk.quads;
+		}
+	}
+
+	if (frame % tilemapNS::EVICT_FRAMES == 0)
+		evictChunks();
+}
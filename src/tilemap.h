@@ -0,0 +1,159 @@
+#ifndef _TILEMAP_H
+#define _TILEMAP_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "textureManager.h"
+#include "constants.h"
+#include "camera.h"
+
+namespace tilemapNS {
+	const int   CHUNK_SIZE = 32;			// chunk width and height in tiles
+	const int   MAX_LAYERS = 8;				// keeps a chunk under 65536 vertices
+	const int   MAX_CHUNK_QUADS = CHUNK_SIZE * CHUNK_SIZE * MAX_LAYERS;
+	const int   EVICT_FRAMES = 300;			// free geometry of chunks not drawn for this many frames
+	const UINT  FILE_MAGIC = 0x4d545844;	// "DXTM"
+	const UINT  FILE_VERSION = 1;
+	const WORD  EMPTY = 0;					// tile number of an empty cell
+}
+
+// Map file header. Followed by layers * height * width tile numbers (WORD),
+// layer 0 first, each layer in rows from the top.
+// Tile numbers are TMX global tile ids with firstgid 1: 0 is empty, n is
+// tile n-1 of the tileset, counted in rows from the top left. A TMX map is
+// converted by writing the CSV data of each tile layer in this layout.
+struct TilemapHeader {
+	UINT32      magic;				// FILE_MAGIC
+	UINT32      version;			// FILE_VERSION
+	UINT32      width, height;		// size in tiles
+	UINT32      tileWidth, tileHeight;	// size of a tile in pixels
+	UINT32      layers;				// tile layers, drawn in order
+};
+
+// Layered tile map split into square chunks. The quads of a chunk are built
+// once into a static vertex buffer and rebuilt only after one of its tiles
+// changes. Drawing visits only the chunks that intersect the view, so the
+// cost of a frame depends on the view size, not the map size.
+// Chunk geometry is in managed memory and survives a device reset; the
+// owner of the tileset TextureManager handles its lost and reset calls.
+class Tilemap {
+private:
+	// One CHUNK_SIZE square of the map, all layers
+	struct Chunk {
+		LP_VERTEXBUFFER vb;			// static geometry, NULL until built
+		UINT        quads;			// quads in the geometry
+		UINT        capacity;		// quads vb can hold
+		int         lastDrawn;		// frame number of last draw
+		bool        dirty;			// tiles changed since geometry was built
+		bool        built;			// in the built list
+	};
+
+	Graphics    *graphics;		// pointer to graphics, NULL to build geometry without drawing
+	TextureManager *tileset;	// tile images
+	int         width, height;	// size in tiles
+	int         layers;
+	int         tileWidth, tileHeight;	// pixels
+	int         tilesetColumns;	// tiles per row of the tileset
+	float       texWidth, texHeight;	// tileset size in pixels
+	int         chunksX, chunksY;	// map size in chunks
+	std::vector<WORD> tiles;	// layers * height * width tile numbers
+	std::vector<Chunk> chunks;
+	std::vector<int> builtChunks;	// chunks with geometry, checked for eviction
+	std::vector<QuadVertex> vertices;	// scratch for building a chunk
+	LP_INDEXBUFFER indices;		// quad indices shared by all chunks
+	int         frame;			// frames drawn
+
+	// statistics
+	UINT        chunksDrawn;	// chunks drawn by the last draw()
+	UINT        quadsDrawn;		// quads drawn by the last draw()
+	UINT        chunksBuilt;	// chunk geometry builds since resetStats()
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Set up chunks for the current size. All chunks start dirty.
+	bool createChunks();
+
+	// Build the geometry of chunk cx, cy.
+	void buildChunk(int cx, int cy);
+
+	// Free the geometry of chunks not drawn for EVICT_FRAMES frames.
+	void evictChunks();
+
+	// Release all chunk geometry and the index buffer.
+	void releaseAll();
+
+	// Draw the chunks that intersect left, top, right, bottom (map pixels)
+	// through viewMatrix.
+	void drawBounds(float left, float top, float right, float bottom, const D3DXMATRIX &viewMatrix);
+
+public:
+	// Constructor
+	Tilemap();
+
+	// Destructor
+	virtual ~Tilemap();
+
+	// Load a map file.
+	// Pre: *g points to Graphics object, or NULL to build geometry without drawing
+	//      *tilesetM holds the tile images, may be NULL when g is NULL
+	// Post: returns false on error
+	bool initialize(Graphics *g, TextureManager *tilesetM, const char *file);
+
+	// Create an empty map of width x height tiles.
+	// Post: returns false on error
+	bool initialize(Graphics *g, TextureManager *tilesetM, int width, int height,
+		int layers, int tileWidth, int tileHeight);
+
+	// Save the map in the format read by initialize().
+	// Post: returns false on error
+	bool save(const char *file) const;
+
+	// Return the tile number at x, y of layer, EMPTY if outside the map.
+	WORD getTile(int layer, int x, int y) const {
+		if (layer < 0 || layer >= layers || x < 0 || x >= width || y < 0 || y >= height)
+			return tilemapNS::EMPTY;
+		return tiles[((size_t)layer * height + y) * width + x];
+	}
+
+	// Set the tile number at x, y of layer. The chunk holding the tile is
+	// rebuilt the next time it is drawn.
+	void setTile(int layer, int x, int y, WORD tile);
+
+	// Draw the part of the map inside the view.
+	// viewX, viewY = map pixel at the top left of the screen
+	// viewWidth, viewHeight = view size in pixels
+	// Pre: graphics->beginScene() has been called, sprite drawing has ended
+	void draw(float viewX, float viewY, float viewWidth, float viewHeight);
+
+	// Draw the part of the map the camera sees, as a layer of the camera.
+	// Pre: graphics->beginScene() has been called, sprite drawing has ended
+	void draw(const Camera2D &camera, int layer = cameraNS::WORLD_LAYER);
+
+	// Return map width in tiles.
+	int getWidth() const { return width; }
+
+	// Return map height in tiles.
+	int getHeight() const { return height; }
+
+	// Return number of layers.
+	int getLayers() const { return layers; }
+
+	// Return tile width in pixels.
+	int getTileWidth() const { return tileWidth; }
+
+	// Return tile height in pixels.
+	int getTileHeight() const { return tileHeight; }
+
+	// Return chunks drawn by the last draw().
+	UINT getChunksDrawn() const { return chunksDrawn; }
+
+	// Return quads drawn by the last draw().
+	UINT getQuadsDrawn() const { return quadsDrawn; }
+
+	// Return chunk geometry builds since resetStats().
+	UINT getChunksBuilt() const { return chunksBuilt; }
+
+	// Reset the build count.
+	void resetStats() { chunksBuilt = 0; }
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "timerWheel.h"
+#include <intrin.h>
+#include <string.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+TimerWheel::TimerWheel() {
+	now = 0;
+	fraction = 0;
+	count = 0;
+	firing = timerNS::NONE;
+	firingCancelled = false;
+	fired = 0;
+	moved = 0;
+	memset(heads, 0xff, sizeof(heads));
+	memset(occupied, 0, sizeof(occupied));
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+TimerWheel::~TimerWheel() {}
+
+//=============================================================================
+// Make room for maxTimers timers
+//=============================================================================
+bool TimerWheel::initialize(UINT maxTimers) {
+	timers.clear();
+	freeList.clear();
+	try {
+		timers.resize(maxTimers);
+		freeList.resize(maxTimers);
+	}
+	catch (...) {
+		timers.clear();
+		freeList.clear();
+		return false;
+	}
+	for (UINT i = 0; i < maxTimers; i++) {
+		timers[i].generation = 0;
+		timers[i].slot = timerNS::NONE;
+		freeList[i] = maxTimers - 1 - i;		// timer 0 is used first
+	}
+	memset(heads, 0xff, sizeof(heads));
+	memset(occupied, 0, sizeof(occupied));
+	now = 0;
+	fraction = 0;
+	count = 0;
+	firing = timerNS::NONE;
+	fired = 0;
+	moved = 0;
+	return true;
+}
+
+//=============================================================================
+// Link timer i at the head of a list
+//=============================================================================
+void TimerWheel::link(UINT i, UINT slot) {
+	Timer &t = timers[i];
+	t.slot = slot;
+	t.prev = timerNS::NONE;
+	t.next = heads[slot];
+	if (t.next != timerNS::NONE)
+		timers[t.next].prev = i;
+	heads[slot] = i;
+}
+
+//=============================================================================
+// Put timer i in the slot for its due tick
+// The level is the highest byte in which due differs from now, so the slot
+// moves down exactly when now reaches the start of its range.
+//=============================================================================
+void TimerWheel::insert(UINT i) {
+	using namespace timerNS;
+	UINT64 differ = timers[i].due ^ now;
+	int level = 0;
+	while (level < LEVELS - 1 && (differ >> (SLOT_BITS * (level + 1))) != 0)
+		level++;
+	UINT s = (UINT)(timers[i].due >> (SLOT_BITS * level)) & (SLOTS - 1);
+	link(i, level * SLOTS + s);
+	occupied[level][s >> 5] |= 1u << (s & 31);
+}
+
+//=============================================================================
+// Take timer i out of its list
+//=============================================================================
+void TimerWheel::unlink(UINT i) {
+	using namespace timerNS;
+	Timer &t = timers[i];
+	if (t.slot == NONE)
+		return;
+	if (t.prev != NONE)
+		timers[t.prev].next = t.next;
+	else
+		heads[t.slot] = t.next;
+	if (t.next != NONE)
+		timers[t.next].prev = t.prev;
+	if (heads[t.slot] == NONE && t.slot < (UINT)(LEVELS * SLOTS)) {
+		UINT s = t.slot % SLOTS;
+		occupied[t.slot / SLOTS][s >> 5] &= ~(1u << (s & 31));
+	}
+	t.slot = NONE;
+}
+
+//=============================================================================
+// Return the first slot of level in [first, last] with timers
+//=============================================================================
+int TimerWheel::findSlot(int level, UINT first, UINT last) const {
+	for (UINT w = first >> 5; w <= last >> 5; w++) {
+		DWORD bits = occupied[level][w];
+		if (w == first >> 5)
+			bits &= ~0u << (first & 31);
+		if (w == last >> 5 && (last & 31) != 31)
+			bits &= (2u << (last & 31)) - 1;
+		unsigned long bit;
+		if (_BitScanForward(&bit, bits))
+			return (int)(w * 32 + bit);
+	}
+	return -1;
+}
+
+//=============================================================================
+// Move the timers of the slots that start at now down the levels
+// Called when level 0 wraps. Each level above moves its next slot down, and
+// only wraps the level above it in turn when that slot is its first.
+//=============================================================================
+void TimerWheel::cascade() {
+	using namespace timerNS;
+	for (int level = 1; level < LEVELS; level++) {
+		UINT s = (UINT)(now >> (SLOT_BITS * level)) & (SLOTS - 1);
+		UINT slot = level * SLOTS + s;
+		UINT i = heads[slot];
+		heads[slot] = NONE;
+		occupied[level][s >> 5] &= ~(1u << (s & 31));
+		while (i != NONE) {
+			UINT next = timers[i].next;
+			insert(i);
+			moved++;
+			i = next;
+		}
+		if (s != 0)
+			break;
+	}
+}
+
+//=============================================================================
+// Call the timers in level 0 slot s
+// The slot is moved to the firing list first, and each timer is taken off
+// it before its callback, so callbacks can cancel any timer, including the
+// ones still to be called this tick.
+//=============================================================================
+void TimerWheel::fire(UINT s) {
+	using namespace timerNS;
+	const UINT FIRING = LEVELS * SLOTS;
+	UINT i = heads[s];
+	if (i == NONE)
+		return;
+	heads[s] = NONE;
+	occupied[0][s >> 5] &= ~(1u << (s & 31));
+	heads[FIRING] = i;
+	for (; i != NONE; i = timers[i].next)
+		timers[i].slot = FIRING;
+
+	while ((i = heads[FIRING]) != NONE) {
+		unlink(i);
+		Timer &t = timers[i];
+		if (t.period > 0) {						// due again, before the callback may cancel it
+			t.due += t.period;
+			insert(i);
+		}
+		PoolHandle h;
+		h.index = i;
+		h.generation = t.generation;
+		firing = i;
+		firingCancelled = false;
+		fired++;
+		t.callback(h);
+		firing = NONE;
+		if (firingCancelled) {					// ended by cancel(), free it now its callback is done
+			freeList.push_back(i);
+			count--;
+		}
+		else if (timers[i].period == 0)
+			release(i);
+	}
+}
+
+//=============================================================================
+// End timer i
+//=============================================================================
+void TimerWheel::release(UINT i) {
+	Timer &t = timers[i];
+	if ((t.generation & 1) == 0)
+		return;
+	unlink(i);
+	t.generation++;							// stale handles no longer match
+	freeList.push_back(i);
+	count--;
+}
+
+//=============================================================================
+// Schedule a timer
+//=============================================================================
+PoolHandle TimerWheel::schedule(float delay, const Callback &callback, float period) {
+	using namespace timerNS;
+	PoolHandle h;
+	if (freeList.empty())
+		return h;
+	UINT i = freeList.back();
+	freeList.pop_back();
+	Timer &t = timers[i];
+	double ticks = delay * (double)TICKS_PER_SECOND + 0.5;
+	UINT64 delayTicks = (ticks < 1) ? 1 : (ticks > MAX_DELAY) ? MAX_DELAY : (UINT64)ticks;
+	double periodTicks = (period > 0) ? period * (double)TICKS_PER_SECOND + 0.5 : 0;
+	t.callback = callback;
+	t.due = now + delayTicks;
+	t.period = (period <= 0) ? 0 : (periodTicks < 1) ? 1 : (periodTicks > MAX_DELAY) ? (UINT)MAX_DELAY : (UINT)periodTicks;
+	t.generation++;							// odd while scheduled
+	insert(i);
+	count++;
+	h.index = i;
+	h.generation = t.generation;
+	return h;
+}
+
+//=============================================================================
+// Stop a timer
+// A timer cancelled by its own callback ends at once, but its slot is not
+// freed until the callback returns, so the callback is not overwritten.
+//=============================================================================
+bool TimerWheel::cancel(PoolHandle h) {
+	if (!isPending(h))
+		return false;
+	if (h.index == firing) {
+		unlink(h.index);
+		timers[h.index].generation++;
+		firingCancelled = true;
+		return true;
+	}
+	release(h.index);
+	return true;
+}
+
+//=============================================================================
+// Stop all timers
+//=============================================================================
+void TimerWheel::clear() {
+	for (UINT i = 0; i < timers.size(); i++) {
+		PoolHandle h;
+		h.index = i;
+		h.generation = timers[i].generation;
+		cancel(h);
+	}
+}
+
+//=============================================================================
+// Advance time, calling timers as they come due
+// Level 0 is searched for the next slot with timers up to the target or the
+// end of its turn, whichever is first. Empty stretches are skipped a turn of
+// level 0 at a time.
+//=============================================================================
+void TimerWheel::advance(float seconds) {
+	using namespace timerNS;
+	if (seconds > 0)
+		fraction += seconds * (double)TICKS_PER_SECOND;
+	if (fraction < 1)
+		return;
+	UINT64 ticks = (UINT64)fraction;
+	fraction -= (double)ticks;
+	UINT64 target = now + ticks;
+
+	while (now < target) {
+		UINT64 base = now & ~(UINT64)(SLOTS - 1);
+		UINT first = (UINT)(now - base) + 1;
+		UINT last = (target - base >= (UINT64)SLOTS) ? SLOTS - 1 : (UINT)(target - base);
+		int s = (first <= last) ? findSlot(0, first, last) : -1;
+		if (s >= 0) {
+			now = base + s;
+			fire((UINT)s);
+			continue;
+		}
+		if (target - base < (UINT64)SLOTS) {	// nothing due before the target
+			now = target;
+			break;
+		}
+		now = base + SLOTS;						// level 0 wraps
+		cascade();
+		fire(0);
+	}
+}
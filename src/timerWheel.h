@@ -0,0 +1,140 @@
+#ifndef _TIMERWHEEL_H
+#define _TIMERWHEEL_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <Windows.h>
+#include <vector>
+#include <functional>
+#include "objectPool.h"
+
+namespace timerNS {
+	const int    SLOT_BITS = 8;
+	const int    SLOTS = 1 << SLOT_BITS;	// slots in each level
+	const int    LEVELS = 4;				// level n slots are SLOTS^n ticks wide
+	const float  TICKS_PER_SECOND = 1000.0f;
+	const UINT64 MAX_DELAY = 0xff000000;	// longest delay in ticks, about 49 days, so a timer never
+											// lands in the top level slot that has already moved down
+	const UINT   NONE = 0xffffffff;			// no timer, or a timer in no slot
+}
+
+// Schedules one-shot and repeating callbacks on a hierarchical timer wheel.
+// Time is counted in ticks of 1 ms. Level 0 has a slot for each of the next
+// 256 ticks, level 1 a slot for each of the next 256 runs of 256 ticks, and
+// so on; a timer goes in the level of the highest byte in which its due
+// tick differs from now. When level 0 wraps, the next slot of level 1 is
+// moved down, and so on up the levels, so each timer is moved at most once
+// per level. Scheduling and cancelling are O(1), and advance() skips empty
+// slots with a bitmap of each level, so it only touches the slots that
+// expire or move down.
+// Timers live in a fixed number of slots allocated by initialize(), with
+// handles that go stale when the timer ends, as ObjectPool handles do.
+class TimerWheel {
+public:
+	// Called when a timer is due, with its handle. A callback may schedule
+	// and cancel timers, including its own.
+	typedef std::function<void(PoolHandle timer)> Callback;
+
+private:
+	struct Timer {
+		Callback    callback;
+		UINT64      due;				// tick the timer fires on
+		UINT        period;				// ticks between repeats, 0 for one-shot
+		UINT        generation;			// odd while scheduled
+		UINT        next, prev;			// neighbours in its slot
+		UINT        slot;				// list the timer is in, NONE for none
+	};
+
+	std::vector<Timer> timers;
+	std::vector<UINT> freeList;			// stack of free timers
+	UINT        heads[timerNS::LEVELS * timerNS::SLOTS + 1];	// first timer of each slot, then the firing list
+	DWORD       occupied[timerNS::LEVELS][timerNS::SLOTS / 32];	// bit set for slots with timers
+	UINT64      now;					// ticks since initialize()
+	double      fraction;				// part of a tick advanced but not yet counted
+	UINT        count;					// timers scheduled
+	UINT        firing;					// timer whose callback is running, NONE if none
+	bool        firingCancelled;		// it was cancelled by its own callback
+	UINT64      fired;					// callbacks called
+	UINT64      moved;					// timers moved down a level
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Put timer i in the slot for its due tick.
+	void insert(UINT i);
+
+	// Take timer i out of its slot.
+	void unlink(UINT i);
+
+	// Link timer i at the head of list slot.
+	void link(UINT i, UINT slot);
+
+	// Return the first slot of level in [first, last] with timers, -1 if none.
+	int findSlot(int level, UINT first, UINT last) const;
+
+	// Move the timers of the level slots that start at now down the levels.
+	void cascade();
+
+	// Call the timers in level 0 slot s, which are due now.
+	void fire(UINT s);
+
+	// End timer i and free its slot.
+	void release(UINT i);
+
+	// Wheels hold callbacks that refer to their owners, so they are not copied
+	TimerWheel(const TimerWheel&);
+	TimerWheel& operator=(const TimerWheel&);
+
+public:
+	// Constructor
+	TimerWheel();
+
+	// Destructor
+	virtual ~TimerWheel();
+
+	// Make room for maxTimers timers scheduled at once, and start at time 0.
+	// Post: returns false if out of memory
+	bool initialize(UINT maxTimers);
+
+	// Call callback after delay seconds, then every period seconds if
+	// period > 0. Delays round to the nearest tick, at least 1.
+	// Returns the timer's handle, or an invalid handle if the wheel is full.
+	// A timer keeps its slot until its last callback returns, so a one-shot
+	// timer that schedules another needs a free slot.
+	PoolHandle schedule(float delay, const Callback &callback, float period = 0.0f);
+
+	// Stop a timer. Returns false if h is stale or invalid.
+	bool cancel(PoolHandle h);
+
+	// Stop all timers.
+	void clear();
+
+	// Advance time by seconds, calling timers as they come due, in order of
+	// due tick. Timers due on the same tick are called in no set order. A
+	// repeating timer is called once for each period that passes.
+	void advance(float seconds);
+
+	// Return true if h refers to a timer that has not ended.
+	bool isPending(PoolHandle h) const {
+		return h.index < timers.size() && timers[h.index].generation == h.generation && (h.generation & 1);
+	}
+
+	// Return seconds until h is due, 0 if it is stale or invalid.
+	float getRemaining(PoolHandle h) const {
+		return isPending(h) ? (timers[h.index].due - now) / timerNS::TICKS_PER_SECOND : 0.0f;
+	}
+
+	// Return number of timers scheduled.
+	UINT getCount() const { return count; }
+
+	// Return most timers scheduled at once.
+	UINT getCapacity() const { return (UINT)timers.size(); }
+
+	// Return ticks since initialize().
+	UINT64 getTicks() const { return now; }
+
+	// Return callbacks called since initialize().
+	UINT64 getFired() const { return fired; }
+
+	// Return times a timer was moved down a level since initialize().
+	UINT64 getMoved() const { return moved; }
+};
+
+#endif
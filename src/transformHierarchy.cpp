@@ -0,0 +1,320 @@
+#include "transformHierarchy.h"
+#include "image.h"
+#include <math.h>
+#include <string.h>
+
+//=============================================================================
+// Constructor
+//=============================================================================
+TransformHierarchy::TransformHierarchy() {
+	firstDirty = 0;
+	orderDirty = false;
+	updated = 0;
+}
+
+//=============================================================================
+// Destructor
+//=============================================================================
+TransformHierarchy::~TransformHierarchy() {}
+
+//=============================================================================
+// Reserve space for maxNodes nodes
+//=============================================================================
+bool TransformHierarchy::initialize(int maxNodes) {
+	clear();
+	try {
+		nodeParent.reserve(maxNodes);
+		nodePosition.reserve(maxNodes);
+		order.reserve(maxNodes);
+		parents.reserve(maxNodes);
+		locals.reserve(maxNodes);
+		worlds.reserve(maxNodes);
+		dirty.reserve(maxNodes);
+		childStart.reserve(maxNodes + 1);
+		children.reserve(maxNodes);
+		newOrder.reserve(maxNodes);
+		newParents.reserve(maxNodes);
+		newLocals.reserve(maxNodes);
+		newWorlds.reserve(maxNodes);
+	}
+	catch (...) { return false; }
+	return true;
+}
+
+//=============================================================================
+// Add a node with the identity local transform
+//=============================================================================
+int TransformHierarchy::add(int parent) {
+	if (parent != transformNS::NONE && !isValid(parent))
+		return transformNS::NONE;
+	int n;
+	if (!freeNodes.empty()) {
+		n = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		n = (int)nodeParent.size();
+		nodeParent.push_back(transformNS::NONE);
+		nodePosition.push_back(transformNS::NONE);
+	}
+	nodeParent[n] = parent;
+	nodePosition[n] = (int)order.size();
+
+	// appended after its parent, so update() is correct before the order is rebuilt
+	LocalTransform local = { 0.0f, 0.0f, 0.0f, 1.0f };
+	WorldTransform world = { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+	order.push_back(n);
+	parents.push_back(parent == transformNS::NONE ? transformNS::NONE : nodePosition[parent]);
+	locals.push_back(local);
+	worlds.push_back(world);
+	dirty.push_back(0);
+	markDirty(n);
+	orderDirty = true;
+	return n;
+}
+
+//=============================================================================
+// Remove a node; its descendants are freed by rebuildOrder()
+//=============================================================================
+void TransformHierarchy::remove(int n) {
+	if (!isValid(n))
+		return;
+	nodeParent[n] = transformNS::REMOVED;
+	orderDirty = true;
+}
+
+//=============================================================================
+// Move a node to a new parent
+//=============================================================================
+bool TransformHierarchy::setParent(int n, int parent) {
+	if (!isValid(n))
+		return false;
+	if (parent != transformNS::NONE) {
+		if (!isValid(parent))
+			return false;
+		for (int p = parent; p >= 0; p = nodeParent[p])	// no cycles
+			if (p == n)
+				return false;
+	}
+	if (nodeParent[n] == parent)
+		return true;
+	nodeParent[n] = parent;
+	markDirty(n);
+	orderDirty = true;
+	return true;
+}
+
+//=============================================================================
+// Set the local transform of a node
+//=============================================================================
+void TransformHierarchy::setLocal(int n, float x, float y, float angle, float scale) {
+	LocalTransform &local = locals[nodePosition[n]];
+	local.x = x;
+	local.y = y;
+	local.angle = angle;
+	local.scale = scale;
+	markDirty(n);
+}
+
+//=============================================================================
+// Set the local position of a node
+//=============================================================================
+void TransformHierarchy::setPosition(int n, float x, float y) {
+	LocalTransform &local = locals[nodePosition[n]];
+	local.x = x;
+	local.y = y;
+	markDirty(n);
+}
+
+//=============================================================================
+// Set the local rotation of a node
+//=============================================================================
+void TransformHierarchy::setAngle(int n, float angle) {
+	locals[nodePosition[n]].angle = angle;
+	markDirty(n);
+}
+
+//=============================================================================
+// Set the local scale of a node
+//=============================================================================
+void TransformHierarchy::setScale(int n, float scale) {
+	locals[nodePosition[n]].scale = scale;
+	markDirty(n);
+}
+
+//=============================================================================
+// Store the nodes breadth first
+// Children are grouped by parent with a counting sort, then the roots and
+// their descendants are visited level by level. Nodes that are not reached
+// were removed, or are descendants of removed nodes, and are freed.
+// Dirty flags move with their nodes.
+//=============================================================================
+void TransformHierarchy::rebuildOrder() {
+	using namespace transformNS;
+	orderDirty = false;
+	int nodes = (int)nodeParent.size();
+	int count = (int)order.size();
+
+	// group children by parent, keeping their current order
+	childStart.assign(nodes + 1, 0);
+	for (int p = 0; p < count; p++) {
+		int parent = nodeParent[order[p]];
+		if (parent >= 0)
+			childStart[parent + 1]++;
+	}
+	for (int n = 0; n < nodes; n++)
+		childStart[n + 1] += childStart[n];
+	children.resize(childStart[nodes]);
+	newParents.assign(childStart.begin(), childStart.end() - 1);	// fill position of each parent
+	for (int p = 0; p < count; p++) {
+		int parent = nodeParent[order[p]];
+		if (parent >= 0)
+			children[newParents[parent]++] = order[p];
+	}
+
+	// roots, then each level in turn
+	newOrder.clear();
+	for (int p = 0; p < count; p++)
+		if (nodeParent[order[p]] == NONE)
+			newOrder.push_back(order[p]);
+	for (size_t k = 0; k < newOrder.size(); k++) {
+		int n = newOrder[k];
+		for (int c = childStart[n]; c < childStart[n + 1]; c++)
+			newOrder.push_back(children[c]);
+	}
+
+	// move node data to the new positions
+	int newCount = (int)newOrder.size();
+	newLocals.resize(newCount);
+	newWorlds.resize(newCount);
+	newParents.resize(newCount);
+	for (int k = 0; k < newCount; k++) {
+		int old = nodePosition[newOrder[k]];
+		newLocals[k] = locals[old];
+		newWorlds[k] = worlds[old];
+		newParents[k] = dirty[old];				// dirty flag, until positions are known
+	}
+	for (int p = 0; p < count; p++)
+		nodePosition[order[p]] = NONE;
+	dirty.resize(newCount);
+	firstDirty = newCount;
+	for (int k = 0; k < newCount; k++) {
+		nodePosition[newOrder[k]] = k;
+		dirty[k] = (BYTE)newParents[k];
+		if (dirty[k] && k < firstDirty)
+			firstDirty = k;
+	}
+	for (int k = 0; k < newCount; k++) {		// parents come first, so have their positions
+		int parent = nodeParent[newOrder[k]];
+		newParents[k] = (parent == NONE) ? NONE : nodePosition[parent];
+	}
+
+	// free nodes that were not reached
+	for (int p = 0; p < count; p++) {
+		int n = order[p];
+		if (nodePosition[n] == NONE) {
+			nodeParent[n] = NONE;
+			freeNodes.push_back(n);
+		}
+	}
+
+	order.swap(newOrder);
+	parents.swap(newParents);
+	locals.swap(newLocals);
+	worlds.swap(newWorlds);
+}
+
+//=============================================================================
+// Recompute world transforms of dirty nodes and their descendants
+// One pass from the lowest dirty position. A node is recomputed if it is
+// dirty or its parent was recomputed in this pass; its parent is always
+// earlier, so is already up to date.
+//=============================================================================
+void TransformHierarchy::update() {
+	bool reordered = orderDirty;
+	if (orderDirty)
+		rebuildOrder();
+	updated = 0;
+	int count = (int)order.size();
+	for (int p = firstDirty; p < count; p++) {
+		int parent = parents[p];
+		if (!dirty[p]) {
+			if (parent == transformNS::NONE || !dirty[parent])
+				continue;
+			dirty[p] = 1;						// descendants follow
+		}
+
+		// local rotation and scale, then translation
+		const LocalTransform &l = locals[p];
+		float c = cosf(l.angle) * l.scale;
+		float s = sinf(l.angle) * l.scale;
+		WorldTransform &w = worlds[p];
+		if (parent == transformNS::NONE) {
+			w.m11 = c;  w.m12 = s;
+			w.m21 = -s; w.m22 = c;
+			w.dx = l.x; w.dy = l.y;
+		}
+		else {									// local * parent world
+			const WorldTransform &pw = worlds[parent];
+			w.m11 = c * pw.m11 + s * pw.m21;
+			w.m12 = c * pw.m12 + s * pw.m22;
+			w.m21 = -s * pw.m11 + c * pw.m21;
+			w.m22 = -s * pw.m12 + c * pw.m22;
+			w.dx = l.x * pw.m11 + l.y * pw.m21 + pw.dx;
+			w.dy = l.x * pw.m12 + l.y * pw.m22 + pw.dy;
+		}
+		updated++;
+	}
+	if (firstDirty < count)
+		memset(&dirty[firstDirty], 0, count - firstDirty);
+	firstDirty = count;
+	if (updated > 0 || reordered)			// attached images move, for drawing on demand
+		imageNS::markChanged();
+}
+
+//=============================================================================
+// Return the world transform of a node as a D3DXMATRIX
+//=============================================================================
+void TransformHierarchy::getWorldMatrix(int n, D3DXMATRIX &matrix) const {
+	const WorldTransform &w = worlds[nodePosition[n]];
+	D3DXMatrixIdentity(&matrix);
+	matrix._11 = w.m11;
+	matrix._12 = w.m12;
+	matrix._21 = w.m21;
+	matrix._22 = w.m22;
+	matrix._41 = w.dx;
+	matrix._42 = w.dy;
+}
+
+//=============================================================================
+// Return the world rotation of a node
+//=============================================================================
+float TransformHierarchy::getWorldAngle(int n) const {
+	const WorldTransform &w = worlds[nodePosition[n]];
+	return atan2f(w.m12, w.m11);
+}
+
+//=============================================================================
+// Return the world scale of a node
+//=============================================================================
+float TransformHierarchy::getWorldScale(int n) const {
+	const WorldTransform &w = worlds[nodePosition[n]];
+	return sqrtf(w.m11 * w.m11 + w.m12 * w.m12);
+}
+
+//=============================================================================
+// Remove all nodes
+//=============================================================================
+void TransformHierarchy::clear() {
+	nodeParent.clear();
+	nodePosition.clear();
+	freeNodes.clear();
+	order.clear();
+	parents.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	firstDirty = 0;
+	orderDirty = false;
+	updated = 0;
+}
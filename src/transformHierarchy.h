@@ -0,0 +1,152 @@
+#ifndef _TRANSFORMHIERARCHY_H
+#define _TRANSFORMHIERARCHY_H
+#define WIN32_LEAN_AND_MEAN
+
+#include <vector>
+#include "graphics.h"
+
+namespace transformNS {
+	const int   NONE = -1;				// no parent, or no node
+	const int   REMOVED = -2;			// parent of a node removed since the last update()
+}
+
+// Transform of a node relative to its parent. The node is rotated by angle
+// (radians, clockwise) and scaled about its origin, then moved to x,y.
+struct LocalTransform {
+	float       x, y;
+	float       angle;
+	float       scale;
+};
+
+// World transform of a node. A point x,y maps to
+// (x * m11 + y * m21 + dx, x * m12 + y * m22 + dy), the row vector
+// convention of D3DXMATRIX.
+struct WorldTransform {
+	float       m11, m12;
+	float       m21, m22;
+	float       dx, dy;
+};
+
+// Parent/child hierarchy of 2D transforms, such as turrets attached to a
+// ship. Nodes keep a local transform and a cached world transform, which
+// update() recomputes only for nodes that changed and their descendants.
+// Node data is stored in breadth first order so a parent always comes
+// before its children and update() is one forward pass over packed arrays.
+// Nodes are referred to by number; numbers of removed nodes are reused.
+class TransformHierarchy {
+private:
+	// By node number
+	std::vector<int> nodeParent;		// parent node, NONE for a root, REMOVED
+	std::vector<int> nodePosition;		// position in the arrays below, NONE if free
+	std::vector<int> freeNodes;			// unused node numbers
+
+	// By position, breadth first
+	std::vector<int> order;				// node at each position
+	std::vector<int> parents;			// position of the parent, NONE for a root
+	std::vector<LocalTransform> locals;
+	std::vector<WorldTransform> worlds;
+	std::vector<BYTE> dirty;			// local transform changed, or parent was recomputed
+	int         firstDirty;				// lowest dirty position
+	bool        orderDirty;				// nodes were added, removed or moved to another parent
+	int         updated;				// nodes recomputed by the last update()
+
+	// Scratch space for rebuildOrder()
+	std::vector<int> childStart;
+	std::vector<int> children;
+	std::vector<int> newOrder;
+	std::vector<int> newParents;
+	std::vector<LocalTransform> newLocals;
+	std::vector<WorldTransform> newWorlds;
+
+	// (For internal engine use only. No user serviceable parts inside.)
+	// Store the nodes breadth first and free the descendants of removed nodes.
+	void rebuildOrder();
+
+	// Mark node n for recomputing.
+	void markDirty(int n) {
+		int p = nodePosition[n];
+		dirty[p] = 1;
+		if (p < firstDirty)
+			firstDirty = p;
+	}
+
+public:
+	// Constructor
+	TransformHierarchy();
+
+	// Destructor
+	virtual ~TransformHierarchy();
+
+	// Reserve space for maxNodes nodes.
+	// Post: returns false on error
+	bool initialize(int maxNodes);
+
+	// Add a node with the identity local transform.
+	// parent = NONE for a root.
+	// Returns the node number, NONE if parent is not a node.
+	int add(int parent = transformNS::NONE);
+
+	// Remove node n. Its descendants are removed by the next update().
+	void remove(int n);
+
+	// Move node n to a new parent, NONE to make it a root.
+	// Returns false if parent is n or one of its descendants.
+	bool setParent(int n, int parent);
+
+	// Return the parent of node n, NONE for a root.
+	int getParent(int n) const { return nodeParent[n]; }
+
+	// Return true if n is a node.
+	bool isValid(int n) const {
+		return n >= 0 && n < (int)nodeParent.size() && nodePosition[n] != transformNS::NONE &&
+			nodeParent[n] != transformNS::REMOVED;
+	}
+
+	// Set the local transform of node n.
+	void setLocal(int n, float x, float y, float angle, float scale);
+
+	// Set the local position of node n.
+	void setPosition(int n, float x, float y);
+
+	// Set the local rotation of node n in radians.
+	void setAngle(int n, float angle);
+
+	// Set the local scale of node n.
+	void setScale(int n, float scale);
+
+	// Return the local transform of node n.
+	const LocalTransform& getLocal(int n) const { return locals[nodePosition[n]]; }
+
+	// Recompute the world transforms of changed nodes and their descendants.
+	// Call once per frame after moving nodes and before drawing.
+	void update();
+
+	// Return the world transform of node n as of the last update().
+	const WorldTransform& getWorld(int n) const { return worlds[nodePosition[n]]; }
+
+	// Return the world transform of node n as a D3DXMATRIX.
+	void getWorldMatrix(int n, D3DXMATRIX &matrix) const;
+
+	// Return the world X of node n's origin.
+	float getWorldX(int n) const { return worlds[nodePosition[n]].dx; }
+
+	// Return the world Y of node n's origin.
+	float getWorldY(int n) const { return worlds[nodePosition[n]].dy; }
+
+	// Return the world rotation of node n in radians.
+	float getWorldAngle(int n) const;
+
+	// Return the world scale of node n.
+	float getWorldScale(int n) const;
+
+	// Remove all nodes.
+	void clear();
+
+	// Return number of nodes.
+	int getCount() const { return (int)order.size(); }
+
+	// Return number of nodes recomputed by the last update().
+	int getUpdated() const { return updated; }
+};
+
+#endif
@@ -4,11 +4,16 @@
 #include <Windows.h>
 #include <stdlib.h>				// for detecting memory leaks
 #include <crtdbg.h>				// for detecting memory leaks
+#include <sstream>
+#include <string>
 #include "samplegame.h"
+#include "benchmarks.h"
+#include "assetPack.h"
 
 // Function prototypes
 int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int);
 bool CreateMainWindow(HWND &, HINSTANCE, int);
+void StartCommandLineModes(LPSTR);
 LRESULT WINAPI WinProc(HWND, UINT, WPARAM, LPARAM);
 
 // Game pointer
@@ -26,15 +31,42 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
 	MSG msg;
 
+	// Headless subsystem benchmark: -bench <name> <report>
+	std::istringstream args(lpCmdLine);
+	std::string arg, name, report;
+	if (args >> arg && arg == "-bench") {
+		args >> name >> report;
+		if (benchmarkNS::runBenchmark(name.c_str(), report.c_str()))
+			return 0;
+		MessageBox(NULL, ("Error running benchmark " + name).c_str(), "Error", MB_OK);
+		return 1;
+	}
+
+	// Asset packer: -pack <dir> <file> [-lz4]
+	if (arg == "-pack") {
+		std::string dir, file, option;
+		args >> dir >> file >> option;
+		if (assetPackNS::build(dir.c_str(), file.c_str(), option == "-lz4"))
+			return 0;
+		MessageBox(NULL, ("Error packing " + dir).c_str(), "Error", MB_OK);
+		return 1;
+	}
+
 	// Create the game, sets up message handler
 	game = new SampleGame;
 
+	// Replays and benchmarks run without showing the window
+	std::string cmdLine = lpCmdLine;
+	if (cmdLine.find("-replay") != std::string::npos || cmdLine.find("-benchmark") != std::string::npos)
+		nCmdShow = SW_HIDE;
+
 	// Create the window
 	if (!CreateMainWindow(hwnd, hInstance, nCmdShow))
 		return 1;
 
 	try {
 		game->initialize(hwnd);     // throws GameError
+		StartCommandLineModes(lpCmdLine); // throws GameError
 
 		// main message loop
 		int done = 0;
@@ -48,8 +80,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 				TranslateMessage(&msg);
 				DispatchMessage(&msg);
 			}
-			else
+			else {
 				game->run(hwnd);    // run the game loop
+				// sleep until a message arrives or the next frame is due
+				if (game->getWaitTime() > 0)
+					MsgWaitForMultipleObjects(0, NULL, FALSE, game->getWaitTime(), QS_ALLINPUT);
+			}
 		}
 		SAFE_DELETE(game);     // free memory before exit
 		return msg.wParam;
@@ -69,6 +105,46 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 	return 0;
 }
 
+//=============================================================================
+// Start input recording, replay or benchmark from the command line
+//   -record <file>             record input to file
+//   -replay <file>             replay recorded input, then exit
+//   -benchmark <file> <report> replay and write per-frame timings to report
+//   -frametime <seconds>       fixed frameTime for -replay and -benchmark
+//   -strictalloc               forbid heap allocations in steady-state frames
+//   -timeline <file>           write the asset loading timeline to file
+// throws GameError on error
+//=============================================================================
+void StartCommandLineModes(LPSTR lpCmdLine) {
+	std::istringstream args(lpCmdLine);
+	std::string arg, record, replay, report;
+	float frameTime = 0;
+	while (args >> arg) {
+		if (arg == "-record")
+			args >> record;
+		else if (arg == "-replay")
+			args >> replay;
+		else if (arg == "-benchmark")
+			args >> replay >> report;
+		else if (arg == "-frametime")
+			args >> frameTime;
+		else if (arg == "-strictalloc")
+			game->setStrictAllocations(true);
+		else if (arg == "-timeline") {
+			std::string timeline;
+			args >> timeline;
+			game->writeStartupTimeline(timeline.c_str());
+		}
+	}
+
+	if (!report.empty())
+		game->startBenchmark(replay.c_str(), report.c_str(), frameTime);
+	else if (!replay.empty())
+		game->startReplay(replay.c_str(), frameTime);
+	else if (!record.empty())
+		game->startRecording(record.c_str());
+}
+
 //=============================================================================
 // window event callback function
 //=============================================================================